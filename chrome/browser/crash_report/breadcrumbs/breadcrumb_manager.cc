@@ -4,6 +4,7 @@
 
 #include "ios/chrome/browser/crash_report/breadcrumbs/breadcrumb_manager.h"
 
+#include "base/check_op.h"
 #include "base/strings/stringprintf.h"
 #include "base/time/time.h"
 #include "ios/chrome/browser/crash_report/breadcrumbs/breadcrumb_manager_observer.h"
@@ -12,17 +13,14 @@
 namespace {
 
 // The maximum number of breadcrumbs which are expected to be useful to store.
-// NOTE: Events are "bucketed" into groups by short time intervals to make it
-// more efficient to manage the continuous dropping of old events. Since events
-// are only dropped at the bucket level, it is expected that the total number of
-// stored breadcrumbs will exceed this value. This value should be close to the
-// upper limit of useful events. (Most events + timestamp breadcrumbs are
-// currently longer than 10 characters.)
+// This value should be close to the upper limit of useful events. (Most events
+// + timestamp breadcrumbs are currently longer than 10 characters.) Events are
+// stored in a ring buffer of this size.
 constexpr unsigned long kMaxUsefulBreadcrumbEvents =
     kMaxBreadcrumbsDataLength / 10;
 
 // The minimum number of event buckets to keep, even if they are expired.
-const int kMinEventsBuckets = 2;
+const size_t kMinEventsBuckets = 2;
 
 // Returns a Time used to bucket events for easier discarding of expired events.
 base::Time EventBucket(const base::Time& time) {
@@ -39,66 +37,98 @@ base::Time EventBucket(const base::Time& time) {
 
 }  // namespace
 
-BreadcrumbManager::BreadcrumbManager() : start_time_(base::Time::Now()) {}
+BreadcrumbManager::BreadcrumbManager()
+    : BreadcrumbManager(kMaxUsefulBreadcrumbEvents) {}
+
+BreadcrumbManager::BreadcrumbManager(size_t capacity)
+    : start_time_(base::Time::Now()), events_(capacity) {
+  DCHECK_GT(capacity, 0ul);
+}
 
 BreadcrumbManager::~BreadcrumbManager() = default;
 
 size_t BreadcrumbManager::GetEventCount() {
   DropOldEvents();
-
-  size_t count = 0;
-  for (auto it = event_buckets_.rbegin(); it != event_buckets_.rend(); ++it) {
-    std::list<std::string> bucket_events = it->second;
-    count += bucket_events.size();
-  }
-  return count;
+  return event_count_;
 }
 
 const std::list<std::string> BreadcrumbManager::GetEvents(
     size_t event_count_limit) {
+  EventsView view = GetEventsView(event_count_limit);
+  return std::list<std::string>(view.begin(), view.end());
+}
+
+BreadcrumbManager::EventsView BreadcrumbManager::GetEventsView(
+    size_t event_count_limit) {
   DropOldEvents();
 
-  std::list<std::string> events;
-  for (auto it = event_buckets_.rbegin(); it != event_buckets_.rend(); ++it) {
-    std::list<std::string> bucket_events = it->second;
-    for (auto event_it = bucket_events.rbegin();
-         event_it != bucket_events.rend(); ++event_it) {
-      std::string event = *event_it;
-      events.push_front(event);
-      if (event_count_limit > 0 && events.size() >= event_count_limit) {
-        return events;
-      }
-    }
+  size_t count = event_count_;
+  if (event_count_limit > 0 && event_count_limit < count) {
+    count = event_count_limit;
   }
-  return events;
+  const size_t position =
+      (oldest_event_index_ + event_count_ - count) % events_.size();
+  return EventsView(&events_, position, count);
 }
 
 void BreadcrumbManager::AddEvent(const std::string& event) {
   base::Time time = base::Time::Now();
   base::Time bucket_time = EventBucket(time);
 
-  // If bucket exists, it will be at the end of the list.
-  if (event_buckets_.empty() || event_buckets_.back().first != bucket_time) {
-    std::pair<base::Time, std::list<std::string>> bucket(
-        bucket_time, std::list<std::string>());
-    event_buckets_.push_back(bucket);
+  // Overwrite the oldest event once the buffer is full. Observers are only
+  // notified once every event of the oldest bucket has been overwritten, as
+  // for expired buckets.
+  bool oldest_bucket_removed = false;
+  if (event_count_ == events_.size()) {
+    oldest_bucket_removed = PopOldestEvent();
+  }
+
+  // If the bucket already exists, it is the bucket of the newest event.
+  const size_t newest_event_index =
+      (oldest_event_index_ + event_count_ + events_.size() - 1) %
+      events_.size();
+  if (event_count_ == 0 ||
+      events_[newest_event_index].bucket_time != bucket_time) {
+    ++bucket_count_;
   }
 
   base::Time::Exploded exploded;
   time.UTCExplode(&exploded);
-  std::string timestamp =
-      base::StringPrintf("%02d:%02d", exploded.minute, exploded.second);
-  std::string event_log =
-      base::StringPrintf("%s %s", timestamp.c_str(), event.c_str());
-  event_buckets_.back().second.push_back(event_log);
+  Event& slot = events_[(oldest_event_index_ + event_count_) % events_.size()];
+  slot.bucket_time = bucket_time;
+  // Reuse the existing storage of |slot.event| rather than assigning a newly
+  // formatted string.
+  slot.event.clear();
+  base::StringAppendF(&slot.event, "%02d:%02d %s", exploded.minute,
+                      exploded.second, event.c_str());
+  ++event_count_;
 
   for (auto& observer : observers_) {
-    observer.EventAdded(this, event_log);
+    observer.EventAdded(this, slot.event);
+  }
+
+  if (oldest_bucket_removed) {
+    for (auto& observer : observers_) {
+      observer.OldEventsRemoved(this);
+    }
   }
 
   DropOldEvents();
 }
 
+bool BreadcrumbManager::PopOldestEvent() {
+  DCHECK_GT(event_count_, 0ul);
+  const base::Time bucket_time = events_[oldest_event_index_].bucket_time;
+  oldest_event_index_ = (oldest_event_index_ + 1) % events_.size();
+  --event_count_;
+  if (event_count_ == 0 ||
+      events_[oldest_event_index_].bucket_time != bucket_time) {
+    --bucket_count_;
+    return true;
+  }
+  return false;
+}
+
 void BreadcrumbManager::DropOldEvents() {
   static const base::TimeDelta kMessageExpirationTime =
       base::TimeDelta::FromMinutes(20);
@@ -106,27 +136,18 @@ void BreadcrumbManager::DropOldEvents() {
   bool old_buckets_dropped = false;
   base::Time now = base::Time::Now();
   // Drop buckets which are more than kMessageExpirationTime old.
-  while (event_buckets_.size() > kMinEventsBuckets) {
-    base::Time oldest_bucket_time = event_buckets_.front().first;
+  while (bucket_count_ > kMinEventsBuckets) {
+    const base::Time oldest_bucket_time =
+        events_[oldest_event_index_].bucket_time;
     if (now - oldest_bucket_time < kMessageExpirationTime) {
       break;
     }
-    event_buckets_.pop_front();
-    old_buckets_dropped = true;
-  }
-
-  // Drop buckets if the data is unlikely to ever be needed.
-  unsigned long newer_event_count = 0;
-  auto event_bucket_it = event_buckets_.rbegin();
-  while (event_bucket_it != event_buckets_.rend()) {
-    std::list<std::string> bucket_events = event_bucket_it->second;
-    if (newer_event_count > kMaxUsefulBreadcrumbEvents) {
-      event_buckets_.erase(event_buckets_.begin(), event_bucket_it.base());
-      old_buckets_dropped = true;
-      break;
+    // Drop every event of the oldest bucket.
+    while (event_count_ > 0 &&
+           events_[oldest_event_index_].bucket_time == oldest_bucket_time) {
+      PopOldestEvent();
     }
-    newer_event_count += bucket_events.size();
-    ++event_bucket_it;
+    old_buckets_dropped = true;
   }
 
   if (old_buckets_dropped) {
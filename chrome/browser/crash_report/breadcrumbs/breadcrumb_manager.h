@@ -5,9 +5,11 @@
 #ifndef IOS_CHROME_BROWSER_CRASH_REPORT_BREADCRUMBS_BREADCRUMB_MANAGER_H_
 #define IOS_CHROME_BROWSER_CRASH_REPORT_BREADCRUMBS_BREADCRUMB_MANAGER_H_
 
+#include <iterator>
 #include <list>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "base/observer_list.h"
 #include "base/time/time.h"
@@ -19,8 +21,79 @@ class BreadcrumbManagerObserver;
 // time has passed unless no more recent events are available. The internal
 // management of events aims to keep relevant events available while clearing
 // stale data.
+// Events are kept in a fixed-capacity ring buffer so that adding an event and
+// counting events are constant time operations. Once the buffer is full, the
+// oldest event is overwritten by each new event.
 class BreadcrumbManager {
  public:
+  // A single stored event and the time bucket it was logged in.
+  struct Event {
+    // The minute resolution time at which the event was logged.
+    base::Time bucket_time;
+    // The event string, with the timestamp prepended.
+    std::string event;
+  };
+
+  // A read-only view over stored events, ordered oldest to newest. A view does
+  // not copy events and is only valid until the next call to a non-const
+  // method of the BreadcrumbManager which returned it.
+  class EventsView {
+   public:
+    class const_iterator {
+     public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = std::string;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const std::string*;
+      using reference = const std::string&;
+
+      const_iterator(const std::vector<Event>* events,
+                     size_t position,
+                     size_t offset)
+          : events_(events), position_(position), offset_(offset) {}
+
+      reference operator*() const {
+        return (*events_)[(position_ + offset_) % events_->size()].event;
+      }
+      pointer operator->() const { return &operator*(); }
+      const_iterator& operator++() {
+        ++offset_;
+        return *this;
+      }
+      bool operator==(const const_iterator& other) const {
+        return events_ == other.events_ && position_ == other.position_ &&
+               offset_ == other.offset_;
+      }
+      bool operator!=(const const_iterator& other) const {
+        return !(*this == other);
+      }
+
+     private:
+      const std::vector<Event>* events_;
+      // Index in |events_| of the first event of the view.
+      size_t position_;
+      // Offset from |position_| of the current event.
+      size_t offset_;
+    };
+
+    EventsView(const std::vector<Event>* events, size_t position, size_t size)
+        : events_(events), position_(position), size_(size) {}
+
+    const_iterator begin() const {
+      return const_iterator(events_, position_, 0);
+    }
+    const_iterator end() const {
+      return const_iterator(events_, position_, size_);
+    }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+   private:
+    const std::vector<Event>* events_;
+    size_t position_;
+    size_t size_;
+  };
+
   // Returns the number of collected breadcrumb events which are still relevant.
   // Note: This method may drop old events so the value can change even when no
   // new events have been added, but time has passed.
@@ -34,6 +107,13 @@ class BreadcrumbManager {
   // even if no new events have been added, but time has passed.
   const std::list<std::string> GetEvents(size_t event_count_limit);
 
+  // Returns a view of the most recent stored events, up to
+  // |event_count_limit|, without copying them. Passing zero for
+  // |event_count_limit| signifies no limit. See |EventsView| for the lifetime
+  // of the returned view.
+  // Note: This method may drop old events, see |GetEvents|.
+  EventsView GetEventsView(size_t event_count_limit);
+
   // Logs a breadcrumb event with message data |event|.
   // NOTE: |event| must not include newline characters as newlines are used by
   // BreadcrumbPersistentStore as a deliminator.
@@ -44,6 +124,8 @@ class BreadcrumbManager {
   void RemoveObserver(BreadcrumbManagerObserver* observer);
 
   BreadcrumbManager();
+  // Creates a BreadcrumbManager which retains at most |capacity| events.
+  explicit BreadcrumbManager(size_t capacity);
   ~BreadcrumbManager();
 
  private:
@@ -55,12 +137,27 @@ class BreadcrumbManager {
   // newer events are limited.
   void DropOldEvents();
 
+  // Removes the oldest event. |event_count_| must not be zero. Returns whether
+  // it was the last event of its bucket.
+  bool PopOldestEvent();
+
   // Creation time of the BreadcrumbManager.
   const base::Time start_time_;
 
-  // List of events, paired with the time which they were logged to minute
-  // resolution. Newer events are at the end of the list.
-  std::list<std::pair<base::Time, std::list<std::string>>> event_buckets_;
+  // Ring buffer of events. The slots are allocated once at construction and
+  // reused, so the storage of each event string is recycled once the buffer
+  // has wrapped around.
+  std::vector<Event> events_;
+
+  // Index in |events_| of the oldest event.
+  size_t oldest_event_index_ = 0;
+
+  // Number of events currently stored in |events_|.
+  size_t event_count_ = 0;
+
+  // Number of runs of consecutive events sharing the same
+  // |Event::bucket_time| currently stored.
+  size_t bucket_count_ = 0;
 
   base::ObserverList<BreadcrumbManagerObserver, /*check_empty=*/true>
       observers_;
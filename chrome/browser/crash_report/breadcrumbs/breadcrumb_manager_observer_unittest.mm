@@ -86,3 +86,30 @@ TEST_F(BreadcrumbManagerObserverTest, OldEventsRemoved) {
 
   EXPECT_EQ(&manager_, observer_.old_events_removed_last_received_manager_);
 }
+
+// Tests that |BreadcumbManager::OldEventsRemoved| is called when every event of
+// the oldest bucket is overwritten because the manager is at capacity, and not
+// for each overwritten event.
+TEST_F(BreadcrumbManagerObserverTest, OldEventsRemovedAtCapacity) {
+  BreadcrumbManager manager(/*capacity=*/2);
+  FakeBreadcrumbManagerObserver observer;
+  manager.AddObserver(&observer);
+
+  manager.AddEvent("event1");
+  task_env_.FastForwardBy(base::TimeDelta::FromMinutes(1));
+  manager.AddEvent("event2");
+  EXPECT_FALSE(observer.old_events_removed_last_received_manager_);
+
+  // Overwrites the only event of the oldest bucket.
+  manager.AddEvent("event3");
+  EXPECT_EQ(&manager, observer.old_events_removed_last_received_manager_);
+  EXPECT_EQ(2ul, manager.GetEventCount());
+
+  // Overwrites an event of the newest bucket, which still has an event.
+  observer.old_events_removed_last_received_manager_ = nullptr;
+  manager.AddEvent("event4");
+  EXPECT_FALSE(observer.old_events_removed_last_received_manager_);
+  EXPECT_EQ(2ul, manager.GetEventCount());
+
+  manager.RemoveObserver(&observer);
+}
@@ -0,0 +1,140 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <list>
+#include <string>
+
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "base/timer/elapsed_timer.h"
+#include "ios/chrome/browser/crash_report/breadcrumbs/breadcrumb_manager.h"
+#include "ios/chrome/browser/crash_report/crash_reporter_breadcrumb_constants.h"
+#include "ios/chrome/test/base/perf_test_ios.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace {
+
+// Number of events logged per timed run.
+const int kEventCount = 5000;
+
+// Number of events read back after each logged event.
+const size_t kEventCountLimit = 20;
+
+// Replicates the list of per-minute event lists which was used to store
+// breadcrumbs before BreadcrumbManager used a ring buffer. Used as a baseline.
+class ListOfListsBreadcrumbs {
+ public:
+  size_t GetEventCount() {
+    DropOldEvents();
+    size_t count = 0;
+    for (auto it = event_buckets_.rbegin(); it != event_buckets_.rend(); ++it) {
+      std::list<std::string> bucket_events = it->second;
+      count += bucket_events.size();
+    }
+    return count;
+  }
+
+  const std::list<std::string> GetEvents(size_t event_count_limit) {
+    DropOldEvents();
+    std::list<std::string> events;
+    for (auto it = event_buckets_.rbegin(); it != event_buckets_.rend(); ++it) {
+      std::list<std::string> bucket_events = it->second;
+      for (auto event_it = bucket_events.rbegin();
+           event_it != bucket_events.rend(); ++event_it) {
+        events.push_front(*event_it);
+        if (event_count_limit > 0 && events.size() >= event_count_limit) {
+          return events;
+        }
+      }
+    }
+    return events;
+  }
+
+  void AddEvent(const std::string& event) {
+    base::Time time = base::Time::Now();
+    base::Time::Exploded exploded;
+    time.LocalExplode(&exploded);
+    exploded.millisecond = 0;
+    exploded.second = 0;
+    base::Time bucket_time;
+    base::Time::FromLocalExploded(exploded, &bucket_time);
+
+    if (event_buckets_.empty() || event_buckets_.back().first != bucket_time) {
+      event_buckets_.push_back(
+          std::make_pair(bucket_time, std::list<std::string>()));
+    }
+    time.UTCExplode(&exploded);
+    event_buckets_.back().second.push_back(base::StringPrintf(
+        "%02d:%02d %s", exploded.minute, exploded.second, event.c_str()));
+    DropOldEvents();
+  }
+
+ private:
+  void DropOldEvents() {
+    const unsigned long kMaxUsefulEvents = kMaxBreadcrumbsDataLength / 10;
+    unsigned long newer_event_count = 0;
+    auto event_bucket_it = event_buckets_.rbegin();
+    while (event_bucket_it != event_buckets_.rend()) {
+      std::list<std::string> bucket_events = event_bucket_it->second;
+      if (newer_event_count > kMaxUsefulEvents) {
+        event_buckets_.erase(event_buckets_.begin(), event_bucket_it.base());
+        break;
+      }
+      newer_event_count += bucket_events.size();
+      ++event_bucket_it;
+    }
+  }
+
+  std::list<std::pair<base::Time, std::list<std::string>>> event_buckets_;
+};
+
+class BreadcrumbManagerPerfTest : public PerfTest {
+ protected:
+  BreadcrumbManagerPerfTest() : PerfTest("Breadcrumb Manager") {}
+};
+
+// Measures logging events and reading back the most recent ones with the
+// previous list of lists storage.
+TEST_F(BreadcrumbManagerPerfTest, ListOfListsAddAndGetEvents) {
+  RepeatTimedRuns("List of lists add and get events",
+                  ^base::TimeDelta(int) {
+                    ListOfListsBreadcrumbs breadcrumbs;
+                    base::ElapsedTimer timer;
+                    for (int i = 0; i < kEventCount; i++) {
+                      breadcrumbs.AddEvent(base::StringPrintf("event %d", i));
+                      breadcrumbs.GetEventCount();
+                      breadcrumbs.GetEvents(kEventCountLimit);
+                    }
+                    return timer.Elapsed();
+                  },
+                  nil);
+}
+
+// Measures logging events and reading back the most recent ones with the ring
+// buffer storage of BreadcrumbManager.
+TEST_F(BreadcrumbManagerPerfTest, RingBufferAddAndGetEvents) {
+  RepeatTimedRuns("Ring buffer add and get events",
+                  ^base::TimeDelta(int) {
+                    BreadcrumbManager breadcrumb_manager;
+                    base::ElapsedTimer timer;
+                    size_t total_length = 0;
+                    for (int i = 0; i < kEventCount; i++) {
+                      breadcrumb_manager.AddEvent(
+                          base::StringPrintf("event %d", i));
+                      breadcrumb_manager.GetEventCount();
+                      for (const std::string& event :
+                           breadcrumb_manager.GetEventsView(kEventCountLimit)) {
+                        total_length += event.size();
+                      }
+                    }
+                    EXPECT_GT(total_length, 0ul);
+                    return timer.Elapsed();
+                  },
+                  nil);
+}
+
+}  // namespace
@@ -4,6 +4,7 @@
 
 #include "ios/chrome/browser/crash_report/breadcrumbs/breadcrumb_manager.h"
 
+#include "base/strings/stringprintf.h"
 #import "ios/web/public/test/web_task_environment.h"
 #include "testing/platform_test.h"
 
@@ -86,3 +87,41 @@ TEST_F(BreadcrumbManagerTest, MinimumEventsReturned) {
   std::list<std::string> events = breadcrumb_manager_.GetEvents(0);
   EXPECT_EQ(2ul, events.size());
 }
+
+// Tests that the oldest events are overwritten once the capacity of the
+// manager is reached.
+TEST_F(BreadcrumbManagerTest, OldestEventsOverwrittenAtCapacity) {
+  BreadcrumbManager breadcrumb_manager(/*capacity=*/3);
+  breadcrumb_manager.AddEvent("event1");
+  breadcrumb_manager.AddEvent("event2");
+  breadcrumb_manager.AddEvent("event3");
+  breadcrumb_manager.AddEvent("event4");
+  breadcrumb_manager.AddEvent("event5");
+
+  EXPECT_EQ(3ul, breadcrumb_manager.GetEventCount());
+  std::list<std::string> events = breadcrumb_manager.GetEvents(0);
+  ASSERT_EQ(3ul, events.size());
+  EXPECT_NE(std::string::npos, events.front().find("event3"));
+  EXPECT_NE(std::string::npos, events.back().find("event5"));
+}
+
+// Tests that |GetEventsView| returns the most recent events in order, limited
+// by |event_count_limit|, across a wrap around of the ring buffer.
+TEST_F(BreadcrumbManagerTest, EventsView) {
+  BreadcrumbManager breadcrumb_manager(/*capacity=*/4);
+  for (int i = 1; i <= 6; i++) {
+    breadcrumb_manager.AddEvent(base::StringPrintf("event%d", i));
+  }
+
+  BreadcrumbManager::EventsView view = breadcrumb_manager.GetEventsView(3);
+  ASSERT_EQ(3ul, view.size());
+  int expected_index = 4;
+  for (const std::string& event : view) {
+    EXPECT_NE(std::string::npos,
+              event.find(base::StringPrintf("event%d", expected_index)));
+    expected_index++;
+  }
+  EXPECT_EQ(7, expected_index);
+
+  EXPECT_EQ(4ul, breadcrumb_manager.GetEventsView(0).size());
+}
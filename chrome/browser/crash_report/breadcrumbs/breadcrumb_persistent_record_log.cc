@@ -0,0 +1,215 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ios/chrome/browser/crash_report/breadcrumbs/breadcrumb_persistent_record_log.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/bits.h"
+#include "base/check_op.h"
+#include "base/files/file.h"
+#include "base/files/memory_mapped_file.h"
+#include "third_party/zlib/zlib.h"
+
+namespace {
+
+// Identifies a breadcrumbs record log file ("BCRL").
+const uint32_t kFileMagic = 0x4C524342;
+
+// Version of the record format. Files with a different version are discarded.
+const uint32_t kFormatVersion = 1;
+
+// Header at the start of the file.
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  // Offset in the data region at which the next record will be written.
+  uint32_t write_cursor;
+  uint32_t reserved;
+};
+
+// Header preceding the payload of each record.
+struct RecordHeader {
+  // Length of the payload. Zero terminates a chain of records.
+  uint32_t length;
+  // CRC of |length| and the payload.
+  uint32_t crc;
+};
+
+// Records start on multiples of this value.
+const size_t kRecordAlignment = 4;
+
+// Returns the size of a record holding a payload of |length| bytes.
+size_t RecordSize(size_t length) {
+  return sizeof(RecordHeader) + base::bits::Align(length, kRecordAlignment);
+}
+
+// Returns the CRC of a record with |length| bytes of payload at |payload|.
+uint32_t RecordCrc(uint32_t length, const char* payload) {
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, reinterpret_cast<const Bytef*>(&length), sizeof(length));
+  crc = crc32(crc, reinterpret_cast<const Bytef*>(payload), length);
+  return static_cast<uint32_t>(crc);
+}
+
+}  // namespace
+
+BreadcrumbPersistentRecordLog::BreadcrumbPersistentRecordLog(
+    const base::FilePath& file_path,
+    size_t file_size)
+    : file_path_(file_path),
+      file_size_(file_size),
+      data_size_(base::bits::AlignDown(file_size - sizeof(FileHeader),
+                                       kRecordAlignment)) {
+  DCHECK_GT(file_size, sizeof(FileHeader) + sizeof(RecordHeader));
+}
+
+BreadcrumbPersistentRecordLog::~BreadcrumbPersistentRecordLog() = default;
+
+bool BreadcrumbPersistentRecordLog::Initialize() {
+  auto file = std::make_unique<base::MemoryMappedFile>();
+  const base::MemoryMappedFile::Region region = {0, file_size_};
+  const bool file_valid = file->Initialize(
+      base::File(file_path_, base::File::FLAG_OPEN_ALWAYS |
+                                 base::File::FLAG_READ |
+                                 base::File::FLAG_WRITE),
+      region, base::MemoryMappedFile::READ_WRITE_EXTEND);
+  if (!file_valid) {
+    return false;
+  }
+  file_ = std::move(file);
+
+  FileHeader header;
+  memcpy(&header, file_->data(), sizeof(header));
+  if (header.magic != kFileMagic || header.version != kFormatVersion) {
+    // New or incompatible file, start from an empty log.
+    Clear();
+    return true;
+  }
+
+  // Recover the write cursor from the records rather than trusting the stored
+  // value, which may be stale if a crash happened while writing a record.
+  write_cursor_ = ParseRecords(0, nullptr);
+  if (write_cursor_ != header.write_cursor) {
+    StoreWriteCursor();
+  }
+  return true;
+}
+
+bool BreadcrumbPersistentRecordLog::IsInitialized() const {
+  return file_ != nullptr;
+}
+
+void BreadcrumbPersistentRecordLog::Append(base::StringPiece event) {
+  if (!file_ || event.empty()) {
+    return;
+  }
+
+  const uint32_t length =
+      static_cast<uint32_t>(std::min(event.size(), data_size_ / 2));
+  const size_t record_size = RecordSize(length);
+  char* data = GetDataRegion();
+
+  if (write_cursor_ + record_size > data_size_) {
+    // Terminate the current lap so that records older than the wrap point are
+    // not mistaken for newer ones.
+    memset(&data[write_cursor_], 0, data_size_ - write_cursor_);
+    write_cursor_ = 0;
+  }
+
+  RecordHeader record_header = {length, RecordCrc(length, event.data())};
+  memcpy(&data[write_cursor_ + sizeof(RecordHeader)], event.data(), length);
+  memcpy(&data[write_cursor_], &record_header, sizeof(record_header));
+  write_cursor_ += record_size;
+
+  // Terminate the chain of records of the current lap. This overwrites the
+  // header of the oldest record from the previous lap, if any.
+  if (write_cursor_ + sizeof(uint32_t) <= data_size_) {
+    memset(&data[write_cursor_], 0, sizeof(uint32_t));
+  }
+  StoreWriteCursor();
+}
+
+std::vector<base::StringPiece> BreadcrumbPersistentRecordLog::GetEvents()
+    const {
+  std::vector<base::StringPiece> events;
+  if (!file_) {
+    return events;
+  }
+
+  std::vector<base::StringPiece> newer_events;
+  const size_t newer_events_end = ParseRecords(0, &newer_events);
+
+  // Records from the previous lap follow the newer records, but the first of
+  // them may have been partially overwritten. Skip to the first valid one.
+  for (size_t offset = newer_events_end;
+       offset + sizeof(RecordHeader) <= data_size_;
+       offset += kRecordAlignment) {
+    if (IsValidRecordAt(offset)) {
+      ParseRecords(offset, &events);
+      break;
+    }
+  }
+
+  events.insert(events.end(), newer_events.begin(), newer_events.end());
+  return events;
+}
+
+void BreadcrumbPersistentRecordLog::Clear() {
+  if (!file_) {
+    return;
+  }
+
+  memset(file_->data(), 0, file_size_);
+  FileHeader header = {kFileMagic, kFormatVersion, 0, 0};
+  memcpy(file_->data(), &header, sizeof(header));
+  write_cursor_ = 0;
+}
+
+char* BreadcrumbPersistentRecordLog::GetDataRegion() const {
+  return reinterpret_cast<char*>(file_->data()) + sizeof(FileHeader);
+}
+
+bool BreadcrumbPersistentRecordLog::IsValidRecordAt(size_t offset) const {
+  if (offset + sizeof(RecordHeader) > data_size_) {
+    return false;
+  }
+
+  const char* data = GetDataRegion();
+  RecordHeader record_header;
+  memcpy(&record_header, &data[offset], sizeof(record_header));
+  if (record_header.length == 0 ||
+      record_header.length > data_size_ - offset - sizeof(RecordHeader)) {
+    return false;
+  }
+  return record_header.crc ==
+         RecordCrc(record_header.length,
+                   &data[offset + sizeof(RecordHeader)]);
+}
+
+size_t BreadcrumbPersistentRecordLog::ParseRecords(
+    size_t offset,
+    std::vector<base::StringPiece>* events) const {
+  const char* data = GetDataRegion();
+  while (IsValidRecordAt(offset)) {
+    uint32_t length;
+    memcpy(&length, &data[offset], sizeof(length));
+    if (events) {
+      events->push_back(
+          base::StringPiece(&data[offset + sizeof(RecordHeader)], length));
+    }
+    offset += RecordSize(length);
+  }
+  return offset;
+}
+
+void BreadcrumbPersistentRecordLog::StoreWriteCursor() {
+  const uint32_t write_cursor = write_cursor_;
+  memcpy(reinterpret_cast<char*>(file_->data()) +
+             offsetof(FileHeader, write_cursor),
+         &write_cursor, sizeof(write_cursor));
+}
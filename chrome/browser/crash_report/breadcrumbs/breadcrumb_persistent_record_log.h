@@ -0,0 +1,86 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef IOS_CHROME_BROWSER_CRASH_REPORT_BREADCRUMBS_BREADCRUMB_PERSISTENT_RECORD_LOG_H_
+#define IOS_CHROME_BROWSER_CRASH_REPORT_BREADCRUMBS_BREADCRUMB_PERSISTENT_RECORD_LOG_H_
+
+#include <memory>
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "base/strings/string_piece.h"
+
+namespace base {
+class MemoryMappedFile;
+}  // namespace base
+
+// A circular log of breadcrumb events stored in a memory mapped file which
+// stays mapped for the lifetime of the instance.
+//
+// The file starts with a header holding the current write cursor. It is
+// followed by a data region of length-prefixed, CRC-checked records. Each
+// appended event is copied once into the mapping. When a record does not fit
+// before the end of the data region, writing wraps around to the start of the
+// region and overwrites the oldest records. Records torn by a crash while
+// being written fail their CRC check and are discarded.
+//
+// This class is not thread safe and must be used on a sequence which allows
+// blocking.
+class BreadcrumbPersistentRecordLog {
+ public:
+  // Creates a log stored at |file_path|. The file will be |file_size| bytes.
+  BreadcrumbPersistentRecordLog(const base::FilePath& file_path,
+                                size_t file_size);
+  ~BreadcrumbPersistentRecordLog();
+
+  // Maps the file, creating it if it does not exist. Records from an existing
+  // file are recovered. Returns false if the file could not be mapped, in
+  // which case all other methods are no-ops.
+  bool Initialize();
+
+  // Returns whether the file has been successfully mapped.
+  bool IsInitialized() const;
+
+  // Appends |event| to the log, overwriting the oldest records if needed.
+  // |event| is truncated if it is larger than half of the data region.
+  void Append(base::StringPiece event);
+
+  // Returns the stored events, oldest first. The returned pieces point into
+  // the mapped file and are invalidated by the next call to |Append| or
+  // |Clear|.
+  std::vector<base::StringPiece> GetEvents() const;
+
+  // Removes all stored events.
+  void Clear();
+
+ private:
+  BreadcrumbPersistentRecordLog(const BreadcrumbPersistentRecordLog&) = delete;
+  BreadcrumbPersistentRecordLog& operator=(
+      const BreadcrumbPersistentRecordLog&) = delete;
+
+  // Returns the start of the data region.
+  char* GetDataRegion() const;
+
+  // Returns whether a complete record with a valid CRC starts at |offset|.
+  bool IsValidRecordAt(size_t offset) const;
+
+  // Follows the chain of valid records starting at |offset|, appending their
+  // payloads to |events| if non-null. Returns the offset after the last valid
+  // record.
+  size_t ParseRecords(size_t offset,
+                      std::vector<base::StringPiece>* events) const;
+
+  // Writes |write_cursor_| to the file header.
+  void StoreWriteCursor();
+
+  const base::FilePath file_path_;
+  const size_t file_size_;
+  // The size of the data region following the header.
+  const size_t data_size_;
+  std::unique_ptr<base::MemoryMappedFile> file_;
+  // Offset in the data region at which the next record will be written.
+  size_t write_cursor_ = 0;
+};
+
+#endif  // IOS_CHROME_BROWSER_CRASH_REPORT_BREADCRUMBS_BREADCRUMB_PERSISTENT_RECORD_LOG_H_
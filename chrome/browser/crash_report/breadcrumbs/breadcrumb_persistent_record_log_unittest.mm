@@ -0,0 +1,159 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ios/chrome/browser/crash_report/breadcrumbs/breadcrumb_persistent_record_log.h"
+
+#include <string>
+#include <vector>
+
+#include "base/files/file.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "testing/platform_test.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace {
+
+// Size of the log file used by the tests.
+const size_t kFileSize = 512;
+
+}  // namespace
+
+// Test fixture for testing BreadcrumbPersistentRecordLog class.
+class BreadcrumbPersistentRecordLogTest : public PlatformTest {
+ protected:
+  BreadcrumbPersistentRecordLogTest() {
+    EXPECT_TRUE(scoped_temp_directory_.CreateUniqueTempDir());
+    file_path_ = scoped_temp_directory_.GetPath().Append("log");
+  }
+
+  // Returns a new initialized log stored at |file_path_|.
+  std::unique_ptr<BreadcrumbPersistentRecordLog> CreateLog() {
+    auto log =
+        std::make_unique<BreadcrumbPersistentRecordLog>(file_path_, kFileSize);
+    EXPECT_TRUE(log->Initialize());
+    return log;
+  }
+
+  base::ScopedTempDir scoped_temp_directory_;
+  base::FilePath file_path_;
+};
+
+// Tests that appended events are returned in order.
+TEST_F(BreadcrumbPersistentRecordLogTest, AppendEvents) {
+  std::unique_ptr<BreadcrumbPersistentRecordLog> log = CreateLog();
+  EXPECT_TRUE(log->GetEvents().empty());
+
+  log->Append("event1");
+  log->Append("event2");
+
+  std::vector<base::StringPiece> events = log->GetEvents();
+  ASSERT_EQ(2ul, events.size());
+  EXPECT_EQ("event1", events[0]);
+  EXPECT_EQ("event2", events[1]);
+}
+
+// Tests that the oldest events are overwritten when the log wraps around and
+// that the remaining events are contiguous and in order.
+TEST_F(BreadcrumbPersistentRecordLogTest, WrapAround) {
+  std::unique_ptr<BreadcrumbPersistentRecordLog> log = CreateLog();
+  const int kEventCount = 200;
+  for (int i = 0; i < kEventCount; i++) {
+    log->Append(base::StringPrintf("event %d", i));
+  }
+
+  std::vector<base::StringPiece> events = log->GetEvents();
+  ASSERT_GT(events.size(), 1ul);
+  EXPECT_LT(events.size(), static_cast<size_t>(kEventCount));
+  EXPECT_EQ(base::StringPrintf("event %d", kEventCount - 1), events.back());
+
+  int first_index = 0;
+  ASSERT_TRUE(base::StringToInt(events.front().substr(6), &first_index));
+  for (size_t i = 0; i < events.size(); i++) {
+    EXPECT_EQ(base::StringPrintf("event %d", first_index + static_cast<int>(i)),
+              events[i]);
+  }
+}
+
+// Tests that events are recovered when the file is mapped again.
+TEST_F(BreadcrumbPersistentRecordLogTest, EventsRecovered) {
+  for (int i = 0; i < 100; i++) {
+    CreateLog()->Append(base::StringPrintf("event %d", i));
+  }
+
+  std::unique_ptr<BreadcrumbPersistentRecordLog> log = CreateLog();
+  std::vector<base::StringPiece> events = log->GetEvents();
+  ASSERT_GT(events.size(), 1ul);
+  EXPECT_EQ("event 99", events.back());
+
+  log->Append("event 100");
+  events = log->GetEvents();
+  EXPECT_EQ("event 100", events.back());
+  EXPECT_EQ("event 99", events[events.size() - 2]);
+}
+
+// Tests that a record torn by a crash while it was written is discarded and
+// that the next event is written in its place.
+TEST_F(BreadcrumbPersistentRecordLogTest, TornRecordDiscarded) {
+  {
+    std::unique_ptr<BreadcrumbPersistentRecordLog> log = CreateLog();
+    log->Append("event1");
+    log->Append("event2");
+  }
+
+  // Corrupt the payload of the last record.
+  base::File file(file_path_, base::File::FLAG_OPEN | base::File::FLAG_READ |
+                                  base::File::FLAG_WRITE);
+  ASSERT_TRUE(file.IsValid());
+  std::vector<char> contents(kFileSize);
+  ASSERT_EQ(static_cast<int>(kFileSize),
+            file.Read(0, contents.data(), kFileSize));
+  std::string data(contents.begin(), contents.end());
+  size_t position = data.find("event2");
+  ASSERT_NE(std::string::npos, position);
+  ASSERT_EQ(1, file.Write(position, "X", 1));
+  file.Close();
+
+  std::unique_ptr<BreadcrumbPersistentRecordLog> log = CreateLog();
+  std::vector<base::StringPiece> events = log->GetEvents();
+  ASSERT_EQ(1ul, events.size());
+  EXPECT_EQ("event1", events[0]);
+
+  log->Append("event3");
+  events = log->GetEvents();
+  ASSERT_EQ(2ul, events.size());
+  EXPECT_EQ("event1", events[0]);
+  EXPECT_EQ("event3", events[1]);
+}
+
+// Tests that a file which is not a record log is replaced by an empty log.
+TEST_F(BreadcrumbPersistentRecordLogTest, InvalidFileCleared) {
+  base::File file(file_path_,
+                  base::File::FLAG_CREATE_ALWAYS | base::File::FLAG_WRITE);
+  ASSERT_TRUE(file.IsValid());
+  const std::string contents = "08:27 event\n08:28 event\n";
+  ASSERT_TRUE(file.WriteAndCheck(
+      /*offset=*/0, base::as_bytes(base::make_span(contents))));
+  file.Close();
+
+  std::unique_ptr<BreadcrumbPersistentRecordLog> log = CreateLog();
+  EXPECT_TRUE(log->GetEvents().empty());
+}
+
+// Tests that |Clear| removes all events.
+TEST_F(BreadcrumbPersistentRecordLogTest, Clear) {
+  std::unique_ptr<BreadcrumbPersistentRecordLog> log = CreateLog();
+  log->Append("event1");
+  log->Clear();
+  EXPECT_TRUE(log->GetEvents().empty());
+
+  log->Append("event2");
+  std::vector<base::StringPiece> events = log->GetEvents();
+  ASSERT_EQ(1ul, events.size());
+  EXPECT_EQ("event2", events[0]);
+}
@@ -5,6 +5,7 @@
 #ifndef IOS_CHROME_BROWSER_CRASH_REPORT_BREADCRUMBS_BREADCRUMB_PERSISTENT_STORAGE_MANAGER_H_
 #define IOS_CHROME_BROWSER_CRASH_REPORT_BREADCRUMBS_BREADCRUMB_PERSISTENT_STORAGE_MANAGER_H_
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -26,10 +27,14 @@ class FilePath;
 }  // namespace base
 
 class BreadcrumbManagerKeyedService;
+class BreadcrumbPersistentRecordLog;
 
 // Stores breadcrumb events to and retireves them from a file on disk.
 // Persisting these events allows access to breadcrumb events from previous
 // application sessions.
+// When |kBreadcrumbsRecordLog| is enabled, events are appended to a circular
+// log of records which stays memory mapped for the session instead of being
+// periodically rewritten.
 class BreadcrumbPersistentStorageManager : public BreadcrumbManagerObserver {
  public:
   explicit BreadcrumbPersistentStorageManager(base::FilePath directory);
@@ -98,6 +103,13 @@ class BreadcrumbPersistentStorageManager : public BreadcrumbManagerObserver {
   // file, if any, is retrieved.
   base::Optional<size_t> current_mapped_file_position_;
 
+  // Whether events are persisted to |record_log_|.
+  const bool use_record_log_;
+
+  // The circular log events are persisted to if |use_record_log_| is true.
+  // Only accessed on |task_runner_|.
+  std::unique_ptr<BreadcrumbPersistentRecordLog> record_log_;
+
   // The SequencedTaskRunner on which File IO operations are performed.
   scoped_refptr<base::SequencedTaskRunner> task_runner_;
 
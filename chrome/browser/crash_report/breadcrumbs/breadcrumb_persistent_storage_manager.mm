@@ -7,6 +7,7 @@
 #include <memory>
 
 #include "base/bind.h"
+#include "base/feature_list.h"
 #include "base/files/file_util.h"
 #include "base/files/memory_mapped_file.h"
 #include "base/sequenced_task_runner.h"
@@ -18,7 +19,9 @@
 #include "base/task/thread_pool.h"
 #include "ios/chrome/browser/crash_report/breadcrumbs/breadcrumb_manager.h"
 #include "ios/chrome/browser/crash_report/breadcrumbs/breadcrumb_manager_keyed_service.h"
+#include "ios/chrome/browser/crash_report/breadcrumbs/breadcrumb_persistent_record_log.h"
 #include "ios/chrome/browser/crash_report/breadcrumbs/breadcrumb_persistent_storage_util.h"
+#include "ios/chrome/browser/crash_report/breadcrumbs/features.h"
 
 #if !defined(__has_feature) || !__has_feature(objc_arc)
 #error "This file requires ARC support."
@@ -97,11 +100,47 @@ std::vector<std::string> DoGetStoredEvents(const base::FilePath& file_path) {
   if (!events_file.ReadAndCheck(/*offset=*/0, data)) {
     return std::vector<std::string>();
   }
-  std::string persisted_events(data.begin(), data.end());
-  std::string all_events =
-      persisted_events.substr(/*pos=*/0, strlen(persisted_events.c_str()));
-  return base::SplitString(all_events, kEventSeparator, base::TRIM_WHITESPACE,
-                           base::SPLIT_WANT_NONEMPTY);
+  // Split the events in place, the file contents end at the first \0.
+  const char* persisted_events = reinterpret_cast<const char*>(data.data());
+  return base::SplitString(
+      base::StringPiece(persisted_events, strnlen(persisted_events, file_size)),
+      kEventSeparator, base::TRIM_WHITESPACE, base::SPLIT_WANT_NONEMPTY);
+}
+
+// Maps |record_log|. If the log did not exist yet, events persisted to
+// |legacy_file_path| by a previous session are migrated into it.
+void DoInitializeRecordLog(BreadcrumbPersistentRecordLog* record_log,
+                           const base::FilePath& record_log_file_path,
+                           const base::FilePath& legacy_file_path) {
+  const bool record_log_existed = base::PathExists(record_log_file_path);
+  if (!record_log->Initialize() || record_log_existed) {
+    return;
+  }
+
+  for (const std::string& event : DoGetStoredEvents(legacy_file_path)) {
+    record_log->Append(event);
+  }
+}
+
+// Appends the events in |events|, separated by |kEventSeparator|, to
+// |record_log|.
+void DoAppendEventsToRecordLog(BreadcrumbPersistentRecordLog* record_log,
+                               const std::string& events) {
+  for (base::StringPiece event :
+       base::SplitStringPiece(events, kEventSeparator, base::TRIM_WHITESPACE,
+                              base::SPLIT_WANT_NONEMPTY)) {
+    record_log->Append(event);
+  }
+}
+
+// Returns the events stored in |record_log|.
+std::vector<std::string> DoGetRecordLogEvents(
+    BreadcrumbPersistentRecordLog* record_log) {
+  std::vector<std::string> events;
+  for (base::StringPiece event : record_log->GetEvents()) {
+    events.push_back(event.as_string());
+  }
+  return events;
 }
 
 // Returns the total length of stored breadcrumb events at |file_path|. The
@@ -143,6 +182,8 @@ size_t DoGetStoredEventsLength(const base::FilePath& file_path) {
 
 using breadcrumb_persistent_storage_util::
     GetBreadcrumbPersistentStorageFilePath;
+using breadcrumb_persistent_storage_util::
+    GetBreadcrumbPersistentStorageRecordLogFilePath;
 using breadcrumb_persistent_storage_util::
     GetBreadcrumbPersistentStorageTempFilePath;
 
@@ -154,10 +195,24 @@ BreadcrumbPersistentStorageManager::BreadcrumbPersistentStorageManager(
       breadcrumbs_file_path_(GetBreadcrumbPersistentStorageFilePath(directory)),
       breadcrumbs_temp_file_path_(
           GetBreadcrumbPersistentStorageTempFilePath(directory)),
+      use_record_log_(base::FeatureList::IsEnabled(kBreadcrumbsRecordLog)),
       task_runner_(base::ThreadPool::CreateSequencedTaskRunner(
           {base::MayBlock(), base::TaskPriority::BEST_EFFORT,
            base::TaskShutdownBehavior::BLOCK_SHUTDOWN})),
       weak_ptr_factory_(this) {
+  if (use_record_log_) {
+    const base::FilePath record_log_file_path =
+        GetBreadcrumbPersistentStorageRecordLogFilePath(directory);
+    record_log_ = std::make_unique<BreadcrumbPersistentRecordLog>(
+        record_log_file_path, kPersistedFilesizeInBytes);
+    task_runner_->PostTask(
+        FROM_HERE,
+        base::BindOnce(&DoInitializeRecordLog,
+                       base::Unretained(record_log_.get()),
+                       record_log_file_path, breadcrumbs_file_path_));
+    return;
+  }
+
   task_runner_->PostTaskAndReplyWithResult(
       FROM_HERE,
       base::BindOnce(&DoGetStoredEventsLength, breadcrumbs_file_path_),
@@ -166,11 +221,24 @@ BreadcrumbPersistentStorageManager::BreadcrumbPersistentStorageManager(
           weak_ptr_factory_.GetWeakPtr()));
 }
 
-BreadcrumbPersistentStorageManager::~BreadcrumbPersistentStorageManager() =
-    default;
+BreadcrumbPersistentStorageManager::~BreadcrumbPersistentStorageManager() {
+  if (record_log_) {
+    // Delete after any pending file operations which use |record_log_|.
+    task_runner_->DeleteSoon(FROM_HERE, std::move(record_log_));
+  }
+}
 
 void BreadcrumbPersistentStorageManager::GetStoredEvents(
     base::OnceCallback<void(std::vector<std::string>)> callback) {
+  if (use_record_log_) {
+    task_runner_->PostTaskAndReplyWithResult(
+        FROM_HERE,
+        base::BindOnce(&DoGetRecordLogEvents,
+                       base::Unretained(record_log_.get())),
+        std::move(callback));
+    return;
+  }
+
   task_runner_->PostTaskAndReplyWithResult(
       FROM_HERE, base::BindOnce(&DoGetStoredEvents, breadcrumbs_file_path_),
       std::move(callback));
@@ -256,6 +324,17 @@ void BreadcrumbPersistentStorageManager::WritePendingBreadcrumbs() {
     return;
   }
 
+  if (use_record_log_) {
+    task_runner_->PostTask(
+        FROM_HERE,
+        base::BindOnce(&DoAppendEventsToRecordLog,
+                       base::Unretained(record_log_.get()),
+                       std::move(pending_breadcrumbs_)));
+    last_written_time_ = base::TimeTicks::Now();
+    pending_breadcrumbs_.clear();
+    return;
+  }
+
   task_runner_->PostTask(FROM_HERE,
                          base::BindOnce(&DoInsertEventsIntoMemoryMappedFile,
                                         breadcrumbs_file_path_,
@@ -293,11 +372,17 @@ void BreadcrumbPersistentStorageManager::WriteEvents() {
   // Delay writing the event to disk if an event was just written or if the size
   // of exisiting breadcrumbs is not yet known.
   if (time_delta_since_last_write < kMinDelayBetweenWrites ||
-      !current_mapped_file_position_) {
+      (!use_record_log_ && !current_mapped_file_position_)) {
     write_timer_.Start(FROM_HERE,
                        kMinDelayBetweenWrites - time_delta_since_last_write,
                        this, &BreadcrumbPersistentStorageManager::WriteEvents);
   } else {
+    // The record log wraps around on its own, it never needs to be rewritten.
+    if (use_record_log_) {
+      WritePendingBreadcrumbs();
+      return;
+    }
+
     // If the event does not fit within |kPersistedFilesizeInBytes|, rewrite the
     // file to trim old events.
     if ((current_mapped_file_position_.value() + pending_breadcrumbs_.size())
@@ -314,5 +399,10 @@ void BreadcrumbPersistentStorageManager::WriteEvents() {
 
 void BreadcrumbPersistentStorageManager::OldEventsRemoved(
     BreadcrumbManager* manager) {
+  // Old records are overwritten as the record log wraps around.
+  if (use_record_log_) {
+    return;
+  }
+
   RewriteAllExistingBreadcrumbs();
 }
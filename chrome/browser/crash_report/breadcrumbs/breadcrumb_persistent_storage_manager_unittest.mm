@@ -12,12 +12,14 @@
 #include "base/strings/string_number_conversions.h"
 #include "base/strings/stringprintf.h"
 #import "base/test/ios/wait_util.h"
+#include "base/test/scoped_feature_list.h"
 #include "ios/chrome/browser/browser_state/test_chrome_browser_state.h"
 #include "ios/chrome/browser/browser_state/test_chrome_browser_state_manager.h"
 #include "ios/chrome/browser/crash_report/breadcrumbs/breadcrumb_manager.h"
 #include "ios/chrome/browser/crash_report/breadcrumbs/breadcrumb_manager_keyed_service.h"
 #include "ios/chrome/browser/crash_report/breadcrumbs/breadcrumb_manager_keyed_service_factory.h"
 #include "ios/chrome/browser/crash_report/breadcrumbs/breadcrumb_persistent_storage_util.h"
+#include "ios/chrome/browser/crash_report/breadcrumbs/features.h"
 #import "ios/chrome/browser/crash_report/crash_reporter_breadcrumb_observer.h"
 #include "ios/chrome/test/ios_chrome_scoped_testing_chrome_browser_state_manager.h"
 #include "ios/web/public/test/web_task_environment.h"
@@ -286,3 +288,44 @@ TEST_F(BreadcrumbPersistentStorageManagerTest,
     return events_received;
   }));
 }
+
+// Ensures that logged events are persisted to the record log and that the
+// persisted events stay bounded when |kBreadcrumbsRecordLog| is enabled.
+TEST_F(BreadcrumbPersistentStorageManagerTest, PersistEventsToRecordLog) {
+  base::test::ScopedFeatureList feature_list;
+  feature_list.InitAndEnableFeature(kBreadcrumbsRecordLog);
+  auto record_log_storage =
+      std::make_unique<BreadcrumbPersistentStorageManager>(
+          scoped_temp_directory_.GetPath());
+  breadcrumb_manager_service_->StartPersisting(record_log_storage.get());
+
+  std::string event;
+  unsigned long event_count = 0;
+  while (event_count < kEventCountTooManyForPersisting) {
+    event = base::StringPrintf("event %lu", event_count);
+    breadcrumb_manager_service_->AddEvent(event);
+    task_env_.FastForwardBy(base::TimeDelta::FromMilliseconds(100));
+
+    event_count++;
+  }
+
+  // Advance clock to trigger writing final events.
+  task_env_.FastForwardBy(base::TimeDelta::FromMinutes(1));
+
+  __block bool events_received = false;
+  record_log_storage->GetStoredEvents(
+      base::BindOnce(^(std::vector<std::string> events) {
+        ASSERT_GT(events.size(), 0ul);
+        EXPECT_LT(events.size(), event_count);
+
+        EXPECT_TRUE(ValidatePersistedEvents(event, events));
+        events_received = true;
+      }));
+
+  ASSERT_TRUE(WaitUntilConditionOrTimeout(kWaitForFileOperationTimeout, ^{
+    base::RunLoop().RunUntilIdle();
+    return events_received;
+  }));
+
+  breadcrumb_manager_service_->StartPersisting(persistent_storage_.get());
+}
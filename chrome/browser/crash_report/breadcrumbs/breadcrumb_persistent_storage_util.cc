@@ -14,6 +14,9 @@ const base::FilePath::CharType kBreadcrumbsFile[] =
 const base::FilePath::CharType kBreadcrumbsTempFile[] =
     FILE_PATH_LITERAL("iOS Breadcrumbs.temp");
 
+const base::FilePath::CharType kBreadcrumbsRecordLogFile[] =
+    FILE_PATH_LITERAL("iOS Breadcrumbs.log");
+
 base::FilePath GetBreadcrumbPersistentStorageFilePath(
     base::FilePath storage_dir) {
   return storage_dir.Append(kBreadcrumbsFile);
@@ -24,4 +27,9 @@ base::FilePath GetBreadcrumbPersistentStorageTempFilePath(
   return storage_dir.Append(kBreadcrumbsTempFile);
 }
 
+base::FilePath GetBreadcrumbPersistentStorageRecordLogFilePath(
+    base::FilePath storage_dir) {
+  return storage_dir.Append(kBreadcrumbsRecordLogFile);
+}
+
 }  // namespace breadcrumb_persistent_storage_util
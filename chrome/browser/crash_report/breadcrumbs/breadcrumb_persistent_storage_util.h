@@ -23,6 +23,13 @@ base::FilePath GetBreadcrumbPersistentStorageFilePath(
 base::FilePath GetBreadcrumbPersistentStorageTempFilePath(
     base::FilePath storage_dir);
 
+// Returns the path to a file for storing breadcrumbs within |storage_dir| as a
+// circular log of binary records. Used instead of the file at
+// |GetBreadcrumbPersistentStorageFilePath()| when |kBreadcrumbsRecordLog| is
+// enabled.
+base::FilePath GetBreadcrumbPersistentStorageRecordLogFilePath(
+    base::FilePath storage_dir);
+
 }  // namespace breadcrumb_persistent_storage_util
 
 #endif  // IOS_CHROME_BROWSER_CRASH_REPORT_BREADCRUMBS_BREADCRUMB_PERSISTENT_STORAGE_UTIL_H_
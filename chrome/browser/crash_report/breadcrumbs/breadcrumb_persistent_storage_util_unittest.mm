@@ -13,6 +13,8 @@
 
 using breadcrumb_persistent_storage_util::
     GetBreadcrumbPersistentStorageFilePath;
+using breadcrumb_persistent_storage_util::
+    GetBreadcrumbPersistentStorageRecordLogFilePath;
 using breadcrumb_persistent_storage_util::
     GetBreadcrumbPersistentStorageTempFilePath;
 
@@ -29,3 +31,16 @@ TEST_F(BreadcrumbPersistentStorageUtilTest, UniqueTempStorage) {
   EXPECT_NE(GetBreadcrumbPersistentStorageFilePath(directory),
             GetBreadcrumbPersistentStorageTempFilePath(directory));
 }
+
+// Tests that the breadcrumb record log file path is different from the other
+// breadcrumb storage file paths.
+TEST_F(BreadcrumbPersistentStorageUtilTest, UniqueRecordLogStorage) {
+  base::ScopedTempDir scoped_temp_directory;
+  EXPECT_TRUE(scoped_temp_directory.CreateUniqueTempDir());
+
+  base::FilePath directory = scoped_temp_directory.GetPath();
+  EXPECT_NE(GetBreadcrumbPersistentStorageFilePath(directory),
+            GetBreadcrumbPersistentStorageRecordLogFilePath(directory));
+  EXPECT_NE(GetBreadcrumbPersistentStorageTempFilePath(directory),
+            GetBreadcrumbPersistentStorageRecordLogFilePath(directory));
+}
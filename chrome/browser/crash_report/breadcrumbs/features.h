@@ -10,4 +10,8 @@
 // Feature flag to log breadcrumb events.
 extern const base::Feature kLogBreadcrumbs;
 
+// Feature flag to persist breadcrumb events to a memory mapped circular log of
+// records which stays mapped for the whole session.
+extern const base::Feature kBreadcrumbsRecordLog;
+
 #endif  // IOS_CHROME_BROWSER_CRASH_REPORT_BREADCRUMBS_FEATURES_H_
@@ -10,3 +10,6 @@
 
 const base::Feature kLogBreadcrumbs{"LogBreadcrumbs",
                                     base::FEATURE_DISABLED_BY_DEFAULT};
+
+const base::Feature kBreadcrumbsRecordLog{"BreadcrumbsRecordLog",
+                                          base::FEATURE_DISABLED_BY_DEFAULT};
@@ -58,6 +58,12 @@
 + (BOOL)deleteSessionForBrowserState:(ChromeBrowserState*)browserState
                           backupFile:(NSString*)file;
 
+// Moves the session files of the tabs of the session at |sessionPath| next to
+// |destinationPath|, if the session was saved with one file per tab. Deletes
+// them if |destinationPath| is nil.
++ (void)moveTabSessionsFromSessionPath:(NSString*)sessionPath
+                         toSessionPath:(NSString*)destinationPath;
+
 // Returns the path where the sessions with |sessionID| for the main browser
 // state are backed up.
 + (NSString*)backupPathForSessionID:(NSString*)sessionID;
@@ -305,6 +311,7 @@ static BOOL _sessionRestored = NO;
     if (!fileOperationSuccess) {
       return NO;
     }
+    [self moveTabSessionsFromSessionPath:sessionPath toSessionPath:backupPath];
   } else {
     NSError* error;
     BOOL fileOperationSuccess = [fileManager removeItemAtPath:sessionPath
@@ -315,6 +322,7 @@ static BOOL _sessionRestored = NO;
     if (!fileOperationSuccess) {
       return NO;
     }
+    [self moveTabSessionsFromSessionPath:sessionPath toSessionPath:nil];
   }
   return YES;
 }
@@ -346,6 +354,7 @@ static BOOL _sessionRestored = NO;
     if (!fileOperationSuccess) {
       return NO;
     }
+    [self moveTabSessionsFromSessionPath:sessionPath toSessionPath:file];
   } else {
     NSError* error;
     BOOL fileOperationSuccess =
@@ -356,10 +365,32 @@ static BOOL _sessionRestored = NO;
     if (!fileOperationSuccess) {
       return NO;
     }
+    [self moveTabSessionsFromSessionPath:sessionPath toSessionPath:nil];
   }
   return YES;
 }
 
++ (void)moveTabSessionsFromSessionPath:(NSString*)sessionPath
+                         toSessionPath:(NSString*)destinationPath {
+  NSFileManager* fileManager = [NSFileManager defaultManager];
+  NSString* tabsDirectory =
+      [SessionServiceIOS tabSessionsDirectoryForSessionPath:sessionPath];
+  if (![fileManager fileExistsAtPath:tabsDirectory])
+    return;
+
+  if (!destinationPath) {
+    [fileManager removeItemAtPath:tabsDirectory error:nil];
+    return;
+  }
+
+  NSString* destinationTabsDirectory =
+      [SessionServiceIOS tabSessionsDirectoryForSessionPath:destinationPath];
+  [fileManager removeItemAtPath:destinationTabsDirectory error:nil];
+  [fileManager moveItemAtPath:tabsDirectory
+                       toPath:destinationTabsDirectory
+                        error:nil];
+}
+
 + (NSString*)backupPathForSessionID:(NSString*)sessionID {
   NSString* tmpDirectory = NSTemporaryDirectory();
   if (!sessionID || !sessionID.length)
@@ -489,6 +520,8 @@ static BOOL _sessionRestored = NO;
     [fileManager moveItemAtPath:backupPath
                          toPath:originalSessionPath
                           error:&error];
+    [[strongSelf class] moveTabSessionsFromSessionPath:backupPath
+                                         toSessionPath:originalSessionPath];
     // Remove Parent directory for the backup path, so it doesn't show restore
     // prompt again.
     [fileManager removeItemAtPath:[backupPath stringByDeletingLastPathComponent]
@@ -48,8 +48,8 @@ class CredentialProviderService
       const CoreAccountInfo& previous_primary_account_info) override;
 
  private:
-  // Request all the credentials to sync them. Before adding the fresh ones,
-  // the old ones are deleted.
+  // Request all the credentials to sync them. The credentials that are not in
+  // the password store anymore are deleted.
   void RequestSyncAllCredentials();
 
   // Evaluates if a credential refresh is needed, and request all the
@@ -57,7 +57,7 @@ class CredentialProviderService
   void RequestSyncAllCredentialsIfNeeded();
 
   // Replaces all data with credentials created from the passed forms and then
-  // syncs to disk.
+  // syncs to disk. Only the credentials that changed are replaced.
   void SyncAllCredentials(
       std::vector<std::unique_ptr<password_manager::PasswordForm>> forms);
 
@@ -193,8 +193,31 @@ void CredentialProviderService::RequestSyncAllCredentialsIfNeeded() {
 
 void CredentialProviderService::SyncAllCredentials(
     std::vector<std::unique_ptr<PasswordForm>> forms) {
-  [archivable_credential_store_ removeAllCredentials];
-  AddCredentials(std::move(forms));
+  // Only the credentials that changed are replaced, so that saving the store
+  // only writes them.
+  NSMutableDictionary<NSString*, id<Credential>>* stale_credentials =
+      [NSMutableDictionary dictionary];
+  for (id<Credential> credential in archivable_credential_store_.credentials) {
+    stale_credentials[credential.recordIdentifier] = credential;
+  }
+  NSMutableArray<ArchivableCredential*>* changed_credentials =
+      [NSMutableArray array];
+  for (const auto& form : forms) {
+    ArchivableCredential* credential = [[ArchivableCredential alloc]
+        initWithPasswordForm:*form
+                     favicon:nil
+        validationIdentifier:account_validation_id_];
+    DCHECK(credential);
+    id<Credential> stored_credential =
+        stale_credentials[credential.recordIdentifier];
+    if (![credential isEqual:stored_credential]) {
+      [changed_credentials addObject:credential];
+    }
+    [stale_credentials removeObjectForKey:credential.recordIdentifier];
+  }
+  [archivable_credential_store_
+                      addOrUpdateCredentials:changed_credentials
+      removeCredentialsWithRecordIdentifiers:stale_credentials.allKeys];
   SyncStore(true);
 }
 
@@ -221,24 +244,31 @@ void CredentialProviderService::SyncStore(bool set_first_time_sync_flag) {
 
 void CredentialProviderService::AddCredentials(
     std::vector<std::unique_ptr<PasswordForm>> forms) {
+  NSMutableArray<ArchivableCredential*>* credentials =
+      [NSMutableArray arrayWithCapacity:forms.size()];
   for (const auto& form : forms) {
     ArchivableCredential* credential = [[ArchivableCredential alloc]
         initWithPasswordForm:*form
                      favicon:nil
         validationIdentifier:account_validation_id_];
     DCHECK(credential);
-    [archivable_credential_store_ addCredential:credential];
+    [credentials addObject:credential];
   }
+  [archivable_credential_store_ addOrUpdateCredentials:credentials
+                removeCredentialsWithRecordIdentifiers:nil];
 }
 
 void CredentialProviderService::RemoveCredentials(
     std::vector<std::unique_ptr<PasswordForm>> forms) {
+  NSMutableArray<NSString*>* record_ids =
+      [NSMutableArray arrayWithCapacity:forms.size()];
   for (const auto& form : forms) {
     NSString* recordID = RecordIdentifierForPasswordForm(*form);
     DCHECK(recordID);
-    [archivable_credential_store_
-        removeCredentialWithRecordIdentifier:recordID];
+    [record_ids addObject:recordID];
   }
+  [archivable_credential_store_ addOrUpdateCredentials:nil
+                removeCredentialsWithRecordIdentifiers:record_ids];
 }
 
 void CredentialProviderService::UpdateAccountValidationId() {
@@ -7,6 +7,10 @@
 
 #import <Foundation/Foundation.h>
 
+#include <map>
+#include <memory>
+#include <string>
+
 #include "base/macros.h"
 #include "base/task/cancelable_task_tracker.h"
 #include "components/keyed_service/core/keyed_service.h"
@@ -20,14 +24,48 @@ class LargeIconService;
 
 // A class that manages asynchronously loading favicons or fallback attributes
 // from LargeIconService and caching them, given a URL.
+//
+// Concurrent requests for the same favicon are coalesced onto a single
+// LargeIconService request, whose result is passed to all of them. When
+// kFaviconLoaderFetchLimit is enabled, a limited number of LargeIconService
+// requests are in flight at a time, so the requests can be reprioritized or
+// cancelled, e.g. when the cell displaying the favicon is scrolled off-screen,
+// before they reach LargeIconService.
 class FaviconLoader : public KeyedService {
  public:
   // Type for completion block for FaviconForURL().
   typedef void (^FaviconAttributesCompletionBlock)(FaviconAttributes*);
 
+  // Identifies a request, to change its priority or cancel it.
+  using RequestId = int;
+  static const RequestId kInvalidRequestId = 0;
+
+  // Priority of a request. When the number of requests in flight is limited,
+  // the high priority requests are sent to LargeIconService first, the most
+  // recent first.
+  enum class Priority {
+    kLow,
+    kHigh,
+  };
+
+  // Counters of the requests since the FaviconLoader was created.
+  struct Stats {
+    // Number of requests that were not answered from the cache.
+    int request_count = 0;
+    // Number of requests coalesced onto a request for the same favicon.
+    int deduplicated_request_count = 0;
+    // Number of requests cancelled before they completed.
+    int cancelled_request_count = 0;
+    // Number of requests sent to LargeIconService.
+    int backend_request_count = 0;
+  };
+
   explicit FaviconLoader(favicon::LargeIconService* large_icon_service);
   ~FaviconLoader() override;
 
+  // The following methods return kInvalidRequestId if the favicon is found in
+  // the cache, or the ID of the request, which has the high priority.
+
   // Tries to find a FaviconAttributes in |favicon_cache_| with |page_url|:
   // If found, invokes |faviconBlockHandler| and exits.
   // If not found, invokes |faviconBlockHandler| with a default placeholder
@@ -39,11 +77,12 @@ class FaviconLoader : public KeyedService {
   //      |fallback_to_google_server|=YES (|size_in_points| is ignored when
   //      fetching from the Google server);
   //   3. Create a favicon base on the fallback style from |large_icon_service|.
-  void FaviconForPageUrl(const GURL& page_url,
-                         float size_in_points,
-                         float min_size_in_points,
-                         bool fallback_to_google_server,
-                         FaviconAttributesCompletionBlock faviconBlockHandler);
+  RequestId FaviconForPageUrl(
+      const GURL& page_url,
+      float size_in_points,
+      float min_size_in_points,
+      bool fallback_to_google_server,
+      FaviconAttributesCompletionBlock faviconBlockHandler);
 
   // Tries to find a FaviconAttributes in |favicon_cache_| with |page_url|:
   // If found, invokes |faviconBlockHandler| and exits.
@@ -53,7 +92,7 @@ class FaviconLoader : public KeyedService {
   //   1. Use |large_icon_service_| to fetch from local DB managed by
   //      HistoryService;
   //   2. Create a favicon base on the fallback style from |large_icon_service|.
-  void FaviconForPageUrlOrHost(
+  RequestId FaviconForPageUrlOrHost(
       const GURL& page_url,
       float size_in_points,
       FaviconAttributesCompletionBlock favicon_block_handler);
@@ -66,15 +105,85 @@ class FaviconLoader : public KeyedService {
   //   1. Use |large_icon_service_| to fetch from local DB managed by
   //      HistoryService;
   //   2. Create a favicon base on the fallback style from |large_icon_service|.
-  void FaviconForIconUrl(const GURL& icon_url,
-                         float size_in_points,
-                         float min_size_in_points,
-                         FaviconAttributesCompletionBlock faviconBlockHandler);
+  RequestId FaviconForIconUrl(
+      const GURL& icon_url,
+      float size_in_points,
+      float min_size_in_points,
+      FaviconAttributesCompletionBlock faviconBlockHandler);
+
+  // Sets the priority of the request |request_id|, if it is not complete.
+  void SetRequestPriority(RequestId request_id, Priority priority);
+
+  // Cancels the request |request_id|, if it is not complete. Its completion
+  // block is not invoked anymore.
+  void CancelRequest(RequestId request_id);
 
   // Cancel all incomplete requests.
   void CancellAllRequests();
 
+  const Stats& stats() const { return stats_; }
+
  private:
+  // Type of the blocks fetching a favicon from |large_icon_service_| and
+  // passing it to a completion block. They return the ID of the
+  // LargeIconService task.
+  typedef base::CancelableTaskTracker::TaskId (^FetchBlock)(
+      FaviconAttributesCompletionBlock);
+
+  // Request for a favicon, shared by all the requests for the same favicon.
+  struct PendingFetch {
+    PendingFetch();
+    ~PendingFetch();
+
+    // Completion blocks of the requests, and their priority, by request ID.
+    std::map<RequestId, FaviconAttributesCompletionBlock> handlers;
+    std::map<RequestId, Priority> priorities;
+    // Order in which the fetch was added, to start the most recent first.
+    int sequence_number = 0;
+    FetchBlock fetch;
+    // Whether the fetch was sent to |large_icon_service_|, and the ID of its
+    // current task.
+    bool started = false;
+    base::CancelableTaskTracker::TaskId task_id =
+        base::CancelableTaskTracker::kBadTaskId;
+
+    // Returns the highest priority of the requests.
+    Priority GetPriority() const;
+  };
+
+  // Adds a request with |handler| for the favicon cached with |key|, which is
+  // fetched with |fetch| unless it is already being fetched. Returns the ID of
+  // the request.
+  RequestId AddRequest(NSString* key,
+                       FaviconAttributesCompletionBlock handler,
+                       FetchBlock fetch);
+
+  // Starts the pending fetches, while fewer than the maximum number of fetches
+  // are in flight.
+  void StartPendingFetches();
+
+  // Completes the fetch for |key| with |attributes|, and invokes the completion
+  // blocks of its requests.
+  void CompleteFetch(const std::string& key, FaviconAttributes* attributes);
+
+  // Returns the started fetch for |key| whose current task is |task_id|, or
+  // null if its requests were cancelled.
+  PendingFetch* FindStartedFetch(const std::string& key,
+                                 base::CancelableTaskTracker::TaskId task_id);
+
+  // Fetches the favicon of |page_url|, from the Google server if it is not
+  // available locally and |fallback_to_google_server|, caches it with |key|
+  // and passes it to |completion|. Returns the ID of the LargeIconService task.
+  // The fetch for |key| is updated with the ID of the task reading the favicon
+  // fetched from the Google server.
+  base::CancelableTaskTracker::TaskId FetchFaviconForPageUrl(
+      const GURL& page_url,
+      float size_in_points,
+      float min_size_in_points,
+      bool fallback_to_google_server,
+      NSString* key,
+      FaviconAttributesCompletionBlock completion);
+
   // The LargeIconService used to retrieve favicon.
   favicon::LargeIconService* large_icon_service_;
 
@@ -86,6 +195,18 @@ class FaviconLoader : public KeyedService {
   // algorithm. Keyed by NSString of URL (page URL or icon URL) spec.
   NSCache<NSString*, FaviconAttributes*>* favicon_cache_;
 
+  // Fetches of the favicons being requested, by cache key.
+  std::map<std::string, std::unique_ptr<PendingFetch>> pending_fetches_;
+  // Cache keys of the requests, by request ID.
+  std::map<RequestId, std::string> request_keys_;
+  RequestId next_request_id_ = kInvalidRequestId + 1;
+  int next_sequence_number_ = 0;
+  // Number of fetches sent to |large_icon_service_| and not complete, and the
+  // maximum number of them.
+  int in_flight_fetch_count_ = 0;
+  const int max_in_flight_fetches_;
+  Stats stats_;
+
   DISALLOW_COPY_AND_ASSIGN(FaviconLoader);
 };
 
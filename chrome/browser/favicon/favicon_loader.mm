@@ -6,6 +6,9 @@
 
 #import <UIKit/UIKit.h>
 
+#include <algorithm>
+#include <limits>
+
 #include "base/bind.h"
 #import "base/mac/foundation_util.h"
 #include "base/strings/sys_string_conversions.h"
@@ -14,6 +17,7 @@
 #include "components/favicon_base/fallback_icon_style.h"
 #include "components/favicon_base/favicon_callback.h"
 #include "components/favicon_base/favicon_types.h"
+#include "ios/chrome/browser/favicon/features.h"
 #import "ios/chrome/browser/ui/util/uikit_ui_util.h"
 #import "ios/chrome/common/ui/favicon/favicon_attributes.h"
 #include "net/traffic_annotation/network_traffic_annotation.h"
@@ -27,6 +31,16 @@
 namespace {
 const CGFloat kFallbackIconDefaultTextColor = 0xAAAAAA;
 
+// Returns the maximum number of requests sent to LargeIconService at a time.
+// Its requests to the favicon database are handled one at a time, so sending
+// more of them would only prevent the pending ones from being reprioritized or
+// cancelled.
+int GetMaxInFlightFetches() {
+  if (!base::FeatureList::IsEnabled(kFaviconLoaderFetchLimit))
+    return std::numeric_limits<int>::max();
+  return std::max(1, kFaviconLoaderMaxInFlightFetches.Get());
+}
+
 // NetworkTrafficAnnotationTag for fetching favicon from a Google server.
 const net::NetworkTrafficAnnotationTag kTrafficAnnotation =
     net::DefineNetworkTrafficAnnotation("favicon_loader_get_large_icon", R"(
@@ -47,15 +61,28 @@ const net::NetworkTrafficAnnotationTag kTrafficAnnotation =
         )");
 }  // namespace
 
+FaviconLoader::PendingFetch::PendingFetch() = default;
+
+FaviconLoader::PendingFetch::~PendingFetch() = default;
+
+FaviconLoader::Priority FaviconLoader::PendingFetch::GetPriority() const {
+  for (const auto& pair : priorities) {
+    if (pair.second == Priority::kHigh)
+      return Priority::kHigh;
+  }
+  return Priority::kLow;
+}
+
 FaviconLoader::FaviconLoader(favicon::LargeIconService* large_icon_service)
     : large_icon_service_(large_icon_service),
-      favicon_cache_([[NSCache alloc] init]) {}
+      favicon_cache_([[NSCache alloc] init]),
+      max_in_flight_fetches_(GetMaxInFlightFetches()) {}
 FaviconLoader::~FaviconLoader() {}
 
 // TODO(pinkerton): How do we update the favicon if it's changed on the web?
 // We can possibly just rely on this class being purged or the app being killed
 // to reset it, but then how do we ensure the FaviconService is updated?
-void FaviconLoader::FaviconForPageUrl(
+FaviconLoader::RequestId FaviconLoader::FaviconForPageUrl(
     const GURL& page_url,
     float size_in_points,
     float min_size_in_points,
@@ -70,80 +97,25 @@ void FaviconLoader::FaviconForPageUrl(
   FaviconAttributes* value = [favicon_cache_ objectForKey:key];
   if (value) {
     faviconBlockHandler(value);
-    return;
+    return kInvalidRequestId;
   }
 
-  const CGFloat scale = UIScreen.mainScreen.scale;
-  GURL block_page_url(page_url);
-  auto favicon_block = ^(const favicon_base::LargeIconResult& result) {
-    // GetLargeIconOrFallbackStyle() either returns a valid favicon (which can
-    // be the default favicon) or fallback attributes.
-    if (result.bitmap.is_valid()) {
-      scoped_refptr<base::RefCountedMemory> data =
-          result.bitmap.bitmap_data.get();
-      // The favicon code assumes favicons are PNG-encoded.
-      UIImage* favicon = [UIImage
-          imageWithData:[NSData dataWithBytes:data->front() length:data->size()]
-                  scale:scale];
-      FaviconAttributes* attributes =
-          [FaviconAttributes attributesWithImage:favicon];
-      [favicon_cache_ setObject:attributes forKey:key];
-
-      DCHECK(favicon.size.width <= size_in_points &&
-             favicon.size.height <= size_in_points);
-      faviconBlockHandler(attributes);
-      return;
-    } else if (fallback_to_google_server) {
-      void (^favicon_loaded_from_server_block)(
-          favicon_base::GoogleFaviconServerRequestStatus status) =
-          ^(const favicon_base::GoogleFaviconServerRequestStatus status) {
-            // Update the time when the icon was last requested - postpone thus
-            // the automatic eviction of the favicon from the favicon database.
-            large_icon_service_->TouchIconFromGoogleServer(block_page_url);
-
-            // Favicon should be loaded to the db that backs LargeIconService
-            // now.  Fetch it again. Even if the request was not successful, the
-            // fallback style will be used.
-            FaviconForPageUrl(
-                block_page_url, size_in_points, min_size_in_points,
-                /*continueToGoogleServer=*/false, faviconBlockHandler);
-          };
-
-      large_icon_service_
-          ->GetLargeIconOrFallbackStyleFromGoogleServerSkippingLocalCache(
-              block_page_url,
-              /*may_page_url_be_private=*/true,
-              /*should_trim_page_url_path=*/false, kTrafficAnnotation,
-              base::BindRepeating(favicon_loaded_from_server_block));
-      return;
-    }
-
-    // Did not get valid favicon back and are not attempting to retrieve one
-    // from a Google Server.
-    DCHECK(result.fallback_icon_style);
-    FaviconAttributes* attributes = [FaviconAttributes
-        attributesWithMonogram:base::SysUTF16ToNSString(
-                                   favicon::GetFallbackIconText(block_page_url))
-                     textColor:UIColorFromRGB(kFallbackIconDefaultTextColor)
-               backgroundColor:UIColor.clearColor
-        defaultBackgroundColor:result.fallback_icon_style->
-                               is_default_background_color];
-
-    [favicon_cache_ setObject:attributes forKey:key];
-    faviconBlockHandler(attributes);
-  };
-
   // First, synchronously return a fallback image.
   faviconBlockHandler([FaviconAttributes attributesWithDefaultImage]);
 
-  // Now fetch the image synchronously.
-  DCHECK(large_icon_service_);
-  large_icon_service_->GetLargeIconRawBitmapOrFallbackStyleForPageUrl(
-      page_url, scale * min_size_in_points, scale * size_in_points,
-      base::BindRepeating(favicon_block), &cancelable_task_tracker_);
+  // Now fetch the image asynchronously.
+  GURL block_page_url(page_url);
+  return AddRequest(
+      key, faviconBlockHandler,
+      ^(FaviconAttributesCompletionBlock completion) {
+        return FetchFaviconForPageUrl(block_page_url, size_in_points,
+                                      min_size_in_points,
+                                      fallback_to_google_server, key,
+                                      completion);
+      });
 }
 
-void FaviconLoader::FaviconForPageUrlOrHost(
+FaviconLoader::RequestId FaviconLoader::FaviconForPageUrlOrHost(
     const GURL& page_url,
     float size_in_points,
     FaviconAttributesCompletionBlock favicon_block_handler) {
@@ -154,57 +126,63 @@ void FaviconLoader::FaviconForPageUrlOrHost(
   FaviconAttributes* value = [favicon_cache_ objectForKey:key];
   if (value) {
     favicon_block_handler(value);
-    return;
+    return kInvalidRequestId;
   }
 
   const CGFloat scale = UIScreen.mainScreen.scale;
   GURL block_page_url(page_url);
-  auto favicon_block = ^(const favicon_base::LargeIconResult& result) {
-    // GetLargeIconOrFallbackStyle() either returns a valid favicon (which can
-    // be the default favicon) or fallback attributes.
-    if (result.bitmap.is_valid()) {
-      scoped_refptr<base::RefCountedMemory> data =
-          result.bitmap.bitmap_data.get();
-      // The favicon code assumes favicons are PNG-encoded.
-      UIImage* favicon = [UIImage
-          imageWithData:[NSData dataWithBytes:data->front() length:data->size()]
-                  scale:scale];
-      FaviconAttributes* attributes =
-          [FaviconAttributes attributesWithImage:favicon];
-      [favicon_cache_ setObject:attributes forKey:key];
+  FetchBlock fetch = ^(FaviconAttributesCompletionBlock completion) {
+    auto favicon_block = ^(const favicon_base::LargeIconResult& result) {
+      // GetLargeIconOrFallbackStyle() either returns a valid favicon (which
+      // can be the default favicon) or fallback attributes.
+      if (result.bitmap.is_valid()) {
+        scoped_refptr<base::RefCountedMemory> data =
+            result.bitmap.bitmap_data.get();
+        // The favicon code assumes favicons are PNG-encoded.
+        UIImage* favicon =
+            [UIImage imageWithData:[NSData dataWithBytes:data->front()
+                                                  length:data->size()]
+                             scale:scale];
+        FaviconAttributes* attributes =
+            [FaviconAttributes attributesWithImage:favicon];
+        [favicon_cache_ setObject:attributes forKey:key];
 
-      DCHECK(favicon.size.width <= size_in_points &&
-             favicon.size.height <= size_in_points);
-      favicon_block_handler(attributes);
-      return;
-    }
+        DCHECK(favicon.size.width <= size_in_points &&
+               favicon.size.height <= size_in_points);
+        completion(attributes);
+        return;
+      }
 
-    // Did not get valid favicon back and are not attempting to retrieve one
-    // from a Google Server.
-    DCHECK(result.fallback_icon_style);
-    FaviconAttributes* attributes = [FaviconAttributes
-        attributesWithMonogram:base::SysUTF16ToNSString(
-                                   favicon::GetFallbackIconText(block_page_url))
-                     textColor:UIColorFromRGB(kFallbackIconDefaultTextColor)
-               backgroundColor:UIColor.clearColor
-        defaultBackgroundColor:result.fallback_icon_style->
-                               is_default_background_color];
+      // Did not get valid favicon back and are not attempting to retrieve one
+      // from a Google Server.
+      DCHECK(result.fallback_icon_style);
+      FaviconAttributes* attributes = [FaviconAttributes
+          attributesWithMonogram:base::SysUTF16ToNSString(
+                                     favicon::GetFallbackIconText(
+                                         block_page_url))
+                       textColor:UIColorFromRGB(kFallbackIconDefaultTextColor)
+                 backgroundColor:UIColor.clearColor
+          defaultBackgroundColor:result.fallback_icon_style->
+                                 is_default_background_color];
 
-    [favicon_cache_ setObject:attributes forKey:key];
-    favicon_block_handler(attributes);
+      [favicon_cache_ setObject:attributes forKey:key];
+      completion(attributes);
+    };
+
+    DCHECK(large_icon_service_);
+    return large_icon_service_->GetIconRawBitmapOrFallbackStyleForPageUrl(
+        block_page_url, scale * size_in_points,
+        base::BindRepeating(favicon_block), &cancelable_task_tracker_);
   };
 
   // First, synchronously return a fallback image.
   favicon_block_handler([FaviconAttributes attributesWithDefaultImage]);
 
-  // Now fetch the image synchronously.
-  DCHECK(large_icon_service_);
-  large_icon_service_->GetIconRawBitmapOrFallbackStyleForPageUrl(
-      page_url, scale * size_in_points, base::BindRepeating(favicon_block),
-      &cancelable_task_tracker_);
+  // Now fetch the image asynchronously.
+  return AddRequest(key, favicon_block_handler, fetch);
 }
 
-void FaviconLoader::FaviconForIconUrl(
+FaviconLoader::RequestId FaviconLoader::FaviconForIconUrl(
     const GURL& icon_url,
     float size_in_points,
     float min_size_in_points,
@@ -216,13 +194,209 @@ void FaviconLoader::FaviconForIconUrl(
   FaviconAttributes* value = [favicon_cache_ objectForKey:key];
   if (value) {
     faviconBlockHandler(value);
-    return;
+    return kInvalidRequestId;
   }
 
   const CGFloat scale = UIScreen.mainScreen.scale;
   const CGFloat favicon_size_in_pixels = scale * size_in_points;
   const CGFloat min_favicon_size_in_pixels = scale * min_size_in_points;
   GURL block_icon_url(icon_url);
+  FetchBlock fetch = ^(FaviconAttributesCompletionBlock completion) {
+    auto favicon_block = ^(const favicon_base::LargeIconResult& result) {
+      // GetLargeIconOrFallbackStyle() either returns a valid favicon (which
+      // can be the default favicon) or fallback attributes.
+      if (result.bitmap.is_valid()) {
+        scoped_refptr<base::RefCountedMemory> data =
+            result.bitmap.bitmap_data.get();
+        // The favicon code assumes favicons are PNG-encoded.
+        UIImage* favicon =
+            [UIImage imageWithData:[NSData dataWithBytes:data->front()
+                                                  length:data->size()]
+                             scale:scale];
+        FaviconAttributes* attributes =
+            [FaviconAttributes attributesWithImage:favicon];
+        [favicon_cache_ setObject:attributes forKey:key];
+        completion(attributes);
+        return;
+      }
+      // Did not get valid favicon back and are not attempting to retrieve one
+      // from a Google Server
+      DCHECK(result.fallback_icon_style);
+      FaviconAttributes* attributes = [FaviconAttributes
+          attributesWithMonogram:base::SysUTF16ToNSString(
+                                     favicon::GetFallbackIconText(
+                                         block_icon_url))
+                       textColor:UIColorFromRGB(kFallbackIconDefaultTextColor)
+                 backgroundColor:UIColor.clearColor
+          defaultBackgroundColor:result.fallback_icon_style->
+                                 is_default_background_color];
+
+      [favicon_cache_ setObject:attributes forKey:key];
+      completion(attributes);
+    };
+
+    DCHECK(large_icon_service_);
+    return large_icon_service_->GetLargeIconRawBitmapOrFallbackStyleForIconUrl(
+        block_icon_url, min_favicon_size_in_pixels, favicon_size_in_pixels,
+        base::BindRepeating(favicon_block), &cancelable_task_tracker_);
+  };
+
+  // First, return a fallback synchronously.
+  faviconBlockHandler([FaviconAttributes
+      attributesWithImage:[UIImage imageNamed:@"default_world_favicon"]]);
+
+  // Now call the service for a better async icon.
+  return AddRequest(key, faviconBlockHandler, fetch);
+}
+
+void FaviconLoader::SetRequestPriority(RequestId request_id,
+                                       Priority priority) {
+  auto key_it = request_keys_.find(request_id);
+  if (key_it == request_keys_.end())
+    return;
+  PendingFetch* pending_fetch = pending_fetches_[key_it->second].get();
+  DCHECK(pending_fetch);
+  pending_fetch->priorities[request_id] = priority;
+}
+
+void FaviconLoader::CancelRequest(RequestId request_id) {
+  auto key_it = request_keys_.find(request_id);
+  if (key_it == request_keys_.end())
+    return;
+  const std::string key = key_it->second;
+  request_keys_.erase(key_it);
+  stats_.cancelled_request_count++;
+
+  auto fetch_it = pending_fetches_.find(key);
+  DCHECK(fetch_it != pending_fetches_.end());
+  PendingFetch* pending_fetch = fetch_it->second.get();
+  pending_fetch->handlers.erase(request_id);
+  pending_fetch->priorities.erase(request_id);
+  if (!pending_fetch->handlers.empty())
+    return;
+
+  // No request is waiting for the favicon anymore.
+  if (pending_fetch->started) {
+    cancelable_task_tracker_.TryCancel(pending_fetch->task_id);
+    in_flight_fetch_count_--;
+  }
+  pending_fetches_.erase(fetch_it);
+  StartPendingFetches();
+}
+
+void FaviconLoader::CancellAllRequests() {
+  cancelable_task_tracker_.TryCancelAll();
+  stats_.cancelled_request_count += request_keys_.size();
+  pending_fetches_.clear();
+  request_keys_.clear();
+  in_flight_fetch_count_ = 0;
+}
+
+FaviconLoader::RequestId FaviconLoader::AddRequest(
+    NSString* key,
+    FaviconAttributesCompletionBlock handler,
+    FetchBlock fetch) {
+  const std::string fetch_key = base::SysNSStringToUTF8(key);
+  const RequestId request_id = next_request_id_++;
+  request_keys_[request_id] = fetch_key;
+  stats_.request_count++;
+
+  std::unique_ptr<PendingFetch>& pending_fetch = pending_fetches_[fetch_key];
+  if (pending_fetch) {
+    stats_.deduplicated_request_count++;
+  } else {
+    pending_fetch = std::make_unique<PendingFetch>();
+    pending_fetch->fetch = fetch;
+  }
+  // A request coalesced onto a pending one is as recent as the last request.
+  pending_fetch->sequence_number = next_sequence_number_++;
+  pending_fetch->handlers[request_id] = handler;
+  pending_fetch->priorities[request_id] = Priority::kHigh;
+
+  StartPendingFetches();
+  return request_id;
+}
+
+void FaviconLoader::StartPendingFetches() {
+  while (in_flight_fetch_count_ < max_in_flight_fetches_) {
+    // Find the most recent of the fetches with the highest priority.
+    std::string next_key;
+    PendingFetch* next_fetch = nullptr;
+    for (const auto& pair : pending_fetches_) {
+      PendingFetch* pending_fetch = pair.second.get();
+      if (pending_fetch->started)
+        continue;
+      if (!next_fetch ||
+          std::make_pair(pending_fetch->GetPriority(),
+                         pending_fetch->sequence_number) >
+              std::make_pair(next_fetch->GetPriority(),
+                             next_fetch->sequence_number)) {
+        next_key = pair.first;
+        next_fetch = pending_fetch;
+      }
+    }
+    if (!next_fetch)
+      return;
+
+    next_fetch->started = true;
+    in_flight_fetch_count_++;
+    stats_.backend_request_count++;
+    FetchBlock fetch = next_fetch->fetch;
+    next_fetch->fetch = nil;
+    base::CancelableTaskTracker::TaskId task_id =
+        fetch(^(FaviconAttributes* attributes) {
+          CompleteFetch(next_key, attributes);
+        });
+
+    // The fetch may have completed synchronously.
+    auto it = pending_fetches_.find(next_key);
+    if (it != pending_fetches_.end() && it->second.get() == next_fetch)
+      next_fetch->task_id = task_id;
+  }
+}
+
+void FaviconLoader::CompleteFetch(const std::string& key,
+                                  FaviconAttributes* attributes) {
+  auto it = pending_fetches_.find(key);
+  if (it == pending_fetches_.end() || !it->second->started) {
+    // The requests were cancelled.
+    return;
+  }
+  std::unique_ptr<PendingFetch> pending_fetch = std::move(it->second);
+  pending_fetches_.erase(it);
+  in_flight_fetch_count_--;
+  for (const auto& pair : pending_fetch->handlers)
+    request_keys_.erase(pair.first);
+
+  for (const auto& pair : pending_fetch->handlers)
+    pair.second(attributes);
+  StartPendingFetches();
+}
+
+FaviconLoader::PendingFetch* FaviconLoader::FindStartedFetch(
+    const std::string& key,
+    base::CancelableTaskTracker::TaskId task_id) {
+  auto it = pending_fetches_.find(key);
+  if (it == pending_fetches_.end() || !it->second->started ||
+      it->second->task_id != task_id) {
+    return nullptr;
+  }
+  return it->second.get();
+}
+
+base::CancelableTaskTracker::TaskId FaviconLoader::FetchFaviconForPageUrl(
+    const GURL& page_url,
+    float size_in_points,
+    float min_size_in_points,
+    bool fallback_to_google_server,
+    NSString* key,
+    FaviconAttributesCompletionBlock completion) {
+  const CGFloat scale = UIScreen.mainScreen.scale;
+  GURL block_page_url(page_url);
+  const std::string fetch_key = base::SysNSStringToUTF8(key);
+  // Set once the task is created, before it completes.
+  __block base::CancelableTaskTracker::TaskId task_id =
+      base::CancelableTaskTracker::kBadTaskId;
   auto favicon_block = ^(const favicon_base::LargeIconResult& result) {
     // GetLargeIconOrFallbackStyle() either returns a valid favicon (which can
     // be the default favicon) or fallback attributes.
@@ -236,35 +410,67 @@ void FaviconLoader::FaviconForIconUrl(
       FaviconAttributes* attributes =
           [FaviconAttributes attributesWithImage:favicon];
       [favicon_cache_ setObject:attributes forKey:key];
-      faviconBlockHandler(attributes);
+
+      DCHECK(favicon.size.width <= size_in_points &&
+             favicon.size.height <= size_in_points);
+      completion(attributes);
+      return;
+    } else if (fallback_to_google_server) {
+      void (^favicon_loaded_from_server_block)(
+          favicon_base::GoogleFaviconServerRequestStatus status) =
+          ^(const favicon_base::GoogleFaviconServerRequestStatus status) {
+            // Update the time when the icon was last requested - postpone thus
+            // the automatic eviction of the favicon from the favicon database.
+            large_icon_service_->TouchIconFromGoogleServer(block_page_url);
+
+            // The requests may have been cancelled while the favicon was
+            // fetched from the server.
+            if (!FindStartedFetch(fetch_key, task_id))
+              return;
+
+            // Favicon should be loaded to the db that backs LargeIconService
+            // now.  Fetch it again. Even if the request was not successful, the
+            // fallback style will be used.
+            base::CancelableTaskTracker::TaskId local_task_id =
+                FetchFaviconForPageUrl(block_page_url, size_in_points,
+                                       min_size_in_points,
+                                       /*fallback_to_google_server=*/false,
+                                       key, completion);
+
+            // Track the new task so that cancelling the requests cancels it.
+            if (PendingFetch* pending_fetch =
+                    FindStartedFetch(fetch_key, task_id)) {
+              pending_fetch->task_id = local_task_id;
+            }
+          };
+
+      large_icon_service_
+          ->GetLargeIconOrFallbackStyleFromGoogleServerSkippingLocalCache(
+              block_page_url,
+              /*may_page_url_be_private=*/true,
+              /*should_trim_page_url_path=*/false, kTrafficAnnotation,
+              base::BindRepeating(favicon_loaded_from_server_block));
       return;
     }
+
     // Did not get valid favicon back and are not attempting to retrieve one
-    // from a Google Server
+    // from a Google Server.
     DCHECK(result.fallback_icon_style);
     FaviconAttributes* attributes = [FaviconAttributes
         attributesWithMonogram:base::SysUTF16ToNSString(
-                                   favicon::GetFallbackIconText(block_icon_url))
+                                   favicon::GetFallbackIconText(block_page_url))
                      textColor:UIColorFromRGB(kFallbackIconDefaultTextColor)
                backgroundColor:UIColor.clearColor
         defaultBackgroundColor:result.fallback_icon_style->
                                is_default_background_color];
 
     [favicon_cache_ setObject:attributes forKey:key];
-    faviconBlockHandler(attributes);
+    completion(attributes);
   };
 
-  // First, return a fallback synchronously.
-  faviconBlockHandler([FaviconAttributes
-      attributesWithImage:[UIImage imageNamed:@"default_world_favicon"]]);
-
-  // Now call the service for a better async icon.
   DCHECK(large_icon_service_);
-  large_icon_service_->GetLargeIconRawBitmapOrFallbackStyleForIconUrl(
-      icon_url, min_favicon_size_in_pixels, favicon_size_in_pixels,
+  task_id = large_icon_service_->GetLargeIconRawBitmapOrFallbackStyleForPageUrl(
+      page_url, scale * min_size_in_points, scale * size_in_points,
       base::BindRepeating(favicon_block), &cancelable_task_tracker_);
-}
-
-void FaviconLoader::CancellAllRequests() {
-  cancelable_task_tracker_.TryCancelAll();
+  return task_id;
 }
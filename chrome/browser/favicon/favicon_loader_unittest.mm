@@ -4,9 +4,15 @@
 
 #import "ios/chrome/browser/favicon/favicon_loader.h"
 
+#include <utility>
+#include <vector>
+
+#include "base/strings/string_number_conversions.h"
+#include "base/test/scoped_feature_list.h"
 #include "components/favicon/core/large_icon_service_impl.h"
 #include "components/favicon_base/fallback_icon_style.h"
 #include "components/favicon_base/favicon_types.h"
+#include "ios/chrome/browser/favicon/features.h"
 #import "ios/chrome/common/ui/favicon/favicon_attributes.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/platform_test.h"
@@ -47,7 +53,8 @@ class FakeLargeIconService : public favicon::LargeIconServiceImpl {
             /*google_server_client_param=*/"test_chrome") {}
 
   // Returns LargeIconResult with valid bitmap if |page_url| is
-  // |kTestFaviconURL|, or LargeIconResult with fallback style.
+  // |kTestFaviconURL|, or LargeIconResult with fallback style. If the
+  // callbacks are deferred, |callback| is run by RunDeferredCallbacks().
   base::CancelableTaskTracker::TaskId
   GetLargeIconRawBitmapOrFallbackStyleForPageUrl(
       const GURL& page_url,
@@ -55,6 +62,80 @@ class FakeLargeIconService : public favicon::LargeIconServiceImpl {
       int desired_size_in_pixel,
       favicon_base::LargeIconCallback callback,
       base::CancelableTaskTracker* tracker) override {
+    request_count_++;
+    if (defer_callbacks_) {
+      deferred_callbacks_.emplace_back(page_url, std::move(callback));
+      return request_count_;
+    }
+    RunCallback(page_url, std::move(callback));
+    return request_count_;
+  }
+
+  // Returns the same as |GetLargeIconRawBitmapOrFallbackStyleForPageUrl|.
+  base::CancelableTaskTracker::TaskId
+  GetLargeIconRawBitmapOrFallbackStyleForIconUrl(
+      const GURL& icon_url,
+      int min_source_size_in_pixel,
+      int desired_size_in_pixel,
+      favicon_base::LargeIconCallback callback,
+      base::CancelableTaskTracker* tracker) override {
+    return GetLargeIconRawBitmapOrFallbackStyleForPageUrl(
+        icon_url, min_source_size_in_pixel, desired_size_in_pixel,
+        std::move(callback), tracker);
+  }
+
+  // Defers the request to the Google server, which is completed by
+  // RunGoogleServerCallbacks().
+  void GetLargeIconOrFallbackStyleFromGoogleServerSkippingLocalCache(
+      const GURL& page_url,
+      bool may_page_url_be_private,
+      bool should_trim_page_url_path,
+      const net::NetworkTrafficAnnotationTag& traffic_annotation,
+      favicon_base::GoogleFaviconServerCallback callback) override {
+    google_server_callbacks_.push_back(std::move(callback));
+  }
+
+  // Does nothing, there is no favicon database.
+  void TouchIconFromGoogleServer(const GURL& icon_url) override {}
+
+  // Completes the requests to the Google server, which failed.
+  void RunGoogleServerCallbacks() {
+    std::vector<favicon_base::GoogleFaviconServerCallback> callbacks;
+    callbacks.swap(google_server_callbacks_);
+    for (auto& callback : callbacks) {
+      std::move(callback).Run(
+          favicon_base::GoogleFaviconServerRequestStatus::FAILURE_HTTP_ERROR);
+    }
+  }
+
+  // Sets whether the callbacks are run by RunDeferredCallbacks() instead of
+  // synchronously.
+  void set_defer_callbacks(bool defer_callbacks) {
+    defer_callbacks_ = defer_callbacks;
+  }
+
+  // Runs the deferred callbacks, in the order of the requests.
+  void RunDeferredCallbacks() {
+    std::vector<std::pair<GURL, favicon_base::LargeIconCallback>> callbacks;
+    callbacks.swap(deferred_callbacks_);
+    for (auto& pair : callbacks)
+      RunCallback(pair.first, std::move(pair.second));
+  }
+
+  // Returns the URLs of the requests whose callbacks are deferred.
+  std::vector<GURL> GetDeferredUrls() const {
+    std::vector<GURL> urls;
+    for (const auto& pair : deferred_callbacks_)
+      urls.push_back(pair.first);
+    return urls;
+  }
+
+  // Number of requests received.
+  int request_count() const { return request_count_; }
+
+ private:
+  void RunCallback(const GURL& page_url,
+                   favicon_base::LargeIconCallback callback) {
     if (page_url.spec() == kTestFaviconURL) {
       favicon_base::FaviconRawBitmapResult bitmapResult;
       bitmapResult.expired = false;
@@ -75,22 +156,14 @@ class FakeLargeIconService : public favicon::LargeIconServiceImpl {
       fallback = NULL;
       std::move(callback).Run(result);
     }
-
-    return 1;
   }
 
-  // Returns the same as |GetLargeIconRawBitmapOrFallbackStyleForPageUrl|.
-  base::CancelableTaskTracker::TaskId
-  GetLargeIconRawBitmapOrFallbackStyleForIconUrl(
-      const GURL& icon_url,
-      int min_source_size_in_pixel,
-      int desired_size_in_pixel,
-      favicon_base::LargeIconCallback callback,
-      base::CancelableTaskTracker* tracker) override {
-    return GetLargeIconRawBitmapOrFallbackStyleForPageUrl(
-        icon_url, min_source_size_in_pixel, desired_size_in_pixel,
-        std::move(callback), tracker);
-  }
+  bool defer_callbacks_ = false;
+  std::vector<std::pair<GURL, favicon_base::LargeIconCallback>>
+      deferred_callbacks_;
+  std::vector<favicon_base::GoogleFaviconServerCallback>
+      google_server_callbacks_;
+  int request_count_ = 0;
 };
 
 class FaviconLoaderTest : public PlatformTest,
@@ -103,16 +176,24 @@ class FaviconLoaderTest : public PlatformTest,
 
   // Returns FaviconLoader::FaviconForPageUrl or
   // FaviconLoader::FaviconForIconUrl depending on the TEST_P param.
-  void FaviconForUrl(const GURL& url,
-                     FaviconLoader::FaviconAttributesCompletionBlock callback) {
+  FaviconLoader::RequestId FaviconForUrl(
+      const GURL& url,
+      FaviconLoader::FaviconAttributesCompletionBlock callback) {
+    return FaviconForUrl(&favicon_loader_, url, callback);
+  }
+
+  // Same as above, with |favicon_loader|.
+  FaviconLoader::RequestId FaviconForUrl(
+      FaviconLoader* favicon_loader,
+      const GURL& url,
+      FaviconLoader::FaviconAttributesCompletionBlock callback) {
     if (GetParam() == TEST_PAGE_URL) {
-      favicon_loader_.FaviconForPageUrl(url, kTestFaviconSize, kTestFaviconSize,
-                                        /*fallback_to_google_server=*/false,
-                                        callback);
-    } else {
-      favicon_loader_.FaviconForIconUrl(url, kTestFaviconSize, kTestFaviconSize,
-                                        callback);
+      return favicon_loader->FaviconForPageUrl(
+          url, kTestFaviconSize, kTestFaviconSize,
+          /*fallback_to_google_server=*/false, callback);
     }
+    return favicon_loader->FaviconForIconUrl(url, kTestFaviconSize,
+                                             kTestFaviconSize, callback);
   }
 
  private:
@@ -174,6 +255,136 @@ TEST_P(FaviconLoaderTest, Cache) {
   EXPECT_TRUE(faviconImage);
 }
 
+// Tests that concurrent requests for the same favicon are sent once to
+// LargeIconService, and that all of them get the favicon.
+TEST_P(FaviconLoaderTest, CoalesceRequests) {
+  large_icon_service_.set_defer_callbacks(true);
+  __block int callback_executed_count = 0;
+  auto confirmation_block = ^(FaviconAttributes* favicon_attributes) {
+    ++callback_executed_count;
+  };
+  EXPECT_NE(FaviconLoader::kInvalidRequestId,
+            FaviconForUrl(GURL(kTestFaviconURL), confirmation_block));
+  EXPECT_NE(FaviconLoader::kInvalidRequestId,
+            FaviconForUrl(GURL(kTestFaviconURL), confirmation_block));
+  // Only the placeholders were returned.
+  EXPECT_EQ(2, callback_executed_count);
+  EXPECT_EQ(1, large_icon_service_.request_count());
+
+  large_icon_service_.RunDeferredCallbacks();
+  EXPECT_EQ(4, callback_executed_count);
+  EXPECT_EQ(2, favicon_loader_.stats().request_count);
+  EXPECT_EQ(1, favicon_loader_.stats().deduplicated_request_count);
+  EXPECT_EQ(1, favicon_loader_.stats().backend_request_count);
+}
+
+// Tests that a cancelled request doesn't get the favicon, while the other
+// requests for the same favicon do.
+TEST_P(FaviconLoaderTest, CancelRequest) {
+  large_icon_service_.set_defer_callbacks(true);
+  __block int cancelled_callback_count = 0;
+  FaviconLoader::RequestId request_id =
+      FaviconForUrl(GURL(kTestFaviconURL), ^(FaviconAttributes* attributes) {
+        ++cancelled_callback_count;
+      });
+  __block int callback_executed_count = 0;
+  FaviconForUrl(GURL(kTestFaviconURL), ^(FaviconAttributes* attributes) {
+    ++callback_executed_count;
+  });
+
+  favicon_loader_.CancelRequest(request_id);
+  large_icon_service_.RunDeferredCallbacks();
+  // Only the placeholder was returned to the cancelled request.
+  EXPECT_EQ(1, cancelled_callback_count);
+  EXPECT_EQ(2, callback_executed_count);
+  EXPECT_EQ(1, favicon_loader_.stats().cancelled_request_count);
+}
+
+// Tests that all the requests are sent to LargeIconService by default.
+TEST_P(FaviconLoaderTest, NoFetchLimit) {
+  large_icon_service_.set_defer_callbacks(true);
+  for (int i = 0; i < 6; i++) {
+    FaviconForUrl(GURL("http://test/" + base::NumberToString(i)),
+                  ^(FaviconAttributes* attributes){
+                  });
+  }
+  EXPECT_EQ(6, large_icon_service_.request_count());
+}
+
+// Tests that, with kFaviconLoaderFetchLimit, a limited number of requests are
+// sent to LargeIconService at a time, and that the others are sent by
+// priority.
+TEST_P(FaviconLoaderTest, RequestPriority) {
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeatureWithParameters(
+      kFaviconLoaderFetchLimit,
+      {{kFaviconLoaderMaxInFlightFetches.name, "4"}});
+  // The limit is read when the loader is created.
+  FaviconLoader favicon_loader(&large_icon_service_);
+
+  large_icon_service_.set_defer_callbacks(true);
+  std::vector<GURL> urls;
+  std::vector<FaviconLoader::RequestId> request_ids;
+  for (int i = 0; i < 6; i++) {
+    urls.push_back(GURL("http://test/" + base::NumberToString(i)));
+    request_ids.push_back(FaviconForUrl(&favicon_loader, urls.back(),
+                                        ^(FaviconAttributes* attributes){
+                                        }));
+  }
+  EXPECT_EQ(4, large_icon_service_.request_count());
+
+  // The most recent request would be sent first, if it had the same priority.
+  favicon_loader.SetRequestPriority(request_ids[5],
+                                    FaviconLoader::Priority::kLow);
+  large_icon_service_.RunDeferredCallbacks();
+  EXPECT_EQ(std::vector<GURL>({urls[4], urls[5]}),
+            large_icon_service_.GetDeferredUrls());
+}
+
+// Tests that a request cancelled while its favicon is fetched from the Google
+// server doesn't read the fetched favicon.
+TEST_P(FaviconLoaderTest, CancelRequestDuringGoogleServerFetch) {
+  if (GetParam() != TEST_PAGE_URL)
+    return;
+
+  large_icon_service_.set_defer_callbacks(true);
+  __block int callback_executed_count = 0;
+  FaviconLoader::RequestId request_id = favicon_loader_.FaviconForPageUrl(
+      GURL(kTestFallbackURL), kTestFaviconSize, kTestFaviconSize,
+      /*fallback_to_google_server=*/true, ^(FaviconAttributes* attributes) {
+        ++callback_executed_count;
+      });
+  large_icon_service_.RunDeferredCallbacks();
+  EXPECT_EQ(1, large_icon_service_.request_count());
+
+  favicon_loader_.CancelRequest(request_id);
+  large_icon_service_.RunGoogleServerCallbacks();
+  large_icon_service_.RunDeferredCallbacks();
+  EXPECT_EQ(1, large_icon_service_.request_count());
+  // Only the placeholder was returned.
+  EXPECT_EQ(1, callback_executed_count);
+}
+
+// Tests that a request whose favicon is fetched from the Google server gets
+// the favicon read again from LargeIconService.
+TEST_P(FaviconLoaderTest, GoogleServerFetch) {
+  if (GetParam() != TEST_PAGE_URL)
+    return;
+
+  large_icon_service_.set_defer_callbacks(true);
+  __block int callback_executed_count = 0;
+  favicon_loader_.FaviconForPageUrl(
+      GURL(kTestFallbackURL), kTestFaviconSize, kTestFaviconSize,
+      /*fallback_to_google_server=*/true, ^(FaviconAttributes* attributes) {
+        ++callback_executed_count;
+      });
+  large_icon_service_.RunDeferredCallbacks();
+  large_icon_service_.RunGoogleServerCallbacks();
+  EXPECT_EQ(2, large_icon_service_.request_count());
+  large_icon_service_.RunDeferredCallbacks();
+  EXPECT_EQ(2, callback_executed_count);
+}
+
 INSTANTIATE_TEST_SUITE_P(ProgrammaticFaviconLoaderTest,
                          FaviconLoaderTest,
                          ::testing::Values(FaviconUrlType::TEST_PAGE_URL,
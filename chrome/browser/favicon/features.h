@@ -0,0 +1,20 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef IOS_CHROME_BROWSER_FAVICON_FEATURES_H_
+#define IOS_CHROME_BROWSER_FAVICON_FEATURES_H_
+
+#include "base/feature_list.h"
+#include "base/metrics/field_trial_params.h"
+
+// Feature flag to limit the number of requests FaviconLoader sends to
+// LargeIconService at a time, so the pending ones can still be reprioritized
+// or cancelled.
+extern const base::Feature kFaviconLoaderFetchLimit;
+
+// The maximum number of requests sent to LargeIconService at a time, when
+// kFaviconLoaderFetchLimit is enabled.
+extern const base::FeatureParam<int> kFaviconLoaderMaxInFlightFetches;
+
+#endif  // IOS_CHROME_BROWSER_FAVICON_FEATURES_H_
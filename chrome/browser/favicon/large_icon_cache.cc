@@ -4,56 +4,113 @@
 
 #include "ios/chrome/browser/favicon/large_icon_cache.h"
 
+#include "base/check.h"
 #include "components/favicon_base/fallback_icon_style.h"
 #include "components/favicon_base/favicon_types.h"
 #include "url/gurl.h"
 
 namespace {
 
-const int kMaxCacheSize = 12;
+// Memory budget of the cache. It holds the icons of the most visited tiles of
+// the NTP, which are at most a few kilobytes each once encoded.
+const size_t kMaxMemoryUsage = 256 * 1024;
+
+// Smallest size bucket. The sizes are rounded up to a power of two, so that
+// the requests for close sizes share their icon.
+const int kMinSizeBucket = 16;
+
+int GetSizeBucket(int desired_size_in_pixel) {
+  int bucket = kMinSizeBucket;
+  while (bucket < desired_size_in_pixel)
+    bucket *= 2;
+  return bucket;
+}
+
+// Clones a LargeIconResult. The bitmap data is shared.
+std::unique_ptr<favicon_base::LargeIconResult> CloneLargeIconResult(
+    const favicon_base::LargeIconResult& large_icon_result) {
+  std::unique_ptr<favicon_base::LargeIconResult> clone;
+  if (large_icon_result.bitmap.is_valid()) {
+    clone.reset(new favicon_base::LargeIconResult(large_icon_result.bitmap));
+  } else {
+    clone.reset(
+        new favicon_base::LargeIconResult(new favicon_base::FallbackIconStyle(
+            *large_icon_result.fallback_icon_style.get())));
+  }
+  return clone;
+}
 
 }  // namespace
 
-struct LargeIconCacheEntry {
-  LargeIconCacheEntry() {}
-  ~LargeIconCacheEntry() {}
+LargeIconCacheEntry::LargeIconCacheEntry(
+    const favicon_base::LargeIconResult& result)
+    : result_(CloneLargeIconResult(result)) {}
+
+LargeIconCacheEntry::~LargeIconCacheEntry() {}
+
+size_t LargeIconCacheEntry::EstimateMemoryUsage() const {
+  size_t memory_usage = sizeof(*this) + sizeof(*result_);
+  if (result_->bitmap.is_valid()) {
+    memory_usage += result_->bitmap.bitmap_data->size() +
+                    result_->bitmap.icon_url.spec().size();
+  } else {
+    memory_usage += sizeof(*result_->fallback_icon_style);
+  }
+  return memory_usage;
+}
 
-  std::unique_ptr<favicon_base::LargeIconResult> result;
-};
+LargeIconCache::LargeIconCache() : LargeIconCache(kMaxMemoryUsage) {}
 
-LargeIconCache::LargeIconCache() : cache_(kMaxCacheSize) {}
+LargeIconCache::LargeIconCache(size_t max_memory_usage)
+    : cache_(decltype(cache_)::NO_AUTO_EVICT),
+      max_memory_usage_(max_memory_usage) {}
 
 LargeIconCache::~LargeIconCache() {}
 
 void LargeIconCache::SetCachedResult(
     const GURL& url,
+    int desired_size_in_pixel,
     const favicon_base::LargeIconResult& result) {
-  std::unique_ptr<LargeIconCacheEntry> entry(new LargeIconCacheEntry);
-  entry->result = CloneLargeIconResult(result);
-  cache_.Put(url, std::move(entry));
+  Key key = GetKey(url, desired_size_in_pixel);
+  auto iter = cache_.Peek(key);
+  if (iter != cache_.end()) {
+    memory_usage_ -= iter->second->EstimateMemoryUsage();
+    cache_.Erase(iter);
+  }
+
+  auto entry = base::MakeRefCounted<LargeIconCacheEntry>(result);
+  memory_usage_ += entry->EstimateMemoryUsage();
+  cache_.Put(std::move(key), std::move(entry));
+  EvictIfNeeded();
 }
 
-std::unique_ptr<favicon_base::LargeIconResult> LargeIconCache::GetCachedResult(
-    const GURL& url) {
-  auto iter = cache_.Get(url);
-  if (iter != cache_.end()) {
-    DCHECK(iter->second->result);
-    return CloneLargeIconResult(*iter->second->result.get());
+scoped_refptr<const LargeIconCacheEntry> LargeIconCache::GetCachedResult(
+    const GURL& url,
+    int desired_size_in_pixel) {
+  auto iter = cache_.Get(GetKey(url, desired_size_in_pixel));
+  if (iter == cache_.end()) {
+    stats_.miss_count++;
+    return nullptr;
   }
 
-  return std::unique_ptr<favicon_base::LargeIconResult>();
+  stats_.hit_count++;
+  return iter->second;
 }
 
-std::unique_ptr<favicon_base::LargeIconResult>
-LargeIconCache::CloneLargeIconResult(
-    const favicon_base::LargeIconResult& large_icon_result) {
-  std::unique_ptr<favicon_base::LargeIconResult> clone;
-  if (large_icon_result.bitmap.is_valid()) {
-    clone.reset(new favicon_base::LargeIconResult(large_icon_result.bitmap));
-  } else {
-    clone.reset(
-        new favicon_base::LargeIconResult(new favicon_base::FallbackIconStyle(
-            *large_icon_result.fallback_icon_style.get())));
+// static
+LargeIconCache::Key LargeIconCache::GetKey(const GURL& url,
+                                           int desired_size_in_pixel) {
+  return Key(url.has_host() ? url.host() : url.spec(),
+             GetSizeBucket(desired_size_in_pixel));
+}
+
+void LargeIconCache::EvictIfNeeded() {
+  // The most recently used result is kept even if it exceeds the budget.
+  while (memory_usage_ > max_memory_usage_ && cache_.size() > 1) {
+    auto iter = cache_.rbegin();
+    DCHECK_GE(memory_usage_, iter->second->EstimateMemoryUsage());
+    memory_usage_ -= iter->second->EstimateMemoryUsage();
+    cache_.Erase(iter);
+    stats_.eviction_count++;
   }
-  return clone;
 }
@@ -5,47 +5,107 @@
 #ifndef IOS_CHROME_BROWSER_FAVICON_LARGE_ICON_CACHE_H_
 #define IOS_CHROME_BROWSER_FAVICON_LARGE_ICON_CACHE_H_
 
+#include <stddef.h>
+
 #include <memory>
+#include <string>
+#include <utility>
 
 #include "base/containers/mru_cache.h"
 #include "base/macros.h"
+#include "base/memory/ref_counted.h"
 #include "components/keyed_service/core/keyed_service.h"
 
 class GURL;
-struct LargeIconCacheEntry;
 
 namespace favicon_base {
 struct LargeIconResult;
 }
 
+// Immutable LargeIconResult shared between the LargeIconCache and the users of
+// the results it returns, so that they are not copied.
+class LargeIconCacheEntry : public base::RefCounted<LargeIconCacheEntry> {
+ public:
+  explicit LargeIconCacheEntry(const favicon_base::LargeIconResult& result);
+
+  const favicon_base::LargeIconResult& result() const { return *result_; }
+
+  // Returns the memory used by the result, which is dominated by the encoded
+  // bitmap.
+  size_t EstimateMemoryUsage() const;
+
+ private:
+  friend class base::RefCounted<LargeIconCacheEntry>;
+
+  ~LargeIconCacheEntry();
+
+  const std::unique_ptr<const favicon_base::LargeIconResult> result_;
+
+  DISALLOW_COPY_AND_ASSIGN(LargeIconCacheEntry);
+};
+
 // Provides a cache of most recently used LargeIconResult.
 //
+// The results are cached by host and by bucket of requested size, so that the
+// pages of a site share their icon, and are evicted, least recently used
+// first, when their memory usage exceeds a budget.
+//
 // Example usage:
 //   LargeIconCache* large_icon_cache =
 //       IOSChromeLargeIconServiceFactory::GetForBrowserState(browser_state);
-//   std::unique_ptr<favicon_base::LargeIconResult> icon =
+//   scoped_refptr<const LargeIconCacheEntry> icon =
 //       large_icon_cache->GetCachedResult(...);
 //
 class LargeIconCache : public KeyedService {
  public:
+  // Statistics of the cache since it was created.
+  struct Stats {
+    // Number of lookups that found a result.
+    int hit_count = 0;
+    // Number of lookups that did not find a result.
+    int miss_count = 0;
+    // Number of results evicted to stay within the memory budget.
+    int eviction_count = 0;
+  };
+
   LargeIconCache();
+  // Creates a cache using at most |max_memory_usage| bytes, except for its
+  // most recently used result.
+  explicit LargeIconCache(size_t max_memory_usage);
   ~LargeIconCache() override;
 
   // |LargeIconService| does everything on callbacks, and iOS needs to load the
-  // icons immediately on page load. This caches the LargeIconResult so we can
-  // immediately load.
-  void SetCachedResult(const GURL& url, const favicon_base::LargeIconResult&);
+  // icons immediately on page load. This caches the LargeIconResult requested
+  // for |url| with |desired_size_in_pixel| so we can immediately load.
+  void SetCachedResult(const GURL& url,
+                       int desired_size_in_pixel,
+                       const favicon_base::LargeIconResult& result);
 
-  // Returns a cached LargeIconResult.
-  std::unique_ptr<favicon_base::LargeIconResult> GetCachedResult(
-      const GURL& url);
+  // Returns the cached LargeIconResult for |url| and |desired_size_in_pixel|,
+  // or null.
+  scoped_refptr<const LargeIconCacheEntry> GetCachedResult(
+      const GURL& url,
+      int desired_size_in_pixel);
+
+  const Stats& stats() const { return stats_; }
+
+  // Returns the memory used by the cached results.
+  size_t memory_usage() const { return memory_usage_; }
 
  private:
-  // Clones a LargeIconResult.
-  std::unique_ptr<favicon_base::LargeIconResult> CloneLargeIconResult(
-      const favicon_base::LargeIconResult& large_icon_result);
+  // Host, or spec for the URLs without host, and size bucket of a result.
+  using Key = std::pair<std::string, int>;
+
+  static Key GetKey(const GURL& url, int desired_size_in_pixel);
+
+  // Evicts the least recently used results until the memory usage is within
+  // the budget.
+  void EvictIfNeeded();
 
-  base::MRUCache<GURL, std::unique_ptr<LargeIconCacheEntry>> cache_;
+  base::MRUCache<Key, scoped_refptr<const LargeIconCacheEntry>> cache_;
+  const size_t max_memory_usage_;
+  size_t memory_usage_ = 0;
+  Stats stats_;
 
   DISALLOW_COPY_AND_ASSIGN(LargeIconCache);
 };
@@ -16,6 +16,8 @@ namespace {
 
 const char kDummyUrl[] = "http://www.example.com";
 const char kDummyUrl2[] = "http://www.example2.com";
+const char kDummyUrlPath[] = "http://www.example.com/path";
+const int kDummySize = 64;
 const SkColor kTestColor = SK_ColorRED;
 
 favicon_base::FaviconRawBitmapResult CreateTestBitmap(int w,
@@ -65,7 +67,9 @@ class LargeIconCacheTest : public PlatformTest {
 
 TEST_F(LargeIconCacheTest, EmptyCache) {
   std::unique_ptr<LargeIconCache> large_icon_cache(new LargeIconCache);
-  EXPECT_EQ(nullptr, large_icon_cache->GetCachedResult(GURL(kDummyUrl)));
+  EXPECT_EQ(nullptr,
+            large_icon_cache->GetCachedResult(GURL(kDummyUrl), kDummySize));
+  EXPECT_EQ(1, large_icon_cache->stats().miss_count);
 }
 
 TEST_F(LargeIconCacheTest, RetreiveItem) {
@@ -75,29 +79,87 @@ TEST_F(LargeIconCacheTest, RetreiveItem) {
   expected_result2.reset(new favicon_base::LargeIconResult(
       new favicon_base::FallbackIconStyle(*expected_fallback_icon_style_)));
 
-  large_icon_cache_->SetCachedResult(GURL(kDummyUrl), *expected_result1);
-  large_icon_cache_->SetCachedResult(GURL(kDummyUrl2), *expected_result2);
+  large_icon_cache_->SetCachedResult(GURL(kDummyUrl), kDummySize,
+                                     *expected_result1);
+  large_icon_cache_->SetCachedResult(GURL(kDummyUrl2), kDummySize,
+                                     *expected_result2);
 
-  std::unique_ptr<favicon_base::LargeIconResult> result1 =
-      large_icon_cache_->GetCachedResult(GURL(kDummyUrl));
-  EXPECT_EQ(true, result1->bitmap.is_valid());
-  EXPECT_EQ(expected_result1->bitmap.pixel_size, result1->bitmap.pixel_size);
+  scoped_refptr<const LargeIconCacheEntry> result1 =
+      large_icon_cache_->GetCachedResult(GURL(kDummyUrl), kDummySize);
+  EXPECT_EQ(true, result1->result().bitmap.is_valid());
+  EXPECT_EQ(expected_result1->bitmap.pixel_size,
+            result1->result().bitmap.pixel_size);
 
-  std::unique_ptr<favicon_base::LargeIconResult> result2 =
-      large_icon_cache_->GetCachedResult(GURL(kDummyUrl2));
-  EXPECT_EQ(false, result2->bitmap.is_valid());
+  scoped_refptr<const LargeIconCacheEntry> result2 =
+      large_icon_cache_->GetCachedResult(GURL(kDummyUrl2), kDummySize);
+  EXPECT_EQ(false, result2->result().bitmap.is_valid());
   EXPECT_EQ(expected_result2->fallback_icon_style->background_color,
-            result2->fallback_icon_style->background_color);
-  EXPECT_FALSE(result2->fallback_icon_style->is_default_background_color);
+            result2->result().fallback_icon_style->background_color);
+  EXPECT_FALSE(
+      result2->result().fallback_icon_style->is_default_background_color);
 
   // Test overwriting kDummyUrl.
-  large_icon_cache_->SetCachedResult(GURL(kDummyUrl), *expected_result2);
-  std::unique_ptr<favicon_base::LargeIconResult> result3 =
-      large_icon_cache_->GetCachedResult(GURL(kDummyUrl2));
-  EXPECT_EQ(false, result3->bitmap.is_valid());
+  large_icon_cache_->SetCachedResult(GURL(kDummyUrl), kDummySize,
+                                     *expected_result2);
+  scoped_refptr<const LargeIconCacheEntry> result3 =
+      large_icon_cache_->GetCachedResult(GURL(kDummyUrl2), kDummySize);
+  EXPECT_EQ(false, result3->result().bitmap.is_valid());
   EXPECT_EQ(expected_result2->fallback_icon_style->background_color,
-            result3->fallback_icon_style->background_color);
-  EXPECT_FALSE(result2->fallback_icon_style->is_default_background_color);
+            result3->result().fallback_icon_style->background_color);
+  EXPECT_FALSE(
+      result2->result().fallback_icon_style->is_default_background_color);
+}
+
+// Tests that the pages of a site share their icon, for close sizes, and that
+// the cached result is not copied.
+TEST_F(LargeIconCacheTest, SharedResult) {
+  favicon_base::LargeIconResult expected_result(expected_bitmap_);
+  large_icon_cache_->SetCachedResult(GURL(kDummyUrl), kDummySize,
+                                     expected_result);
+
+  scoped_refptr<const LargeIconCacheEntry> result =
+      large_icon_cache_->GetCachedResult(GURL(kDummyUrlPath), kDummySize - 1);
+  ASSERT_TRUE(result);
+  EXPECT_EQ(result,
+            large_icon_cache_->GetCachedResult(GURL(kDummyUrl), kDummySize));
+  EXPECT_EQ(expected_bitmap_.bitmap_data,
+            result->result().bitmap.bitmap_data);
+
+  // A different size bucket doesn't share the icon.
+  EXPECT_FALSE(
+      large_icon_cache_->GetCachedResult(GURL(kDummyUrl), 2 * kDummySize));
+  EXPECT_EQ(2, large_icon_cache_->stats().hit_count);
+  EXPECT_EQ(1, large_icon_cache_->stats().miss_count);
+}
+
+// Tests that the least recently used results are evicted when the memory
+// budget is exceeded.
+TEST_F(LargeIconCacheTest, MemoryBudget) {
+  favicon_base::LargeIconResult expected_result(expected_bitmap_);
+  large_icon_cache_->SetCachedResult(GURL(kDummyUrl), kDummySize,
+                                     expected_result);
+  const size_t entry_memory_usage = large_icon_cache_->memory_usage();
+  EXPECT_LT(expected_bitmap_.bitmap_data->size(), entry_memory_usage);
+
+  // Create a cache holding two results.
+  large_icon_cache_.reset(new LargeIconCache(2 * entry_memory_usage));
+  large_icon_cache_->SetCachedResult(GURL("http://a.com"), kDummySize,
+                                     expected_result);
+  large_icon_cache_->SetCachedResult(GURL("http://b.com"), kDummySize,
+                                     expected_result);
+  EXPECT_TRUE(
+      large_icon_cache_->GetCachedResult(GURL("http://a.com"), kDummySize));
+  large_icon_cache_->SetCachedResult(GURL("http://c.com"), kDummySize,
+                                     expected_result);
+
+  EXPECT_EQ(1, large_icon_cache_->stats().eviction_count);
+  EXPECT_EQ(2 * entry_memory_usage, large_icon_cache_->memory_usage());
+  EXPECT_TRUE(
+      large_icon_cache_->GetCachedResult(GURL("http://a.com"), kDummySize));
+  EXPECT_FALSE(
+      large_icon_cache_->GetCachedResult(GURL("http://b.com"), kDummySize));
+  EXPECT_TRUE(
+      large_icon_cache_->GetCachedResult(GURL("http://c.com"), kDummySize));
 }
 
 }  // namespace
@@ -0,0 +1,19 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef IOS_CHROME_BROWSER_READING_LIST_FEATURES_H_
+#define IOS_CHROME_BROWSER_READING_LIST_FEATURES_H_
+
+#include "base/feature_list.h"
+#include "base/metrics/field_trial_params.h"
+
+// Feature flag to download several reading list entries at a time, the most
+// recently added first, saving the images of each page in parallel.
+extern const base::Feature kReadingListConcurrentDownloads;
+
+// The maximum number of reading list entries downloaded or deleted at a time
+// when kReadingListConcurrentDownloads is enabled.
+extern const base::FeatureParam<int> kReadingListMaxConcurrentDownloads;
+
+#endif  // IOS_CHROME_BROWSER_READING_LIST_FEATURES_H_
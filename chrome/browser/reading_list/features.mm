@@ -0,0 +1,15 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ios/chrome/browser/reading_list/features.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+const base::Feature kReadingListConcurrentDownloads{
+    "ReadingListConcurrentDownloads", base::FEATURE_DISABLED_BY_DEFAULT};
+
+const base::FeatureParam<int> kReadingListMaxConcurrentDownloads{
+    &kReadingListConcurrentDownloads, "max_concurrent_downloads", 3};
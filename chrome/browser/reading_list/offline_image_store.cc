@@ -0,0 +1,194 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ios/chrome/browser/reading_list/offline_image_store.h"
+
+#include "base/files/file_enumerator.h"
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/stl_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/strings/string_util.h"
+#include "base/threading/scoped_blocking_call.h"
+#include "crypto/sha2.h"
+
+namespace reading_list {
+
+namespace {
+
+// Name of the directory of the store, in the offline root directory. It can't
+// collide with the directories of the offline pages, which are named after a
+// hash.
+const char kStoreDirectoryName[] = "Images";
+
+// Name of the manifest listing the images of an offline page, in the page
+// directory.
+const char kManifestFileName[] = "images_manifest.txt";
+
+// Returns the name of the image with content |data|.
+std::string GetImageName(const std::string& data) {
+  return base::ToLowerASCII(
+      base::HexEncode(crypto::SHA256HashString(data).data(),
+                      crypto::kSHA256Length));
+}
+
+// Returns whether |image_name| can be the name of an image of the store.
+bool IsValidImageName(const std::string& image_name) {
+  return image_name.size() == 2 * crypto::kSHA256Length &&
+         base::ContainsOnlyChars(image_name, "0123456789abcdef");
+}
+
+}  // namespace
+
+OfflineImageStore::OfflineImageStore(const base::FilePath& offline_root)
+    : offline_root_(offline_root),
+      store_directory_(offline_root.Append(kStoreDirectoryName)) {}
+
+OfflineImageStore::~OfflineImageStore() = default;
+
+// static
+base::FilePath OfflineImageStore::GetImagePath(
+    const base::FilePath& offline_root,
+    const std::string& image_name) {
+  DCHECK(IsValidImageName(image_name));
+  return offline_root.Append(kStoreDirectoryName).Append(image_name);
+}
+
+// static
+const char* OfflineImageStore::GetStoreDirectoryName() {
+  return kStoreDirectoryName;
+}
+
+// static
+std::vector<std::string> OfflineImageStore::ReadManifest(
+    const base::FilePath& page_directory) {
+  base::ScopedBlockingCall scoped_blocking_call(FROM_HERE,
+                                                base::BlockingType::MAY_BLOCK);
+  std::string manifest;
+  if (!base::ReadFileToString(page_directory.Append(kManifestFileName),
+                              &manifest)) {
+    return std::vector<std::string>();
+  }
+  std::vector<std::string> image_names = base::SplitString(
+      manifest, "\n", base::TRIM_WHITESPACE, base::SPLIT_WANT_NONEMPTY);
+  base::EraseIf(image_names, [](const std::string& image_name) {
+    return !IsValidImageName(image_name);
+  });
+  return image_names;
+}
+
+int64_t OfflineImageStore::AddImage(const std::string& data,
+                                    std::string* image_name) {
+  DCHECK(image_name);
+  // Hash the image before taking the lock, so that images are still hashed in
+  // parallel.
+  *image_name = GetImageName(data);
+  base::FilePath path = store_directory_.Append(*image_name);
+
+  base::AutoLock auto_lock(lock_);
+  EnsureLoaded();
+  base::ScopedBlockingCall scoped_blocking_call(FROM_HERE,
+                                                base::BlockingType::MAY_BLOCK);
+  // The file is checked even if the image is referenced, in case the offline
+  // directory was deleted without going through the store.
+  int64_t written = 0;
+  if (!base::PathExists(path)) {
+    if (!base::DirectoryExists(store_directory_) &&
+        !base::CreateDirectory(store_directory_)) {
+      return -1;
+    }
+    // Write to a temporary file first, so that a partially written image is
+    // never shared.
+    base::FilePath temporary_path;
+    if (!base::CreateTemporaryFileInDir(store_directory_, &temporary_path))
+      return -1;
+    if (!base::WriteFile(temporary_path, data) ||
+        !base::Move(temporary_path, path)) {
+      base::DeleteFile(temporary_path);
+      return -1;
+    }
+    written = data.size();
+  }
+  reference_counts_[*image_name]++;
+  return written;
+}
+
+void OfflineImageStore::ReleaseImages(
+    const std::vector<std::string>& image_names) {
+  base::AutoLock auto_lock(lock_);
+  EnsureLoaded();
+  ReleaseImagesLocked(image_names);
+}
+
+bool OfflineImageStore::WriteManifest(
+    const base::FilePath& page_directory,
+    const std::vector<std::string>& image_names) {
+  base::ScopedBlockingCall scoped_blocking_call(FROM_HERE,
+                                                base::BlockingType::MAY_BLOCK);
+  std::string manifest;
+  for (const std::string& image_name : image_names) {
+    DCHECK(IsValidImageName(image_name));
+    manifest += image_name + "\n";
+  }
+  return base::WriteFile(page_directory.Append(kManifestFileName), manifest);
+}
+
+bool OfflineImageStore::DeletePage(const base::FilePath& page_directory) {
+  std::vector<std::string> image_names = ReadManifest(page_directory);
+
+  base::AutoLock auto_lock(lock_);
+  EnsureLoaded();
+  base::ScopedBlockingCall scoped_blocking_call(FROM_HERE,
+                                                base::BlockingType::MAY_BLOCK);
+  // Delete the page before releasing its images, so that they are never
+  // referenced by a page that still exists.
+  if (!base::DeletePathRecursively(page_directory))
+    return false;
+  ReleaseImagesLocked(image_names);
+  return true;
+}
+
+void OfflineImageStore::EnsureLoaded() {
+  if (loaded_)
+    return;
+  loaded_ = true;
+
+  base::ScopedBlockingCall scoped_blocking_call(FROM_HERE,
+                                                base::BlockingType::MAY_BLOCK);
+  base::FileEnumerator page_enumerator(offline_root_, false,
+                                       base::FileEnumerator::DIRECTORIES);
+  for (base::FilePath page_directory = page_enumerator.Next();
+       !page_directory.empty(); page_directory = page_enumerator.Next()) {
+    if (page_directory == store_directory_)
+      continue;
+    for (const std::string& image_name : ReadManifest(page_directory))
+      reference_counts_[image_name]++;
+  }
+
+  base::FileEnumerator image_enumerator(store_directory_, false,
+                                        base::FileEnumerator::FILES);
+  for (base::FilePath image_path = image_enumerator.Next();
+       !image_path.empty(); image_path = image_enumerator.Next()) {
+    if (!base::Contains(reference_counts_, image_path.BaseName().value()))
+      base::DeleteFile(image_path);
+  }
+}
+
+void OfflineImageStore::ReleaseImagesLocked(
+    const std::vector<std::string>& image_names) {
+  base::ScopedBlockingCall scoped_blocking_call(FROM_HERE,
+                                                base::BlockingType::MAY_BLOCK);
+  for (const std::string& image_name : image_names) {
+    auto it = reference_counts_.find(image_name);
+    if (it == reference_counts_.end())
+      continue;
+    if (--it->second > 0)
+      continue;
+    reference_counts_.erase(it);
+    base::DeleteFile(store_directory_.Append(image_name));
+  }
+}
+
+}  // namespace reading_list
@@ -0,0 +1,99 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef IOS_CHROME_BROWSER_READING_LIST_OFFLINE_IMAGE_STORE_H_
+#define IOS_CHROME_BROWSER_READING_LIST_OFFLINE_IMAGE_STORE_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+#include "base/thread_annotations.h"
+
+namespace reading_list {
+
+// Store of the images of the offline pages, shared by all the pages and
+// addressed by the hash of their content, so that an image used by several
+// pages is only stored once.
+//
+// Each offline page directory contains a manifest listing the images the page
+// references. The reference counts of the images are rebuilt from the
+// manifests when the store is first used, and the images that are no longer
+// referenced, e.g. after a crash during a download, are deleted at that time.
+//
+// All the methods access the file system and must be called on a sequence
+// that allows blocking. They can be called from any such sequence, as the
+// operations are serialized by a lock.
+class OfflineImageStore : public base::RefCountedThreadSafe<OfflineImageStore> {
+ public:
+  // |offline_root| is the root directory of the offline pages.
+  explicit OfflineImageStore(const base::FilePath& offline_root);
+
+  // Returns the path of the image named |image_name| in the store of
+  // |offline_root|.
+  static base::FilePath GetImagePath(const base::FilePath& offline_root,
+                                     const std::string& image_name);
+
+  // Returns the name of the directory of the store, in the offline root
+  // directory.
+  static const char* GetStoreDirectoryName();
+
+  // Returns the names of the images referenced by the offline page in
+  // |page_directory|, as written in its manifest.
+  static std::vector<std::string> ReadManifest(
+      const base::FilePath& page_directory);
+
+  // Adds a reference to the image with content |data|, and writes it to the
+  // store if it is not already there. Sets |image_name| to the name of the
+  // image, and returns the number of bytes written, i.e. 0 if the image was
+  // already stored, or -1 if the image could not be written, in which case no
+  // reference is added.
+  int64_t AddImage(const std::string& data, std::string* image_name);
+
+  // Removes a reference to each image of |image_names|, and deletes the images
+  // that are no longer referenced.
+  void ReleaseImages(const std::vector<std::string>& image_names);
+
+  // Writes the manifest of the offline page in |page_directory|, which holds
+  // a reference to each image of |image_names|. Returns whether the manifest
+  // was written.
+  bool WriteManifest(const base::FilePath& page_directory,
+                     const std::vector<std::string>& image_names);
+
+  // Deletes the offline page in |page_directory| and releases the images it
+  // references. Returns whether the directory was deleted.
+  bool DeletePage(const base::FilePath& page_directory);
+
+ private:
+  friend class base::RefCountedThreadSafe<OfflineImageStore>;
+  ~OfflineImageStore();
+
+  // Rebuilds the reference counts from the manifests of the offline pages and
+  // deletes the unreferenced images, the first time it is called.
+  void EnsureLoaded() EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Removes a reference to each image of |image_names|.
+  void ReleaseImagesLocked(const std::vector<std::string>& image_names)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  const base::FilePath offline_root_;
+  const base::FilePath store_directory_;
+
+  base::Lock lock_;
+  bool loaded_ GUARDED_BY(lock_) = false;
+  // Number of references to each stored image, by name.
+  std::map<std::string, int> reference_counts_ GUARDED_BY(lock_);
+
+  DISALLOW_COPY_AND_ASSIGN(OfflineImageStore);
+};
+
+}  // namespace reading_list
+
+#endif  // IOS_CHROME_BROWSER_READING_LIST_OFFLINE_IMAGE_STORE_H_
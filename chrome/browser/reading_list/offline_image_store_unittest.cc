@@ -0,0 +1,110 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ios/chrome/browser/reading_list/offline_image_store.h"
+
+#include <string>
+#include <vector>
+
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/platform_test.h"
+
+namespace reading_list {
+
+class OfflineImageStoreTest : public PlatformTest {
+ protected:
+  void SetUp() override {
+    PlatformTest::SetUp();
+    ASSERT_TRUE(temp_directory_.CreateUniqueTempDir());
+    page_directory_ = temp_directory_.GetPath().Append("page");
+    other_page_directory_ = temp_directory_.GetPath().Append("other_page");
+    ASSERT_TRUE(base::CreateDirectory(page_directory_));
+    ASSERT_TRUE(base::CreateDirectory(other_page_directory_));
+  }
+
+  // Returns whether the image named |image_name| is in the store.
+  bool ImageExists(const std::string& image_name) {
+    return base::PathExists(OfflineImageStore::GetImagePath(
+        temp_directory_.GetPath(), image_name));
+  }
+
+  base::ScopedTempDir temp_directory_;
+  base::FilePath page_directory_;
+  base::FilePath other_page_directory_;
+};
+
+// Tests that an image used by two pages is written once, and deleted when the
+// last page using it is deleted.
+TEST_F(OfflineImageStoreTest, SharedImage) {
+  auto store =
+      base::MakeRefCounted<OfflineImageStore>(temp_directory_.GetPath());
+
+  std::string image_name;
+  EXPECT_EQ(5, store->AddImage("image", &image_name));
+  EXPECT_TRUE(ImageExists(image_name));
+  ASSERT_TRUE(store->WriteManifest(page_directory_, {image_name}));
+
+  std::string other_image_name;
+  EXPECT_EQ(0, store->AddImage("image", &other_image_name));
+  EXPECT_EQ(image_name, other_image_name);
+  ASSERT_TRUE(store->WriteManifest(other_page_directory_, {image_name}));
+  EXPECT_EQ(std::vector<std::string>({image_name}),
+            OfflineImageStore::ReadManifest(other_page_directory_));
+
+  EXPECT_TRUE(store->DeletePage(page_directory_));
+  EXPECT_FALSE(base::PathExists(page_directory_));
+  EXPECT_TRUE(ImageExists(image_name));
+
+  EXPECT_TRUE(store->DeletePage(other_page_directory_));
+  EXPECT_FALSE(ImageExists(image_name));
+}
+
+// Tests that released images are deleted if no page references them.
+TEST_F(OfflineImageStoreTest, ReleaseImages) {
+  auto store =
+      base::MakeRefCounted<OfflineImageStore>(temp_directory_.GetPath());
+
+  std::string image_name;
+  std::string other_image_name;
+  EXPECT_EQ(5, store->AddImage("image", &image_name));
+  EXPECT_EQ(11, store->AddImage("other image", &other_image_name));
+  EXPECT_NE(image_name, other_image_name);
+  ASSERT_TRUE(store->WriteManifest(page_directory_, {image_name}));
+  EXPECT_EQ(0, store->AddImage("image", &image_name));
+
+  store->ReleaseImages({image_name, other_image_name});
+  EXPECT_TRUE(ImageExists(image_name));
+  EXPECT_FALSE(ImageExists(other_image_name));
+}
+
+// Tests that the references are rebuilt from the manifests by a new store, and
+// that the images that are not referenced are deleted.
+TEST_F(OfflineImageStoreTest, Reload) {
+  std::string image_name;
+  std::string orphan_image_name;
+  {
+    auto store =
+        base::MakeRefCounted<OfflineImageStore>(temp_directory_.GetPath());
+    store->AddImage("image", &image_name);
+    store->AddImage("orphan", &orphan_image_name);
+    ASSERT_TRUE(store->WriteManifest(page_directory_, {image_name}));
+  }
+
+  auto store =
+      base::MakeRefCounted<OfflineImageStore>(temp_directory_.GetPath());
+  std::string other_image_name;
+  EXPECT_EQ(0, store->AddImage("image", &other_image_name));
+  EXPECT_TRUE(ImageExists(image_name));
+  EXPECT_FALSE(ImageExists(orphan_image_name));
+
+  // The image is still referenced by the other add.
+  EXPECT_TRUE(store->DeletePage(page_directory_));
+  EXPECT_TRUE(ImageExists(image_name));
+  store->ReleaseImages({other_image_name});
+  EXPECT_FALSE(ImageExists(image_name));
+}
+
+}  // namespace reading_list
@@ -4,6 +4,8 @@
 
 #import "ios/chrome/browser/reading_list/offline_page_tab_helper.h"
 
+#include <set>
+
 #include "base/base64.h"
 #include "base/files/file_enumerator.h"
 #include "base/files/file_util.h"
@@ -19,6 +21,7 @@
 #include "components/reading_list/core/reading_list_model.h"
 #include "ios/chrome/browser/browser_state/chrome_browser_state.h"
 #include "ios/chrome/browser/chrome_url_constants.h"
+#include "ios/chrome/browser/reading_list/offline_image_store.h"
 #include "ios/chrome/browser/reading_list/offline_url_utils.h"
 #include "ios/chrome/browser/reading_list/reading_list_download_service.h"
 #include "ios/chrome/browser/reading_list/reading_list_download_service_factory.h"
@@ -76,6 +79,30 @@ std::string GetOfflineData(base::FilePath offline_root,
     base::ReplaceSubstringsAfterOffset(&content, 0, src_with_file,
                                        src_with_data);
   }
+
+  // Images of the pages saved since the image store was introduced are in the
+  // store, and listed in the manifest of the page.
+  std::vector<std::string> image_names =
+      reading_list::OfflineImageStore::ReadManifest(absolute_path.DirName());
+  std::set<std::string> inlined_image_names;
+  for (const std::string& image_name : image_names) {
+    if (!inlined_image_names.insert(image_name).second) {
+      continue;
+    }
+    std::string image;
+    if (!base::ReadFileToString(
+            reading_list::OfflineImageStore::GetImagePath(
+                reading_list::OfflineRootDirectoryPath(offline_root),
+                image_name),
+            &image)) {
+      continue;
+    }
+    base::Base64Encode(image, &image);
+    std::string src_with_data =
+        base::StringPrintf("data:image/png;base64,%s", image.c_str());
+    base::ReplaceSubstringsAfterOffset(&content, 0, image_name,
+                                       src_with_data);
+  }
   return content;
 }
 }
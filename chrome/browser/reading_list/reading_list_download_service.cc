@@ -19,6 +19,7 @@
 #include "components/reading_list/core/reading_list_entry.h"
 #include "components/reading_list/core/reading_list_model.h"
 #include "ios/chrome/browser/application_context.h"
+#include "ios/chrome/browser/reading_list/offline_image_store.h"
 #include "ios/chrome/browser/reading_list/reading_list_distiller_page_factory.h"
 #include "net/base/network_change_notifier.h"
 #include "services/network/public/cpp/shared_url_loader_factory.h"
@@ -153,7 +154,10 @@ void ReadingListDownloadService::ProcessNewEntry(const GURL& url) {
 
 void ReadingListDownloadService::SyncWithModel() {
   DCHECK(reading_list_model_->loaded());
-  std::set<std::string> processed_directories;
+  // The images of the processed entries are in the image store. The images of
+  // the deleted entries are deleted by the store the next time it is loaded.
+  std::set<std::string> processed_directories = {
+      reading_list::OfflineImageStore::GetStoreDirectoryName()};
   std::set<GURL> unprocessed_entries;
   for (const auto& url : reading_list_model_->Keys()) {
     const ReadingListEntry* entry = reading_list_model_->GetEntryByURL(url);
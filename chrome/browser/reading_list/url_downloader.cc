@@ -4,6 +4,8 @@
 
 #include "ios/chrome/browser/reading_list/url_downloader.h"
 
+#include <algorithm>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -11,6 +13,7 @@
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
 #include "base/memory/ptr_util.h"
+#include "base/metrics/histogram_macros.h"
 #include "base/path_service.h"
 #include "base/stl_util.h"
 #include "base/task/post_task.h"
@@ -18,6 +21,8 @@
 #include "components/reading_list/core/offline_url_utils.h"
 #include "ios/chrome/browser/chrome_paths.h"
 #include "ios/chrome/browser/dom_distiller/distiller_viewer.h"
+#include "ios/chrome/browser/reading_list/features.h"
+#include "ios/chrome/browser/reading_list/offline_image_store.h"
 #include "ios/chrome/browser/reading_list/reading_list_distiller_page.h"
 #include "ios/chrome/browser/reading_list/reading_list_distiller_page_factory.h"
 #include "net/base/escape.h"
@@ -39,8 +44,121 @@ const char kDisableImageContextMenuScript[] =
     "    document.head.appendChild(imgMenuDisabler);"
     "}, false);"
     "</script>";
+
+// Traits of the task runner used for the file operations.
+constexpr base::TaskTraits kFileTaskTraits = {
+    base::MayBlock(), base::TaskPriority::BEST_EFFORT,
+    base::TaskShutdownBehavior::SKIP_ON_SHUTDOWN};
+
+// Returns the maximum number of tasks handled at a time by URLDownloader.
+int GetMaxConcurrentTasks() {
+  if (!base::FeatureList::IsEnabled(kReadingListConcurrentDownloads))
+    return 1;
+  return std::max(1, kReadingListMaxConcurrentDownloads.Get());
+}
+
+// Returns the task runner for the file operations, which runs them in parallel
+// if several tasks are handled at a time.
+scoped_refptr<base::TaskRunner> CreateFileTaskRunner(
+    int max_concurrent_tasks) {
+  if (max_concurrent_tasks > 1)
+    return base::ThreadPool::CreateTaskRunner(kFileTaskTraits);
+  return base::ThreadPool::CreateSequencedTaskRunner(kFileTaskTraits);
+}
+
+// Creates the offline directory for |url|. Returns true if successful or if
+// the directory already exists.
+bool CreateOfflineURLDirectory(const base::FilePath& base_directory,
+                               const GURL& url) {
+  base::FilePath directory_path =
+      reading_list::OfflineURLDirectoryAbsolutePath(base_directory, url);
+  if (!base::DirectoryExists(directory_path)) {
+    return base::CreateDirectoryAndGetError(directory_path, nullptr);
+  }
+  return true;
+}
+
+// Replaces the references in |html| to the images in |image_references|, by
+// their name in |image_names|, or by an empty name if they were not saved.
+// Then writes the manifest listing the images of the page, and saves the page
+// to disk in the correct location for |url|. Returns the number of bytes
+// written, or -1 if the save failed.
+int64_t ReplaceImagesAndSaveHTML(
+    scoped_refptr<reading_list::OfflineImageStore> image_store,
+    const base::FilePath& base_directory,
+    const GURL& url,
+    std::string html,
+    const std::vector<std::pair<std::string, GURL>>& image_references,
+    const std::map<GURL, std::string>& image_names) {
+  bool local_images_found = false;
+  for (const auto& pair : image_references) {
+    const std::string& image_url = pair.first;
+    auto it = image_names.find(pair.second);
+    const std::string local_image_name =
+        it != image_names.end() ? it->second : std::string();
+    size_t pos = html.find(image_url, 0);
+    while (pos != std::string::npos) {
+      local_images_found = true;
+      html.replace(pos, image_url.size(), local_image_name);
+      pos = html.find(image_url, pos + local_image_name.size());
+    }
+  }
+  if (local_images_found) {
+    html += kDisableImageContextMenuScript;
+  }
+
+  if (html.empty()) {
+    return -1;
+  }
+
+  // The manifest is written first, so that an existing page always holds the
+  // references to its images.
+  std::vector<std::string> manifest;
+  for (const auto& pair : image_names) {
+    manifest.push_back(pair.second);
+  }
+  if (!image_store->WriteManifest(
+          reading_list::OfflineURLDirectoryAbsolutePath(base_directory, url),
+          manifest)) {
+    return -1;
+  }
+
+  base::FilePath path = reading_list::OfflineURLAbsolutePathFromRelativePath(
+      base_directory,
+      reading_list::OfflinePagePath(url, reading_list::OFFLINE_TYPE_HTML));
+  int written = base::WriteFile(path, html.c_str(), html.length());
+  return written > 0 ? written : -1;
+}
+
+// Moves the PDF downloaded at |temporary_path| to the offline directory for
+// |url|. Returns the size of the file, or -1 if the move failed.
+int64_t SavePDFFile(const base::FilePath& base_directory,
+                    const GURL& url,
+                    const base::FilePath& temporary_path) {
+  if (!CreateOfflineURLDirectory(base_directory, url)) {
+    return -1;
+  }
+  base::FilePath path =
+      reading_list::OfflinePagePath(url, reading_list::OFFLINE_TYPE_PDF);
+  base::FilePath absolute_path =
+      reading_list::OfflineURLAbsolutePathFromRelativePath(base_directory,
+                                                           path);
+  if (!base::Move(temporary_path, absolute_path)) {
+    return -1;
+  }
+  int64_t pdf_file_size = 0;
+  base::GetFileSize(absolute_path, &pdf_file_size);
+  return pdf_file_size;
+}
+
 }  // namespace
 
+// URLDownloader::Download
+
+URLDownloader::Download::Download(const GURL& url) : original_url(url) {}
+
+URLDownloader::Download::~Download() = default;
+
 // URLDownloader
 
 URLDownloader::URLDownloader(
@@ -56,13 +174,15 @@ URLDownloader::URLDownloader(
       pref_service_(prefs),
       download_completion_(download_completion),
       delete_completion_(delete_completion),
-      working_(false),
+      max_concurrent_tasks_(GetMaxConcurrentTasks()),
+      prioritize_recent_downloads_(
+          base::FeatureList::IsEnabled(kReadingListConcurrentDownloads)),
+      in_flight_task_count_(0),
       base_directory_(chrome_profile_path),
-      mime_type_(),
       url_loader_factory_(std::move(url_loader_factory)),
-      task_runner_(base::ThreadPool::CreateSequencedTaskRunner(
-          {base::MayBlock(), base::TaskPriority::BEST_EFFORT,
-           base::TaskShutdownBehavior::SKIP_ON_SHUTDOWN})),
+      image_store_(base::MakeRefCounted<reading_list::OfflineImageStore>(
+          reading_list::OfflineRootDirectoryPath(base_directory_))),
+      task_runner_(CreateFileTaskRunner(max_concurrent_tasks_)),
       task_tracker_() {}
 
 URLDownloader::~URLDownloader() {
@@ -101,31 +221,42 @@ void URLDownloader::DownloadCompletionHandler(
     const std::string& title,
     const base::FilePath& offline_path,
     SuccessState success) {
-  DCHECK(working_);
+  DCHECK(GetDownload(url));
 
   auto post_delete = base::BindOnce(
       [](URLDownloader* _this, const GURL& url, const std::string& title,
          const base::FilePath& offline_path, SuccessState success) {
-        _this->download_completion_.Run(url, _this->distilled_url_, success,
-                                        offline_path, _this->saved_size_,
+        auto it = _this->downloads_.find(url);
+        DCHECK(it != _this->downloads_.end());
+        std::unique_ptr<Download> download = std::move(it->second);
+        _this->downloads_.erase(it);
+        _this->in_flight_task_count_--;
+        _this->download_completion_.Run(url, download->distilled_url, success,
+                                        offline_path, download->saved_size,
                                         title);
-        _this->distiller_.reset();
-        _this->working_ = false;
         _this->HandleNextTask();
       },
       base::Unretained(this), url, title, offline_path, success);
 
-  // If downloading failed, clean up any partial download.
+  // If downloading failed, clean up any partial download, and release the
+  // images it saved.
   if (success == ERROR) {
     base::FilePath directory_path =
         reading_list::OfflineURLDirectoryAbsolutePath(base_directory_, url);
+    std::vector<std::string> image_names;
+    for (const auto& pair : GetDownload(url)->image_names) {
+      image_names.push_back(pair.second);
+    }
     task_tracker_.PostTaskAndReply(
         task_runner_.get(), FROM_HERE,
         base::BindOnce(
-            [](const base::FilePath& offline_directory_path) {
+            [](scoped_refptr<reading_list::OfflineImageStore> image_store,
+               const base::FilePath& offline_directory_path,
+               const std::vector<std::string>& image_names) {
               base::DeletePathRecursively(offline_directory_path);
+              image_store->ReleaseImages(image_names);
             },
-            directory_path),
+            image_store_, directory_path, std::move(image_names)),
         std::move(post_delete));
   } else {
     std::move(post_delete).Run();
@@ -133,35 +264,83 @@ void URLDownloader::DownloadCompletionHandler(
 }
 
 void URLDownloader::DeleteCompletionHandler(const GURL& url, bool success) {
-  DCHECK(working_);
+  DCHECK(base::Contains(deletions_, url));
+  deletions_.erase(url);
+  in_flight_task_count_--;
   delete_completion_.Run(url, success);
-  working_ = false;
   HandleNextTask();
 }
 
-void URLDownloader::HandleNextTask() {
-  if (working_ || tasks_.empty()) {
-    return;
+URLDownloader::Download* URLDownloader::GetDownload(const GURL& url) {
+  auto it = downloads_.find(url);
+  return it != downloads_.end() ? it->second.get() : nullptr;
+}
+
+int URLDownloader::GetNextTaskIndex() const {
+  // A task can be handled if no task for the same URL is in progress or was
+  // queued before it.
+  auto can_handle = [this](int index) {
+    const GURL& url = tasks_[index].second;
+    if (base::Contains(downloads_, url) || base::Contains(deletions_, url))
+      return false;
+    for (int i = 0; i < index; i++) {
+      if (tasks_[i].second == url)
+        return false;
+    }
+    return true;
+  };
+
+  const int count = static_cast<int>(tasks_.size());
+  if (!prioritize_recent_downloads_) {
+    for (int index = 0; index < count; index++) {
+      if (can_handle(index))
+        return index;
+    }
+    return -1;
   }
-  working_ = true;
 
-  Task task = tasks_.front();
-  tasks_.pop_front();
-  GURL url = task.second;
-  base::FilePath directory_path =
-      reading_list::OfflineURLDirectoryAbsolutePath(base_directory_, url);
+  // Deletions are handled first as they are quick and free disk space, then
+  // the most recently added downloads.
+  for (int index = 0; index < count; index++) {
+    if (tasks_[index].first == DELETE && can_handle(index))
+      return index;
+  }
+  for (int index = count - 1; index >= 0; index--) {
+    if (tasks_[index].first == DOWNLOAD && can_handle(index))
+      return index;
+  }
+  return -1;
+}
 
-  if (task.first == DELETE) {
-    task_tracker_.PostTaskAndReplyWithResult(
-        task_runner_.get(), FROM_HERE,
-        base::BindOnce(&base::DeletePathRecursively, directory_path),
-        base::BindOnce(&URLDownloader::DeleteCompletionHandler,
-                       base::Unretained(this), url));
-  } else if (task.first == DOWNLOAD) {
-    DCHECK(!distiller_);
-    OfflinePathExists(directory_path,
-                      base::BindOnce(&URLDownloader::DownloadURL,
-                                     base::Unretained(this), url));
+void URLDownloader::HandleNextTask() {
+  while (in_flight_task_count_ < max_concurrent_tasks_) {
+    const int index = GetNextTaskIndex();
+    if (index == -1) {
+      return;
+    }
+    in_flight_task_count_++;
+
+    Task task = tasks_[index];
+    tasks_.erase(tasks_.begin() + index);
+    GURL url = task.second;
+    base::FilePath directory_path =
+        reading_list::OfflineURLDirectoryAbsolutePath(base_directory_, url);
+
+    if (task.first == DELETE) {
+      deletions_.insert(url);
+      task_tracker_.PostTaskAndReplyWithResult(
+          task_runner_.get(), FROM_HERE,
+          base::BindOnce(&reading_list::OfflineImageStore::DeletePage,
+                         image_store_, directory_path),
+          base::BindOnce(&URLDownloader::DeleteCompletionHandler,
+                         base::Unretained(this), url));
+    } else if (task.first == DOWNLOAD) {
+      DCHECK(!GetDownload(url));
+      downloads_[url] = std::make_unique<Download>(url);
+      OfflinePathExists(directory_path,
+                        base::BindOnce(&URLDownloader::DownloadURL,
+                                       base::Unretained(this), url));
+    }
   }
 }
 
@@ -172,14 +351,14 @@ void URLDownloader::DownloadURL(const GURL& url, bool offline_url_exists) {
     return;
   }
 
-  original_url_ = url;
-  distilled_url_ = url;
-  saved_size_ = 0;
+  Download* download = GetDownload(url);
+  download->distilled_url = url;
+  download->stage_start_time = base::TimeTicks::Now();
   std::unique_ptr<reading_list::ReadingListDistillerPage>
       reading_list_distiller_page =
           distiller_page_factory_->CreateReadingListDistillerPage(url, this);
 
-  distiller_.reset(new dom_distiller::DistillerViewer(
+  download->distiller.reset(new dom_distiller::DistillerViewer(
       distiller_factory_, std::move(reading_list_distiller_page), pref_service_,
       url,
       base::BindRepeating(&URLDownloader::DistillerCallback,
@@ -188,80 +367,88 @@ void URLDownloader::DownloadURL(const GURL& url, bool offline_url_exists) {
 
 void URLDownloader::DistilledPageRedirectedToURL(const GURL& page_url,
                                                  const GURL& redirected_url) {
-  DCHECK(original_url_ == page_url);
-  distilled_url_ = redirected_url;
+  Download* download = GetDownload(page_url);
+  DCHECK(download);
+  download->distilled_url = redirected_url;
 }
 
 void URLDownloader::DistilledPageHasMimeType(const GURL& original_url,
                                              const std::string& mime_type) {
-  DCHECK(original_url_ == original_url);
-  mime_type_ = mime_type;
+  Download* download = GetDownload(original_url);
+  DCHECK(download);
+  download->mime_type = mime_type;
 }
 
 void URLDownloader::OnURLLoadComplete(const GURL& original_url,
                                       base::FilePath response_path) {
+  Download* download = GetDownload(original_url);
+  DCHECK(download);
   // At the moment, only pdf files are downloaded using URLFetcher.
-  DCHECK(mime_type_ == "application/pdf");
+  DCHECK(download->mime_type == "application/pdf");
+  UMA_HISTOGRAM_MEDIUM_TIMES(
+      "IOS.ReadingList.Download.FetchTime",
+      base::TimeTicks::Now() - download->stage_start_time);
+
   base::FilePath path = reading_list::OfflinePagePath(
-      original_url_, reading_list::OFFLINE_TYPE_PDF);
+      original_url, reading_list::OFFLINE_TYPE_PDF);
   std::string mime_type;
-  if (url_loader_->ResponseInfo()) {
-    mime_type = url_loader_->ResponseInfo()->mime_type;
+  if (download->url_loader->ResponseInfo()) {
+    mime_type = download->url_loader->ResponseInfo()->mime_type;
   }
-  if (response_path.empty() || mime_type != mime_type_) {
-    return DownloadCompletionHandler(original_url_, "", path, ERROR);
+  download->url_loader.reset();
+  if (response_path.empty() || mime_type != download->mime_type) {
+    return DownloadCompletionHandler(original_url, "", path, ERROR);
   }
 
+  download->stage_start_time = base::TimeTicks::Now();
   task_tracker_.PostTaskAndReplyWithResult(
       task_runner_.get(), FROM_HERE,
-      base::BindOnce(&URLDownloader::SavePDFFile, base::Unretained(this),
+      base::BindOnce(&SavePDFFile, base_directory_, original_url,
                      response_path),
-      base::BindOnce(&URLDownloader::DownloadCompletionHandler,
-                     base::Unretained(this), original_url, "", path));
+      base::BindOnce(&URLDownloader::PDFSaved, base::Unretained(this),
+                     original_url));
+}
 
-  url_loader_.reset();
+void URLDownloader::PDFSaved(const GURL& url, int64_t written) {
+  Download* download = GetDownload(url);
+  DCHECK(download);
+  UMA_HISTOGRAM_MEDIUM_TIMES(
+      "IOS.ReadingList.Download.WriteTime",
+      base::TimeTicks::Now() - download->stage_start_time);
+  if (written >= 0) {
+    download->saved_size += written;
+  }
+  DownloadCompletionHandler(
+      url, "",
+      reading_list::OfflinePagePath(url, reading_list::OFFLINE_TYPE_PDF),
+      written >= 0 ? DOWNLOAD_SUCCESS : ERROR);
 }
 
 void URLDownloader::CancelTask() {
   task_tracker_.TryCancelAll();
-  distiller_.reset();
+  in_flight_task_count_ -=
+      static_cast<int>(downloads_.size() + deletions_.size());
+  downloads_.clear();
+  deletions_.clear();
 }
 
-void URLDownloader::FetchPDFFile() {
-  const GURL& pdf_url =
-      distilled_url_.is_valid() ? distilled_url_ : original_url_;
+void URLDownloader::FetchPDFFile(const GURL& url) {
+  Download* download = GetDownload(url);
+  DCHECK(download);
+  download->stage_start_time = base::TimeTicks::Now();
+  const GURL& pdf_url = download->distilled_url.is_valid()
+                            ? download->distilled_url
+                            : download->original_url;
   auto resource_request = std::make_unique<network::ResourceRequest>();
   resource_request->url = pdf_url;
   resource_request->load_flags = net::LOAD_SKIP_CACHE_VALIDATION;
 
-  url_loader_ = network::SimpleURLLoader::Create(std::move(resource_request),
-                                                 NO_TRAFFIC_ANNOTATION_YET);
-  url_loader_->DownloadToTempFile(
+  download->url_loader = network::SimpleURLLoader::Create(
+      std::move(resource_request), NO_TRAFFIC_ANNOTATION_YET);
+  download->url_loader->DownloadToTempFile(
       url_loader_factory_.get(),
       base::BindOnce(&URLDownloader::OnURLLoadComplete, base::Unretained(this),
-                     pdf_url));
-}
-
-URLDownloader::SuccessState URLDownloader::SavePDFFile(
-    const base::FilePath& temporary_path) {
-  if (CreateOfflineURLDirectory(original_url_)) {
-    base::FilePath path = reading_list::OfflinePagePath(
-        original_url_, reading_list::OFFLINE_TYPE_PDF);
-    base::FilePath absolute_path =
-        reading_list::OfflineURLAbsolutePathFromRelativePath(base_directory_,
-                                                             path);
-
-    if (base::Move(temporary_path, absolute_path)) {
-      int64_t pdf_file_size;
-      base::GetFileSize(absolute_path, &pdf_file_size);
-      saved_size_ += pdf_file_size;
-      return DOWNLOAD_SUCCESS;
-    } else {
-      return ERROR;
-    }
-  }
-
-  return ERROR;
+                     url));
 }
 
 void URLDownloader::DistillerCallback(
@@ -270,12 +457,18 @@ void URLDownloader::DistillerCallback(
     const std::vector<dom_distiller::DistillerViewerInterface::ImageInfo>&
         images,
     const std::string& title) {
+  Download* download = GetDownload(page_url);
+  DCHECK(download);
+  UMA_HISTOGRAM_MEDIUM_TIMES(
+      "IOS.ReadingList.Download.DistillTime",
+      base::TimeTicks::Now() - download->stage_start_time);
+
   if (html.empty()) {
     // The page may not be HTML. Check the mime-type to see if another handler
     // can save offline content.
-    if (mime_type_ == "application/pdf") {
+    if (download->mime_type == "application/pdf") {
       // PDF handler just downloads the PDF file.
-      FetchPDFFile();
+      FetchPDFFile(page_url);
       return;
     }
     // This content cannot be processed, return an error value to the client.
@@ -283,110 +476,130 @@ void URLDownloader::DistillerCallback(
     return;
   }
 
-  std::vector<dom_distiller::DistillerViewer::ImageInfo> images_block = images;
-  std::string block_html = html;
+  download->title = title;
   task_tracker_.PostTaskAndReplyWithResult(
       task_runner_.get(), FROM_HERE,
-      base::BindOnce(&URLDownloader::SaveDistilledHTML, base::Unretained(this),
-                     page_url, images_block, block_html),
-      base::BindOnce(&URLDownloader::DownloadCompletionHandler,
-                     base::Unretained(this), page_url, title,
-                     reading_list::OfflinePagePath(
-                         page_url, reading_list::OFFLINE_TYPE_HTML)));
+      base::BindOnce(&CreateOfflineURLDirectory, base_directory_, page_url),
+      base::BindOnce(&URLDownloader::SaveDistilledPage, base::Unretained(this),
+                     page_url, html, images));
 }
 
-URLDownloader::SuccessState URLDownloader::SaveDistilledHTML(
+void URLDownloader::SaveDistilledPage(
     const GURL& url,
+    const std::string& html,
     const std::vector<dom_distiller::DistillerViewerInterface::ImageInfo>&
         images,
-    const std::string& html) {
-  if (CreateOfflineURLDirectory(url)) {
-    return SaveHTMLForURL(SaveAndReplaceImagesInHTML(url, html, images), url)
-               ? DOWNLOAD_SUCCESS
-               : ERROR;
-  }
-  return ERROR;
-}
-
-bool URLDownloader::CreateOfflineURLDirectory(const GURL& url) {
-  base::FilePath directory_path =
-      reading_list::OfflineURLDirectoryAbsolutePath(base_directory_, url);
-  if (!DirectoryExists(directory_path)) {
-    return CreateDirectoryAndGetError(directory_path, nil);
-  }
-  return true;
-}
-
-bool URLDownloader::SaveImage(const GURL& url,
-                              const GURL& image_url,
-                              const std::string& data,
-                              std::string* image_name) {
-  std::string image_hash = base::MD5String(image_url.spec());
-  *image_name = image_hash;
-  base::FilePath directory_path =
-      reading_list::OfflineURLDirectoryAbsolutePath(base_directory_, url);
-  base::FilePath path = directory_path.Append(image_hash);
-  if (!base::PathExists(path)) {
-    int written = base::WriteFile(path, data.c_str(), data.length());
-    if (written <= 0) {
-      return false;
-    }
-    saved_size_ += written;
-    return true;
+    bool directory_created) {
+  Download* download = GetDownload(url);
+  DCHECK(download);
+  if (!directory_created) {
+    DownloadCompletionHandler(
+        url, download->title,
+        reading_list::OfflinePagePath(url, reading_list::OFFLINE_TYPE_HTML),
+        ERROR);
+    return;
   }
-  return true;
-}
 
-std::string URLDownloader::SaveAndReplaceImagesInHTML(
-    const GURL& url,
-    const std::string& html,
-    const std::vector<dom_distiller::DistillerViewerInterface::ImageInfo>&
-        images) {
-  std::string mutable_html = html;
-  bool local_images_found = false;
-  for (size_t i = 0; i < images.size(); i++) {
-    if (images[i].url.SchemeIs(url::kDataScheme)) {
+  // Save each distinct image in its own task, so that they are saved in
+  // parallel if the task runner allows it. The images are added to the shared
+  // store, so an image already saved by another page is not written again.
+  std::vector<std::pair<std::string, GURL>> image_references;
+  std::set<GURL> saved_image_urls;
+  download->stage_start_time = base::TimeTicks::Now();
+  for (const auto& image : images) {
+    if (image.url.SchemeIs(url::kDataScheme)) {
       // Data URI, the data part of the image is empty, no need to store it.
       continue;
     }
-    std::string local_image_name;
     // Mixed content is HTTP images on HTTPS pages.
-    bool image_is_mixed_content = distilled_url_.SchemeIsCryptographic() &&
-                                  !images[i].url.SchemeIsCryptographic();
+    bool image_is_mixed_content =
+        download->distilled_url.SchemeIsCryptographic() &&
+        !image.url.SchemeIsCryptographic();
     // Only save images if it is not mixed content and image data is valid.
-    if (!image_is_mixed_content && images[i].url.is_valid() &&
-        !images[i].data.empty()) {
-      if (!SaveImage(url, images[i].url, images[i].data, &local_image_name)) {
-        return std::string();
+    if (!image_is_mixed_content && image.url.is_valid() &&
+        !image.data.empty()) {
+      if (saved_image_urls.insert(image.url).second) {
+        download->pending_image_count++;
       }
     }
-    std::string image_url = net::EscapeForHTML(images[i].url.spec());
-    size_t image_url_size = image_url.size();
-    size_t pos = mutable_html.find(image_url, 0);
-    while (pos != std::string::npos) {
-      local_images_found = true;
-      mutable_html.replace(pos, image_url_size, local_image_name);
-      pos = mutable_html.find(image_url, pos + local_image_name.size());
-    }
+    image_references.emplace_back(net::EscapeForHTML(image.url.spec()),
+                                  image.url);
   }
-  if (local_images_found) {
-    mutable_html += kDisableImageContextMenuScript;
+
+  download->save_html =
+      base::BindOnce(&ReplaceImagesAndSaveHTML, image_store_, base_directory_,
+                     url, html, std::move(image_references));
+  if (download->pending_image_count == 0) {
+    SaveHTML(url);
+    return;
   }
+  for (const auto& image : images) {
+    if (saved_image_urls.erase(image.url) == 0) {
+      continue;
+    }
+    std::string* image_name = new std::string();
+    task_tracker_.PostTaskAndReplyWithResult(
+        task_runner_.get(), FROM_HERE,
+        base::BindOnce(&reading_list::OfflineImageStore::AddImage,
+                       image_store_, image.data, image_name),
+        base::BindOnce(&URLDownloader::ImageSaved, base::Unretained(this),
+                       url, image.url, base::Owned(image_name)));
+  }
+}
 
-  return mutable_html;
+void URLDownloader::ImageSaved(const GURL& url,
+                               const GURL& image_url,
+                               const std::string* image_name,
+                               int64_t written) {
+  Download* download = GetDownload(url);
+  DCHECK(download);
+  DCHECK_GT(download->pending_image_count, 0);
+  if (written < 0) {
+    download->image_save_failed = true;
+  } else {
+    download->image_names[image_url] = *image_name;
+    download->saved_size += written;
+  }
+  if (--download->pending_image_count == 0) {
+    UMA_HISTOGRAM_MEDIUM_TIMES(
+        "IOS.ReadingList.Download.ImageSaveTime",
+        base::TimeTicks::Now() - download->stage_start_time);
+    SaveHTML(url);
+  }
 }
 
-bool URLDownloader::SaveHTMLForURL(std::string html, const GURL& url) {
-  if (html.empty()) {
-    return false;
+void URLDownloader::SaveHTML(const GURL& url) {
+  Download* download = GetDownload(url);
+  DCHECK(download);
+  DCHECK_EQ(0, download->pending_image_count);
+  // If some images could not be saved, the partial processing is cleaned by
+  // DownloadCompletionHandler().
+  if (download->image_save_failed) {
+    DownloadCompletionHandler(
+        url, download->title,
+        reading_list::OfflinePagePath(url, reading_list::OFFLINE_TYPE_HTML),
+        ERROR);
+    return;
   }
-  base::FilePath path = reading_list::OfflineURLAbsolutePathFromRelativePath(
-      base_directory_,
-      reading_list::OfflinePagePath(url, reading_list::OFFLINE_TYPE_HTML));
-  int written = base::WriteFile(path, html.c_str(), html.length());
-  if (written <= 0) {
-    return false;
+
+  download->stage_start_time = base::TimeTicks::Now();
+  task_tracker_.PostTaskAndReplyWithResult(
+      task_runner_.get(), FROM_HERE,
+      base::BindOnce(std::move(download->save_html), download->image_names),
+      base::BindOnce(&URLDownloader::HTMLSaved, base::Unretained(this), url));
+}
+
+void URLDownloader::HTMLSaved(const GURL& url, int64_t written) {
+  Download* download = GetDownload(url);
+  DCHECK(download);
+  UMA_HISTOGRAM_MEDIUM_TIMES(
+      "IOS.ReadingList.Download.WriteTime",
+      base::TimeTicks::Now() - download->stage_start_time);
+  if (written >= 0) {
+    download->saved_size += written;
   }
-  saved_size_ += written;
-  return true;
+  DownloadCompletionHandler(
+      url, download->title,
+      reading_list::OfflinePagePath(url, reading_list::OFFLINE_TYPE_HTML),
+      written >= 0 ? DOWNLOAD_SUCCESS : ERROR);
 }
@@ -5,18 +5,26 @@
 #ifndef IOS_CHROME_BROWSER_READING_LIST_URL_DOWNLOADER_H_
 #define IOS_CHROME_BROWSER_READING_LIST_URL_DOWNLOADER_H_
 
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "base/callback.h"
 #include "base/containers/circular_deque.h"
 #include "base/files/file_path.h"
 #include "base/task/cancelable_task_tracker.h"
+#include "base/time/time.h"
 #include "ios/chrome/browser/dom_distiller/distiller_viewer.h"
 #include "ios/chrome/browser/reading_list/reading_list_distiller_page.h"
+#include "url/gurl.h"
 
 class PrefService;
-class GURL;
 namespace base {
 class FilePath;
-class SequencedTaskRunner;
+class TaskRunner;
 }
 
 namespace network {
@@ -25,6 +33,7 @@ class SimpleURLLoader;
 }
 
 namespace reading_list {
+class OfflineImageStore;
 class ReadingListDistillerPageFactory;
 }
 
@@ -33,10 +42,15 @@ class ReadingListDistillerPageFactory;
 // fetch the page and simplify it.
 // If the URL points to a PDF file, the PDF is simply downloaded and saved to
 // the disk.
-// Only one item is downloaded or deleted at a time using a queue of tasks that
-// are handled sequentially. Items (page + images) are saved to individual
-// folders within an offline folder, using md5 hashing to create unique file
-// names. When a deletion is requested, all previous downloads for that URL are
+// By default, only one item is downloaded or deleted at a time using a queue of
+// tasks that are handled sequentially. If the ReadingListConcurrentDownloads
+// feature is enabled, several items are handled at a time, the most recently
+// added first, and the images of a page are saved in parallel. Tasks for the
+// same URL are always handled in order, one at a time.
+// Pages are saved to individual folders within an offline folder, using md5
+// hashing to create unique file names. Their images are saved to a store shared
+// by all the pages, so that an image used by several pages is only saved once.
+// When a deletion is requested, all previous downloads for that URL are
 // cancelled as they would be deleted.
 class URLDownloader : reading_list::ReadingListDistillerPageDelegate {
   friend class MockURLDownloader;
@@ -94,24 +108,61 @@ class URLDownloader : reading_list::ReadingListDistillerPageDelegate {
   // Asynchronously remove the offline version of the URL if it exists.
   void RemoveOfflineURL(const GURL& url);
 
-  // URL loader completion callback.
+  // URL loader completion callback for the download of |original_url|.
   void OnURLLoadComplete(const GURL& original_url,
                          base::FilePath response_path);
 
-  // Cancels the current download task.
+  // Cancels the tasks in progress.
   void CancelTask();
 
  private:
   enum TaskType { DELETE, DOWNLOAD };
   using Task = std::pair<TaskType, GURL>;
 
+  // State of a download in progress.
+  struct Download {
+    explicit Download(const GURL& url);
+    ~Download();
+
+    const GURL original_url;
+    GURL distilled_url;
+    int64_t saved_size = 0;
+    std::string mime_type;
+    // Title of the distilled page.
+    std::string title;
+    // Number of images of the distilled page still being saved, and whether
+    // saving any of them failed.
+    int pending_image_count = 0;
+    bool image_save_failed = false;
+    // Names of the images saved to the image store, by URL. The download holds
+    // a reference to each of them.
+    std::map<GURL, std::string> image_names;
+    // Saves the HTML of the distilled page once the images are saved, given
+    // |image_names|, and returns the number of bytes written, or -1 on
+    // failure.
+    base::OnceCallback<int64_t(const std::map<GURL, std::string>&)> save_html;
+    // Start time of the current stage of the download, for the metrics.
+    base::TimeTicks stage_start_time;
+    // URL loader used to redownload the document and save it in the sandbox.
+    std::unique_ptr<network::SimpleURLLoader> url_loader;
+    std::unique_ptr<dom_distiller::DistillerViewerInterface> distiller;
+  };
+
+  // Returns the download in progress for |url|, or null if there is none.
+  Download* GetDownload(const GURL& url);
+
+  // Returns the index in |tasks_| of the next task to handle, or -1 if there
+  // is none that can be handled now.
+  int GetNextTaskIndex() const;
+
   // Calls callback with true if an offline path exists. |path| must be
   // absolute.
   void OfflinePathExists(const base::FilePath& url,
                          base::OnceCallback<void(bool)> callback);
-  // Handles the next task in the queue, if no task is currently being handled.
+  // Handles the next tasks in the queue, while fewer than
+  // |max_concurrent_tasks_| tasks are being handled.
   void HandleNextTask();
-  // Callback for completed (or failed) download, handles calling
+  // Callback for completed (or failed) download of |url|, handles calling
   // downloadCompletion and starting the next task.
   void DownloadCompletionHandler(const GURL& url,
                                  const std::string& title,
@@ -121,10 +172,6 @@ class URLDownloader : reading_list::ReadingListDistillerPageDelegate {
   // deleteCompletion and starting the next task.
   void DeleteCompletionHandler(const GURL& url, bool success);
 
-  // Creates the offline directory for |url|. Returns true if successful or if
-  // the directory already exists.
-  bool CreateOfflineURLDirectory(const GURL& url);
-
   // Downloads |url|, depending on |offlineURLExists| state.
   virtual void DownloadURL(const GURL& url, bool offlineURLExists);
 
@@ -136,29 +183,6 @@ class URLDownloader : reading_list::ReadingListDistillerPageDelegate {
 
   // HTML processing methods.
 
-  // Saves the |data| for image at |imageURL| to disk, for main URL |url|;
-  // puts path of saved file in |path| and returns whether save was successful.
-  bool SaveImage(const GURL& url,
-                 const GURL& imageURL,
-                 const std::string& data,
-                 std::string* image_name);
-  // Saves images in |images| array to disk and replaces references in |html| to
-  // local path. Returns updated html.
-  // If some images could not be saved, returns an empty string. It is the
-  // responsibility of the caller to clean the partial processing.
-  std::string SaveAndReplaceImagesInHTML(
-      const GURL& url,
-      const std::string& html,
-      const std::vector<dom_distiller::DistillerViewerInterface::ImageInfo>&
-          images);
-  // Saves |html| to disk in the correct location for |url|; returns success.
-  bool SaveHTMLForURL(std::string html, const GURL& url);
-  // Saves distilled html to disk, including saving images and main file.
-  SuccessState SaveDistilledHTML(
-      const GURL& url,
-      const std::vector<dom_distiller::DistillerViewerInterface::ImageInfo>&
-          images,
-      const std::string& html);
   // Callback for distillation completion.
   void DistillerCallback(
       const GURL& pageURL,
@@ -166,15 +190,37 @@ class URLDownloader : reading_list::ReadingListDistillerPageDelegate {
       const std::vector<dom_distiller::DistillerViewerInterface::ImageInfo>&
           images,
       const std::string& title);
+  // Saves the images in |images| to disk, then |html| with the references to
+  // the images replaced by their local path, once the offline directory for
+  // |url| was created, if |directory_created|.
+  void SaveDistilledPage(
+      const GURL& url,
+      const std::string& html,
+      const std::vector<dom_distiller::DistillerViewerInterface::ImageInfo>&
+          images,
+      bool directory_created);
+  // Callback for the save of the image at |image_url| of |url| as
+  // |image_name|, of |written| bytes, or -1 if the save failed. Once all the
+  // images are saved, saves the HTML.
+  void ImageSaved(const GURL& url,
+                  const GURL& image_url,
+                  const std::string* image_name,
+                  int64_t written);
+  // Saves the HTML of |url| once all its images are saved, unless saving one
+  // of them failed.
+  void SaveHTML(const GURL& url);
+  // Callback for the save of the HTML of |url|, of |written| bytes, or -1 if
+  // the save failed.
+  void HTMLSaved(const GURL& url, int64_t written);
 
   // PDF processing methods
 
-  // Starts fetching the PDF file. If |original_url_| triggered a redirection,
-  // directly save |distilled_url_|.
-  virtual void FetchPDFFile();
-  // Saves the file downloaded by |url_loader_|. Creates the directory if
-  // needed.
-  SuccessState SavePDFFile(const base::FilePath& temporary_path);
+  // Starts fetching the PDF file of |url|. If |url| triggered a redirection,
+  // directly fetch the redirected URL.
+  virtual void FetchPDFFile(const GURL& url);
+  // Callback for the save of the PDF of |url|, of |written| bytes, or -1 if
+  // the save failed.
+  void PDFSaved(const GURL& url, int64_t written);
 
   reading_list::ReadingListDistillerPageFactory* distiller_page_factory_;
   dom_distiller::DistillerFactory* distiller_factory_;
@@ -183,18 +229,24 @@ class URLDownloader : reading_list::ReadingListDistillerPageDelegate {
   const SuccessCompletion delete_completion_;
 
   base::circular_deque<Task> tasks_;
-  bool working_;
+  // Maximum number of tasks handled at a time, and whether the most recently
+  // added downloads are handled first.
+  const int max_concurrent_tasks_;
+  const bool prioritize_recent_downloads_;
+  // Number of tasks being handled.
+  int in_flight_task_count_;
+  // Downloads and deletions being handled, by URL.
+  std::map<GURL, std::unique_ptr<Download>> downloads_;
+  std::set<GURL> deletions_;
   base::FilePath base_directory_;
-  GURL original_url_;
-  GURL distilled_url_;
-  int64_t saved_size_;
-  std::string mime_type_;
-  // URL loader used to redownload the document and save it in the sandbox.
-  std::unique_ptr<network::SimpleURLLoader> url_loader_;
+  // Store of the images of the offline pages.
+  scoped_refptr<reading_list::OfflineImageStore> image_store_;
   // URLLoaderFactory needed for the URLLoader.
   scoped_refptr<network::SharedURLLoaderFactory> url_loader_factory_;
-  std::unique_ptr<dom_distiller::DistillerViewerInterface> distiller_;
-  scoped_refptr<base::SequencedTaskRunner> task_runner_;
+  // Task runner for the file operations. It is sequenced, unless several
+  // tasks are handled at a time, as the file operations of different URLs are
+  // independent.
+  scoped_refptr<base::TaskRunner> task_runner_;
   base::CancelableTaskTracker task_tracker_;
 
   DISALLOW_COPY_AND_ASSIGN(URLDownloader);
@@ -7,14 +7,18 @@
 #include <vector>
 
 #include "base/bind.h"
+#include "base/files/file_enumerator.h"
 #include "base/files/file_util.h"
 #include "base/path_service.h"
 #include "base/stl_util.h"
 #import "base/test/ios/wait_util.h"
+#include "base/test/scoped_feature_list.h"
 #include "base/test/task_environment.h"
 #include "components/reading_list/core/offline_url_utils.h"
 #include "ios/chrome/browser/chrome_paths.h"
 #include "ios/chrome/browser/dom_distiller/distiller_viewer.h"
+#include "ios/chrome/browser/reading_list/features.h"
+#include "ios/chrome/browser/reading_list/offline_image_store.h"
 #include "ios/chrome/browser/reading_list/offline_url_utils.h"
 #include "ios/chrome/browser/reading_list/reading_list_distiller_page.h"
 #include "services/network/public/cpp/weak_wrapper_shared_url_loader_factory.h"
@@ -96,10 +100,24 @@ class MockURLDownloader : public URLDownloader {
             base_directory_, reading_list::OfflinePagePath(url, file_type)));
   }
 
-  void FakeWorking() { working_ = true; }
+  // Returns the number of images in the image store.
+  int CountStoredImages() {
+    base::FileEnumerator enumerator(
+        reading_list::OfflineRootDirectoryPath(base_directory_).Append(
+            reading_list::OfflineImageStore::GetStoreDirectoryName()),
+        false, base::FileEnumerator::FILES);
+    int count = 0;
+    for (base::FilePath path = enumerator.Next(); !path.empty();
+         path = enumerator.Next()) {
+      count++;
+    }
+    return count;
+  }
+
+  void FakeWorking() { in_flight_task_count_++; }
 
   void FakeEndWorking() {
-    working_ = false;
+    in_flight_task_count_--;
     HandleNextTask();
   }
 
@@ -116,9 +134,8 @@ class MockURLDownloader : public URLDownloader {
                                 DOWNLOAD_EXISTS);
       return;
     }
-    original_url_ = url;
-    saved_size_ = 0;
-    distiller_.reset(new DistillerViewerTest(
+    Download* download = GetDownload(url);
+    download->distiller.reset(new DistillerViewerTest(
         url,
         base::BindRepeating(&URLDownloader::DistillerCallback,
                             base::Unretained(this)),
@@ -152,12 +169,19 @@ class URLDownloaderTest : public PlatformTest {
     base::FilePath data_dir;
     base::PathService::Get(ios::DIR_USER_DATA, &data_dir);
     RemoveOfflineFilesDirectory(data_dir);
-    downloader_.reset(
-        new MockURLDownloader(data_dir, test_shared_url_loader_factory_));
+    ResetDownloader();
   }
 
   ~URLDownloaderTest() override {}
 
+  // Creates a new downloader, which reads the features.
+  void ResetDownloader() {
+    base::FilePath data_dir;
+    base::PathService::Get(ios::DIR_USER_DATA, &data_dir);
+    downloader_.reset(
+        new MockURLDownloader(data_dir, test_shared_url_loader_factory_));
+  }
+
   void TearDown() override {
     base::FilePath data_dir;
     base::PathService::Get(ios::DIR_USER_DATA, &data_dir);
@@ -278,4 +302,84 @@ TEST_F(URLDownloaderTest, DownloadAndRemoveAndRedownload) {
   ASSERT_TRUE(downloader_->CheckExistenceOfOfflineURLPagePath(url));
 }
 
+// Tests that an image used by two pages is stored once, until both pages are
+// removed.
+TEST_F(URLDownloaderTest, SharedImage) {
+  GURL url = GURL("http://test.com");
+  GURL url2 = GURL("http://test2.com");
+  downloader_->DownloadOfflineURL(url);
+  downloader_->DownloadOfflineURL(url2);
+
+  // Wait for all asynchronous tasks to complete.
+  task_environment_.RunUntilIdle();
+
+  ASSERT_TRUE(downloader_->CheckExistenceOfOfflineURLPagePath(url));
+  ASSERT_TRUE(downloader_->CheckExistenceOfOfflineURLPagePath(url2));
+  EXPECT_EQ(1, downloader_->CountStoredImages());
+
+  downloader_->RemoveOfflineURL(url);
+  task_environment_.RunUntilIdle();
+  EXPECT_FALSE(downloader_->CheckExistenceOfOfflineURLPagePath(url));
+  EXPECT_EQ(1, downloader_->CountStoredImages());
+
+  downloader_->RemoveOfflineURL(url2);
+  task_environment_.RunUntilIdle();
+  EXPECT_EQ(0, downloader_->CountStoredImages());
+}
+
+// Tests that the most recently added entries are downloaded first when the
+// concurrent downloads are enabled.
+TEST_F(URLDownloaderTest, ConcurrentDownloadsPrioritizeRecent) {
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeatureWithParameters(
+      kReadingListConcurrentDownloads,
+      {{kReadingListMaxConcurrentDownloads.name, "1"}});
+  ResetDownloader();
+
+  GURL url1 = GURL("http://test1.com");
+  GURL url2 = GURL("http://test2.com");
+  GURL url3 = GURL("http://test3.com");
+  downloader_->FakeWorking();
+  downloader_->DownloadOfflineURL(url1);
+  downloader_->DownloadOfflineURL(url2);
+  downloader_->DownloadOfflineURL(url3);
+  downloader_->FakeEndWorking();
+
+  // Wait for all asynchronous tasks to complete.
+  task_environment_.RunUntilIdle();
+
+  EXPECT_EQ(std::vector<GURL>({url3, url2, url1}),
+            downloader_->downloaded_files_);
+}
+
+// Tests that concurrent downloads are all saved, and that the tasks for the
+// same URL are still handled in order.
+TEST_F(URLDownloaderTest, ConcurrentDownloadAndRemoveAndRedownload) {
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeatureWithParameters(
+      kReadingListConcurrentDownloads,
+      {{kReadingListMaxConcurrentDownloads.name, "3"}});
+  ResetDownloader();
+
+  GURL url = GURL("http://test.com");
+  GURL url2 = GURL("http://test2.com");
+  GURL url3 = GURL("http://test3.com");
+  downloader_->FakeWorking();
+  downloader_->DownloadOfflineURL(url);
+  downloader_->DownloadOfflineURL(url2);
+  downloader_->DownloadOfflineURL(url3);
+  downloader_->RemoveOfflineURL(url);
+  downloader_->DownloadOfflineURL(url);
+  downloader_->FakeEndWorking();
+
+  // Wait for all asynchronous tasks to complete.
+  task_environment_.RunUntilIdle();
+
+  EXPECT_EQ(3ul, downloader_->downloaded_files_.size());
+  EXPECT_EQ(std::vector<GURL>({url}), downloader_->removed_files_);
+  EXPECT_TRUE(downloader_->CheckExistenceOfOfflineURLPagePath(url));
+  EXPECT_TRUE(downloader_->CheckExistenceOfOfflineURLPagePath(url2));
+  EXPECT_TRUE(downloader_->CheckExistenceOfOfflineURLPagePath(url3));
+}
+
 }  // namespace
@@ -0,0 +1,25 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef IOS_CHROME_BROWSER_SESSIONS_FEATURES_H_
+#define IOS_CHROME_BROWSER_SESSIONS_FEATURES_H_
+
+#include "base/feature_list.h"
+
+// Feature flag to save the sessions in a compact binary format instead of
+// NSKeyedArchiver. Sessions in both formats are loaded whether the feature is
+// enabled or not.
+extern const base::Feature kSessionBinaryFormat;
+
+// Feature flag to save each tab of a session in its own file, next to a
+// manifest of the window. Only the tabs which changed since the previous save
+// are serialized and written.
+extern const base::Feature kSessionPerTabStorage;
+
+// Feature flag to restore the tabs of a session as unrealized WebStates. Their
+// navigation history is only restored when they are activated or when their
+// navigation manager is requested.
+extern const base::Feature kLazySessionRestoration;
+
+#endif  // IOS_CHROME_BROWSER_SESSIONS_FEATURES_H_
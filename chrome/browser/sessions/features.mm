@@ -0,0 +1,18 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ios/chrome/browser/sessions/features.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+const base::Feature kSessionBinaryFormat{"SessionBinaryFormat",
+                                         base::FEATURE_DISABLED_BY_DEFAULT};
+
+const base::Feature kSessionPerTabStorage{"SessionPerTabStorage",
+                                          base::FEATURE_DISABLED_BY_DEFAULT};
+
+const base::Feature kLazySessionRestoration{"LazySessionRestoration",
+                                            base::FEATURE_DISABLED_BY_DEFAULT};
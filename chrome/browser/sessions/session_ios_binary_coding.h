@@ -0,0 +1,42 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef IOS_CHROME_BROWSER_SESSIONS_SESSION_IOS_BINARY_CODING_H_
+#define IOS_CHROME_BROWSER_SESSIONS_SESSION_IOS_BINARY_CODING_H_
+
+#import <Foundation/Foundation.h>
+
+@class CRWSessionStorage;
+@class SessionIOS;
+
+// Compact binary encoding of SessionIOS, used instead of NSKeyedArchiver when
+// the kSessionBinaryFormat feature is enabled.
+//
+// The data starts with a magic number and a format version, followed by the
+// windows of the session. Each CRWSessionStorage of a window is stored as a
+// flat length-prefixed record of its fields, so that the records can be
+// skipped without being decoded.
+namespace session_binary_coding {
+
+// Returns whether |data| holds a session in the binary format.
+bool IsBinarySessionData(NSData* data);
+
+// Returns the binary encoding of |session|.
+NSData* EncodeSession(SessionIOS* session);
+
+// Returns the session encoded in |data|, or nil if |data| is not a valid
+// binary session. The CRWSessionStorages are only decoded when they are first
+// accessed, and |data| is retained until then.
+SessionIOS* DecodeSession(NSData* data);
+
+// Returns the binary record of |session_storage|.
+NSData* EncodeSessionStorage(CRWSessionStorage* session_storage);
+
+// Returns the CRWSessionStorage encoded in the |length| bytes of |record|, or
+// nil if the record is invalid.
+CRWSessionStorage* DecodeSessionStorage(const char* record, size_t length);
+
+}  // namespace session_binary_coding
+
+#endif  // IOS_CHROME_BROWSER_SESSIONS_SESSION_IOS_BINARY_CODING_H_
@@ -0,0 +1,464 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/chrome/browser/sessions/session_ios_binary_coding.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/check.h"
+#import "base/mac/foundation_util.h"
+#include "base/pickle.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/sys_string_conversions.h"
+#include "base/time/time.h"
+#import "ios/chrome/browser/sessions/session_ios.h"
+#import "ios/chrome/browser/sessions/session_window_ios.h"
+#include "ios/web/common/features.h"
+#include "ios/web/common/user_agent.h"
+#import "ios/web/public/session/crw_navigation_item_storage.h"
+#import "ios/web/public/session/crw_session_certificate_policy_cache_storage.h"
+#import "ios/web/public/session/crw_session_storage.h"
+#import "ios/web/public/session/serializable_user_data_manager.h"
+#include "net/cert/x509_certificate.h"
+#include "net/cert/x509_util.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace {
+
+// Identifies a binary session file ("CRSB").
+const uint32_t kSessionMagic = 0x42535243;
+
+// Version of the format. Files with a different version are not decoded.
+const uint32_t kSessionFormatVersion = 1;
+
+// Header at the start of the data, followed by a base::Pickle holding the
+// windows of the session.
+struct SessionHeader {
+  uint32_t magic;
+  uint32_t version;
+};
+
+// Location of the record of a CRWSessionStorage in the session data.
+struct SessionStorageRecord {
+  const char* data;
+  size_t length;
+};
+
+// Returns |user_agent_type| as it must be persisted.
+web::UserAgentType UserAgentTypeForSaving(web::UserAgentType user_agent_type) {
+  if (user_agent_type == web::UserAgentType::AUTOMATIC &&
+      !web::features::UseWebClientDefaultUserAgent()) {
+    return web::UserAgentType::MOBILE;
+  }
+  return user_agent_type;
+}
+
+void WriteNavigationItem(CRWNavigationItemStorage* item, base::Pickle* pickle) {
+  pickle->WriteString(item.URL.spec());
+  // Like NSCoding, only store the virtual URL when it differs from the URL.
+  pickle->WriteString(item.virtualURL != item.URL ? item.virtualURL.spec()
+                                                   : std::string());
+  pickle->WriteString(item.referrer.url.spec());
+  pickle->WriteInt(item.referrer.policy);
+  pickle->WriteInt64(item.timestamp.ToInternalValue());
+  pickle->WriteString16(item.title);
+
+  const web::PageDisplayState& display_state = item.displayState;
+  const CGPoint& content_offset = display_state.scroll_state().content_offset();
+  const UIEdgeInsets& content_inset =
+      display_state.scroll_state().content_inset();
+  pickle->WriteDouble(content_offset.x);
+  pickle->WriteDouble(content_offset.y);
+  pickle->WriteDouble(content_inset.top);
+  pickle->WriteDouble(content_inset.left);
+  pickle->WriteDouble(content_inset.bottom);
+  pickle->WriteDouble(content_inset.right);
+  pickle->WriteDouble(display_state.zoom_state().minimum_zoom_scale());
+  pickle->WriteDouble(display_state.zoom_state().maximum_zoom_scale());
+  pickle->WriteDouble(display_state.zoom_state().zoom_scale());
+
+  pickle->WriteBool(item.shouldSkipRepostFormConfirmation);
+  pickle->WriteString(web::GetUserAgentTypeDescription(item.userAgentType));
+
+  NSDictionary* headers = item.HTTPRequestHeaders;
+  pickle->WriteInt(static_cast<int>(headers.count));
+  for (NSString* name in headers) {
+    pickle->WriteString(base::SysNSStringToUTF8(name));
+    pickle->WriteString(base::SysNSStringToUTF8(
+        base::mac::ObjCCast<NSString>(headers[name])));
+  }
+}
+
+CRWNavigationItemStorage* ReadNavigationItem(base::PickleIterator* iterator) {
+  std::string url;
+  std::string virtual_url;
+  std::string referrer_url;
+  int referrer_policy = 0;
+  int64_t timestamp = 0;
+  base::string16 title;
+  if (!iterator->ReadString(&url) || !iterator->ReadString(&virtual_url) ||
+      !iterator->ReadString(&referrer_url) ||
+      !iterator->ReadInt(&referrer_policy) ||
+      !iterator->ReadInt64(&timestamp) || !iterator->ReadString16(&title)) {
+    return nil;
+  }
+  if (referrer_policy < 0 || referrer_policy > web::ReferrerPolicyLast)
+    return nil;
+
+  double display_state_values[9];
+  for (double& value : display_state_values) {
+    if (!iterator->ReadDouble(&value))
+      return nil;
+  }
+
+  bool skip_repost_form_confirmation = false;
+  std::string user_agent_description;
+  int header_count = 0;
+  if (!iterator->ReadBool(&skip_repost_form_confirmation) ||
+      !iterator->ReadString(&user_agent_description) ||
+      !iterator->ReadInt(&header_count) || header_count < 0) {
+    return nil;
+  }
+  NSMutableDictionary* headers = nil;
+  if (header_count) {
+    headers = [NSMutableDictionary dictionaryWithCapacity:header_count];
+    for (int i = 0; i < header_count; i++) {
+      std::string name;
+      std::string value;
+      if (!iterator->ReadString(&name) || !iterator->ReadString(&value))
+        return nil;
+      headers[base::SysUTF8ToNSString(name)] = base::SysUTF8ToNSString(value);
+    }
+  }
+
+  CRWNavigationItemStorage* item = [[CRWNavigationItemStorage alloc] init];
+  item.URL = GURL(url);
+  if (!virtual_url.empty())
+    item.virtualURL = GURL(virtual_url);
+  item.referrer = web::Referrer(
+      GURL(referrer_url), static_cast<web::ReferrerPolicy>(referrer_policy));
+  item.timestamp = base::Time::FromInternalValue(timestamp);
+  item.title = title;
+  item.displayState = web::PageDisplayState(
+      CGPointMake(display_state_values[0], display_state_values[1]),
+      UIEdgeInsetsMake(display_state_values[2], display_state_values[3],
+                       display_state_values[4], display_state_values[5]),
+      display_state_values[6], display_state_values[7],
+      display_state_values[8]);
+  item.shouldSkipRepostFormConfirmation = skip_repost_form_confirmation;
+  item.userAgentType =
+      web::GetUserAgentTypeWithDescription(user_agent_description);
+  item.HTTPRequestHeaders = headers;
+  return item;
+}
+
+void WriteCertificatePolicyCache(
+    CRWSessionCertificatePolicyCacheStorage* cache_storage,
+    base::Pickle* pickle) {
+  NSSet* certificate_storages = cache_storage.certificateStorages;
+  pickle->WriteInt(static_cast<int>(certificate_storages.count));
+  for (CRWSessionCertificateStorage* storage in certificate_storages) {
+    base::StringPiece certificate = net::x509_util::CryptoBufferAsStringPiece(
+        storage.certificate->cert_buffer());
+    pickle->WriteData(certificate.data(), certificate.size());
+    pickle->WriteString(storage.host);
+    pickle->WriteUInt32(storage.status);
+  }
+}
+
+CRWSessionCertificatePolicyCacheStorage* ReadCertificatePolicyCache(
+    base::PickleIterator* iterator) {
+  int count = 0;
+  if (!iterator->ReadInt(&count) || count < 0)
+    return nil;
+
+  NSMutableSet* certificate_storages =
+      [[NSMutableSet alloc] initWithCapacity:count];
+  for (int i = 0; i < count; i++) {
+    const char* certificate_data = nullptr;
+    int certificate_length = 0;
+    std::string host;
+    uint32_t status = 0;
+    if (!iterator->ReadData(&certificate_data, &certificate_length) ||
+        !iterator->ReadString(&host) || !iterator->ReadUInt32(&status)) {
+      return nil;
+    }
+    scoped_refptr<net::X509Certificate> certificate =
+        net::X509Certificate::CreateFromBytes(certificate_data,
+                                              certificate_length);
+    // Skip the policies which cannot be restored, as NSCoding does.
+    if (!certificate || host.empty())
+      continue;
+    [certificate_storages
+        addObject:[[CRWSessionCertificateStorage alloc]
+                      initWithCertificate:certificate
+                                     host:host
+                                   status:status]];
+  }
+
+  CRWSessionCertificatePolicyCacheStorage* cache_storage =
+      [[CRWSessionCertificatePolicyCacheStorage alloc] init];
+  cache_storage.certificateStorages = certificate_storages;
+  return cache_storage;
+}
+
+// Returns the NSKeyedArchiver encoding of |user_data|, which is opaque.
+NSData* EncodeUserData(web::SerializableUserData* user_data) {
+  if (!user_data)
+    return nil;
+  NSKeyedArchiver* archiver =
+      [[NSKeyedArchiver alloc] initRequiringSecureCoding:NO];
+  user_data->Encode(archiver);
+  [archiver finishEncoding];
+  return archiver.encodedData;
+}
+
+std::unique_ptr<web::SerializableUserData> DecodeUserData(const char* data,
+                                                          int length) {
+  std::unique_ptr<web::SerializableUserData> user_data =
+      web::SerializableUserData::Create();
+  if (!length)
+    return user_data;
+
+  NSData* archive = [NSData dataWithBytesNoCopy:const_cast<char*>(data)
+                                         length:length
+                                   freeWhenDone:NO];
+  NSKeyedUnarchiver* unarchiver =
+      [[NSKeyedUnarchiver alloc] initForReadingFromData:archive error:nil];
+  if (!unarchiver)
+    return user_data;
+  unarchiver.requiresSecureCoding = NO;
+  user_data->Decode(unarchiver);
+  return user_data;
+}
+
+// Returns the pickle following the header of |data|, or null if |data| is not
+// a binary session.
+std::unique_ptr<base::Pickle> GetSessionPickle(NSData* data) {
+  if (!session_binary_coding::IsBinarySessionData(data))
+    return nullptr;
+  SessionHeader header;
+  memcpy(&header, data.bytes, sizeof(header));
+  if (header.version != kSessionFormatVersion)
+    return nullptr;
+  return std::make_unique<base::Pickle>(
+      static_cast<const char*>(data.bytes) + sizeof(header),
+      data.length - sizeof(header));
+}
+
+}  // namespace
+
+// An immutable array of CRWSessionStorage decoding each element from its
+// record on first access.
+@interface LazySessionStorageArray : NSArray
+
+// Initializes the array with |records| pointing into |data|.
+- (instancetype)initWithData:(NSData*)data
+                     records:(std::vector<SessionStorageRecord>)records;
+
+@end
+
+@implementation LazySessionStorageArray {
+  // The session data, retained for the lifetime of |_records|.
+  NSData* _data;
+  std::vector<SessionStorageRecord> _records;
+  // The decoded session storages, nil until first accessed.
+  std::vector<CRWSessionStorage*> _sessionStorages;
+}
+
+- (instancetype)initWithData:(NSData*)data
+                     records:(std::vector<SessionStorageRecord>)records {
+  if ((self = [super init])) {
+    _data = data;
+    _records = std::move(records);
+    _sessionStorages.resize(_records.size());
+  }
+  return self;
+}
+
+#pragma mark - NSCopying
+
+// The array is immutable, return it instead of an eagerly decoded copy.
+- (id)copyWithZone:(NSZone*)zone {
+  return self;
+}
+
+#pragma mark - NSArray
+
+- (NSUInteger)count {
+  return _records.size();
+}
+
+- (id)objectAtIndex:(NSUInteger)index {
+  CHECK_LT(index, _records.size());
+  if (!_sessionStorages[index]) {
+    CRWSessionStorage* sessionStorage =
+        session_binary_coding::DecodeSessionStorage(_records[index].data,
+                                                    _records[index].length);
+    if (!sessionStorage) {
+      // Restore an empty tab rather than dropping it, so that the indexes of
+      // the window stay valid.
+      sessionStorage = [[CRWSessionStorage alloc] init];
+      sessionStorage.lastCommittedItemIndex = -1;
+      sessionStorage.itemStorages = @[];
+    }
+    _sessionStorages[index] = sessionStorage;
+  }
+  return _sessionStorages[index];
+}
+
+@end
+
+namespace session_binary_coding {
+
+bool IsBinarySessionData(NSData* data) {
+  if (data.length < sizeof(SessionHeader))
+    return false;
+  SessionHeader header;
+  memcpy(&header, data.bytes, sizeof(header));
+  return header.magic == kSessionMagic;
+}
+
+NSData* EncodeSession(SessionIOS* session) {
+  base::Pickle pickle;
+  pickle.WriteInt(static_cast<int>(session.sessionWindows.count));
+  for (SessionWindowIOS* window in session.sessionWindows) {
+    pickle.WriteInt64(window.selectedIndex == NSNotFound
+                          ? -1
+                          : static_cast<int64_t>(window.selectedIndex));
+    pickle.WriteInt(static_cast<int>(window.sessions.count));
+    for (CRWSessionStorage* session_storage in window.sessions) {
+      NSData* record = EncodeSessionStorage(session_storage);
+      pickle.WriteData(static_cast<const char*>(record.bytes), record.length);
+    }
+  }
+
+  const SessionHeader header = {kSessionMagic, kSessionFormatVersion};
+  NSMutableData* data =
+      [NSMutableData dataWithCapacity:sizeof(header) + pickle.size()];
+  [data appendBytes:&header length:sizeof(header)];
+  [data appendBytes:pickle.data() length:pickle.size()];
+  return data;
+}
+
+SessionIOS* DecodeSession(NSData* data) {
+  std::unique_ptr<base::Pickle> pickle = GetSessionPickle(data);
+  if (!pickle)
+    return nil;
+
+  base::PickleIterator iterator(*pickle);
+  int window_count = 0;
+  if (!iterator.ReadInt(&window_count) || window_count < 0)
+    return nil;
+
+  NSMutableArray<SessionWindowIOS*>* windows =
+      [NSMutableArray arrayWithCapacity:window_count];
+  for (int i = 0; i < window_count; i++) {
+    int64_t selected_index = 0;
+    int session_count = 0;
+    if (!iterator.ReadInt64(&selected_index) ||
+        !iterator.ReadInt(&session_count) || session_count < 0 ||
+        selected_index < -1 || selected_index >= session_count) {
+      return nil;
+    }
+
+    // Only locate the records, they are decoded when first accessed.
+    std::vector<SessionStorageRecord> records;
+    records.reserve(session_count);
+    for (int j = 0; j < session_count; j++) {
+      const char* record = nullptr;
+      int length = 0;
+      if (!iterator.ReadData(&record, &length))
+        return nil;
+      records.push_back({record, static_cast<size_t>(length)});
+    }
+
+    NSArray<CRWSessionStorage*>* sessions =
+        [[LazySessionStorageArray alloc] initWithData:data
+                                              records:std::move(records)];
+    [windows
+        addObject:[[SessionWindowIOS alloc]
+                      initWithSessions:sessions
+                         selectedIndex:selected_index == -1
+                                           ? NSNotFound
+                                           : static_cast<NSUInteger>(
+                                                 selected_index)]];
+  }
+  return [[SessionIOS alloc] initWithWindows:windows];
+}
+
+NSData* EncodeSessionStorage(CRWSessionStorage* session_storage) {
+  base::Pickle pickle;
+  pickle.WriteBool(session_storage.hasOpener);
+  pickle.WriteInt(static_cast<int>(session_storage.lastCommittedItemIndex));
+  pickle.WriteString(web::GetUserAgentTypeDescription(
+      UserAgentTypeForSaving(session_storage.userAgentType)));
+
+  pickle.WriteInt(static_cast<int>(session_storage.itemStorages.count));
+  for (CRWNavigationItemStorage* item in session_storage.itemStorages)
+    WriteNavigationItem(item, &pickle);
+
+  WriteCertificatePolicyCache(session_storage.certPolicyCacheStorage, &pickle);
+
+  NSData* user_data = EncodeUserData(session_storage.userData);
+  pickle.WriteData(static_cast<const char*>(user_data.bytes),
+                   user_data.length);
+
+  return [NSData dataWithBytes:pickle.data() length:pickle.size()];
+}
+
+CRWSessionStorage* DecodeSessionStorage(const char* record, size_t length) {
+  base::Pickle pickle(record, length);
+  base::PickleIterator iterator(pickle);
+
+  bool has_opener = false;
+  int last_committed_item_index = -1;
+  std::string user_agent_description;
+  int item_count = 0;
+  if (!iterator.ReadBool(&has_opener) ||
+      !iterator.ReadInt(&last_committed_item_index) ||
+      !iterator.ReadString(&user_agent_description) ||
+      !iterator.ReadInt(&item_count) || item_count < 0) {
+    return nil;
+  }
+
+  NSMutableArray<CRWNavigationItemStorage*>* items =
+      [NSMutableArray arrayWithCapacity:item_count];
+  for (int i = 0; i < item_count; i++) {
+    CRWNavigationItemStorage* item = ReadNavigationItem(&iterator);
+    if (!item)
+      return nil;
+    [items addObject:item];
+  }
+
+  CRWSessionCertificatePolicyCacheStorage* cache_storage =
+      ReadCertificatePolicyCache(&iterator);
+  const char* user_data = nullptr;
+  int user_data_length = 0;
+  if (!cache_storage || !iterator.ReadData(&user_data, &user_data_length))
+    return nil;
+
+  CRWSessionStorage* session_storage = [[CRWSessionStorage alloc] init];
+  session_storage.hasOpener = has_opener;
+  session_storage.lastCommittedItemIndex =
+      items.count ? last_committed_item_index : -1;
+  session_storage.itemStorages = items;
+  session_storage.certPolicyCacheStorage = cache_storage;
+  session_storage.userAgentType =
+      web::GetUserAgentTypeWithDescription(user_agent_description);
+  [session_storage
+      setSerializableUserData:DecodeUserData(user_data, user_data_length)];
+  return session_storage;
+}
+
+}  // namespace session_binary_coding
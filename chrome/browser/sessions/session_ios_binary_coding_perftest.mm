@@ -0,0 +1,160 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import <Foundation/Foundation.h>
+
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/timer/elapsed_timer.h"
+#import "ios/chrome/browser/sessions/session_ios.h"
+#import "ios/chrome/browser/sessions/session_ios_binary_coding.h"
+#import "ios/chrome/browser/sessions/session_window_ios.h"
+#include "ios/chrome/test/base/perf_test_ios.h"
+#import "ios/web/public/session/crw_navigation_item_storage.h"
+#import "ios/web/public/session/crw_session_storage.h"
+#include "url/gurl.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace {
+
+// Number of tabs of the synthetic session.
+const int kTabCount = 500;
+
+// Number of navigation items of each tab.
+const int kItemCount = 10;
+
+// Returns a session with a single window of |kTabCount| tabs.
+SessionIOS* CreateSyntheticSession() {
+  NSMutableArray<CRWSessionStorage*>* sessions = [NSMutableArray array];
+  for (int i = 0; i < kTabCount; i++) {
+    NSMutableArray<CRWNavigationItemStorage*>* items = [NSMutableArray array];
+    for (int j = 0; j < kItemCount; j++) {
+      CRWNavigationItemStorage* item = [[CRWNavigationItemStorage alloc] init];
+      item.URL = GURL("https://www.example.com/tab/" + base::NumberToString(i) +
+                      "/page/" + base::NumberToString(j));
+      item.title = base::ASCIIToUTF16("Page " + base::NumberToString(j));
+      item.timestamp = base::Time::Now();
+      [items addObject:item];
+    }
+    CRWSessionStorage* session_storage = [[CRWSessionStorage alloc] init];
+    session_storage.itemStorages = items;
+    session_storage.lastCommittedItemIndex = kItemCount - 1;
+    [sessions addObject:session_storage];
+  }
+  SessionWindowIOS* window =
+      [[SessionWindowIOS alloc] initWithSessions:sessions selectedIndex:0];
+  return [[SessionIOS alloc] initWithWindows:@[ window ]];
+}
+
+NSData* ArchiveSession(SessionIOS* session) {
+  NSError* error = nil;
+  NSData* data = [NSKeyedArchiver archivedDataWithRootObject:session
+                                       requiringSecureCoding:NO
+                                                       error:&error];
+  EXPECT_FALSE(error);
+  return data;
+}
+
+SessionIOS* UnarchiveSession(NSData* data) {
+  NSError* error = nil;
+  NSKeyedUnarchiver* unarchiver =
+      [[NSKeyedUnarchiver alloc] initForReadingFromData:data error:&error];
+  EXPECT_FALSE(error);
+  unarchiver.requiresSecureCoding = NO;
+  return [unarchiver decodeObjectForKey:NSKeyedArchiveRootObjectKey];
+}
+
+class SessionIOSBinaryCodingPerfTest : public PerfTest {
+ protected:
+  SessionIOSBinaryCodingPerfTest()
+      : PerfTest("Session coding"), session_(CreateSyntheticSession()) {}
+
+  SessionIOS* session_;
+};
+
+// Measures the size of the session file in both formats.
+TEST_F(SessionIOSBinaryCodingPerfTest, FileSize) {
+  LogPerfValue("NSKeyedArchiver file size", ArchiveSession(session_).length,
+               "bytes");
+  LogPerfValue("Binary file size",
+               session_binary_coding::EncodeSession(session_).length, "bytes");
+}
+
+TEST_F(SessionIOSBinaryCodingPerfTest, ArchiverEncode) {
+  RepeatTimedRuns("NSKeyedArchiver encode",
+                  ^base::TimeDelta(int) {
+                    base::ElapsedTimer timer;
+                    ArchiveSession(session_);
+                    return timer.Elapsed();
+                  },
+                  nil);
+}
+
+TEST_F(SessionIOSBinaryCodingPerfTest, BinaryEncode) {
+  RepeatTimedRuns("Binary encode",
+                  ^base::TimeDelta(int) {
+                    base::ElapsedTimer timer;
+                    session_binary_coding::EncodeSession(session_);
+                    return timer.Elapsed();
+                  },
+                  nil);
+}
+
+// Measures decoding the whole session with NSKeyedUnarchiver.
+TEST_F(SessionIOSBinaryCodingPerfTest, ArchiverDecode) {
+  NSData* data = ArchiveSession(session_);
+  RepeatTimedRuns("NSKeyedArchiver decode",
+                  ^base::TimeDelta(int) {
+                    base::ElapsedTimer timer;
+                    SessionIOS* session = UnarchiveSession(data);
+                    EXPECT_EQ(static_cast<NSUInteger>(kTabCount),
+                              session.sessionWindows[0].sessions.count);
+                    return timer.Elapsed();
+                  },
+                  nil);
+}
+
+// Measures decoding the binary session, then the selected tab only, which is
+// what is needed to display the first page at startup.
+TEST_F(SessionIOSBinaryCodingPerfTest, BinaryDecodeSelectedTab) {
+  NSData* data = session_binary_coding::EncodeSession(session_);
+  RepeatTimedRuns("Binary decode selected tab",
+                  ^base::TimeDelta(int) {
+                    base::ElapsedTimer timer;
+                    SessionIOS* session =
+                        session_binary_coding::DecodeSession(data);
+                    EXPECT_EQ(static_cast<NSUInteger>(kItemCount),
+                              session.sessionWindows[0]
+                                  .sessions[0]
+                                  .itemStorages.count);
+                    return timer.Elapsed();
+                  },
+                  nil);
+}
+
+// Measures decoding the binary session and all its tabs.
+TEST_F(SessionIOSBinaryCodingPerfTest, BinaryDecodeAllTabs) {
+  NSData* data = session_binary_coding::EncodeSession(session_);
+  RepeatTimedRuns("Binary decode all tabs",
+                  ^base::TimeDelta(int) {
+                    base::ElapsedTimer timer;
+                    SessionIOS* session =
+                        session_binary_coding::DecodeSession(data);
+                    NSUInteger item_count = 0;
+                    for (CRWSessionStorage* session_storage in session
+                             .sessionWindows[0]
+                             .sessions) {
+                      item_count += session_storage.itemStorages.count;
+                    }
+                    EXPECT_EQ(static_cast<NSUInteger>(kTabCount * kItemCount),
+                              item_count);
+                    return timer.Elapsed();
+                  },
+                  nil);
+}
+
+}  // namespace
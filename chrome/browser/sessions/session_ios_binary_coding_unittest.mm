@@ -0,0 +1,132 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/chrome/browser/sessions/session_ios_binary_coding.h"
+
+#import <Foundation/Foundation.h>
+
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/time/time.h"
+#import "ios/chrome/browser/sessions/session_ios.h"
+#import "ios/chrome/browser/sessions/session_window_ios.h"
+#import "ios/web/public/session/crw_navigation_item_storage.h"
+#import "ios/web/public/session/crw_session_storage.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/platform_test.h"
+#include "url/gurl.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace {
+
+CRWNavigationItemStorage* CreateItemForTest(int index) {
+  CRWNavigationItemStorage* item = [[CRWNavigationItemStorage alloc] init];
+  item.URL = GURL("https://www.example.com/" + base::NumberToString(index));
+  item.virtualURL = GURL("chrome://version");
+  item.referrer = web::Referrer(GURL("https://www.referrer.com"),
+                                web::ReferrerPolicyOrigin);
+  item.timestamp = base::Time::FromDoubleT(1000 + index);
+  item.title = base::ASCIIToUTF16("Title");
+  item.displayState = web::PageDisplayState(
+      CGPointMake(1.0, 2.0), UIEdgeInsetsMake(3.0, 4.0, 5.0, 6.0), 0.5, 3.0,
+      1.5);
+  item.shouldSkipRepostFormConfirmation = YES;
+  item.userAgentType = web::UserAgentType::DESKTOP;
+  item.HTTPRequestHeaders = @{@"HeaderKey" : @"HeaderValue"};
+  return item;
+}
+
+CRWSessionStorage* CreateSessionStorageForTest(int item_count) {
+  CRWSessionStorage* session_storage = [[CRWSessionStorage alloc] init];
+  session_storage.hasOpener = YES;
+  NSMutableArray* items = [NSMutableArray array];
+  for (int i = 0; i < item_count; i++)
+    [items addObject:CreateItemForTest(i)];
+  session_storage.itemStorages = items;
+  session_storage.lastCommittedItemIndex = item_count - 1;
+  session_storage.userAgentType = web::UserAgentType::MOBILE;
+  return session_storage;
+}
+
+}  // namespace
+
+// Required to clear the autorelease pool automatically between each tests.
+using SessionIOSBinaryCodingTest = PlatformTest;
+
+// Tests that all the persisted fields of a CRWSessionStorage are restored.
+TEST_F(SessionIOSBinaryCodingTest, SessionStorageRoundTrip) {
+  CRWSessionStorage* original = CreateSessionStorageForTest(2);
+  NSData* record = session_binary_coding::EncodeSessionStorage(original);
+  CRWSessionStorage* decoded = session_binary_coding::DecodeSessionStorage(
+      static_cast<const char*>(record.bytes), record.length);
+  ASSERT_TRUE(decoded);
+
+  EXPECT_TRUE(decoded.hasOpener);
+  EXPECT_EQ(1, decoded.lastCommittedItemIndex);
+  EXPECT_EQ(web::UserAgentType::MOBILE, decoded.userAgentType);
+  ASSERT_EQ(2u, decoded.itemStorages.count);
+
+  CRWNavigationItemStorage* expected = original.itemStorages[1];
+  CRWNavigationItemStorage* item = decoded.itemStorages[1];
+  EXPECT_EQ(expected.URL, item.URL);
+  EXPECT_EQ(expected.virtualURL, item.virtualURL);
+  EXPECT_EQ(expected.referrer.url, item.referrer.url);
+  EXPECT_EQ(expected.referrer.policy, item.referrer.policy);
+  EXPECT_EQ(expected.timestamp, item.timestamp);
+  EXPECT_EQ(expected.title, item.title);
+  EXPECT_EQ(expected.displayState, item.displayState);
+  EXPECT_TRUE(item.shouldSkipRepostFormConfirmation);
+  EXPECT_EQ(web::UserAgentType::DESKTOP, item.userAgentType);
+  EXPECT_NSEQ(expected.HTTPRequestHeaders, item.HTTPRequestHeaders);
+}
+
+// Tests that the windows of a session and their selected index are restored.
+TEST_F(SessionIOSBinaryCodingTest, SessionRoundTrip) {
+  SessionWindowIOS* window = [[SessionWindowIOS alloc]
+      initWithSessions:@[
+        CreateSessionStorageForTest(1), CreateSessionStorageForTest(3)
+      ]
+         selectedIndex:1];
+  SessionWindowIOS* empty_window = [[SessionWindowIOS alloc] init];
+  SessionIOS* session =
+      [[SessionIOS alloc] initWithWindows:@[ window, empty_window ]];
+
+  NSData* data = session_binary_coding::EncodeSession(session);
+  EXPECT_TRUE(session_binary_coding::IsBinarySessionData(data));
+
+  SessionIOS* decoded = session_binary_coding::DecodeSession(data);
+  ASSERT_TRUE(decoded);
+  ASSERT_EQ(2u, decoded.sessionWindows.count);
+  EXPECT_EQ(1u, decoded.sessionWindows[0].selectedIndex);
+  ASSERT_EQ(2u, decoded.sessionWindows[0].sessions.count);
+  EXPECT_EQ(3u, decoded.sessionWindows[0].sessions[1].itemStorages.count);
+  EXPECT_EQ(1u, decoded.sessionWindows[0].sessions[0].itemStorages.count);
+  EXPECT_EQ(static_cast<NSUInteger>(NSNotFound),
+            decoded.sessionWindows[1].selectedIndex);
+  EXPECT_EQ(0u, decoded.sessionWindows[1].sessions.count);
+}
+
+// Tests that data which is not a binary session is rejected.
+TEST_F(SessionIOSBinaryCodingTest, RejectInvalidData) {
+  NSError* error = nil;
+  NSData* archive = [NSKeyedArchiver
+      archivedDataWithRootObject:[[SessionIOS alloc] initWithWindows:@[]]
+           requiringSecureCoding:NO
+                           error:&error];
+  ASSERT_FALSE(error);
+  EXPECT_FALSE(session_binary_coding::IsBinarySessionData(archive));
+  EXPECT_FALSE(session_binary_coding::DecodeSession(archive));
+  EXPECT_FALSE(session_binary_coding::DecodeSession([NSData data]));
+
+  // A truncated session is rejected.
+  NSData* data = session_binary_coding::EncodeSession([[SessionIOS alloc]
+      initWithWindows:@[ [[SessionWindowIOS alloc]
+                          initWithSessions:@[ CreateSessionStorageForTest(2) ]
+                             selectedIndex:0] ]]);
+  EXPECT_FALSE(session_binary_coding::DecodeSession(
+      [data subdataWithRange:NSMakeRange(0, data.length / 2)]));
+}
@@ -8,7 +8,13 @@
 #import <Foundation/Foundation.h>
 
 class WebStateList;
+@class CRWSessionStorage;
 @class SessionIOS;
+@class SessionManifestIOS;
+
+namespace web {
+class WebState;
+}
 
 // A factory that is used to create a SessionIOS object for a specific
 // WebStateList. It's the responsibility of the owner of the SessionIOSFactory
@@ -26,6 +32,23 @@ class WebStateList;
 // be used without initializing the object with a non-null WebStateList.
 - (SessionIOS*)sessionForSaving;
 
+// Marks the session of |webState| as changed, so that it is serialized by the
+// next call to |manifestForSavingWithDirtySessions:removedTabIDs:|.
+- (void)markWebStateDirty:(web::WebState*)webState;
+
+// Creates the manifest of the webStateList, and sets |dirtySessions| to the
+// serialized sessions of the WebStates whose saved session is outdated, keyed
+// by tab ID. Those are the WebStates which were not in the previous manifest or
+// were marked as dirty. The openers of the WebStates are only saved in the
+// manifest, not in their sessions. Sets |removedTabIDs| to
+// the tabs of the previous manifest which were closed since, or to nil if this
+// is the first manifest created by the factory. Returns nil if the session
+// can't be saved.
+- (SessionManifestIOS*)
+    manifestForSavingWithDirtySessions:
+        (NSDictionary<NSString*, CRWSessionStorage*>**)dirtySessions
+                         removedTabIDs:(NSArray<NSString*>**)removedTabIDs;
+
 @end
 
 #endif  // IOS_CHROME_BROWSER_SESSIONS_SESSION_IOS_FACTORY_H_
@@ -5,6 +5,7 @@
 #import "ios/chrome/browser/sessions/session_ios_factory.h"
 
 #import "ios/chrome/browser/sessions/session_ios.h"
+#import "ios/chrome/browser/sessions/session_manifest_ios.h"
 #import "ios/chrome/browser/web_state_list/web_state_list.h"
 #import "ios/chrome/browser/web_state_list/web_state_list_serialization.h"
 
@@ -19,6 +20,11 @@
 
 @implementation SessionIOSFactory {
   WebStateList* _webStateList;
+  // The manifest returned by the previous call to
+  // |manifestForSavingWithDirtySessions:removedTabIDs:|.
+  SessionManifestIOS* _savedManifest;
+  // The tab IDs of the WebStates marked as dirty since then.
+  NSMutableSet<NSString*>* _dirtyTabIDs;
 }
 
 #pragma mark - Initialization
@@ -27,6 +33,7 @@
   if (self = [super init]) {
     DCHECK(webStateList);
     _webStateList = webStateList;
+    _dirtyTabIDs = [NSMutableSet set];
   }
   return self;
 }
@@ -48,6 +55,47 @@
       initWithWindows:@[ SerializeWebStateList(_webStateList) ]];
 }
 
+- (void)markWebStateDirty:(web::WebState*)webState {
+  [_dirtyTabIDs addObject:GetTabIdOfWebState(webState)];
+}
+
+- (SessionManifestIOS*)
+    manifestForSavingWithDirtySessions:
+        (NSDictionary<NSString*, CRWSessionStorage*>**)dirtySessions
+                         removedTabIDs:(NSArray<NSString*>**)removedTabIDs {
+  DCHECK(dirtySessions);
+  DCHECK(removedTabIDs);
+  if (![self canSaveCurrentSession])
+    return nil;
+
+  SessionManifestIOS* manifest = SerializeWebStateListManifest(_webStateList);
+
+  // The tabs of the previous manifest which are not in the new one were
+  // closed since.
+  NSMutableSet<NSString*>* removedIDs =
+      [NSMutableSet setWithArray:_savedManifest.tabIDs ?: @[]];
+
+  NSMutableDictionary<NSString*, CRWSessionStorage*>* sessions =
+      [NSMutableDictionary dictionary];
+  for (NSUInteger index = 0; index < manifest.tabIDs.count; ++index) {
+    NSString* tabID = manifest.tabIDs[index];
+    const BOOL saved = [removedIDs containsObject:tabID];
+    [removedIDs removeObject:tabID];
+    // The openers are saved in the manifest, so a tab only needs to be saved
+    // if it is new or its session changed.
+    if (saved && ![_dirtyTabIDs containsObject:tabID])
+      continue;
+    sessions[tabID] = SerializeWebStateWithoutOpener(
+        _webStateList->GetWebStateAt(static_cast<int>(index)));
+  }
+
+  *dirtySessions = sessions;
+  *removedTabIDs = _savedManifest ? removedIDs.allObjects : nil;
+  [_dirtyTabIDs removeAllObjects];
+  _savedManifest = manifest;
+  return manifest;
+}
+
 #pragma mark - Private
 
 - (BOOL)canSaveCurrentSession {
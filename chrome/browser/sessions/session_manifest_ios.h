@@ -0,0 +1,41 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef IOS_CHROME_BROWSER_SESSIONS_SESSION_MANIFEST_IOS_H_
+#define IOS_CHROME_BROWSER_SESSIONS_SESSION_MANIFEST_IOS_H_
+
+#import <Foundation/Foundation.h>
+
+// Describes a session "window" whose tabs are saved in separate files. The
+// manifest only stores the order of the tabs, their opener and the selected
+// tab, so it stays small whatever the size of the tabs' history.
+@interface SessionManifestIOS : NSObject<NSCoding>
+
+// Initializes the manifest. |openerIndexes| and |openerNavigationIndexes| must
+// have one entry per tab ID, -1 meaning that the tab has no opener.
+// |selectedIndex| must be a valid index in |tabIDs| or NSNotFound if |tabIDs|
+// is empty.
+- (instancetype)initWithTabIDs:(NSArray<NSString*>*)tabIDs
+                  openerIndexes:(NSArray<NSNumber*>*)openerIndexes
+        openerNavigationIndexes:(NSArray<NSNumber*>*)openerNavigationIndexes
+                  selectedIndex:(NSUInteger)selectedIndex
+    NS_DESIGNATED_INITIALIZER;
+
+// The unique identifiers of the tabs, in order. May be empty but never nil.
+@property(nonatomic, readonly) NSArray<NSString*>* tabIDs;
+
+// The index of the opener of each tab, or -1 if the tab has no opener.
+@property(nonatomic, readonly) NSArray<NSNumber*>* openerIndexes;
+
+// The navigation index of the opener of each tab, or -1 if the tab has no
+// opener.
+@property(nonatomic, readonly) NSArray<NSNumber*>* openerNavigationIndexes;
+
+// The currently selected tab. NSNotFound if the manifest contains no tabs;
+// otherwise a valid index in |tabIDs|.
+@property(nonatomic, readonly) NSUInteger selectedIndex;
+
+@end
+
+#endif  // IOS_CHROME_BROWSER_SESSIONS_SESSION_MANIFEST_IOS_H_
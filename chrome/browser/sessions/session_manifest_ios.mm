@@ -0,0 +1,115 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/chrome/browser/sessions/session_manifest_ios.h"
+
+#include "base/check_op.h"
+#include "base/format_macros.h"
+#import "base/mac/foundation_util.h"
+#import "ios/chrome/browser/sessions/NSCoder+Compatibility.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace {
+// Serialization keys.
+NSString* const kTabIDsKey = @"tabIDs";
+NSString* const kOpenerIndexesKey = @"openerIndexes";
+NSString* const kOpenerNavigationIndexesKey = @"openerNavigationIndexes";
+NSString* const kSelectedIndexKey = @"selectedIndex";
+
+// Returns whether |index| is valid for a SessionManifestIOS with |tab_count|
+// tabs.
+BOOL IsIndexValidForTabCount(NSUInteger index, NSUInteger tab_count) {
+  return (tab_count == 0) ? (index == static_cast<NSUInteger>(NSNotFound))
+                          : (index < tab_count);
+}
+
+// Returns an array of |count| -1 values.
+NSArray<NSNumber*>* NoOpeners(NSUInteger count) {
+  NSMutableArray<NSNumber*>* indexes =
+      [NSMutableArray arrayWithCapacity:count];
+  for (NSUInteger i = 0; i < count; i++)
+    [indexes addObject:@(-1)];
+  return indexes;
+}
+}  // namespace
+
+@implementation SessionManifestIOS
+
+- (instancetype)init {
+  return [self initWithTabIDs:@[]
+                openerIndexes:@[]
+      openerNavigationIndexes:@[]
+                selectedIndex:NSNotFound];
+}
+
+#pragma mark - Public
+
+- (instancetype)initWithTabIDs:(NSArray<NSString*>*)tabIDs
+                  openerIndexes:(NSArray<NSNumber*>*)openerIndexes
+        openerNavigationIndexes:(NSArray<NSNumber*>*)openerNavigationIndexes
+                  selectedIndex:(NSUInteger)selectedIndex {
+  DCHECK(tabIDs);
+  DCHECK_EQ(tabIDs.count, openerIndexes.count);
+  DCHECK_EQ(tabIDs.count, openerNavigationIndexes.count);
+  DCHECK(IsIndexValidForTabCount(selectedIndex, tabIDs.count));
+  self = [super init];
+  if (self) {
+    _tabIDs = [tabIDs copy];
+    _openerIndexes = [openerIndexes copy];
+    _openerNavigationIndexes = [openerNavigationIndexes copy];
+    _selectedIndex = selectedIndex;
+  }
+  return self;
+}
+
+#pragma mark - NSCoding
+
+- (instancetype)initWithCoder:(NSCoder*)aDecoder {
+  NSUInteger selectedIndex = [aDecoder cr_decodeIndexForKey:kSelectedIndexKey];
+  NSArray<NSString*>* tabIDs = base::mac::ObjCCast<NSArray<NSString*>>(
+      [aDecoder decodeObjectForKey:kTabIDsKey]);
+  NSArray<NSNumber*>* openerIndexes = base::mac::ObjCCast<NSArray<NSNumber*>>(
+      [aDecoder decodeObjectForKey:kOpenerIndexesKey]);
+  NSArray<NSNumber*>* openerNavigationIndexes =
+      base::mac::ObjCCast<NSArray<NSNumber*>>(
+          [aDecoder decodeObjectForKey:kOpenerNavigationIndexesKey]);
+
+  if (!tabIDs)
+    tabIDs = @[];
+
+  // Drop the openers rather than the tabs if the manifest is inconsistent.
+  if (openerIndexes.count != tabIDs.count ||
+      openerNavigationIndexes.count != tabIDs.count) {
+    openerIndexes = NoOpeners(tabIDs.count);
+    openerNavigationIndexes = NoOpeners(tabIDs.count);
+  }
+
+  if (!IsIndexValidForTabCount(selectedIndex, tabIDs.count))
+    selectedIndex = tabIDs.count ? 0 : NSNotFound;
+
+  return [self initWithTabIDs:tabIDs
+                openerIndexes:openerIndexes
+      openerNavigationIndexes:openerNavigationIndexes
+                selectedIndex:selectedIndex];
+}
+
+- (void)encodeWithCoder:(NSCoder*)aCoder {
+  [aCoder cr_encodeIndex:_selectedIndex forKey:kSelectedIndexKey];
+  [aCoder encodeObject:_tabIDs forKey:kTabIDsKey];
+  [aCoder encodeObject:_openerIndexes forKey:kOpenerIndexesKey];
+  [aCoder encodeObject:_openerNavigationIndexes
+                forKey:kOpenerNavigationIndexesKey];
+}
+
+#pragma mark - Debugging
+
+- (NSString*)description {
+  return [NSString stringWithFormat:@"selected index: %" PRIuNS "\ntabs:\n%@\n",
+                                    _selectedIndex, _tabIDs];
+}
+
+@end
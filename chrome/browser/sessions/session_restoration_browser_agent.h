@@ -96,10 +96,15 @@ class SessionRestorationBrowserAgent
                            web::WebState* new_web_state,
                            int active_index,
                            ActiveWebStateChangeReason reason) override;
+  void WebStateListChangedInBatch(
+      WebStateList* web_state_list,
+      const WebStateListChangeSet& change_set) override;
 
   // web::WebStateObserver methods.
   void DidFinishNavigation(web::WebState* web_state,
                            web::NavigationContext* navigation_context) override;
+  void TitleWasSet(web::WebState* web_state) override;
+  void WebStateRealized(web::WebState* web_state) override;
 
   // The path to use for all session storage reads and writes. If multi-window
   // is enabled, the session ID for this agent is used to determine this path;
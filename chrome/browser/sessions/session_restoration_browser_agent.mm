@@ -4,13 +4,17 @@
 
 #include "ios/chrome/browser/sessions/session_restoration_browser_agent.h"
 
+#include "base/feature_list.h"
 #include "base/memory/ptr_util.h"
+#include "base/metrics/histogram_functions.h"
 #include "base/strings/sys_string_conversions.h"
+#include "base/timer/elapsed_timer.h"
 #include "components/favicon/ios/web_favicon_driver.h"
 #import "components/previous_session_info/previous_session_info.h"
 #include "ios/chrome/browser/browser_state/chrome_browser_state.h"
 #include "ios/chrome/browser/chrome_url_constants.h"
 #import "ios/chrome/browser/main/browser.h"
+#include "ios/chrome/browser/sessions/features.h"
 #import "ios/chrome/browser/sessions/session_ios.h"
 #import "ios/chrome/browser/sessions/session_ios_factory.h"
 #import "ios/chrome/browser/sessions/session_restoration_observer.h"
@@ -20,9 +24,9 @@
 #import "ios/chrome/browser/web/page_placeholder_tab_helper.h"
 #import "ios/chrome/browser/web_state_list/all_web_state_observation_forwarder.h"
 #import "ios/chrome/browser/web_state_list/web_state_list.h"
+#import "ios/chrome/browser/web_state_list/web_state_list_change_set.h"
 #import "ios/chrome/browser/web_state_list/web_state_list_serialization.h"
 #import "ios/chrome/browser/web_state_list/web_usage_enabler/web_usage_enabler_browser_agent.h"
-#include "ios/web/public/navigation/navigation_item.h"
 #import "ios/web/public/navigation/navigation_manager.h"
 #include "ios/web/public/security/certificate_policy_cache.h"
 #import "ios/web/public/session/serializable_user_data_manager.h"
@@ -64,7 +68,8 @@ SessionRestorationBrowserAgent::SessionRestorationBrowserAgent(
           std::make_unique<AllWebStateObservationForwarder>(web_state_list_,
                                                             this)) {
   browser->AddObserver(this);
-  web_state_list_->AddObserver(this);
+  // Batch operations, such as closing all the tabs, only need one save.
+  web_state_list_->AddCoalescingObserver(this);
 }
 
 SessionRestorationBrowserAgent::~SessionRestorationBrowserAgent() {
@@ -101,6 +106,12 @@ bool SessionRestorationBrowserAgent::RestoreSessionWindow(
   int old_count = web_state_list_->count();
   DCHECK_GE(old_count, 0);
 
+  // With lazy restoration only the active WebState is realized (when it is
+  // activated), the others keep their session until they are needed.
+  const bool lazy_restoration =
+      base::FeatureList::IsEnabled(kLazySessionRestoration);
+  base::ElapsedTimer restore_timer;
+
   web_state_list_->PerformBatchOperation(base::BindOnce(^(
       WebStateList* web_state_list) {
     // Don't trigger the initial load for these restored WebStates since the
@@ -111,11 +122,19 @@ bool SessionRestorationBrowserAgent::RestoreSessionWindow(
     web::WebState::CreateParams createParams(browser_state_);
     DeserializeWebStateList(
         web_state_list, window,
-        base::BindRepeating(&web::WebState::CreateWithStorageSession,
-                            createParams));
+        base::BindRepeating(
+            lazy_restoration
+                ? &web::WebState::CreateUnrealizedWithStorageSession
+                : &web::WebState::CreateWithStorageSession,
+            createParams));
     web_enabler_->SetTriggersInitialLoad(saved_triggers_initial_load);
   }));
 
+  // The active WebState is realized by now, whether the restoration is lazy
+  // or not.
+  base::UmaHistogramTimes("Session.WebStates.TimeToFirstActiveTab",
+                          restore_timer.Elapsed());
+
   DCHECK_GT(web_state_list_->count(), old_count);
   int restored_count = web_state_list_->count() - old_count;
   DCHECK_EQ(window.sessions.count, static_cast<NSUInteger>(restored_count));
@@ -128,18 +147,19 @@ bool SessionRestorationBrowserAgent::RestoreSessionWindow(
 
   for (int index = old_count; index < web_state_list_->count(); ++index) {
     web::WebState* web_state = web_state_list_->GetWebStateAt(index);
-    web::NavigationItem* visible_item =
-        web_state->GetNavigationManager()->GetVisibleItem();
+    // GetVisibleURL() does not realize unrealized WebStates.
+    const GURL& visible_url = web_state->GetVisibleURL();
 
-    if (!(visible_item &&
-          visible_item->GetVirtualURL() == kChromeUINewTabURL)) {
+    if (visible_url != kChromeUINewTabURL) {
       PagePlaceholderTabHelper::FromWebState(web_state)
           ->AddPlaceholderForNextNavigation();
     }
 
-    if (visible_item && visible_item->GetVirtualURL().is_valid()) {
+    // The favicon of unrealized WebStates is fetched once they are realized,
+    // as the favicon driver stores it in their navigation items.
+    if (web_state->IsRealized() && visible_url.is_valid()) {
       favicon::WebFaviconDriver::FromWebState(web_state)->FetchFavicon(
-          visible_item->GetVirtualURL(), /*is_same_document=*/false);
+          visible_url, /*is_same_document=*/false);
     }
 
     // Restore the CertificatePolicyCache (note that webState is invalid after
@@ -155,6 +175,7 @@ bool SessionRestorationBrowserAgent::RestoreSessionWindow(
   if (old_count == 1) {
     web::WebState* webState = web_state_list_->GetWebStateAt(0);
     bool hasPendingLoad =
+        webState->IsRealized() &&
         webState->GetNavigationManager()->GetPendingItem() != nullptr;
     if (!hasPendingLoad &&
         webState->GetLastCommittedURL() == kChromeUINewTabURL) {
@@ -199,6 +220,11 @@ void SessionRestorationBrowserAgent::SaveSession(bool immediately) {
   if (!CanSaveSession())
     return;
 
+  // The state of the active WebState, such as its scroll position, changes
+  // without notifications, so it is saved each time.
+  if (web::WebState* active_web_state = web_state_list_->GetActiveWebState())
+    [session_ios_factory_ markWebStateDirty:active_web_state];
+
   NSString* path = base::SysUTF8ToNSString(
       GetSessionStoragePath(/*force_single_window=*/false).AsUTF8Unsafe());
   [session_service_ saveSession:session_ios_factory_
@@ -235,6 +261,15 @@ void SessionRestorationBrowserAgent::WebStateActivatedAt(
     web::WebState* new_web_state,
     int active_index,
     ActiveWebStateChangeReason reason) {
+  // The state of the previously active WebState was last updated when it was
+  // hidden.
+  if (old_web_state)
+    [session_ios_factory_ markWebStateDirty:old_web_state];
+
+  // The active WebState is about to be displayed.
+  if (new_web_state)
+    new_web_state->ForceRealized();
+
   if (new_web_state && new_web_state->IsLoading())
     return;
 
@@ -242,6 +277,31 @@ void SessionRestorationBrowserAgent::WebStateActivatedAt(
   SaveSession(/*immediately=*/false);
 }
 
+void SessionRestorationBrowserAgent::WebStateListChangedInBatch(
+    WebStateList* web_state_list,
+    const WebStateListChangeSet& change_set) {
+  if (change_set.empty())
+    return;
+
+  // The WebStates inserted in the batch, including those which replaced
+  // others, need to be saved.
+  for (const WebStateListChangeSet::Range& range : change_set.inserted()) {
+    for (int index = range.index; index < range.index + range.count; ++index) {
+      [session_ios_factory_
+          markWebStateDirty:web_state_list->GetWebStateAt(index)];
+    }
+  }
+
+  web::WebState* active_web_state = web_state_list->GetActiveWebState();
+  if (active_web_state && change_set.active_web_state_changed())
+    active_web_state->ForceRealized();
+
+  if (active_web_state && active_web_state->IsLoading())
+    return;
+
+  SaveSession(/*immediately=*/false);
+}
+
 base::FilePath SessionRestorationBrowserAgent::GetSessionStoragePath(
     bool force_single_window) {
   base::FilePath path = browser_state_->GetStatePath();
@@ -260,5 +320,28 @@ void SessionRestorationBrowserAgent::DidFinishNavigation(
     web::WebState* web_state,
     web::NavigationContext* navigation_context) {
   // Save the session each time a navigation finishes.
+  [session_ios_factory_ markWebStateDirty:web_state];
+  SaveSession(/*immediately=*/false);
+}
+
+void SessionRestorationBrowserAgent::TitleWasSet(web::WebState* web_state) {
+  // The legacy storage archives every tab on each save, so the title is saved
+  // with the next state change. Saving it on its own is only cheap with the
+  // per-tab storage.
+  if (!base::FeatureList::IsEnabled(kSessionPerTabStorage))
+    return;
+
+  // The title is saved in the WebState's navigation items.
+  [session_ios_factory_ markWebStateDirty:web_state];
   SaveSession(/*immediately=*/false);
 }
+
+void SessionRestorationBrowserAgent::WebStateRealized(
+    web::WebState* web_state) {
+  // Only the WebStates restored lazily are realized after their creation.
+  const GURL& visible_url = web_state->GetVisibleURL();
+  if (visible_url.is_valid()) {
+    favicon::WebFaviconDriver::FromWebState(web_state)->FetchFavicon(
+        visible_url, /*is_same_document=*/false);
+  }
+}
@@ -7,8 +7,10 @@
 #include "base/files/file_path.h"
 #include "base/run_loop.h"
 #include "base/strings/sys_string_conversions.h"
+#include "base/test/scoped_feature_list.h"
 #include "ios/chrome/browser/browser_state/test_chrome_browser_state.h"
 #include "ios/chrome/browser/chrome_url_constants.h"
+#include "ios/chrome/browser/sessions/features.h"
 #import "ios/chrome/browser/main/browser.h"
 #import "ios/chrome/browser/main/browser_web_state_list_delegate.h"
 #import "ios/chrome/browser/main/test_browser.h"
@@ -162,6 +164,25 @@ TEST_F(SessionRestorationBrowserAgentTest, RestoreSessionOnEmptyWebStateList) {
             web_state_list_->GetActiveWebState());
 }
 
+// Tests that the active WebState is realized when a session is restored lazily,
+// and that the other WebStates are realized when they are activated.
+TEST_F(SessionRestorationBrowserAgentTest, RestoreSessionLazily) {
+  base::test::ScopedFeatureList feature_list;
+  feature_list.InitAndEnableFeature(kLazySessionRestoration);
+
+  SessionWindowIOS* window(
+      CreateSessionWindow(/*sessions_count=*/5, /*selected_index=*/1));
+  session_restoration_agent_->RestoreSessionWindow(window);
+
+  ASSERT_EQ(5, web_state_list_->count());
+  EXPECT_EQ(web_state_list_->GetWebStateAt(1),
+            web_state_list_->GetActiveWebState());
+  EXPECT_TRUE(web_state_list_->GetActiveWebState()->IsRealized());
+
+  web_state_list_->ActivateWebStateAt(3);
+  EXPECT_TRUE(web_state_list_->GetWebStateAt(3)->IsRealized());
+}
+
 // Tests that restoring a session works correctly on non empty WebStatelist.
 TEST_F(SessionRestorationBrowserAgentTest,
        RestoreSessionWithNonEmptyWebStateList) {
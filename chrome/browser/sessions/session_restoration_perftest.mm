@@ -0,0 +1,120 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import <Foundation/Foundation.h>
+#include <mach/mach.h>
+
+#include "base/bind.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/timer/elapsed_timer.h"
+#import "ios/chrome/browser/sessions/session_window_ios.h"
+#import "ios/chrome/browser/web_state_list/fake_web_state_list_delegate.h"
+#import "ios/chrome/browser/web_state_list/web_state_list.h"
+#import "ios/chrome/browser/web_state_list/web_state_list_serialization.h"
+#include "ios/chrome/test/base/perf_test_ios.h"
+#import "ios/web/public/session/crw_navigation_item_storage.h"
+#import "ios/web/public/session/crw_session_storage.h"
+#include "ios/web/public/test/fakes/test_browser_state.h"
+#import "ios/web/public/web_state.h"
+#include "url/gurl.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace {
+
+// Number of navigation items of each tab.
+const int kItemCount = 5;
+
+// Returns a window of |tab_count| tabs, the last one being selected.
+SessionWindowIOS* CreateSyntheticWindow(int tab_count) {
+  NSMutableArray<CRWSessionStorage*>* sessions = [NSMutableArray array];
+  for (int i = 0; i < tab_count; i++) {
+    NSMutableArray<CRWNavigationItemStorage*>* items = [NSMutableArray array];
+    for (int j = 0; j < kItemCount; j++) {
+      CRWNavigationItemStorage* item = [[CRWNavigationItemStorage alloc] init];
+      item.URL = GURL("https://www.example.com/tab/" + base::NumberToString(i) +
+                      "/page/" + base::NumberToString(j));
+      item.virtualURL = item.URL;
+      item.title = base::ASCIIToUTF16("Page " + base::NumberToString(j));
+      [items addObject:item];
+    }
+    CRWSessionStorage* session_storage = [[CRWSessionStorage alloc] init];
+    session_storage.itemStorages = items;
+    session_storage.lastCommittedItemIndex = kItemCount - 1;
+    [sessions addObject:session_storage];
+  }
+  return [[SessionWindowIOS alloc] initWithSessions:sessions
+                                      selectedIndex:tab_count - 1];
+}
+
+// Returns the physical footprint of the process in bytes, or 0 on failure.
+uint64_t GetPhysicalFootprint() {
+  task_vm_info task_info_data;
+  mach_msg_type_number_t count = sizeof(task_vm_info) / sizeof(natural_t);
+  kern_return_t result =
+      task_info(mach_task_self(), TASK_VM_INFO,
+                reinterpret_cast<task_info_t>(&task_info_data), &count);
+  return result == KERN_SUCCESS ? task_info_data.phys_footprint : 0;
+}
+
+// Measures the restoration of sessions of various sizes, with all the
+// WebStates created eagerly or only the active one realized.
+class SessionRestorationPerfTest : public PerfTest {
+ protected:
+  SessionRestorationPerfTest() : PerfTest("Session restoration") {}
+
+  // Restores a session of |tab_count| tabs and logs the time it takes for the
+  // active tab to be ready, and the memory used by the restored tabs.
+  void MeasureRestoration(int tab_count, bool lazy) {
+    SessionWindowIOS* window = CreateSyntheticWindow(tab_count);
+    const std::string label = std::string(lazy ? "Lazy" : "Eager") + " " +
+                              base::NumberToString(tab_count) + " tabs";
+
+    FakeWebStateListDelegate delegate;
+    WebStateList web_state_list(&delegate);
+    web::WebState::CreateParams params(&browser_state_);
+    const uint64_t footprint_before = GetPhysicalFootprint();
+
+    base::ElapsedTimer timer;
+    DeserializeWebStateList(
+        &web_state_list, window,
+        base::BindRepeating(
+            lazy ? &web::WebState::CreateUnrealizedWithStorageSession
+                 : &web::WebState::CreateWithStorageSession,
+            params));
+    web_state_list.GetActiveWebState()->ForceRealized();
+    LogPerfTiming(label + " time to first active tab", timer.Elapsed());
+
+    const uint64_t footprint_after = GetPhysicalFootprint();
+    if (footprint_before && footprint_after > footprint_before) {
+      LogPerfValue(label + " memory after restore",
+                   (footprint_after - footprint_before) / 1024, "KB");
+    }
+
+    EXPECT_EQ(tab_count, web_state_list.count());
+    web_state_list.CloseAllWebStates(WebStateList::CLOSE_NO_FLAGS);
+  }
+
+  web::TestBrowserState browser_state_;
+};
+
+TEST_F(SessionRestorationPerfTest, Restore100Tabs) {
+  MeasureRestoration(100, /*lazy=*/false);
+  MeasureRestoration(100, /*lazy=*/true);
+}
+
+TEST_F(SessionRestorationPerfTest, Restore500Tabs) {
+  MeasureRestoration(500, /*lazy=*/false);
+  MeasureRestoration(500, /*lazy=*/true);
+}
+
+TEST_F(SessionRestorationPerfTest, Restore1000Tabs) {
+  MeasureRestoration(1000, /*lazy=*/false);
+  MeasureRestoration(1000, /*lazy=*/true);
+}
+
+}  // namespace
@@ -65,6 +65,11 @@ NSString* const kSessionsDirectory = @"Sessions";
 // Returns the path of the session file for |directory|.
 + (NSString*)sessionPathForDirectory:(NSString*)directory;
 
+// Returns the path of the directory holding the sessions of the tabs, when the
+// session file at |sessionPath| is the manifest of a session saved with one
+// file per tab.
++ (NSString*)tabSessionsDirectoryForSessionPath:(NSString*)sessionPath;
+
 @end
 
 @interface SessionServiceIOS (SubClassing)
@@ -6,8 +6,11 @@
 
 #import <UIKit/UIKit.h>
 
+#include <vector>
+
 #include "base/bind.h"
 #include "base/callback_helpers.h"
+#include "base/feature_list.h"
 #include "base/files/file_path.h"
 #include "base/format_macros.h"
 #include "base/location.h"
@@ -22,8 +25,11 @@
 #include "base/task/thread_pool.h"
 #include "base/threading/scoped_blocking_call.h"
 #include "base/time/time.h"
+#include "ios/chrome/browser/sessions/features.h"
 #import "ios/chrome/browser/sessions/session_ios.h"
+#import "ios/chrome/browser/sessions/session_ios_binary_coding.h"
 #import "ios/chrome/browser/sessions/session_ios_factory.h"
+#import "ios/chrome/browser/sessions/session_manifest_ios.h"
 #import "ios/chrome/browser/sessions/session_window_ios.h"
 #import "ios/web/public/session/crw_navigation_item_storage.h"
 #import "ios/web/public/session/crw_session_certificate_policy_cache_storage.h"
@@ -50,6 +56,9 @@ NSString* const kSessionDirectory =
                   // contain all sessions directories.
 NSString* const kSessionFileName =
     @"session.plist";  // The session file name on disk.
+NSString* const kTabSessionsDirectory =
+    @"TabSessions";  // The directory name next to the session file which
+                     // contains the session files of the tabs.
 }
 
 @implementation NSKeyedUnarchiver (CrLegacySessionCompatibility)
@@ -69,6 +78,10 @@ NSString* const kSessionFileName =
   // Maps session path to the pending session factories for the delayed save
   // behaviour. SessionIOSFactory pointers are weak.
   NSMapTable<NSString*, SessionIOSFactory*>* _pendingSessions;
+
+  // The paths of the sessions loaded from a manifest, whose session files of
+  // the tabs must be deleted once they are saved in the legacy format.
+  NSMutableSet<NSString*>* _sessionPathsToMigrate;
 }
 
 #pragma mark - NSObject overrides
@@ -97,6 +110,7 @@ NSString* const kSessionFileName =
   self = [super init];
   if (self) {
     _pendingSessions = [NSMapTable strongToWeakObjectsMapTable];
+    _sessionPathsToMigrate = [NSMutableSet set];
     _taskRunner = taskRunner;
   }
   return self;
@@ -136,6 +150,16 @@ NSString* const kSessionFileName =
     if (!data)
       return nil;
 
+    // Sessions saved in the binary format are loaded even if the feature was
+    // disabled since, and sessions saved with NSKeyedArchiver are migrated by
+    // the next save.
+    if (session_binary_coding::IsBinarySessionData(data)) {
+      SessionIOS* session = session_binary_coding::DecodeSession(data);
+      DLOG_IF(WARNING, !session) << "Error decoding session file: "
+                                 << base::SysNSStringToUTF8(sessionPath);
+      return session;
+    }
+
     NSError* error = nil;
     NSKeyedUnarchiver* unarchiver =
         [[NSKeyedUnarchiver alloc] initForReadingFromData:data error:&error];
@@ -160,6 +184,18 @@ NSString* const kSessionFileName =
   if (!rootObject)
     return nil;
 
+  // Sessions saved with one file per tab are loaded even if the feature was
+  // disabled since.
+  if ([rootObject isKindOfClass:[SessionManifestIOS class]]) {
+    SessionManifestIOS* manifest =
+        base::mac::ObjCCastStrict<SessionManifestIOS>(rootObject);
+    NSString* tabsDirectory =
+        [[self class] tabSessionsDirectoryForSessionPath:sessionPath];
+    if (!base::FeatureList::IsEnabled(kSessionPerTabStorage))
+      [_sessionPathsToMigrate addObject:sessionPath];
+    return [self loadSessionWithManifest:manifest tabsDirectory:tabsDirectory];
+  }
+
   // Support for legacy saved session that contained a single SessionWindowIOS
   // object as the root object (pre-M-59).
   if ([rootObject isKindOfClass:[SessionWindowIOS class]]) {
@@ -193,6 +229,13 @@ NSString* const kSessionFileName =
     [sessionFilesPaths
         addObject:[[self class] sessionPathForDirectory:directory]];
 
+  // Also delete the session files of the tabs, if any.
+  for (NSString* sessionPath in [sessionFilesPaths copy]) {
+    [sessionFilesPaths addObject:[[self class]
+                                     tabSessionsDirectoryForSessionPath:
+                                         sessionPath]];
+  }
+
   [self deletePaths:sessionFilesPaths completion:std::move(callback)];
 }
 
@@ -213,6 +256,11 @@ NSString* const kSessionFileName =
   return [directory stringByAppendingPathComponent:kSessionFileName];
 }
 
++ (NSString*)tabSessionsDirectoryForSessionPath:(NSString*)sessionPath {
+  return [[sessionPath stringByDeletingLastPathComponent]
+      stringByAppendingPathComponent:kTabSessionsDirectory];
+}
+
 + (NSString*)sessionPathForSessionID:(NSString*)sessionID
                            directory:(NSString*)directory {
   if (!sessionID)
@@ -224,6 +272,70 @@ NSString* const kSessionFileName =
 
 #pragma mark - Private methods
 
+// Returns the session described by |manifest|, reading the sessions of the
+// tabs from |tabsDirectory|. The tabs whose session can't be read are dropped.
+- (SessionIOS*)loadSessionWithManifest:(SessionManifestIOS*)manifest
+                         tabsDirectory:(NSString*)tabsDirectory {
+  const NSUInteger tabCount = manifest.tabIDs.count;
+  NSMutableArray<CRWSessionStorage*>* sessions =
+      [NSMutableArray arrayWithCapacity:tabCount];
+  // The index in |sessions| of each tab of the manifest, or -1 if the tab was
+  // dropped.
+  std::vector<int> sessionIndexes(tabCount, -1);
+  NSUInteger selectedIndex = NSNotFound;
+  for (NSUInteger index = 0; index < tabCount; ++index) {
+    NSString* tabPath =
+        [tabsDirectory stringByAppendingPathComponent:manifest.tabIDs[index]];
+    NSData* data = [NSData dataWithContentsOfFile:tabPath];
+    CRWSessionStorage* session =
+        data ? session_binary_coding::DecodeSessionStorage(
+                   static_cast<const char*>(data.bytes), data.length)
+             : nil;
+    if (!session) {
+      DLOG(WARNING) << "Error loading tab session file: "
+                    << base::SysNSStringToUTF8(tabPath);
+      continue;
+    }
+    if (index == manifest.selectedIndex)
+      selectedIndex = sessions.count;
+    sessionIndexes[index] = static_cast<int>(sessions.count);
+    [sessions addObject:session];
+  }
+
+  DLOG_IF(WARNING, sessions.count != tabCount)
+      << "Session restored with missing tabs: "
+      << base::SysNSStringToUTF8(tabsDirectory);
+
+  // Map the openers of the manifest to the loaded sessions. The tabs whose
+  // opener was dropped have no opener.
+  NSMutableArray<NSNumber*>* openerIndexes =
+      [NSMutableArray arrayWithCapacity:sessions.count];
+  NSMutableArray<NSNumber*>* openerNavigationIndexes =
+      [NSMutableArray arrayWithCapacity:sessions.count];
+  for (NSUInteger index = 0; index < tabCount; ++index) {
+    if (sessionIndexes[index] == -1)
+      continue;
+    const int openerIndex = [manifest.openerIndexes[index] intValue];
+    if (openerIndex < 0 || static_cast<NSUInteger>(openerIndex) >= tabCount ||
+        sessionIndexes[openerIndex] == -1) {
+      [openerIndexes addObject:@(-1)];
+      [openerNavigationIndexes addObject:@(-1)];
+      continue;
+    }
+    [openerIndexes addObject:@(sessionIndexes[openerIndex])];
+    [openerNavigationIndexes addObject:manifest.openerNavigationIndexes[index]];
+  }
+
+  if (sessions.count && selectedIndex == NSNotFound)
+    selectedIndex = 0;
+  SessionWindowIOS* window =
+      [[SessionWindowIOS alloc] initWithSessions:sessions
+                                   selectedIndex:selectedIndex
+                                   openerIndexes:openerIndexes
+                         openerNavigationIndexes:openerNavigationIndexes];
+  return [[SessionIOS alloc] initWithWindows:@[ window ]];
+}
+
 // Delete files/folders of the given |paths|.
 - (void)deletePaths:(NSArray<NSString*>*)paths
          completion:(base::OnceClosure)callback {
@@ -255,6 +367,11 @@ NSString* const kSessionFileName =
   // non-threadsafe objects on a background thread.
   SessionIOSFactory* factory = [_pendingSessions objectForKey:sessionPath];
   [_pendingSessions removeObjectForKey:sessionPath];
+  if (base::FeatureList::IsEnabled(kSessionPerTabStorage)) {
+    [self performIncrementalSaveOfFactory:factory sessionPath:sessionPath];
+    return;
+  }
+
   SessionIOS* session = [factory sessionForSaving];
   // Because the factory may be called asynchronously after the underlying
   // web state list is destroyed, the session may be nil; if so, do nothing.
@@ -264,9 +381,14 @@ NSString* const kSessionFileName =
   @try {
     NSError* error = nil;
     size_t previous_cert_policy_bytes = web::GetCertPolicyBytesEncoded();
-    NSData* sessionData = [NSKeyedArchiver archivedDataWithRootObject:session
-                                                requiringSecureCoding:NO
-                                                                error:&error];
+    NSData* sessionData = nil;
+    if (base::FeatureList::IsEnabled(kSessionBinaryFormat)) {
+      sessionData = session_binary_coding::EncodeSession(session);
+    } else {
+      sessionData = [NSKeyedArchiver archivedDataWithRootObject:session
+                                          requiringSecureCoding:NO
+                                                          error:&error];
+    }
     if (!sessionData || error) {
       DLOG(WARNING) << "Error serializing session for path: "
                     << base::SysNSStringToUTF8(sessionPath) << ": "
@@ -281,9 +403,19 @@ NSString* const kSessionFileName =
     base::UmaHistogramCounts100000("Session.WebStates.SerializedSize",
                                    sessionData.length / 1024);
 
+    // The session files of the tabs are no longer referenced once a session
+    // loaded from a manifest is saved in the legacy format.
+    NSString* tabsDirectory = nil;
+    if ([_sessionPathsToMigrate containsObject:sessionPath]) {
+      [_sessionPathsToMigrate removeObject:sessionPath];
+      tabsDirectory =
+          [[self class] tabSessionsDirectoryForSessionPath:sessionPath];
+    }
     _taskRunner->PostTask(FROM_HERE, base::BindOnce(^{
                             [self performSaveSessionData:sessionData
                                              sessionPath:sessionPath];
+                            if (tabsDirectory)
+                              [self deletePathIfExists:tabsDirectory];
                           }));
   } @catch (NSException* exception) {
     NOTREACHED() << "Error serializing session for path: "
@@ -293,6 +425,122 @@ NSString* const kSessionFileName =
   }
 }
 
+// Saves the manifest of the session returned by |factory| to |sessionPath|,
+// and the sessions of its tabs which changed since the previous save next to
+// it. Only those tabs are serialized.
+- (void)performIncrementalSaveOfFactory:(SessionIOSFactory*)factory
+                            sessionPath:(NSString*)sessionPath {
+  NSDictionary<NSString*, CRWSessionStorage*>* dirtySessions = nil;
+  NSArray<NSString*>* removedTabIDs = nil;
+  SessionManifestIOS* manifest =
+      [factory manifestForSavingWithDirtySessions:&dirtySessions
+                                    removedTabIDs:&removedTabIDs];
+  // Because the factory may be called asynchronously after the underlying
+  // web state list is destroyed, the manifest may be nil; if so, do nothing.
+  if (!manifest)
+    return;
+
+  NSMutableDictionary<NSString*, NSData*>* tabsData =
+      [NSMutableDictionary dictionaryWithCapacity:dirtySessions.count];
+  for (NSString* tabID in dirtySessions) {
+    tabsData[tabID] =
+        session_binary_coding::EncodeSessionStorage(dirtySessions[tabID]);
+  }
+
+  NSError* error = nil;
+  NSData* manifestData = [NSKeyedArchiver archivedDataWithRootObject:manifest
+                                               requiringSecureCoding:NO
+                                                               error:&error];
+  if (!manifestData || error) {
+    DLOG(WARNING) << "Error serializing session manifest for path: "
+                  << base::SysNSStringToUTF8(sessionPath) << ": "
+                  << base::SysNSStringToUTF8([error description]);
+    return;
+  }
+
+  NSArray<NSString*>* tabIDs = manifest.tabIDs;
+  _taskRunner->PostTask(FROM_HERE, base::BindOnce(^{
+                          [self performSaveTabsData:tabsData
+                                             tabIDs:tabIDs
+                                      removedTabIDs:removedTabIDs
+                                       manifestData:manifestData
+                                        sessionPath:sessionPath];
+                        }));
+}
+
+// Writes the sessions of the tabs in |tabsData| then the manifest of the
+// session, and deletes the session files of the closed tabs. If
+// |removedTabIDs| is nil, the closed tabs are found from the manifest being
+// replaced.
+- (void)performSaveTabsData:(NSDictionary<NSString*, NSData*>*)tabsData
+                     tabIDs:(NSArray<NSString*>*)tabIDs
+              removedTabIDs:(NSArray<NSString*>*)removedTabIDs
+               manifestData:(NSData*)manifestData
+                sessionPath:(NSString*)sessionPath {
+  base::ScopedBlockingCall scoped_blocking_call(FROM_HERE,
+                                                base::BlockingType::MAY_BLOCK);
+
+  NSString* tabsDirectory =
+      [[self class] tabSessionsDirectoryForSessionPath:sessionPath];
+
+  // Write the sessions of the tabs first, so that the manifest never
+  // references a missing file.
+  for (NSString* tabID in tabsData) {
+    [self performSaveSessionData:tabsData[tabID]
+                     sessionPath:[tabsDirectory
+                                     stringByAppendingPathComponent:tabID]];
+  }
+
+  if (!removedTabIDs) {
+    NSSet<NSString*>* liveTabIDs = [NSSet setWithArray:tabIDs];
+    NSMutableArray<NSString*>* staleTabIDs = [NSMutableArray array];
+    for (NSString* tabID in [self savedManifestAtPath:sessionPath].tabIDs) {
+      if (![liveTabIDs containsObject:tabID])
+        [staleTabIDs addObject:tabID];
+    }
+    removedTabIDs = staleTabIDs;
+  }
+
+  [self performSaveSessionData:manifestData sessionPath:sessionPath];
+
+  for (NSString* tabID in removedTabIDs) {
+    [self deletePathIfExists:[tabsDirectory
+                                 stringByAppendingPathComponent:tabID]];
+  }
+}
+
+// Returns the manifest saved at |sessionPath|, or nil if the session at
+// |sessionPath| was not saved per tab. Must be called on the task runner.
+- (SessionManifestIOS*)savedManifestAtPath:(NSString*)sessionPath {
+  NSData* data = [NSData dataWithContentsOfFile:sessionPath];
+  if (!data || session_binary_coding::IsBinarySessionData(data))
+    return nil;
+
+  NSKeyedUnarchiver* unarchiver =
+      [[NSKeyedUnarchiver alloc] initForReadingFromData:data error:nil];
+  unarchiver.requiresSecureCoding = NO;
+  @try {
+    return base::mac::ObjCCast<SessionManifestIOS>(
+        [unarchiver decodeObjectForKey:kRootObjectKey]);
+  } @catch (NSException* exception) {
+    return nil;
+  }
+}
+
+// Deletes the file or directory at |path| if it exists. Must be called on the
+// task runner.
+- (void)deletePathIfExists:(NSString*)path {
+  NSFileManager* fileManager = [NSFileManager defaultManager];
+  if (![fileManager fileExistsAtPath:path])
+    return;
+
+  NSError* error = nil;
+  if (![fileManager removeItemAtPath:path error:&error]) {
+    DLOG(WARNING) << "Error deleting path: " << base::SysNSStringToUTF8(path)
+                  << ": " << base::SysNSStringToUTF8([error description]);
+  }
+}
+
 @end
 
 @implementation SessionServiceIOS (SubClassing)
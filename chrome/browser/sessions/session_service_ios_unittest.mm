@@ -6,6 +6,7 @@
 
 #include <memory>
 
+#include "base/bind.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
 #include "base/files/scoped_temp_dir.h"
@@ -14,15 +15,19 @@
 #include "base/sequenced_task_runner.h"
 #include "base/strings/sys_string_conversions.h"
 #import "base/test/ios/wait_util.h"
+#include "base/test/scoped_feature_list.h"
 #include "base/test/task_environment.h"
 #include "base/threading/thread_task_runner_handle.h"
 #include "ios/chrome/browser/chrome_paths.h"
+#include "ios/chrome/browser/sessions/features.h"
 #import "ios/chrome/browser/sessions/session_ios.h"
+#import "ios/chrome/browser/sessions/session_ios_binary_coding.h"
 #import "ios/chrome/browser/sessions/session_ios_factory.h"
 #import "ios/chrome/browser/sessions/session_service_ios.h"
 #import "ios/chrome/browser/sessions/session_window_ios.h"
 #import "ios/chrome/browser/web_state_list/fake_web_state_list_delegate.h"
 #import "ios/chrome/browser/web_state_list/web_state_list.h"
+#import "ios/chrome/browser/web_state_list/web_state_list_serialization.h"
 #import "ios/chrome/browser/web_state_list/web_state_opener.h"
 #import "ios/web/public/session/crw_session_storage.h"
 #import "ios/web/public/test/fakes/test_web_state.h"
@@ -218,6 +223,143 @@ TEST_F(SessionServiceTest, LoadSessionFromPath) {
   EXPECT_EQ(0u, session.sessionWindows[0].selectedIndex);
 }
 
+// Tests that sessions are saved in the binary format when the feature is
+// enabled, and that sessions saved with NSKeyedArchiver are migrated.
+TEST_F(SessionServiceTest, MigrateToBinarySession) {
+  std::unique_ptr<WebStateList> web_state_list = CreateWebStateList(2);
+  SessionIOSFactory* factory =
+      [[SessionIOSFactory alloc] initWithWebStateList:web_state_list.get()];
+  NSString* session_path =
+      [SessionServiceIOS sessionPathForDirectory:directory()];
+
+  {
+    base::test::ScopedFeatureList feature_list;
+    feature_list.InitAndDisableFeature(kSessionBinaryFormat);
+    [session_service() saveSession:factory
+                         directory:directory()
+                       immediately:YES];
+    base::RunLoop().RunUntilIdle();
+  }
+  EXPECT_FALSE(session_binary_coding::IsBinarySessionData(
+      [NSData dataWithContentsOfFile:session_path]));
+
+  {
+    base::test::ScopedFeatureList feature_list;
+    feature_list.InitAndEnableFeature(kSessionBinaryFormat);
+    SessionIOS* session =
+        [session_service() loadSessionFromDirectory:directory()];
+    EXPECT_EQ(2u, session.sessionWindows[0].sessions.count);
+
+    [session_service() saveSession:factory
+                         directory:directory()
+                       immediately:YES];
+    base::RunLoop().RunUntilIdle();
+  }
+  EXPECT_TRUE(session_binary_coding::IsBinarySessionData(
+      [NSData dataWithContentsOfFile:session_path]));
+
+  // The binary session is loaded even if the feature is disabled.
+  base::test::ScopedFeatureList feature_list;
+  feature_list.InitAndDisableFeature(kSessionBinaryFormat);
+  SessionIOS* session =
+      [session_service() loadSessionFromDirectory:directory()];
+  EXPECT_EQ(1u, session.sessionWindows.count);
+  EXPECT_EQ(2u, session.sessionWindows[0].sessions.count);
+  EXPECT_EQ(0u, session.sessionWindows[0].selectedIndex);
+}
+
+// Tests that a session saved per tab is loaded with its tabs, active index and
+// openers.
+TEST_F(SessionServiceTest, SaveAndLoadPerTabSession) {
+  base::test::ScopedFeatureList feature_list;
+  feature_list.InitAndEnableFeature(kSessionPerTabStorage);
+
+  std::unique_ptr<WebStateList> web_state_list = CreateWebStateList(3);
+  web_state_list->SetOpenerOfWebStateAt(
+      2, WebStateOpener(web_state_list->GetWebStateAt(0), 1));
+  web_state_list->ActivateWebStateAt(1);
+  SessionIOSFactory* factory =
+      [[SessionIOSFactory alloc] initWithWebStateList:web_state_list.get()];
+  [session_service() saveSession:factory directory:directory() immediately:YES];
+  base::RunLoop().RunUntilIdle();
+
+  NSString* tabs_directory = [SessionServiceIOS
+      tabSessionsDirectoryForSessionPath:[SessionServiceIOS
+                                             sessionPathForDirectory:
+                                                 directory()]];
+  NSArray* tab_files =
+      [[NSFileManager defaultManager] contentsOfDirectoryAtPath:tabs_directory
+                                                          error:nil];
+  EXPECT_EQ(3u, tab_files.count);
+
+  SessionIOS* session =
+      [session_service() loadSessionFromDirectory:directory()];
+  ASSERT_EQ(1u, session.sessionWindows.count);
+  SessionWindowIOS* session_window = session.sessionWindows[0];
+  EXPECT_EQ(3u, session_window.sessions.count);
+  EXPECT_EQ(1u, session_window.selectedIndex);
+
+  std::unique_ptr<WebStateList> restored_web_state_list =
+      CreateWebStateList(0);
+  DeserializeWebStateList(
+      restored_web_state_list.get(), session_window,
+      base::BindRepeating(^std::unique_ptr<web::WebState>(CRWSessionStorage*) {
+        return std::make_unique<web::TestWebState>();
+      }));
+  ASSERT_EQ(3, restored_web_state_list->count());
+  EXPECT_EQ(1, restored_web_state_list->active_index());
+
+  // The openers are restored from the manifest.
+  WebStateOpener opener = restored_web_state_list->GetOpenerOfWebStateAt(2);
+  EXPECT_EQ(restored_web_state_list->GetWebStateAt(0), opener.opener);
+  EXPECT_EQ(1, opener.navigation_index);
+  EXPECT_FALSE(restored_web_state_list->GetOpenerOfWebStateAt(1).opener);
+}
+
+// Tests that only the tabs which changed are written when a session is saved
+// per tab, and that the files of the closed tabs are deleted.
+TEST_F(SessionServiceTest, PerTabSessionWritesChangedTabs) {
+  base::test::ScopedFeatureList feature_list;
+  feature_list.InitAndEnableFeature(kSessionPerTabStorage);
+
+  std::unique_ptr<WebStateList> web_state_list = CreateWebStateList(3);
+  SessionIOSFactory* factory =
+      [[SessionIOSFactory alloc] initWithWebStateList:web_state_list.get()];
+  [session_service() saveSession:factory directory:directory() immediately:YES];
+  base::RunLoop().RunUntilIdle();
+
+  NSString* tabs_directory = [SessionServiceIOS
+      tabSessionsDirectoryForSessionPath:[SessionServiceIOS
+                                             sessionPathForDirectory:
+                                                 directory()]];
+  auto tab_path = [&](int index) {
+    return [tabs_directory
+        stringByAppendingPathComponent:GetTabIdOfWebState(
+                                           web_state_list->GetWebStateAt(
+                                               index))];
+  };
+
+  // Delete the files of the first two tabs, then only mark the second one as
+  // changed. Only its file is written again.
+  NSFileManager* file_manager = [NSFileManager defaultManager];
+  ASSERT_TRUE([file_manager removeItemAtPath:tab_path(0) error:nil]);
+  ASSERT_TRUE([file_manager removeItemAtPath:tab_path(1) error:nil]);
+  [factory markWebStateDirty:web_state_list->GetWebStateAt(1)];
+  [session_service() saveSession:factory directory:directory() immediately:YES];
+  base::RunLoop().RunUntilIdle();
+  EXPECT_FALSE([file_manager fileExistsAtPath:tab_path(0)]);
+  EXPECT_TRUE([file_manager fileExistsAtPath:tab_path(1)]);
+  EXPECT_TRUE([file_manager fileExistsAtPath:tab_path(2)]);
+
+  // Closing a tab deletes its file.
+  NSString* closed_tab_path = tab_path(2);
+  web_state_list->CloseWebStateAt(2, WebStateList::CLOSE_NO_FLAGS);
+  [session_service() saveSession:factory directory:directory() immediately:YES];
+  base::RunLoop().RunUntilIdle();
+  EXPECT_FALSE([file_manager fileExistsAtPath:closed_tab_path]);
+  EXPECT_TRUE([file_manager fileExistsAtPath:tab_path(1)]);
+}
+
 TEST_F(SessionServiceTest, LoadCorruptedSession) {
   NSString* session_path =
       SessionPathForTestData(FILE_PATH_LITERAL("corrupted.plist"));
@@ -16,7 +16,16 @@
 // the |sessions| and |selectedIndex| properties. |selectedIndex| must be a
 // valid indice in |sessions| or NSNotFound if |sessions| is empty.
 - (instancetype)initWithSessions:(NSArray<CRWSessionStorage*>*)sessions
-                   selectedIndex:(NSUInteger)selectedIndex
+                   selectedIndex:(NSUInteger)selectedIndex;
+
+// Initializes SessionsWindowIOS whose openers are |openerIndexes| and
+// |openerNavigationIndexes| rather than the values saved in the user data of
+// |sessions|. Both must have one entry per session, -1 meaning that the session
+// has no opener, or be nil.
+- (instancetype)initWithSessions:(NSArray<CRWSessionStorage*>*)sessions
+                      selectedIndex:(NSUInteger)selectedIndex
+                      openerIndexes:(NSArray<NSNumber*>*)openerIndexes
+            openerNavigationIndexes:(NSArray<NSNumber*>*)openerNavigationIndexes
     NS_DESIGNATED_INITIALIZER;
 
 // The serialized session objects. May be empty but never nil.
@@ -26,6 +35,12 @@
 // no sessions; otherwise a valid index in |sessions|.
 @property(nonatomic, readonly) NSUInteger selectedIndex;
 
+// The index of the opener of each session and its navigation index, -1 meaning
+// that the session has no opener. nil if the openers are saved in the user data
+// of the sessions. Not encoded.
+@property(nonatomic, readonly) NSArray<NSNumber*>* openerIndexes;
+@property(nonatomic, readonly) NSArray<NSNumber*>* openerNavigationIndexes;
+
 @end
 
 #endif  // IOS_CHROME_BROWSER_SESSIONS_SESSION_WINDOW_IOS_H_
@@ -4,7 +4,7 @@
 
 #import "ios/chrome/browser/sessions/session_window_ios.h"
 
-#include "base/check.h"
+#include "base/check_op.h"
 #include "base/format_macros.h"
 #import "base/mac/foundation_util.h"
 #import "ios/chrome/browser/sessions/NSCoder+Compatibility.h"
@@ -39,12 +39,29 @@ BOOL IsIndexValidForSessionCount(NSUInteger index, NSUInteger session_count) {
 
 - (instancetype)initWithSessions:(NSArray<CRWSessionStorage*>*)sessions
                    selectedIndex:(NSUInteger)selectedIndex {
+  return [self initWithSessions:sessions
+                  selectedIndex:selectedIndex
+                  openerIndexes:nil
+        openerNavigationIndexes:nil];
+}
+
+- (instancetype)initWithSessions:(NSArray<CRWSessionStorage*>*)sessions
+                      selectedIndex:(NSUInteger)selectedIndex
+                      openerIndexes:(NSArray<NSNumber*>*)openerIndexes
+            openerNavigationIndexes:
+                (NSArray<NSNumber*>*)openerNavigationIndexes {
   DCHECK(sessions);
   DCHECK(IsIndexValidForSessionCount(selectedIndex, [sessions count]));
+  DCHECK(!openerIndexes || openerIndexes.count == sessions.count);
+  DCHECK_EQ(!openerIndexes, !openerNavigationIndexes);
+  DCHECK(!openerNavigationIndexes ||
+         openerNavigationIndexes.count == sessions.count);
   self = [super init];
   if (self) {
     _sessions = [sessions copy];
     _selectedIndex = selectedIndex;
+    _openerIndexes = [openerIndexes copy];
+    _openerNavigationIndexes = [openerNavigationIndexes copy];
   }
   return self;
 }
@@ -0,0 +1,43 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef IOS_CHROME_BROWSER_SNAPSHOTS_FEATURES_H_
+#define IOS_CHROME_BROWSER_SNAPSHOTS_FEATURES_H_
+
+#include "base/feature_list.h"
+#include "base/metrics/field_trial_params.h"
+
+// Feature flag to limit the in-memory snapshot cache by the decoded size of
+// the snapshots instead of their number.
+extern const base::Feature kSnapshotCacheByteBudget;
+
+// The byte budget of the in-memory snapshot cache, in megabytes, when
+// kSnapshotCacheByteBudget is enabled.
+extern const base::FeatureParam<int> kSnapshotCacheByteBudgetMB;
+
+// Feature flag to limit the size of the snapshots on disk, evicting the least
+// recently updated ones when the cache is purged.
+extern const base::Feature kSnapshotCacheDiskBudget;
+
+// The disk budget of the snapshot cache, in megabytes, when
+// kSnapshotCacheDiskBudget is enabled.
+extern const base::FeatureParam<int> kSnapshotCacheDiskBudgetMB;
+
+// Feature flag to store the snapshots as a compressed image plus a downscaled
+// thumbnail, without the greyscale copy, and to decode them in parallel.
+extern const base::Feature kSnapshotThumbnails;
+
+// The JPEG quality of the stored snapshots and thumbnails, between 0 and 1,
+// when kSnapshotThumbnails is enabled.
+extern const base::FeatureParam<double> kSnapshotThumbnailsJPEGQuality;
+
+// The maximum width or height of the thumbnails, in pixels, when
+// kSnapshotThumbnails is enabled.
+extern const base::FeatureParam<int> kSnapshotThumbnailsMaxPixelSize;
+
+// The byte budget of the in-memory thumbnail cache, in megabytes, when
+// kSnapshotThumbnails is enabled.
+extern const base::FeatureParam<int> kSnapshotThumbnailsByteBudgetMB;
+
+#endif  // IOS_CHROME_BROWSER_SNAPSHOTS_FEATURES_H_
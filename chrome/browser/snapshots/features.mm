@@ -0,0 +1,33 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ios/chrome/browser/snapshots/features.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+const base::Feature kSnapshotCacheByteBudget{"SnapshotCacheByteBudget",
+                                             base::FEATURE_DISABLED_BY_DEFAULT};
+
+const base::FeatureParam<int> kSnapshotCacheByteBudgetMB{
+    &kSnapshotCacheByteBudget, "budget_mb", 32};
+
+const base::Feature kSnapshotCacheDiskBudget{"SnapshotCacheDiskBudget",
+                                             base::FEATURE_DISABLED_BY_DEFAULT};
+
+const base::FeatureParam<int> kSnapshotCacheDiskBudgetMB{
+    &kSnapshotCacheDiskBudget, "disk_budget_mb", 100};
+
+const base::Feature kSnapshotThumbnails{"SnapshotThumbnails",
+                                        base::FEATURE_DISABLED_BY_DEFAULT};
+
+const base::FeatureParam<double> kSnapshotThumbnailsJPEGQuality{
+    &kSnapshotThumbnails, "jpeg_quality", 0.7};
+
+const base::FeatureParam<int> kSnapshotThumbnailsMaxPixelSize{
+    &kSnapshotThumbnails, "thumbnail_max_pixel_size", 600};
+
+const base::FeatureParam<int> kSnapshotThumbnailsByteBudgetMB{
+    &kSnapshotThumbnails, "thumbnail_budget_mb", 24};
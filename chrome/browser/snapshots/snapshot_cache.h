@@ -14,6 +14,20 @@ class Time;
 
 @protocol SnapshotCacheObserver;
 
+// Statistics of the in-memory cache of color snapshots since the creation of
+// the SnapshotCache.
+struct SnapshotCacheMemoryStatistics {
+  // Number of lookups that found, or did not find, the snapshot in memory.
+  NSUInteger hit_count = 0;
+  NSUInteger miss_count = 0;
+  // Number of snapshots evicted to respect the cache limits or on low memory.
+  NSUInteger eviction_count = 0;
+  // Decoded size of the snapshots held in memory, and the maximum allowed (0
+  // if the cache is limited by its number of snapshots instead).
+  NSUInteger total_bytes = 0;
+  NSUInteger byte_budget = 0;
+};
+
 // A class providing an in-memory and on-disk cache of tab snapshots.
 // A snapshot is a full-screen image of the contents of the page at the current
 // scroll offset and zoom level, used to stand in for the WKWebView if it has
@@ -25,6 +39,10 @@ class Time;
 // |UIApplicationDidBecomeActiveNotification|.
 @property(nonatomic, strong) NSSet* pinnedIDs;
 
+// Snapshot ID of the visible tab. Like the pinned snapshots, it is not evicted
+// from disk to respect the disk budget.
+@property(nonatomic, copy) NSString* visibleID;
+
 // Designated initializer. |storagePath| is the file path where all images
 // managed by this SnapshotCache is stored. |storagePath| is not guaranteed to
 // exist. The contents of |storagePath| are entirely managed by this
@@ -43,6 +61,13 @@ class Time;
 - (void)retrieveImageForSnapshotID:(NSString*)snapshotID
                           callback:(void (^)(UIImage*))callback;
 
+// Retrieve a downscaled snapshot for |snapshotID|, suitable for the tab grid,
+// and return it via the callback. Falls back to the full snapshot if there is
+// no thumbnail, which is always the case if the SnapshotThumbnails feature is
+// disabled. The callback is called synchronously if the image is in memory.
+- (void)retrieveThumbnailForSnapshotID:(NSString*)snapshotID
+                              callback:(void (^)(UIImage*))callback;
+
 // Request the grey snapshot for |snapshotID|. If the image is already loaded in
 // memory, this will immediately call back on |callback|.
 - (void)retrieveGreyImageForSnapshotID:(NSString*)snapshotID
@@ -63,7 +88,9 @@ class Time;
                  fromSourcePath:(const base::FilePath&)sourcePath;
 
 // Purge the cache of snapshots that are older than |date|. The snapshots for
-// |liveSnapshotIDs| will be kept. This will be done asynchronously on a
+// |liveSnapshotIDs| will be kept. Beyond the disk budget, if any, the least
+// recently updated snapshots are evicted, including live ones, except the
+// pinned and visible snapshots. This will be done asynchronously on a
 // background thread.
 - (void)purgeCacheOlderThan:(const base::Time&)date
                     keeping:(NSSet*)liveSnapshotIDs;
@@ -84,7 +111,9 @@ class Time;
                       callback:(void (^)(UIImage*))callback;
 
 // Write a grey copy of the snapshot for |snapshotID| to disk, but if and only
-// if a color version of the snapshot already exists in memory or on disk.
+// if a color version of the snapshot already exists in memory or on disk. This
+// is a no-op if the SnapshotThumbnails feature is enabled, as the grey
+// snapshots are then generated from the color ones when requested.
 - (void)saveGreyInBackgroundForSnapshotID:(NSString*)snapshotID;
 
 // Adds an observer to this snapshot cache.
@@ -93,6 +122,13 @@ class Time;
 // Removes an observer from this snapshot cache.
 - (void)removeObserver:(id<SnapshotCacheObserver>)observer;
 
+// Retrieves the total size of the snapshots on disk, in bytes, and returns it
+// asynchronously via |callback|.
+- (void)retrieveDiskUsage:(void (^)(int64_t))callback;
+
+// Returns the statistics of the in-memory cache of color snapshots.
+- (SnapshotCacheMemoryStatistics)memoryStatistics;
+
 // Invoked before the instance is deallocated. Needs to release all reference
 // to C++ objects. Object will soon be deallocated.
 - (void)shutdown;
@@ -5,26 +5,39 @@
 #import "ios/chrome/browser/snapshots/snapshot_cache.h"
 #import "ios/chrome/browser/snapshots/snapshot_cache_internal.h"
 
+#import <ImageIO/ImageIO.h>
 #import <UIKit/UIKit.h>
 
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
 #include "base/base_paths.h"
 #include "base/bind.h"
 #include "base/files/file_enumerator.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
+#import "base/ios/block_types.h"
 #import "base/ios/crb_protocol_observers.h"
 #include "base/logging.h"
+#include "base/mac/scoped_cftyperef.h"
 #include "base/path_service.h"
 #include "base/sequence_checker.h"
 #include "base/sequenced_task_runner.h"
 #include "base/stl_util.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/string_util.h"
 #include "base/strings/sys_string_conversions.h"
 #include "base/task/post_task.h"
 #include "base/task/thread_pool.h"
 #include "base/task_runner_util.h"
 #include "base/threading/scoped_blocking_call.h"
 #include "base/time/time.h"
+#include "ios/chrome/browser/snapshots/features.h"
 #import "ios/chrome/browser/snapshots/snapshot_cache_observer.h"
+#include "ios/chrome/browser/snapshots/snapshot_index.h"
 #import "ios/chrome/browser/snapshots/snapshot_lru_cache.h"
 #include "ios/chrome/browser/ui/util/ui_util.h"
 #import "ios/chrome/browser/ui/util/uikit_ui_util.h"
@@ -54,6 +67,7 @@ namespace {
 enum ImageType {
   IMAGE_TYPE_COLOR,
   IMAGE_TYPE_GREYSCALE,
+  IMAGE_TYPE_THUMBNAIL,
 };
 
 enum ImageScale {
@@ -63,9 +77,21 @@ enum ImageScale {
 };
 
 const ImageType kImageTypes[] = {
-    IMAGE_TYPE_COLOR, IMAGE_TYPE_GREYSCALE,
+    IMAGE_TYPE_COLOR,
+    IMAGE_TYPE_GREYSCALE,
+    IMAGE_TYPE_THUMBNAIL,
+};
+
+const ImageScale kImageScales[] = {
+    IMAGE_SCALE_1X,
+    IMAGE_SCALE_2X,
+    IMAGE_SCALE_3X,
 };
 
+// Name of the file of the SnapshotIndex in the snapshot directory.
+const base::FilePath::CharType kIndexFileName[] =
+    FILE_PATH_LITERAL("SnapshotIndex.plist");
+
 const NSUInteger kGreyInitialCapacity = 8;
 const CGFloat kJPEGImageQuality = 1.0;  // Highest quality. No compression.
 
@@ -73,6 +99,31 @@ const CGFloat kJPEGImageQuality = 1.0;  // Highest quality. No compression.
 // starting to evict elements.
 const NSUInteger kLRUCacheMaxCapacity = 6;
 
+// Fraction of the byte budget of the LRU cache kept on low memory.
+const double kLowMemoryByteBudgetFraction = 0.5;
+
+// Returns the LRU cache holding the color snapshots in memory.
+SnapshotLRUCache* CreateLRUCache() {
+  if (base::FeatureList::IsEnabled(kSnapshotCacheByteBudget)) {
+    const NSUInteger byte_budget =
+        static_cast<NSUInteger>(kSnapshotCacheByteBudgetMB.Get()) * 1024 * 1024;
+    return [[SnapshotLRUCache alloc] initWithCacheSize:0
+                                            byteBudget:byte_budget];
+  }
+  return [[SnapshotLRUCache alloc] initWithCacheSize:kLRUCacheMaxCapacity];
+}
+
+// Returns the LRU cache holding the thumbnails in memory, or nil if the
+// thumbnails are not enabled.
+SnapshotLRUCache* CreateThumbnailLRUCache() {
+  if (!base::FeatureList::IsEnabled(kSnapshotThumbnails))
+    return nil;
+  const NSUInteger byte_budget =
+      static_cast<NSUInteger>(kSnapshotThumbnailsByteBudgetMB.Get()) * 1024 *
+      1024;
+  return [[SnapshotLRUCache alloc] initWithCacheSize:0 byteBudget:byte_budget];
+}
+
 // Returns the path of the image for |snapshot_id|, in |cache_directory|,
 // of type |image_type| and scale |image_scale|.
 base::FilePath ImagePath(NSString* snapshot_id,
@@ -87,6 +138,9 @@ base::FilePath ImagePath(NSString* snapshot_id,
     case IMAGE_TYPE_GREYSCALE:
       filename = [filename stringByAppendingString:@"Grey"];
       break;
+    case IMAGE_TYPE_THUMBNAIL:
+      filename = [filename stringByAppendingString:@"Thumbnail"];
+      break;
   }
   switch (image_scale) {
     case IMAGE_SCALE_1X:
@@ -126,10 +180,58 @@ CGFloat ScaleFromImageScale(ImageScale image_scale) {
   }
 }
 
+// Returns the image decoded from |data|, with the given |scale|. Unlike
+// +[UIImage imageWithData:], the image is decoded immediately so that it is
+// not decoded on the main thread when it is first drawn.
+UIImage* DecodeImage(NSData* data, CGFloat scale) {
+  base::ScopedCFTypeRef<CGImageSourceRef> source(
+      CGImageSourceCreateWithData((__bridge CFDataRef)data, nullptr));
+  if (!source)
+    return nil;
+
+  NSDictionary* options = @{
+    (__bridge NSString*)kCGImageSourceShouldCacheImmediately : @YES,
+  };
+  base::ScopedCFTypeRef<CGImageRef> image(CGImageSourceCreateImageAtIndex(
+      source, 0, (__bridge CFDictionaryRef)options));
+  if (!image)
+    return nil;
+  return [UIImage imageWithCGImage:image
+                             scale:scale
+                       orientation:UIImageOrientationUp];
+}
+
+// Returns a JPEG image of quality |jpeg_quality| downscaled from |jpeg_data|
+// so that its width and height are at most |max_pixel_size|.
+NSData* CreateThumbnailData(NSData* jpeg_data,
+                            int max_pixel_size,
+                            CGFloat jpeg_quality) {
+  base::ScopedCFTypeRef<CGImageSourceRef> source(
+      CGImageSourceCreateWithData((__bridge CFDataRef)jpeg_data, nullptr));
+  if (!source)
+    return nil;
+
+  NSDictionary* options = @{
+    (__bridge NSString*)kCGImageSourceCreateThumbnailFromImageAlways : @YES,
+    (__bridge NSString*)kCGImageSourceCreateThumbnailWithTransform : @YES,
+    (__bridge NSString*)kCGImageSourceThumbnailMaxPixelSize : @(max_pixel_size),
+  };
+  base::ScopedCFTypeRef<CGImageRef> thumbnail(
+      CGImageSourceCreateThumbnailAtIndex(source, 0,
+                                          (__bridge CFDictionaryRef)options));
+  if (!thumbnail)
+    return nil;
+  return UIImageJPEGRepresentation([UIImage imageWithCGImage:thumbnail],
+                                   jpeg_quality);
+}
+
+// Reads the image for |snapshot_id| from disk. If |decode| is true, the image
+// is decoded before being returned.
 UIImage* ReadImageForSnapshotIDFromDisk(NSString* snapshot_id,
                                         ImageType image_type,
                                         ImageScale image_scale,
-                                        const base::FilePath& cache_directory) {
+                                        const base::FilePath& cache_directory,
+                                        bool decode) {
   // TODO(crbug.com/295891): consider changing back to -imageWithContentsOfFile
   // instead of -imageWithData if both rdar://15747161 and the bug incorrectly
   // reporting the image as damaged https://stackoverflow.com/q/5081297/5353
@@ -139,14 +241,17 @@ UIImage* ReadImageForSnapshotIDFromDisk(NSString* snapshot_id,
   NSString* path = base::SysUTF8ToNSString(file_path.AsUTF8Unsafe());
   base::ScopedBlockingCall scoped_blocking_call(FROM_HERE,
                                                 base::BlockingType::WILL_BLOCK);
-  return [UIImage imageWithData:[NSData dataWithContentsOfFile:path]
-                          scale:(image_type == IMAGE_TYPE_GREYSCALE
-                                     ? 1.0
-                                     : ScaleFromImageScale(image_scale))];
+  NSData* data = [NSData dataWithContentsOfFile:path];
+  const CGFloat scale = image_type == IMAGE_TYPE_GREYSCALE
+                            ? 1.0
+                            : ScaleFromImageScale(image_scale);
+  if (decode)
+    return data ? DecodeImage(data, scale) : nil;
+  return [UIImage imageWithData:data scale:scale];
 }
 
-void WriteImageToDisk(UIImage* image, const base::FilePath& file_path) {
-  if (!image)
+void WriteDataToDisk(NSData* data, const base::FilePath& file_path) {
+  if (!data)
     return;
 
   base::FilePath directory = file_path.DirName();
@@ -162,8 +267,7 @@ void WriteImageToDisk(UIImage* image, const base::FilePath& file_path) {
   NSString* path = base::SysUTF8ToNSString(file_path.AsUTF8Unsafe());
   base::ScopedBlockingCall scoped_blocking_call(FROM_HERE,
                                                 base::BlockingType::WILL_BLOCK);
-  [UIImageJPEGRepresentation(image, kJPEGImageQuality) writeToFile:path
-                                                        atomically:YES];
+  [data writeToFile:path atomically:YES];
 
   // Encrypt the snapshot file (mostly for Incognito, but can't hurt to
   // always do it).
@@ -180,6 +284,123 @@ void WriteImageToDisk(UIImage* image, const base::FilePath& file_path) {
   }
 }
 
+void WriteImageToDisk(UIImage* image, const base::FilePath& file_path) {
+  if (!image)
+    return;
+  WriteDataToDisk(UIImageJPEGRepresentation(image, kJPEGImageQuality),
+                  file_path);
+}
+
+// Writes |image| to disk with the given |jpeg_quality|, and a thumbnail of at
+// most |thumbnail_max_pixel_size| pixels wide and high.
+void WriteImageAndThumbnailToDisk(UIImage* image,
+                                  NSString* snapshot_id,
+                                  ImageScale image_scale,
+                                  const base::FilePath& cache_directory,
+                                  CGFloat jpeg_quality,
+                                  int thumbnail_max_pixel_size) {
+  base::ScopedBlockingCall scoped_blocking_call(FROM_HERE,
+                                                base::BlockingType::WILL_BLOCK);
+  NSData* data = UIImageJPEGRepresentation(image, jpeg_quality);
+  WriteDataToDisk(data, ImagePath(snapshot_id, IMAGE_TYPE_COLOR, image_scale,
+                                  cache_directory));
+
+  const base::FilePath thumbnail_path = ImagePath(
+      snapshot_id, IMAGE_TYPE_THUMBNAIL, image_scale, cache_directory);
+  NSData* thumbnail_data =
+      data ? CreateThumbnailData(data, thumbnail_max_pixel_size, jpeg_quality)
+           : nil;
+  if (thumbnail_data) {
+    WriteDataToDisk(thumbnail_data, thumbnail_path);
+  } else {
+    // Do not leave the thumbnail of a previous snapshot.
+    base::DeleteFile(thumbnail_path);
+  }
+}
+
+// Returns the size and modification time of the files of |snapshot_id| in
+// |cache_directory|, of all types and scales.
+SnapshotIndex::Entry GetIndexEntry(NSString* snapshot_id,
+                                   const base::FilePath& cache_directory) {
+  base::ScopedBlockingCall scoped_blocking_call(FROM_HERE,
+                                                base::BlockingType::MAY_BLOCK);
+  SnapshotIndex::Entry entry;
+  for (ImageType image_type : kImageTypes) {
+    for (ImageScale image_scale : kImageScales) {
+      base::File::Info info;
+      if (!base::GetFileInfo(
+              ImagePath(snapshot_id, image_type, image_scale, cache_directory),
+              &info)) {
+        continue;
+      }
+      entry.size += info.size;
+      entry.last_modified = std::max(entry.last_modified, info.last_modified);
+    }
+  }
+  return entry;
+}
+
+// Updates the entry of |snapshot_id| in |index| after its files in
+// |cache_directory| were modified.
+void UpdateIndexEntry(SnapshotIndex* index,
+                      NSString* snapshot_id,
+                      const base::FilePath& cache_directory) {
+  index->Update(base::SysNSStringToUTF8(snapshot_id),
+                GetIndexEntry(snapshot_id, cache_directory));
+}
+
+// Deletes the files of |snapshot_id| in |cache_directory|, of all types and
+// scales, and removes its entry from |index|.
+void DeleteImagesForSnapshotID(SnapshotIndex* index,
+                               const std::string& snapshot_id,
+                               const base::FilePath& cache_directory) {
+  NSString* snapshot_id_string = base::SysUTF8ToNSString(snapshot_id);
+  for (ImageType image_type : kImageTypes) {
+    for (ImageScale image_scale : kImageScales) {
+      base::DeleteFile(ImagePath(snapshot_id_string, image_type, image_scale,
+                                 cache_directory));
+    }
+  }
+  index->Remove(snapshot_id);
+}
+
+// Returns the ID of the snapshot stored in |file_path|, the reverse of
+// ImagePath().
+std::string SnapshotIDFromImagePath(const base::FilePath& file_path) {
+  std::string name = file_path.BaseName().RemoveExtension().value();
+  for (const char* suffix : {"@2x", "@3x", "Grey", "Thumbnail"}) {
+    const base::StringPiece suffix_piece(suffix);
+    if (base::EndsWith(name, suffix_piece, base::CompareCase::SENSITIVE))
+      name.resize(name.size() - suffix_piece.size());
+  }
+  return name;
+}
+
+// Loads |index| from |cache_directory|, rebuilding it by enumerating the
+// directory if it was not saved, e.g. on first run or after a crash.
+void LoadIndex(SnapshotIndex* index, const base::FilePath& cache_directory) {
+  if (index->Load())
+    return;
+
+  std::map<std::string, SnapshotIndex::Entry> entries;
+  base::FileEnumerator enumerator(cache_directory, false,
+                                  base::FileEnumerator::FILES);
+  for (base::FilePath current_file = enumerator.Next(); !current_file.empty();
+       current_file = enumerator.Next()) {
+    if (current_file.Extension() != ".jpg")
+      continue;
+    base::FileEnumerator::FileInfo file_info = enumerator.GetInfo();
+    SnapshotIndex::Entry& entry =
+        entries[SnapshotIDFromImagePath(current_file)];
+    entry.size += file_info.GetSize();
+    entry.last_modified =
+        std::max(entry.last_modified, file_info.GetLastModifiedTime());
+  }
+  for (const auto& pair : entries)
+    index->Update(pair.first, pair.second);
+  index->Save();
+}
+
 void ConvertAndSaveGreyImage(NSString* snapshot_id,
                              ImageScale image_scale,
                              UIImage* color_image,
@@ -187,8 +408,9 @@ void ConvertAndSaveGreyImage(NSString* snapshot_id,
   base::ScopedBlockingCall scoped_blocking_call(FROM_HERE,
                                                 base::BlockingType::WILL_BLOCK);
   if (!color_image) {
-    color_image = ReadImageForSnapshotIDFromDisk(snapshot_id, IMAGE_TYPE_COLOR,
-                                                 image_scale, cache_directory);
+    color_image =
+        ReadImageForSnapshotIDFromDisk(snapshot_id, IMAGE_TYPE_COLOR,
+                                       image_scale, cache_directory, false);
     if (!color_image)
       return;
   }
@@ -231,6 +453,42 @@ void ConvertAndSaveGreyImage(NSString* snapshot_id,
   // by not posting the task).
   scoped_refptr<base::SequencedTaskRunner> _taskRunner;
 
+  // Index of the snapshots on disk. Only used on |_taskRunner|.
+  scoped_refptr<SnapshotIndex> _index;
+
+  // Task runner used to read the snapshots from disk. When the thumbnails are
+  // enabled, this runs the reads in parallel, otherwise it is |_taskRunner|.
+  // Will be invalidated when -shutdown is invoked.
+  scoped_refptr<base::TaskRunner> _readTaskRunner;
+
+  // Whether the snapshots are stored with a thumbnail, and the grey snapshots
+  // are generated from the color ones instead of being saved to disk.
+  BOOL _thumbnailsEnabled;
+
+  // Quality of the JPEG snapshots and thumbnails written to disk, and maximum
+  // width and height of the thumbnails, in pixels.
+  CGFloat _JPEGQuality;
+  int _thumbnailMaxPixelSize;
+
+  // Cache to hold the thumbnails in memory. Nil if the thumbnails are not
+  // enabled.
+  SnapshotLRUCache* _thumbnailCache;
+
+  // Snapshot IDs with a write or a removal pending on |_taskRunner|, and
+  // number of pending operations on the whole directory. Reads of these
+  // snapshots are sequenced after the pending operations.
+  NSCountedSet<NSString*>* _pendingSnapshotIDs;
+  int _pendingDirectoryOperationCount;
+
+  // Generation of the storage, incremented by each modification while reads
+  // are pending. Generation of the last modification of each snapshot and of
+  // the whole directory, only tracked while reads are pending. A read whose
+  // snapshot was modified after it started is run again.
+  NSUInteger _storageGeneration;
+  NSMutableDictionary<NSString*, NSNumber*>* _snapshotGenerations;
+  NSUInteger _directoryGeneration;
+  int _pendingReadCount;
+
   // Check that public API is called from the correct sequence.
   SEQUENCE_CHECKER(_sequenceChecker);
 }
@@ -238,14 +496,29 @@ void ConvertAndSaveGreyImage(NSString* snapshot_id,
 - (instancetype)initWithStoragePath:(const base::FilePath&)storagePath {
   DCHECK_CALLED_ON_VALID_SEQUENCE(_sequenceChecker);
   if ((self = [super init])) {
-    _lruCache =
-        [[SnapshotLRUCache alloc] initWithCacheSize:kLRUCacheMaxCapacity];
+    _lruCache = CreateLRUCache();
     _cacheDirectory = storagePath;
     _snapshotsScale = ImageScaleForDevice();
 
     _taskRunner = base::ThreadPool::CreateSequencedTaskRunner(
         {base::MayBlock(), base::TaskPriority::USER_VISIBLE});
 
+    _thumbnailsEnabled = base::FeatureList::IsEnabled(kSnapshotThumbnails);
+    if (_thumbnailsEnabled) {
+      _JPEGQuality = kSnapshotThumbnailsJPEGQuality.Get();
+      _thumbnailMaxPixelSize = kSnapshotThumbnailsMaxPixelSize.Get();
+      _thumbnailCache = CreateThumbnailLRUCache();
+      _readTaskRunner = base::ThreadPool::CreateTaskRunner(
+          {base::MayBlock(), base::TaskPriority::USER_VISIBLE});
+    } else {
+      _JPEGQuality = kJPEGImageQuality;
+      _readTaskRunner = _taskRunner;
+    }
+    _pendingSnapshotIDs = [[NSCountedSet alloc] init];
+    _snapshotGenerations = [[NSMutableDictionary alloc] init];
+    _index = base::MakeRefCounted<SnapshotIndex>(
+        _cacheDirectory.Append(kIndexFileName));
+
     // Must be called after task runner is created.
     [self createStorageIfNecessary];
 
@@ -310,19 +583,65 @@ void ConvertAndSaveGreyImage(NSString* snapshot_id,
   // Copy ivars used by the block so that it does not reference |self|.
   const base::FilePath cacheDirectory = _cacheDirectory;
   const ImageScale snapshotsScale = _snapshotsScale;
+  const bool decode = _thumbnailsEnabled;
 
   __weak SnapshotLRUCache* weakLRUCache = _lruCache;
-  base::PostTaskAndReplyWithResult(
-      _taskRunner.get(), FROM_HERE, base::BindOnce(^UIImage*() {
-        // Retrieve the image on a high priority thread.
-        return ReadImageForSnapshotIDFromDisk(snapshotID, IMAGE_TYPE_COLOR,
-                                              snapshotsScale, cacheDirectory);
-      }),
-      base::BindOnce(^(UIImage* image) {
-        if (image)
-          [weakLRUCache setObject:image forKey:snapshotID];
-        callback(image);
-      }));
+  [self readImageForSnapshotID:snapshotID
+                    usingBlock:^UIImage*() {
+                      // Retrieve the image on a high priority thread.
+                      return ReadImageForSnapshotIDFromDisk(
+                          snapshotID, IMAGE_TYPE_COLOR, snapshotsScale,
+                          cacheDirectory, decode);
+                    }
+                         reply:^(UIImage* image) {
+                           if (image)
+                             [weakLRUCache setObject:image forKey:snapshotID];
+                           callback(image);
+                         }];
+}
+
+- (void)retrieveThumbnailForSnapshotID:(NSString*)snapshotID
+                              callback:(void (^)(UIImage*))callback {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(_sequenceChecker);
+  DCHECK(snapshotID);
+  DCHECK(callback);
+
+  if (!_thumbnailsEnabled) {
+    [self retrieveImageForSnapshotID:snapshotID callback:callback];
+    return;
+  }
+
+  if (UIImage* image = [_thumbnailCache objectForKey:snapshotID]) {
+    callback(image);
+    return;
+  }
+
+  if (!_taskRunner) {
+    callback(nil);
+    return;
+  }
+
+  // Copy ivars used by the block so that it does not reference |self|.
+  const base::FilePath cacheDirectory = _cacheDirectory;
+  const ImageScale snapshotsScale = _snapshotsScale;
+
+  __weak SnapshotCache* weakSelf = self;
+  __weak SnapshotLRUCache* weakThumbnailCache = _thumbnailCache;
+  [self readImageForSnapshotID:snapshotID
+      usingBlock:^UIImage*() {
+        return ReadImageForSnapshotIDFromDisk(snapshotID, IMAGE_TYPE_THUMBNAIL,
+                                              snapshotsScale, cacheDirectory,
+                                              /*decode=*/true);
+      }
+      reply:^(UIImage* image) {
+        if (image) {
+          [weakThumbnailCache setObject:image forKey:snapshotID];
+          callback(image);
+          return;
+        }
+        // Snapshots saved before the thumbnails were enabled have none.
+        [weakSelf retrieveImageForSnapshotID:snapshotID callback:callback];
+      }];
 }
 
 - (void)setImage:(UIImage*)image withSnapshotID:(NSString*)snapshotID {
@@ -331,6 +650,7 @@ void ConvertAndSaveGreyImage(NSString* snapshot_id,
     return;
 
   [_lruCache setObject:image forKey:snapshotID];
+  [_thumbnailCache removeObjectForKey:snapshotID];
 
   [self.observers snapshotCache:self didUpdateSnapshotForIdentifier:snapshotID];
 
@@ -339,17 +659,32 @@ void ConvertAndSaveGreyImage(NSString* snapshot_id,
   const ImageScale snapshotsScale = _snapshotsScale;
 
   // Save the image to disk.
-  _taskRunner->PostTask(FROM_HERE, base::BindOnce(^{
-                          WriteImageToDisk(
-                              image, ImagePath(snapshotID, IMAGE_TYPE_COLOR,
-                                               snapshotsScale, cacheDirectory));
-                        }));
+  const BOOL thumbnailsEnabled = _thumbnailsEnabled;
+  const CGFloat JPEGQuality = _JPEGQuality;
+  const int thumbnailMaxPixelSize = _thumbnailMaxPixelSize;
+  scoped_refptr<SnapshotIndex> index = _index;
+  ProceduralBlock writeImage = ^{
+    if (thumbnailsEnabled) {
+      WriteImageAndThumbnailToDisk(image, snapshotID, snapshotsScale,
+                                   cacheDirectory, JPEGQuality,
+                                   thumbnailMaxPixelSize);
+    } else {
+      WriteImageToDisk(image, ImagePath(snapshotID, IMAGE_TYPE_COLOR,
+                                        snapshotsScale, cacheDirectory));
+      // A thumbnail written while the thumbnails were enabled is out of date.
+      base::DeleteFile(ImagePath(snapshotID, IMAGE_TYPE_THUMBNAIL,
+                                 snapshotsScale, cacheDirectory));
+    }
+    UpdateIndexEntry(index.get(), snapshotID, cacheDirectory);
+  };
+  [self postStorageTaskForSnapshotID:snapshotID task:writeImage];
 }
 
 - (void)removeImageWithSnapshotID:(NSString*)snapshotID {
   DCHECK_CALLED_ON_VALID_SEQUENCE(_sequenceChecker);
 
   [_lruCache removeObjectForKey:snapshotID];
+  [_thumbnailCache removeObjectForKey:snapshotID];
 
   [self.observers snapshotCache:self didUpdateSnapshotForIdentifier:snapshotID];
 
@@ -360,38 +695,45 @@ void ConvertAndSaveGreyImage(NSString* snapshot_id,
   const base::FilePath cacheDirectory = _cacheDirectory;
   const ImageScale snapshotsScale = _snapshotsScale;
 
-  _taskRunner->PostTask(
-      FROM_HERE, base::BindOnce(^{
-        for (size_t index = 0; index < base::size(kImageTypes); ++index) {
-          base::DeleteFile(ImagePath(snapshotID, kImageTypes[index],
-                                     snapshotsScale, cacheDirectory));
-        }
-      }));
+  scoped_refptr<SnapshotIndex> index = _index;
+  ProceduralBlock removeFiles = ^{
+    for (ImageType imageType : kImageTypes) {
+      base::DeleteFile(
+          ImagePath(snapshotID, imageType, snapshotsScale, cacheDirectory));
+    }
+    UpdateIndexEntry(index.get(), snapshotID, cacheDirectory);
+  };
+  [self postStorageTaskForSnapshotID:snapshotID task:removeFiles];
 }
 
 - (void)removeAllImages {
   DCHECK_CALLED_ON_VALID_SEQUENCE(_sequenceChecker);
 
   [_lruCache removeAllObjects];
+  [_thumbnailCache removeAllObjects];
 
   if (!_taskRunner)
     return;
   // Copy ivars used by the block so that it does not reference |self|.
   const base::FilePath cacheDirectory = _cacheDirectory;
-  _taskRunner->PostTask(
-      FROM_HERE, base::BindOnce(^{
-        if (cacheDirectory.empty() || !base::DirectoryExists(cacheDirectory)) {
-          return;
-        }
-        if (!base::DeletePathRecursively(cacheDirectory)) {
-          DLOG(ERROR) << "Error deleting snapshots storage. "
-                      << cacheDirectory.AsUTF8Unsafe();
-        }
-        if (!base::CreateDirectory(cacheDirectory)) {
-          DLOG(ERROR) << "Error creating snapshot storage "
-                      << cacheDirectory.AsUTF8Unsafe();
-        }
-      }));
+  scoped_refptr<SnapshotIndex> index = _index;
+  ProceduralBlock removeAllFiles = ^{
+    index->Clear();
+    if (cacheDirectory.empty() || !base::DirectoryExists(cacheDirectory)) {
+      return;
+    }
+    if (!base::DeletePathRecursively(cacheDirectory)) {
+      DLOG(ERROR) << "Error deleting snapshots storage. "
+                  << cacheDirectory.AsUTF8Unsafe();
+    }
+    if (!base::CreateDirectory(cacheDirectory)) {
+      DLOG(ERROR) << "Error creating snapshot storage "
+                  << cacheDirectory.AsUTF8Unsafe();
+      return;
+    }
+    index->Save();
+  };
+  [self postStorageTaskForSnapshotID:nil task:removeAllFiles];
 }
 
 - (base::FilePath)imagePathForSnapshotID:(NSString*)snapshotID {
@@ -404,6 +746,11 @@ void ConvertAndSaveGreyImage(NSString* snapshot_id,
                    _cacheDirectory);
 }
 
+- (base::FilePath)thumbnailPathForSnapshotID:(NSString*)snapshotID {
+  return ImagePath(snapshotID, IMAGE_TYPE_THUMBNAIL, _snapshotsScale,
+                   _cacheDirectory);
+}
+
 - (void)migrateSnapshotsWithIDs:(NSSet<NSString*>*)snapshotIDs
                  fromSourcePath:(const base::FilePath&)sourcePath {
   DCHECK_CALLED_ON_VALID_SEQUENCE(_sequenceChecker);
@@ -412,36 +759,52 @@ void ConvertAndSaveGreyImage(NSString* snapshot_id,
   // Copy ivars used by the block so that it does not reference |self|.
   const base::FilePath destinationPath = _cacheDirectory;
   const ImageScale snapshotsScale = _snapshotsScale;
-  _taskRunner->PostTask(
-      FROM_HERE, base::BindOnce(^{
-        if (sourcePath.empty() || !base::DirectoryExists(sourcePath) ||
-            sourcePath == destinationPath) {
-          return;
-        }
-        DCHECK(base::DirectoryExists(destinationPath));
-        for (NSString* snapshotID : snapshotIDs) {
-          for (size_t index = 0; index < base::size(kImageTypes); ++index) {
-            base::FilePath sourceFilePath = ImagePath(
-                snapshotID, kImageTypes[index], snapshotsScale, sourcePath);
-            base::FilePath destinationFilePath =
-                ImagePath(snapshotID, kImageTypes[index], snapshotsScale,
-                          destinationPath);
-            // Only migrate snapshots which are still needed.
-            if (base::PathExists(sourceFilePath) &&
-                !base::PathExists(destinationFilePath)) {
-              if (!base::Move(sourceFilePath, destinationFilePath)) {
-                DLOG(ERROR)
-                    << "Error migrating file " << sourceFilePath.AsUTF8Unsafe();
-              }
-            }
+  scoped_refptr<SnapshotIndex> index = _index;
+  ProceduralBlock migrateFiles = ^{
+    if (sourcePath.empty() || !base::DirectoryExists(sourcePath) ||
+        sourcePath == destinationPath) {
+      return;
+    }
+    DCHECK(base::DirectoryExists(destinationPath));
+    // If the source directory has an index, only the snapshots it lists need
+    // to be looked for.
+    auto sourceIndex =
+        base::MakeRefCounted<SnapshotIndex>(sourcePath.Append(kIndexFileName));
+    const bool hasSourceIndex = sourceIndex->Load();
+    for (NSString* snapshotID : snapshotIDs) {
+      if (hasSourceIndex &&
+          !sourceIndex->Find(base::SysNSStringToUTF8(snapshotID))) {
+        continue;
+      }
+      bool migrated = false;
+      for (size_t index = 0; index < base::size(kImageTypes); ++index) {
+        base::FilePath sourceFilePath = ImagePath(
+            snapshotID, kImageTypes[index], snapshotsScale, sourcePath);
+        base::FilePath destinationFilePath =
+            ImagePath(snapshotID, kImageTypes[index], snapshotsScale,
+                      destinationPath);
+        // Only migrate snapshots which are still needed.
+        if (base::PathExists(sourceFilePath) &&
+            !base::PathExists(destinationFilePath)) {
+          if (base::Move(sourceFilePath, destinationFilePath)) {
+            migrated = true;
+          } else {
+            DLOG(ERROR)
+                << "Error migrating file " << sourceFilePath.AsUTF8Unsafe();
           }
         }
-        // Remove the old source folder.
-        if (!base::DeletePathRecursively(sourcePath)) {
-          DLOG(ERROR) << "Error deleting snapshots folder during migration. "
-                      << sourcePath.AsUTF8Unsafe();
-        }
-      }));
+      }
+      if (migrated)
+        UpdateIndexEntry(index.get(), snapshotID, destinationPath);
+    }
+    index->Save();
+    // Remove the old source folder.
+    if (!base::DeletePathRecursively(sourcePath)) {
+      DLOG(ERROR) << "Error deleting snapshots folder during migration. "
+                  << sourcePath.AsUTF8Unsafe();
+    }
+  };
+  [self postStorageTaskForSnapshotID:nil task:migrateFiles];
 }
 
 - (void)purgeCacheOlderThan:(const base::Time&)date
@@ -456,34 +819,51 @@ void ConvertAndSaveGreyImage(NSString* snapshot_id,
 
   // Copy ivars used by the block so that it does not reference |self|.
   const base::FilePath cacheDirectory = _cacheDirectory;
-  const ImageScale snapshotsScale = _snapshotsScale;
-
-  _taskRunner->PostTask(
-      FROM_HERE, base::BindOnce(^{
-        if (!base::DirectoryExists(cacheDirectory))
-          return;
+  scoped_refptr<SnapshotIndex> index = _index;
+
+  // Least recently updated snapshots are evicted beyond the disk budget, even
+  // if they are live, except the ones likely to be shown soon.
+  const int64_t diskBudget =
+      base::FeatureList::IsEnabled(kSnapshotCacheDiskBudget)
+          ? static_cast<int64_t>(kSnapshotCacheDiskBudgetMB.Get()) * 1024 * 1024
+          : -1;
+  NSMutableSet<NSString*>* retainedSnapshotIDs = [NSMutableSet set];
+  if (self.pinnedIDs)
+    [retainedSnapshotIDs unionSet:self.pinnedIDs];
+  if (self.visibleID)
+    [retainedSnapshotIDs addObject:self.visibleID];
+
+  ProceduralBlock purgeFiles = ^{
+    if (!base::DirectoryExists(cacheDirectory))
+      return;
 
-        std::set<base::FilePath> filesToKeep;
-        for (NSString* snapshotID : liveSnapshotIDs) {
-          for (size_t index = 0; index < base::size(kImageTypes); ++index) {
-            filesToKeep.insert(ImagePath(snapshotID, kImageTypes[index],
-                                         snapshotsScale, cacheDirectory));
-          }
-        }
-        base::FileEnumerator enumerator(cacheDirectory, false,
-                                        base::FileEnumerator::FILES);
-        base::FilePath current_file = enumerator.Next();
-        for (; !current_file.empty(); current_file = enumerator.Next()) {
-          if (current_file.Extension() != ".jpg")
-            continue;
-          if (filesToKeep.find(current_file) != filesToKeep.end())
-            continue;
-          base::FileEnumerator::FileInfo fileInfo = enumerator.GetInfo();
-          if (fileInfo.GetLastModifiedTime() > dateCopy)
-            continue;
-          base::DeleteFile(current_file);
-        }
-      }));
+    std::set<std::string> idsToKeep;
+    for (NSString* snapshotID : liveSnapshotIDs)
+      idsToKeep.insert(base::SysNSStringToUTF8(snapshotID));
+
+    std::vector<std::string> idsToDelete;
+    for (const auto& pair : index->entries()) {
+      if (idsToKeep.find(pair.first) != idsToKeep.end())
+        continue;
+      if (pair.second.last_modified > dateCopy)
+        continue;
+      idsToDelete.push_back(pair.first);
+    }
+    for (const std::string& snapshotID : idsToDelete)
+      DeleteImagesForSnapshotID(index.get(), snapshotID, cacheDirectory);
+
+    if (diskBudget >= 0) {
+      std::set<std::string> idsToRetain;
+      for (NSString* snapshotID : retainedSnapshotIDs)
+        idsToRetain.insert(base::SysNSStringToUTF8(snapshotID));
+      for (const std::string& snapshotID :
+           index->GetEntriesToEvict(diskBudget, idsToRetain)) {
+        DeleteImagesForSnapshotID(index.get(), snapshotID, cacheDirectory);
+      }
+    }
+    index->Save();
+  };
+  [self postStorageTaskForSnapshotID:nil task:purgeFiles];
 }
 
 - (void)willBeSavedGreyWhenBackgrounding:(NSString*)snapshotID {
@@ -494,26 +874,23 @@ void ConvertAndSaveGreyImage(NSString* snapshot_id,
   _backgroundingColorImage = [_lruCache objectForKey:snapshotID];
 }
 
-// Remove all but adjacent UIImages from |lruCache_|.
+// Remove all but adjacent UIImages from |lruCache_|, or only the least recently
+// used ones down to a fraction of its byte budget if it has one.
 - (void)handleLowMemory {
   DCHECK_CALLED_ON_VALID_SEQUENCE(_sequenceChecker);
-  NSMutableDictionary<NSString*, UIImage*>* dictionary =
-      [NSMutableDictionary dictionaryWithCapacity:2];
-  for (NSString* snapshotID in self.pinnedIDs) {
-    UIImage* image = [_lruCache objectForKey:snapshotID];
-    if (image)
-      [dictionary setObject:image forKey:snapshotID];
-  }
-  [_lruCache removeAllObjects];
-  for (NSString* snapshotID in self.pinnedIDs)
-    [_lruCache setObject:[dictionary objectForKey:snapshotID]
-                  forKey:snapshotID];
+  [_lruCache reduceToFraction:kLowMemoryByteBudgetFraction
+      ofByteBudgetKeepingKeys:self.pinnedIDs];
+  [_thumbnailCache reduceToFraction:kLowMemoryByteBudgetFraction
+            ofByteBudgetKeepingKeys:self.pinnedIDs];
 }
 
-// Remove all UIImages from |lruCache_|.
+// Remove all UIImages from |lruCache_| and |_thumbnailCache|, and save the
+// index as the application may be terminated.
 - (void)handleEnterBackground {
   DCHECK_CALLED_ON_VALID_SEQUENCE(_sequenceChecker);
   [_lruCache removeAllObjects];
+  [_thumbnailCache removeAllObjects];
+  [self saveIndex];
 }
 
 // Restore adjacent UIImages to |lruCache_|.
@@ -553,21 +930,22 @@ void ConvertAndSaveGreyImage(NSString* snapshot_id,
   const ImageScale snapshotsScale = _snapshotsScale;
 
   __weak SnapshotCache* weakSelf = self;
-  base::PostTaskAndReplyWithResult(
-      _taskRunner.get(), FROM_HERE, base::BindOnce(^UIImage*() {
+  [self readImageForSnapshotID:snapshotID
+      usingBlock:^UIImage*() {
         // If the image is not in the cache, load it from disk.
         UIImage* localImage = image;
         if (!localImage) {
           localImage = ReadImageForSnapshotIDFromDisk(
-              snapshotID, IMAGE_TYPE_COLOR, snapshotsScale, cacheDirectory);
+              snapshotID, IMAGE_TYPE_COLOR, snapshotsScale, cacheDirectory,
+              /*decode=*/false);
         }
         if (localImage)
           localImage = GreyImage(localImage);
         return localImage;
-      }),
-      base::BindOnce(^(UIImage* greyImage) {
+      }
+      reply:^(UIImage* greyImage) {
         [weakSelf saveGreyImage:greyImage forSnapshotID:snapshotID];
-      }));
+      }];
 }
 
 - (void)createGreyCache:(NSArray*)snapshotIDs {
@@ -629,12 +1007,31 @@ void ConvertAndSaveGreyImage(NSString* snapshot_id,
   const base::FilePath cacheDirectory = _cacheDirectory;
   const ImageScale snapshotsScale = _snapshotsScale;
 
+  // The grey snapshots are not saved to disk when the thumbnails are enabled,
+  // so convert the color image in the background instead.
+  if (_thumbnailsEnabled) {
+    UIImage* colorImage = [_lruCache objectForKey:snapshotID];
+    [self readImageForSnapshotID:snapshotID
+                      usingBlock:^UIImage*() {
+                        UIImage* localImage = colorImage;
+                        if (!localImage) {
+                          localImage = ReadImageForSnapshotIDFromDisk(
+                              snapshotID, IMAGE_TYPE_COLOR, snapshotsScale,
+                              cacheDirectory, /*decode=*/false);
+                        }
+                        return localImage ? GreyImage(localImage) : nil;
+                      }
+                           reply:callback];
+    return;
+  }
+
   __weak SnapshotCache* weakSelf = self;
   base::PostTaskAndReplyWithResult(
       _taskRunner.get(), FROM_HERE, base::BindOnce(^UIImage*() {
         // Retrieve the image on a high priority thread.
         return ReadImageForSnapshotIDFromDisk(snapshotID, IMAGE_TYPE_GREYSCALE,
-                                              snapshotsScale, cacheDirectory);
+                                              snapshotsScale, cacheDirectory,
+                                              /*decode=*/false);
       }),
       base::BindOnce(^(UIImage* image) {
         if (image) {
@@ -652,7 +1049,9 @@ void ConvertAndSaveGreyImage(NSString* snapshot_id,
 
 - (void)saveGreyInBackgroundForSnapshotID:(NSString*)snapshotID {
   DCHECK_CALLED_ON_VALID_SEQUENCE(_sequenceChecker);
-  if (!snapshotID)
+  // The grey snapshots are generated on demand when the thumbnails are
+  // enabled.
+  if (!snapshotID || _thumbnailsEnabled)
     return;
 
   // The color image may still be in memory.  Verify the snapshotID matches.
@@ -671,11 +1070,24 @@ void ConvertAndSaveGreyImage(NSString* snapshot_id,
   const base::FilePath cacheDirectory = _cacheDirectory;
   const ImageScale snapshotsScale = _snapshotsScale;
 
-  _taskRunner->PostTask(FROM_HERE, base::BindOnce(^{
-                          ConvertAndSaveGreyImage(snapshotID, snapshotsScale,
-                                                  backgroundingColorImage,
-                                                  cacheDirectory);
-                        }));
+  scoped_refptr<SnapshotIndex> index = _index;
+  ProceduralBlock saveGreyImage = ^{
+    ConvertAndSaveGreyImage(snapshotID, snapshotsScale, backgroundingColorImage,
+                            cacheDirectory);
+    UpdateIndexEntry(index.get(), snapshotID, cacheDirectory);
+  };
+  [self postStorageTaskForSnapshotID:snapshotID task:saveGreyImage];
+}
+
+- (SnapshotCacheMemoryStatistics)memoryStatistics {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(_sequenceChecker);
+  SnapshotCacheMemoryStatistics statistics;
+  statistics.hit_count = _lruCache.hitCount;
+  statistics.miss_count = _lruCache.missCount;
+  statistics.eviction_count = _lruCache.evictionCount;
+  statistics.total_bytes = _lruCache.totalCost;
+  statistics.byte_budget = _lruCache.byteBudget;
+  return statistics;
 }
 
 - (void)addObserver:(id<SnapshotCacheObserver>)observer {
@@ -686,24 +1098,148 @@ void ConvertAndSaveGreyImage(NSString* snapshot_id,
   [self.observers removeObserver:observer];
 }
 
+- (void)retrieveDiskUsage:(void (^)(int64_t))callback {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(_sequenceChecker);
+  DCHECK(callback);
+  if (!_taskRunner) {
+    callback(0);
+    return;
+  }
+
+  scoped_refptr<SnapshotIndex> index = _index;
+  base::PostTaskAndReplyWithResult(_taskRunner.get(), FROM_HERE,
+                                   base::BindOnce(^int64_t() {
+                                     return index->total_size();
+                                   }),
+                                   base::BindOnce(callback));
+}
+
 - (void)shutdown {
+  [self saveIndex];
   _taskRunner = nullptr;
+  _readTaskRunner = nullptr;
 }
 
 #pragma mark - Private methods
 
+// Posts |task| modifying the storage of |snapshotID|, or the whole storage if
+// |snapshotID| is nil, on |_taskRunner|. Reads of that storage are sequenced
+// after |task| until it has completed.
+- (void)postStorageTaskForSnapshotID:(NSString*)snapshotID
+                                task:(ProceduralBlock)task {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(_sequenceChecker);
+  DCHECK(_taskRunner);
+  if (snapshotID) {
+    [_pendingSnapshotIDs addObject:snapshotID];
+  } else {
+    ++_pendingDirectoryOperationCount;
+  }
+
+  // The reads started before are out of date.
+  if (_pendingReadCount > 0) {
+    ++_storageGeneration;
+    if (snapshotID) {
+      _snapshotGenerations[snapshotID] = @(_storageGeneration);
+    } else {
+      _directoryGeneration = _storageGeneration;
+    }
+  }
+
+  __weak SnapshotCache* weakSelf = self;
+  _taskRunner->PostTaskAndReply(FROM_HERE, base::BindOnce(task),
+                                base::BindOnce(^{
+                                  [weakSelf storageTaskCompletedForSnapshotID:
+                                                snapshotID];
+                                }));
+}
+
+- (void)storageTaskCompletedForSnapshotID:(NSString*)snapshotID {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(_sequenceChecker);
+  if (snapshotID) {
+    [_pendingSnapshotIDs removeObject:snapshotID];
+  } else {
+    DCHECK_GT(_pendingDirectoryOperationCount, 0);
+    --_pendingDirectoryOperationCount;
+  }
+}
+
+// Runs |block| reading the storage of |snapshotID| in the background, then
+// |reply| with its result. The read runs on |_readTaskRunner|, unless a
+// modification of that storage is pending, in which case it is sequenced
+// after it on |_taskRunner|. If the storage of |snapshotID| is modified
+// before the read completes, its result is dropped and |block| is run again.
+- (void)readImageForSnapshotID:(NSString*)snapshotID
+                    usingBlock:(UIImage* (^)())block
+                         reply:(void (^)(UIImage*))reply {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(_sequenceChecker);
+  DCHECK(_taskRunner);
+  const bool hasPendingOperation =
+      _pendingDirectoryOperationCount > 0 ||
+      [_pendingSnapshotIDs countForObject:snapshotID] > 0;
+  base::TaskRunner* taskRunner =
+      hasPendingOperation ? _taskRunner.get() : _readTaskRunner.get();
+
+  ++_pendingReadCount;
+  const NSUInteger generation = _storageGeneration;
+  __weak SnapshotCache* weakSelf = self;
+  base::PostTaskAndReplyWithResult(
+      taskRunner, FROM_HERE, base::BindOnce(block),
+      base::BindOnce(^(UIImage* image) {
+        SnapshotCache* strongSelf = weakSelf;
+        if (strongSelf && ![strongSelf readCompletedForSnapshotID:snapshotID
+                                                       generation:generation]) {
+          [strongSelf readImageForSnapshotID:snapshotID
+                                  usingBlock:block
+                                       reply:reply];
+          return;
+        }
+        reply(image);
+      }));
+}
+
+// Called when a read of |snapshotID| started at |generation| completed.
+// Returns whether its result is up to date, i.e. whether the storage of
+// |snapshotID| was not modified since, or the cache was shut down.
+- (BOOL)readCompletedForSnapshotID:(NSString*)snapshotID
+                        generation:(NSUInteger)generation {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(_sequenceChecker);
+  DCHECK_GT(_pendingReadCount, 0);
+  const BOOL upToDate =
+      !_taskRunner || (_directoryGeneration <= generation &&
+                       [_snapshotGenerations[snapshotID] unsignedIntegerValue] <=
+                           generation);
+  if (--_pendingReadCount == 0)
+    [_snapshotGenerations removeAllObjects];
+  return upToDate;
+}
+
 - (void)createStorageIfNecessary {
   DCHECK_CALLED_ON_VALID_SEQUENCE(_sequenceChecker);
   if (!_taskRunner)
     return;
   // Copy ivars used by the block so that it does not reference |self|.
   const base::FilePath cacheDirectory = _cacheDirectory;
+  scoped_refptr<SnapshotIndex> index = _index;
+  ProceduralBlock createDirectory = ^{
+    // This is a NO-OP if the directory already exists.
+    if (!base::CreateDirectory(cacheDirectory)) {
+      DLOG(ERROR) << "Error creating snapshot storage "
+                  << cacheDirectory.AsUTF8Unsafe();
+      return;
+    }
+    LoadIndex(index.get(), cacheDirectory);
+  };
+  [self postStorageTaskForSnapshotID:nil task:createDirectory];
+}
+
+// Saves the index of the snapshots on disk.
+- (void)saveIndex {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(_sequenceChecker);
+  if (!_taskRunner)
+    return;
+  scoped_refptr<SnapshotIndex> index = _index;
   _taskRunner->PostTask(FROM_HERE, base::BindOnce(^{
-                          // This is a NO-OP if the directory already exists.
-                          if (!base::CreateDirectory(cacheDirectory)) {
-                            DLOG(ERROR) << "Error creating snapshot storage "
-                                        << cacheDirectory.AsUTF8Unsafe();
-                          }
+                          index->Save();
                         }));
 }
 
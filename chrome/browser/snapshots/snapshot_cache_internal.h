@@ -18,6 +18,8 @@ class FilePath;
 - (base::FilePath)imagePathForSnapshotID:(NSString*)snapshotID;
 // Returns filepath to the greyscale snapshot of |snapshotID|.
 - (base::FilePath)greyImagePathForSnapshotID:(NSString*)snapshotID;
+// Returns filepath to the thumbnail of |snapshotID|.
+- (base::FilePath)thumbnailPathForSnapshotID:(NSString*)snapshotID;
 @end
 
 #endif  // IOS_CHROME_BROWSER_SNAPSHOTS_SNAPSHOT_CACHE_INTERNAL_H_
@@ -0,0 +1,147 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/chrome/browser/snapshots/snapshot_cache.h"
+
+#import <UIKit/UIKit.h>
+
+#include <string>
+
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/task/thread_pool/thread_pool_instance.h"
+#include "base/test/scoped_feature_list.h"
+#include "base/timer/elapsed_timer.h"
+#include "ios/chrome/browser/snapshots/features.h"
+#include "ios/chrome/test/base/perf_test_ios.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace {
+
+// Number of snapshots displayed in the tab grid.
+const int kTabCount = 200;
+
+// Size of the snapshots, in points, similar to a phone screen.
+const CGFloat kSnapshotWidth = 375;
+const CGFloat kSnapshotHeight = 812;
+
+// Number of rectangles drawn in each snapshot so that it does not compress
+// unrealistically well.
+const int kRectangleCount = 50;
+
+// Returns the ID of the snapshot at |index|.
+NSString* GetSnapshotID(int index) {
+  return [NSString stringWithFormat:@"SnapshotID-%d", index];
+}
+
+// Returns an image filled with random rectangles.
+UIImage* GenerateRandomImage(CGFloat scale) {
+  UIGraphicsBeginImageContextWithOptions(
+      CGSizeMake(kSnapshotWidth, kSnapshotHeight), /*opaque=*/YES, scale);
+  CGContextRef context = UIGraphicsGetCurrentContext();
+  for (int i = 0; i < kRectangleCount; ++i) {
+    CGContextSetRGBFillColor(context, rand() / CGFloat(RAND_MAX),
+                             rand() / CGFloat(RAND_MAX),
+                             rand() / CGFloat(RAND_MAX), 1.0);
+    CGContextFillRect(context,
+                      CGRectMake(rand() % static_cast<int>(kSnapshotWidth),
+                                 rand() % static_cast<int>(kSnapshotHeight),
+                                 rand() % 200, rand() % 200));
+  }
+  UIImage* image = UIGraphicsGetImageFromCurrentImageContext();
+  UIGraphicsEndImageContext();
+  return image;
+}
+
+// Draws |image| in a small context, which forces it to be decoded like when it
+// is first displayed in the tab grid.
+void DrawImage(UIImage* image) {
+  UIGraphicsBeginImageContextWithOptions(CGSizeMake(1, 1), /*opaque=*/YES, 1);
+  [image drawInRect:CGRectMake(0, 0, 1, 1)];
+  UIGraphicsEndImageContext();
+}
+
+class SnapshotCachePerfTest : public PerfTest {
+ protected:
+  SnapshotCachePerfTest() : PerfTest("Snapshot cache") {}
+
+  // Flushes the tasks posted by the snapshot cache.
+  void FlushRunLoops() {
+    base::ThreadPoolInstance::Get()->FlushForTesting();
+    base::RunLoop().RunUntilIdle();
+  }
+
+  // Saves |kTabCount| snapshots, then measures the size on disk, and the time
+  // needed to retrieve and draw all the snapshots displayed in the tab grid
+  // from a cache without any image in memory.
+  void MeasureTabGrid(bool thumbnails) {
+    base::test::ScopedFeatureList scoped_feature_list;
+    if (thumbnails) {
+      scoped_feature_list.InitAndEnableFeature(kSnapshotThumbnails);
+    } else {
+      scoped_feature_list.InitAndDisableFeature(kSnapshotThumbnails);
+    }
+    const std::string prefix = thumbnails ? "Thumbnails " : "Legacy ";
+
+    base::ScopedTempDir temp_directory;
+    ASSERT_TRUE(temp_directory.CreateUniqueTempDir());
+    SnapshotCache* cache =
+        [[SnapshotCache alloc] initWithStoragePath:temp_directory.GetPath()];
+    srand(1);
+    for (int i = 0; i < kTabCount; ++i) {
+      [cache setImage:GenerateRandomImage([cache snapshotScaleForDevice])
+          withSnapshotID:GetSnapshotID(i)];
+      [cache saveGreyInBackgroundForSnapshotID:GetSnapshotID(i)];
+    }
+    FlushRunLoops();
+    [cache shutdown];
+
+    LogPerfValue(prefix + "size on disk for " +
+                     base::NumberToString(kTabCount) + " snapshots",
+                 base::ComputeDirectorySize(temp_directory.GetPath()),
+                 "bytes");
+
+    // Use a new cache so that no snapshot is in memory.
+    cache =
+        [[SnapshotCache alloc] initWithStoragePath:temp_directory.GetPath()];
+    FlushRunLoops();
+
+    base::RunLoop run_loop;
+    __block int remaining_count = kTabCount;
+    __block base::TimeDelta draw_time;
+    base::RepeatingClosure quit_closure = run_loop.QuitClosure();
+    base::ElapsedTimer timer;
+    for (int i = 0; i < kTabCount; ++i) {
+      [cache retrieveThumbnailForSnapshotID:GetSnapshotID(i)
+                                   callback:^(UIImage* image) {
+                                     EXPECT_TRUE(image);
+                                     base::ElapsedTimer draw_timer;
+                                     DrawImage(image);
+                                     draw_time += draw_timer.Elapsed();
+                                     if (--remaining_count == 0)
+                                       quit_closure.Run();
+                                   }];
+    }
+    run_loop.Run();
+    LogPerfTiming(prefix + "time to populate the grid with " +
+                      base::NumberToString(kTabCount) + " snapshots",
+                  timer.Elapsed());
+    LogPerfTiming(prefix + "main thread decode time for " +
+                      base::NumberToString(kTabCount) + " snapshots",
+                  draw_time);
+    [cache shutdown];
+  }
+};
+
+TEST_F(SnapshotCachePerfTest, TabGrid) {
+  MeasureTabGrid(/*thumbnails=*/false);
+  MeasureTabGrid(/*thumbnails=*/true);
+}
+
+}  // namespace
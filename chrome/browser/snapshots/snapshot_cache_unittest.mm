@@ -13,9 +13,12 @@
 #include "base/location.h"
 #include "base/mac/scoped_cftyperef.h"
 #include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
 #include "base/strings/sys_string_conversions.h"
 #include "base/task/thread_pool/thread_pool_instance.h"
+#include "base/test/scoped_feature_list.h"
 #include "base/time/time.h"
+#include "ios/chrome/browser/snapshots/features.h"
 #import "ios/chrome/browser/snapshots/snapshot_cache_internal.h"
 #import "ios/chrome/browser/snapshots/snapshot_cache_observer.h"
 #include "ios/web/public/test/web_task_environment.h"
@@ -426,6 +429,54 @@ TEST_F(SnapshotCacheTest, Purge) {
   }
 }
 
+// Tests that the disk usage accounts for the snapshots written to disk, and
+// that the least recently updated snapshots are purged beyond the disk budget,
+// except the pinned and visible ones.
+TEST_F(SnapshotCacheTest, DiskUsageAndBudget) {
+  LoadAllColorImagesIntoCache(true);
+  SnapshotCache* cache = GetSnapshotCache();
+
+  __block int64_t disk_usage = -1;
+  [cache retrieveDiskUsage:^(int64_t bytes) {
+    disk_usage = bytes;
+  }];
+  FlushRunLoops();
+  EXPECT_GT(disk_usage, 0);
+  EXPECT_EQ(base::ComputeDirectorySize(scoped_temp_directory_.GetPath()),
+            disk_usage);
+
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeatureWithParameters(
+      kSnapshotCacheDiskBudget, {{kSnapshotCacheDiskBudgetMB.name, "0"}});
+
+  // None of the snapshots is old enough to be purged, and all of them are
+  // live, but only the pinned and the visible ones fit in the budget.
+  NSString* pinnedID = [snapshotIDs_ objectAtIndex:0];
+  NSString* visibleID = [snapshotIDs_ objectAtIndex:1];
+  cache.pinnedIDs = [NSSet setWithObject:pinnedID];
+  cache.visibleID = visibleID;
+  [cache purgeCacheOlderThan:(base::Time::Now() - base::TimeDelta::FromHours(1))
+                     keeping:[NSSet setWithArray:snapshotIDs_]];
+  FlushRunLoops();
+
+  for (NSString* snapshotID in snapshotIDs_) {
+    EXPECT_EQ([snapshotID isEqualToString:pinnedID] ||
+                  [snapshotID isEqualToString:visibleID],
+              base::PathExists([cache imagePathForSnapshotID:snapshotID]));
+  }
+  [cache retrieveDiskUsage:^(int64_t bytes) {
+    disk_usage = bytes;
+  }];
+  FlushRunLoops();
+  int64_t pinned_file_size = 0;
+  int64_t visible_file_size = 0;
+  ASSERT_TRUE(base::GetFileSize([cache imagePathForSnapshotID:pinnedID],
+                                &pinned_file_size));
+  ASSERT_TRUE(base::GetFileSize([cache imagePathForSnapshotID:visibleID],
+                                &visible_file_size));
+  EXPECT_EQ(pinned_file_size + visible_file_size, disk_usage);
+}
+
 // Loads the color images into the cache, and pins two of them.  Ensures that
 // only the two pinned IDs remain in memory after a memory warning.
 TEST_F(SnapshotCacheTest, HandleMemoryWarning) {
@@ -452,6 +503,27 @@ TEST_F(SnapshotCacheTest, HandleMemoryWarning) {
   FlushRunLoops();
 }
 
+// Tests that the statistics of the in-memory cache account for the images
+// evicted from, and found in, the cache.
+TEST_F(SnapshotCacheTest, MemoryStatistics) {
+  LoadAllColorImagesIntoCache(false);
+
+  SnapshotCache* cache = GetSnapshotCache();
+  SnapshotCacheMemoryStatistics statistics = [cache memoryStatistics];
+  EXPECT_EQ(kSnapshotCount - [cache lruCacheMaxSize],
+            statistics.eviction_count);
+  EXPECT_GT(statistics.total_bytes, 0u);
+  EXPECT_EQ(0u, statistics.byte_budget);
+
+  NSString* lastID = [snapshotIDs_ lastObject];
+  [cache retrieveImageForSnapshotID:lastID
+                           callback:^(UIImage*){
+                           }];
+  EXPECT_EQ(statistics.hit_count + 1, [cache memoryStatistics].hit_count);
+
+  FlushRunLoops();
+}
+
 // Tests that createGreyCache creates the grey snapshots in the background,
 // from color images in the in-memory cache.  When the grey images are all
 // loaded into memory, tests that the request to retrieve the grey snapshot
@@ -619,6 +691,141 @@ TEST_F(SnapshotCacheTest, SizeAndScalePreservation) {
   EXPECT_TRUE(callbackComplete);
 }
 
+// Verifies that, with the thumbnails enabled, a smaller thumbnail is saved
+// along with the snapshot, is used for retrieving the thumbnail, and that no
+// grey snapshot is saved to disk.
+TEST_F(SnapshotCacheTest, Thumbnails) {
+  const int kMaxPixelSize = 16;
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeatureWithParameters(
+      kSnapshotThumbnails,
+      {{kSnapshotThumbnailsMaxPixelSize.name,
+        base::NumberToString(kMaxPixelSize)}});
+
+  // The feature is read when the cache is created.
+  base::ScopedTempDir temp_directory;
+  ASSERT_TRUE(temp_directory.CreateUniqueTempDir());
+  SnapshotCache* cache =
+      [[SnapshotCache alloc] initWithStoragePath:temp_directory.GetPath()];
+
+  UIImage* image = GenerateRandomImage(CGSizeMake(200, 100));
+  NSString* const kSnapshotID = @"foo";
+  [cache setImage:image withSnapshotID:kSnapshotID];
+  [cache saveGreyInBackgroundForSnapshotID:kSnapshotID];
+  FlushRunLoops();
+
+  const base::FilePath image_path = [cache imagePathForSnapshotID:kSnapshotID];
+  const base::FilePath thumbnail_path =
+      [cache thumbnailPathForSnapshotID:kSnapshotID];
+  int64_t image_file_size = 0;
+  int64_t thumbnail_file_size = 0;
+  ASSERT_TRUE(base::GetFileSize(image_path, &image_file_size));
+  ASSERT_TRUE(base::GetFileSize(thumbnail_path, &thumbnail_file_size));
+  EXPECT_LT(thumbnail_file_size, image_file_size);
+  EXPECT_FALSE(
+      base::PathExists([cache greyImagePathForSnapshotID:kSnapshotID]));
+
+  __block UIImage* thumbnail = nil;
+  [cache retrieveThumbnailForSnapshotID:kSnapshotID
+                               callback:^(UIImage* image_from_disk) {
+                                 thumbnail = image_from_disk;
+                               }];
+  FlushRunLoops();
+  ASSERT_TRUE(thumbnail);
+  EXPECT_LE(thumbnail.size.width * thumbnail.scale, kMaxPixelSize);
+  EXPECT_LE(thumbnail.size.height * thumbnail.scale, kMaxPixelSize);
+
+  // The grey snapshot is generated from the color one.
+  __block UIImage* grey_image = nil;
+  [cache retrieveGreyImageForSnapshotID:kSnapshotID
+                               callback:^(UIImage* image_from_disk) {
+                                 grey_image = image_from_disk;
+                               }];
+  FlushRunLoops();
+  EXPECT_TRUE(grey_image);
+
+  [cache removeImageWithSnapshotID:kSnapshotID];
+  FlushRunLoops();
+  EXPECT_FALSE(base::PathExists(image_path));
+  EXPECT_FALSE(base::PathExists(thumbnail_path));
+
+  [cache shutdown];
+}
+
+// Verifies that a thumbnail read completing after the snapshot is removed does
+// not return nor cache the removed thumbnail.
+TEST_F(SnapshotCacheTest, ThumbnailReadBeforeRemoval) {
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeature(kSnapshotThumbnails);
+
+  base::ScopedTempDir temp_directory;
+  ASSERT_TRUE(temp_directory.CreateUniqueTempDir());
+  SnapshotCache* cache =
+      [[SnapshotCache alloc] initWithStoragePath:temp_directory.GetPath()];
+
+  NSString* const kSnapshotID = @"foo";
+  [cache setImage:GenerateRandomImage(CGSizeMake(200, 100))
+      withSnapshotID:kSnapshotID];
+  FlushRunLoops();
+
+  __block BOOL callbackComplete = NO;
+  __block UIImage* thumbnail = nil;
+  [cache retrieveThumbnailForSnapshotID:kSnapshotID
+                               callback:^(UIImage* image_from_disk) {
+                                 thumbnail = image_from_disk;
+                                 callbackComplete = YES;
+                               }];
+  [cache removeImageWithSnapshotID:kSnapshotID];
+  FlushRunLoops();
+  EXPECT_TRUE(callbackComplete);
+  EXPECT_FALSE(thumbnail);
+
+  callbackComplete = NO;
+  [cache retrieveThumbnailForSnapshotID:kSnapshotID
+                               callback:^(UIImage* image_from_disk) {
+                                 thumbnail = image_from_disk;
+                                 callbackComplete = YES;
+                               }];
+  FlushRunLoops();
+  EXPECT_TRUE(callbackComplete);
+  EXPECT_FALSE(thumbnail);
+
+  [cache shutdown];
+}
+
+// Verifies that the thumbnail saved while the thumbnails were enabled is
+// deleted when the snapshot is saved again with the thumbnails disabled.
+TEST_F(SnapshotCacheTest, ThumbnailDeletedWhenDisabled) {
+  base::ScopedTempDir temp_directory;
+  ASSERT_TRUE(temp_directory.CreateUniqueTempDir());
+  NSString* const kSnapshotID = @"foo";
+  base::FilePath thumbnail_path;
+  {
+    base::test::ScopedFeatureList scoped_feature_list;
+    scoped_feature_list.InitAndEnableFeature(kSnapshotThumbnails);
+    SnapshotCache* cache =
+        [[SnapshotCache alloc] initWithStoragePath:temp_directory.GetPath()];
+    [cache setImage:GenerateRandomImage(CGSizeMake(200, 100))
+        withSnapshotID:kSnapshotID];
+    FlushRunLoops();
+    thumbnail_path = [cache thumbnailPathForSnapshotID:kSnapshotID];
+    EXPECT_TRUE(base::PathExists(thumbnail_path));
+    [cache shutdown];
+  }
+
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndDisableFeature(kSnapshotThumbnails);
+  SnapshotCache* cache =
+      [[SnapshotCache alloc] initWithStoragePath:temp_directory.GetPath()];
+  [cache setImage:GenerateRandomImage(CGSizeMake(200, 100))
+      withSnapshotID:kSnapshotID];
+  FlushRunLoops();
+  EXPECT_TRUE(base::PathExists([cache imagePathForSnapshotID:kSnapshotID]));
+  EXPECT_FALSE(base::PathExists(thumbnail_path));
+
+  [cache shutdown];
+}
+
 // Verifies that retina-scale images are deleted properly.
 TEST_F(SnapshotCacheTest, DeleteRetinaImages) {
   SnapshotCache* cache = GetSnapshotCache();
@@ -28,6 +28,9 @@ void SnapshotCacheWebStateListObserver::WebStateActivatedAt(
     web::WebState* new_web_state,
     int active_index,
     ActiveWebStateChangeReason reason) {
+  snapshot_cache_.visibleID =
+      new_web_state ? TabIdTabHelper::FromWebState(new_web_state)->tab_id()
+                    : nil;
   if (reason == ActiveWebStateChangeReason::Replaced)
     return;
 
@@ -99,6 +99,16 @@ BOOL ViewHierarchyContainsWKWebView(UIView* view) {
   }
 }
 
+- (void)retrieveThumbnail:(void (^)(UIImage*))callback {
+  DCHECK(callback);
+  if (self.snapshotCache) {
+    [self.snapshotCache retrieveThumbnailForSnapshotID:self.tabID
+                                              callback:callback];
+  } else {
+    callback(nil);
+  }
+}
+
 - (void)retrieveGreySnapshot:(void (^)(UIImage*))callback {
   DCHECK(callback);
 
@@ -0,0 +1,95 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef IOS_CHROME_BROWSER_SNAPSHOTS_SNAPSHOT_INDEX_H_
+#define IOS_CHROME_BROWSER_SNAPSHOTS_SNAPSHOT_INDEX_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/sequence_checker.h"
+#include "base/time/time.h"
+
+// Index of the snapshots stored on disk, with the size and the modification
+// time of their files, so that the storage can be measured, purged and
+// migrated without enumerating the snapshot directory.
+//
+// The index is saved to disk explicitly. The saved file is deleted as soon as
+// the index is modified, so that a stale index is never loaded after a crash
+// and is instead rebuilt from the directory.
+//
+// Can be created on any sequence, but must then be used on a single one.
+class SnapshotIndex : public base::RefCountedThreadSafe<SnapshotIndex> {
+ public:
+  // The files of a snapshot.
+  struct Entry {
+    // Total size of the files, in bytes.
+    int64_t size = 0;
+    // Most recent modification time of the files.
+    base::Time last_modified;
+  };
+
+  // |file_path| is the path of the file where the index is saved.
+  explicit SnapshotIndex(const base::FilePath& file_path);
+
+  // Loads the index saved to disk, replacing the current entries. Returns
+  // false, leaving the index empty, if there is no valid saved index.
+  bool Load();
+
+  // Saves the index to disk, if it was modified since it was last loaded or
+  // saved.
+  void Save();
+
+  // Sets the entry for |snapshot_id|. An entry of size 0 is removed.
+  void Update(const std::string& snapshot_id, const Entry& entry);
+
+  // Removes the entry for |snapshot_id|, if any.
+  void Remove(const std::string& snapshot_id);
+
+  // Removes all the entries.
+  void Clear();
+
+  // Returns the entry for |snapshot_id|, or null if there is none.
+  const Entry* Find(const std::string& snapshot_id) const;
+
+  // Returns the IDs of the least recently modified entries to remove for the
+  // total size to fit in |byte_budget|. The entries of |kept_ids| are never
+  // returned, even if the budget can't be respected without them.
+  std::vector<std::string> GetEntriesToEvict(
+      int64_t byte_budget,
+      const std::set<std::string>& kept_ids) const;
+
+  const std::map<std::string, Entry>& entries() const { return entries_; }
+
+  // Total size of the entries, in bytes.
+  int64_t total_size() const { return total_size_; }
+
+ private:
+  friend class base::RefCountedThreadSafe<SnapshotIndex>;
+  ~SnapshotIndex();
+
+  // Deletes the saved index on the first modification since the index was
+  // loaded or saved.
+  void WillModify();
+
+  const base::FilePath file_path_;
+  std::map<std::string, Entry> entries_;
+  int64_t total_size_ = 0;
+
+  // Whether the index was modified since it was last loaded or saved.
+  bool modified_ = true;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+
+  DISALLOW_COPY_AND_ASSIGN(SnapshotIndex);
+};
+
+#endif  // IOS_CHROME_BROWSER_SNAPSHOTS_SNAPSHOT_INDEX_H_
@@ -0,0 +1,217 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ios/chrome/browser/snapshots/snapshot_index.h"
+
+#import <Foundation/Foundation.h>
+
+#include <algorithm>
+
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/strings/sys_string_conversions.h"
+#include "base/threading/scoped_blocking_call.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace {
+
+// Keys of the saved index.
+NSString* const kVersionKey = @"version";
+NSString* const kEntriesKey = @"entries";
+
+// Version of the format of the saved index, to be incremented on incompatible
+// changes.
+const int kCurrentVersion = 1;
+
+// Returns |time| as a number of microseconds, which is precise enough to be
+// compared with the modification times of files.
+NSNumber* NumberFromTime(base::Time time) {
+  return @(time.ToDeltaSinceWindowsEpoch().InMicroseconds());
+}
+
+base::Time TimeFromNumber(NSNumber* number) {
+  return base::Time::FromDeltaSinceWindowsEpoch(
+      base::TimeDelta::FromMicroseconds(number.longLongValue));
+}
+
+}  // namespace
+
+SnapshotIndex::SnapshotIndex(const base::FilePath& file_path)
+    : file_path_(file_path) {
+  DETACH_FROM_SEQUENCE(sequence_checker_);
+}
+
+SnapshotIndex::~SnapshotIndex() = default;
+
+bool SnapshotIndex::Load() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  base::ScopedBlockingCall scoped_blocking_call(FROM_HERE,
+                                                base::BlockingType::MAY_BLOCK);
+  entries_.clear();
+  total_size_ = 0;
+  modified_ = true;
+
+  NSData* data = [NSData
+      dataWithContentsOfFile:base::SysUTF8ToNSString(file_path_.value())];
+  if (!data)
+    return false;
+
+  NSError* error = nil;
+  NSDictionary* root =
+      [NSPropertyListSerialization propertyListWithData:data
+                                                options:NSPropertyListImmutable
+                                                 format:nullptr
+                                                  error:&error];
+  if (![root isKindOfClass:[NSDictionary class]] ||
+      ![root[kVersionKey] isEqual:@(kCurrentVersion)]) {
+    DLOG_IF(ERROR, error) << "Error reading snapshot index "
+                          << base::SysNSStringToUTF8([error description]);
+    return false;
+  }
+
+  NSDictionary* entries = root[kEntriesKey];
+  if (![entries isKindOfClass:[NSDictionary class]])
+    return false;
+
+  std::map<std::string, Entry> loaded_entries;
+  int64_t loaded_total_size = 0;
+  for (NSString* snapshot_id in entries) {
+    NSArray* values = entries[snapshot_id];
+    if (![snapshot_id isKindOfClass:[NSString class]] ||
+        ![values isKindOfClass:[NSArray class]] || values.count != 2 ||
+        ![values[0] isKindOfClass:[NSNumber class]] ||
+        ![values[1] isKindOfClass:[NSNumber class]]) {
+      return false;
+    }
+    Entry entry;
+    entry.size = [values[0] longLongValue];
+    entry.last_modified = TimeFromNumber(values[1]);
+    if (entry.size <= 0)
+      return false;
+    loaded_entries[base::SysNSStringToUTF8(snapshot_id)] = entry;
+    loaded_total_size += entry.size;
+  }
+
+  entries_.swap(loaded_entries);
+  total_size_ = loaded_total_size;
+  modified_ = false;
+  return true;
+}
+
+void SnapshotIndex::Save() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  if (!modified_)
+    return;
+
+  NSMutableDictionary* entries =
+      [NSMutableDictionary dictionaryWithCapacity:entries_.size()];
+  for (const auto& pair : entries_) {
+    entries[base::SysUTF8ToNSString(pair.first)] =
+        @[ @(pair.second.size), NumberFromTime(pair.second.last_modified) ];
+  }
+  NSDictionary* root = @{
+    kVersionKey : @(kCurrentVersion),
+    kEntriesKey : entries,
+  };
+
+  NSError* error = nil;
+  NSData* data = [NSPropertyListSerialization
+      dataWithPropertyList:root
+                    format:NSPropertyListBinaryFormat_v1_0
+                   options:0
+                     error:&error];
+  if (!data) {
+    DLOG(ERROR) << "Error serializing snapshot index "
+                << base::SysNSStringToUTF8([error description]);
+    return;
+  }
+
+  base::ScopedBlockingCall scoped_blocking_call(FROM_HERE,
+                                                base::BlockingType::MAY_BLOCK);
+  if (![data writeToFile:base::SysUTF8ToNSString(file_path_.value())
+                 options:(NSDataWritingAtomic |
+                          NSDataWritingFileProtectionComplete)
+                   error:&error]) {
+    DLOG(ERROR) << "Error writing snapshot index "
+                << base::SysNSStringToUTF8([error description]);
+    return;
+  }
+  modified_ = false;
+}
+
+void SnapshotIndex::Update(const std::string& snapshot_id,
+                           const Entry& entry) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  if (entry.size <= 0) {
+    Remove(snapshot_id);
+    return;
+  }
+
+  WillModify();
+  Entry& indexed_entry = entries_[snapshot_id];
+  total_size_ += entry.size - indexed_entry.size;
+  indexed_entry = entry;
+}
+
+void SnapshotIndex::Remove(const std::string& snapshot_id) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  auto it = entries_.find(snapshot_id);
+  if (it == entries_.end())
+    return;
+
+  WillModify();
+  total_size_ -= it->second.size;
+  entries_.erase(it);
+}
+
+void SnapshotIndex::Clear() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  WillModify();
+  entries_.clear();
+  total_size_ = 0;
+}
+
+const SnapshotIndex::Entry* SnapshotIndex::Find(
+    const std::string& snapshot_id) const {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  auto it = entries_.find(snapshot_id);
+  return it != entries_.end() ? &it->second : nullptr;
+}
+
+std::vector<std::string> SnapshotIndex::GetEntriesToEvict(
+    int64_t byte_budget,
+    const std::set<std::string>& kept_ids) const {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  std::vector<std::string> evicted_ids;
+  if (total_size_ <= byte_budget)
+    return evicted_ids;
+
+  std::vector<std::pair<base::Time, std::string>> candidates;
+  for (const auto& pair : entries_) {
+    if (kept_ids.find(pair.first) == kept_ids.end())
+      candidates.emplace_back(pair.second.last_modified, pair.first);
+  }
+  std::sort(candidates.begin(), candidates.end());
+
+  int64_t size = total_size_;
+  for (const auto& candidate : candidates) {
+    if (size <= byte_budget)
+      break;
+    size -= entries_.at(candidate.second).size;
+    evicted_ids.push_back(candidate.second);
+  }
+  return evicted_ids;
+}
+
+void SnapshotIndex::WillModify() {
+  if (modified_)
+    return;
+  modified_ = true;
+  base::ScopedBlockingCall scoped_blocking_call(FROM_HERE,
+                                                base::BlockingType::MAY_BLOCK);
+  base::DeleteFile(file_path_);
+}
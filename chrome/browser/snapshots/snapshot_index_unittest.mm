@@ -0,0 +1,115 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ios/chrome/browser/snapshots/snapshot_index.h"
+
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/platform_test.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace {
+
+// Returns an entry of |size| bytes, modified |age| ago.
+SnapshotIndex::Entry CreateEntry(int64_t size, base::TimeDelta age) {
+  SnapshotIndex::Entry entry;
+  entry.size = size;
+  entry.last_modified = base::Time::Now() - age;
+  return entry;
+}
+
+class SnapshotIndexTest : public PlatformTest {
+ protected:
+  void SetUp() override {
+    PlatformTest::SetUp();
+    ASSERT_TRUE(temp_directory_.CreateUniqueTempDir());
+    file_path_ = temp_directory_.GetPath().Append("SnapshotIndex.plist");
+  }
+
+  base::ScopedTempDir temp_directory_;
+  base::FilePath file_path_;
+};
+
+// Tests that the total size follows the updates and removals.
+TEST_F(SnapshotIndexTest, TotalSize) {
+  auto index = base::MakeRefCounted<SnapshotIndex>(file_path_);
+  EXPECT_EQ(0, index->total_size());
+
+  index->Update("a", CreateEntry(10, base::TimeDelta()));
+  index->Update("b", CreateEntry(20, base::TimeDelta()));
+  EXPECT_EQ(30, index->total_size());
+
+  index->Update("a", CreateEntry(5, base::TimeDelta()));
+  EXPECT_EQ(25, index->total_size());
+  ASSERT_TRUE(index->Find("a"));
+  EXPECT_EQ(5, index->Find("a")->size);
+
+  // An empty entry is removed.
+  index->Update("b", CreateEntry(0, base::TimeDelta()));
+  EXPECT_EQ(5, index->total_size());
+  EXPECT_FALSE(index->Find("b"));
+
+  index->Remove("a");
+  index->Remove("unknown");
+  EXPECT_EQ(0, index->total_size());
+  EXPECT_TRUE(index->entries().empty());
+}
+
+// Tests that a saved index is loaded with the same entries, and that the saved
+// index is deleted as soon as the index is modified.
+TEST_F(SnapshotIndexTest, SaveAndLoad) {
+  auto index = base::MakeRefCounted<SnapshotIndex>(file_path_);
+  EXPECT_FALSE(index->Load());
+
+  const SnapshotIndex::Entry entry =
+      CreateEntry(10, base::TimeDelta::FromHours(1));
+  index->Update("a", entry);
+  index->Update("b", CreateEntry(20, base::TimeDelta()));
+  index->Save();
+  EXPECT_TRUE(base::PathExists(file_path_));
+
+  auto loaded_index = base::MakeRefCounted<SnapshotIndex>(file_path_);
+  ASSERT_TRUE(loaded_index->Load());
+  EXPECT_EQ(2U, loaded_index->entries().size());
+  EXPECT_EQ(30, loaded_index->total_size());
+  ASSERT_TRUE(loaded_index->Find("a"));
+  EXPECT_EQ(entry.size, loaded_index->Find("a")->size);
+  EXPECT_EQ(entry.last_modified, loaded_index->Find("a")->last_modified);
+
+  loaded_index->Remove("b");
+  EXPECT_FALSE(base::PathExists(file_path_));
+  EXPECT_FALSE(index->Load());
+}
+
+// Tests that an invalid saved index is not loaded.
+TEST_F(SnapshotIndexTest, LoadInvalidFile) {
+  ASSERT_TRUE(base::WriteFile(file_path_, "invalid"));
+  auto index = base::MakeRefCounted<SnapshotIndex>(file_path_);
+  EXPECT_FALSE(index->Load());
+  EXPECT_TRUE(index->entries().empty());
+}
+
+// Tests that the least recently modified entries are evicted to fit in the
+// budget, except the kept ones.
+TEST_F(SnapshotIndexTest, GetEntriesToEvict) {
+  auto index = base::MakeRefCounted<SnapshotIndex>(file_path_);
+  index->Update("oldest", CreateEntry(10, base::TimeDelta::FromHours(3)));
+  index->Update("older", CreateEntry(10, base::TimeDelta::FromHours(2)));
+  index->Update("old", CreateEntry(10, base::TimeDelta::FromHours(1)));
+  index->Update("new", CreateEntry(10, base::TimeDelta()));
+
+  EXPECT_TRUE(index->GetEntriesToEvict(40, {}).empty());
+  EXPECT_EQ(std::vector<std::string>({"oldest", "older"}),
+            index->GetEntriesToEvict(20, {}));
+  EXPECT_EQ(std::vector<std::string>({"older", "old"}),
+            index->GetEntriesToEvict(20, {"oldest"}));
+  EXPECT_EQ(std::vector<std::string>({"oldest", "older", "old", "new"}),
+            index->GetEntriesToEvict(0, {}));
+}
+
+}  // namespace
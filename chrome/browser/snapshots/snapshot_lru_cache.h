@@ -10,6 +10,9 @@
 // This class implements a cache with a limited size. Once the cache reach its
 // size limit, it will start to evict items in a Least Recently Used order
 // (where the term "used" is determined in terms of query to the cache).
+// The size of the cache can be limited in number of items, in bytes, or both.
+// In the latter case, each item is charged its cost, which defaults to the
+// size of the decoded bitmap for UIImages.
 @interface SnapshotLRUCache : NSObject
 
 // The maximum amount of items that the cache can hold before starting to
@@ -17,13 +20,35 @@
 // amount of elements (i.e. never evicts).
 @property(nonatomic, readonly) NSUInteger maxCacheSize;
 
+// The maximum total cost of the items that the cache can hold before starting
+// to evict. The value 0 is used to signify that the cost of the items is not
+// limited. The most recently added item is never evicted to respect the
+// budget, even if its cost alone exceeds it.
+@property(nonatomic, readonly) NSUInteger byteBudget;
+
+// The total cost of the items currently held by the cache.
+@property(nonatomic, readonly) NSUInteger totalCost;
+
+// Statistics of the cache since its creation: number of queries that found an
+// item, number of queries that did not, and number of items evicted to respect
+// the size limits or the memory pressure (explicit removals are not counted).
+@property(nonatomic, readonly) NSUInteger hitCount;
+@property(nonatomic, readonly) NSUInteger missCount;
+@property(nonatomic, readonly) NSUInteger evictionCount;
+
 // Use the initWithCacheSize: designated initializer. The is no good general
 // default value for the cache size.
 - (instancetype)init NS_UNAVAILABLE;
 
 // |maxCacheSize| value is used to specify the maximum amount of items that the
 // cache can hold before starting to evict items.
+- (instancetype)initWithCacheSize:(NSUInteger)maxCacheSize;
+
+// |maxCacheSize| and |byteBudget| values are used to specify the maximum
+// amount and the maximum total cost of the items that the cache can hold
+// before starting to evict items.
 - (instancetype)initWithCacheSize:(NSUInteger)maxCacheSize
+                       byteBudget:(NSUInteger)byteBudget
     NS_DESIGNATED_INITIALIZER;
 
 // Query the cache for an item corresponding to the |key|. Returns nil if there
@@ -33,15 +58,28 @@
 // Adds the pair |key|, |obj| to the cache. If the value of the maxCacheSize
 // property is non zero, the cache may evict an elements if the maximum cache
 // size is reached. If the |key| is already present in the cache, the value for
-// that key is replaced by |object|.
+// that key is replaced by |object|. The cost of |object| is the size of its
+// decoded bitmap if it is a UIImage, 0 otherwise.
 - (void)setObject:(id<NSObject>)object forKey:(NSObject*)key;
 
+// Adds the pair |key|, |obj| to the cache, charging it |cost| bytes against
+// the byte budget.
+- (void)setObject:(id<NSObject>)object
+           forKey:(NSObject*)key
+             cost:(NSUInteger)cost;
+
 // Remove the key, value pair corresponding to the given |key|.
 - (void)removeObjectForKey:(id<NSObject>)key;
 
 // Remove all objects from the cache.
 - (void)removeAllObjects;
 
+// Evicts the least recently used items, except the ones for |keys|, until the
+// total cost is at most |fraction| of the byte budget. If the cache has no
+// byte budget, evicts all the items except the ones for |keys|.
+- (void)reduceToFraction:(double)fraction
+    ofByteBudgetKeepingKeys:(NSSet*)keys;
+
 // Returns the amount of items that the cache currently hold.
 - (NSUInteger)count;
 
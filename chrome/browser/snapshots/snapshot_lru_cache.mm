@@ -4,12 +4,15 @@
 
 #import "ios/chrome/browser/snapshots/snapshot_lru_cache.h"
 
+#import <UIKit/UIKit.h>
 #include <stddef.h>
 
 #include <memory>
 #include <unordered_map>
 
+#include "base/check_op.h"
 #include "base/containers/mru_cache.h"
+#include "base/mac/foundation_util.h"
 #include "base/macros.h"
 
 #if !defined(__has_feature) || !__has_feature(objc_arc)
@@ -34,47 +37,106 @@ struct MRUCacheNSObjectHashMap {
       std::unordered_map<KeyType, ValueType, HashType, NSObjectEqualTo>;
 };
 
+// An item of the cache and the cost charged for it.
+struct CacheEntry {
+  id<NSObject> object;
+  NSUInteger cost;
+};
+
 using NSObjectMRUCache = base::MRUCacheBase<id<NSObject>,
-                                            id<NSObject>,
+                                            CacheEntry,
                                             NSObjectHash,
                                             MRUCacheNSObjectHashMap>;
 
+// Returns the cost of |object|: the size of the decoded bitmap for UIImages,
+// 0 for other objects.
+NSUInteger CostForObject(id<NSObject> object) {
+  if (![object isKindOfClass:[UIImage class]])
+    return 0;
+  UIImage* image = base::mac::ObjCCastStrict<UIImage>(object);
+  if (CGImageRef cg_image = image.CGImage)
+    return CGImageGetBytesPerRow(cg_image) * CGImageGetHeight(cg_image);
+  // Assume 4 bytes per pixel for images that are not backed by a CGImage.
+  return static_cast<NSUInteger>(image.size.width * image.scale) *
+         static_cast<NSUInteger>(image.size.height * image.scale) * 4;
+}
+
 }  // namespace
 
 @implementation SnapshotLRUCache {
+  // Eviction is done by this class to account for the byte budget, so
+  // |_cache| never evicts by itself.
   std::unique_ptr<NSObjectMRUCache> _cache;
 }
 
 - (instancetype)initWithCacheSize:(NSUInteger)maxCacheSize {
+  return [self initWithCacheSize:maxCacheSize byteBudget:0];
+}
+
+- (instancetype)initWithCacheSize:(NSUInteger)maxCacheSize
+                       byteBudget:(NSUInteger)byteBudget {
   if ((self = [super init])) {
-    _cache = std::make_unique<NSObjectMRUCache>(maxCacheSize);
+    _cache =
+        std::make_unique<NSObjectMRUCache>(NSObjectMRUCache::NO_AUTO_EVICT);
+    _maxCacheSize = maxCacheSize;
+    _byteBudget = byteBudget;
   }
   return self;
 }
 
-- (NSUInteger)maxCacheSize {
-  return _cache->max_size();
-}
-
 - (id)objectForKey:(id<NSObject>)key {
   auto it = _cache->Get(key);
-  if (it == _cache->end())
+  if (it == _cache->end()) {
+    _missCount++;
     return nil;
-  return it->second;
+  }
+  _hitCount++;
+  return it->second.object;
 }
 
 - (void)setObject:(id<NSObject>)value forKey:(NSObject*)key {
-  _cache->Put([key copy], value);
+  [self setObject:value forKey:key cost:CostForObject(value)];
+}
+
+- (void)setObject:(id<NSObject>)value
+           forKey:(NSObject*)key
+             cost:(NSUInteger)cost {
+  [self removeObjectForKey:key];
+  _cache->Put([key copy], CacheEntry{value, cost});
+  _totalCost += cost;
+  [self evictToLimits];
 }
 
 - (void)removeObjectForKey:(id<NSObject>)key {
   auto it = _cache->Peek(key);
-  if (it != _cache->end())
-    _cache->Erase(it);
+  if (it == _cache->end())
+    return;
+  DCHECK_GE(_totalCost, it->second.cost);
+  _totalCost -= it->second.cost;
+  _cache->Erase(it);
 }
 
 - (void)removeAllObjects {
   _cache->Clear();
+  _totalCost = 0;
+}
+
+- (void)reduceToFraction:(double)fraction
+    ofByteBudgetKeepingKeys:(NSSet*)keys {
+  DCHECK_GE(fraction, 0.0);
+  DCHECK_LE(fraction, 1.0);
+  const NSUInteger targetCost =
+      static_cast<NSUInteger>(_byteBudget * fraction);
+  auto it = _cache->rbegin();
+  while (it != _cache->rend()) {
+    if (_byteBudget && _totalCost <= targetCost)
+      break;
+    if ([keys containsObject:it->first]) {
+      ++it;
+      continue;
+    }
+    it = [self evictItemAt:it];
+  }
 }
 
 - (NSUInteger)count {
@@ -85,4 +147,29 @@ using NSObjectMRUCache = base::MRUCacheBase<id<NSObject>,
   return _cache->empty();
 }
 
+#pragma mark - Private
+
+// Evicts the least recently used items until the cache respects its size
+// limits. The most recently used item is always kept.
+- (void)evictToLimits {
+  auto it = _cache->rbegin();
+  while (_cache->size() > 1) {
+    const bool overCount = _maxCacheSize && _cache->size() > _maxCacheSize;
+    const bool overBudget = _byteBudget && _totalCost > _byteBudget;
+    if (!overCount && !overBudget)
+      break;
+    it = [self evictItemAt:it];
+  }
+}
+
+// Evicts the item at |it| and returns the iterator to the next least recently
+// used item.
+- (NSObjectMRUCache::reverse_iterator)evictItemAt:
+    (NSObjectMRUCache::reverse_iterator)it {
+  DCHECK_GE(_totalCost, it->second.cost);
+  _totalCost -= it->second.cost;
+  _evictionCount++;
+  return _cache->Erase(it);
+}
+
 @end
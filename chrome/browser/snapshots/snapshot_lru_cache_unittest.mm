@@ -3,6 +3,9 @@
 // found in the LICENSE file.
 
 #import "ios/chrome/browser/snapshots/snapshot_lru_cache.h"
+
+#import <UIKit/UIKit.h>
+
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/platform_test.h"
 
@@ -48,4 +51,103 @@ TEST_F(SnapshotLRUCacheTest, Basic) {
   EXPECT_TRUE([cache isEmpty]);
 }
 
+// Tests that the cache evicts the least recently used items to respect its
+// byte budget.
+TEST_F(SnapshotLRUCacheTest, ByteBudget) {
+  SnapshotLRUCache* cache = [[SnapshotLRUCache alloc] initWithCacheSize:0
+                                                             byteBudget:100];
+
+  [cache setObject:@"Value 1" forKey:@"VALUE 1" cost:40];
+  [cache setObject:@"Value 2" forKey:@"VALUE 2" cost:40];
+  EXPECT_EQ(80u, [cache totalCost]);
+
+  // Use the first value so that the second one is evicted.
+  EXPECT_TRUE([cache objectForKey:@"VALUE 1"]);
+  [cache setObject:@"Value 3" forKey:@"VALUE 3" cost:40];
+  EXPECT_EQ(2u, [cache count]);
+  EXPECT_EQ(80u, [cache totalCost]);
+  EXPECT_FALSE([cache objectForKey:@"VALUE 2"]);
+  EXPECT_TRUE([cache objectForKey:@"VALUE 1"]);
+
+  // Replacing a value updates its cost.
+  [cache setObject:@"Value 3" forKey:@"VALUE 3" cost:10];
+  EXPECT_EQ(50u, [cache totalCost]);
+
+  // An item larger than the budget evicts all the others but is kept.
+  [cache setObject:@"Value 4" forKey:@"VALUE 4" cost:200];
+  EXPECT_EQ(1u, [cache count]);
+  EXPECT_EQ(200u, [cache totalCost]);
+
+  [cache removeObjectForKey:@"VALUE 4"];
+  EXPECT_EQ(0u, [cache totalCost]);
+}
+
+// Tests that UIImages are charged the size of their decoded bitmap.
+TEST_F(SnapshotLRUCacheTest, ImageCost) {
+  SnapshotLRUCache* cache = [[SnapshotLRUCache alloc] initWithCacheSize:0
+                                                             byteBudget:0];
+  UIGraphicsImageRendererFormat* format =
+      [UIGraphicsImageRendererFormat preferredFormat];
+  format.scale = 1;
+  format.opaque = YES;
+  UIGraphicsImageRenderer* renderer =
+      [[UIGraphicsImageRenderer alloc] initWithSize:CGSizeMake(10, 20)
+                                             format:format];
+  UIImage* image =
+      [renderer imageWithActions:^(UIGraphicsImageRendererContext* context){
+      }];
+
+  [cache setObject:image forKey:@"IMAGE"];
+  EXPECT_EQ(CGImageGetBytesPerRow(image.CGImage) * 20, [cache totalCost]);
+  EXPECT_GE([cache totalCost], 10u * 20u * 4u);
+}
+
+// Tests that reducing the cache keeps the requested keys and the most recently
+// used items that fit in the fraction of the budget.
+TEST_F(SnapshotLRUCacheTest, ReduceToFractionOfByteBudget) {
+  SnapshotLRUCache* cache = [[SnapshotLRUCache alloc] initWithCacheSize:0
+                                                             byteBudget:100];
+  for (int i = 0; i < 5; i++) {
+    NSString* key = [NSString stringWithFormat:@"VALUE %d", i];
+    [cache setObject:key forKey:key cost:20];
+  }
+
+  [cache reduceToFraction:0.5
+      ofByteBudgetKeepingKeys:[NSSet setWithObject:@"VALUE 0"]];
+  EXPECT_EQ(40u, [cache totalCost]);
+  EXPECT_TRUE([cache objectForKey:@"VALUE 0"]);
+  EXPECT_TRUE([cache objectForKey:@"VALUE 4"]);
+  EXPECT_FALSE([cache objectForKey:@"VALUE 3"]);
+
+  // Without a byte budget, all the items but the kept ones are evicted.
+  SnapshotLRUCache* countCache = [[SnapshotLRUCache alloc] initWithCacheSize:3];
+  [countCache setObject:@"Value 1" forKey:@"VALUE 1"];
+  [countCache setObject:@"Value 2" forKey:@"VALUE 2"];
+  [countCache reduceToFraction:0.5
+      ofByteBudgetKeepingKeys:[NSSet setWithObject:@"VALUE 1"]];
+  EXPECT_EQ(1u, [countCache count]);
+  EXPECT_TRUE([countCache objectForKey:@"VALUE 1"]);
+}
+
+// Tests that hits, misses and evictions are counted.
+TEST_F(SnapshotLRUCacheTest, Statistics) {
+  SnapshotLRUCache* cache = [[SnapshotLRUCache alloc] initWithCacheSize:2];
+
+  [cache setObject:@"Value 1" forKey:@"VALUE 1"];
+  [cache setObject:@"Value 2" forKey:@"VALUE 2"];
+  [cache setObject:@"Value 3" forKey:@"VALUE 3"];
+  EXPECT_EQ(1u, [cache evictionCount]);
+
+  EXPECT_FALSE([cache objectForKey:@"VALUE 1"]);
+  EXPECT_TRUE([cache objectForKey:@"VALUE 2"]);
+  EXPECT_TRUE([cache objectForKey:@"VALUE 3"]);
+  EXPECT_EQ(2u, [cache hitCount]);
+  EXPECT_EQ(1u, [cache missCount]);
+
+  // Explicit removals are not evictions.
+  [cache removeObjectForKey:@"VALUE 2"];
+  [cache removeAllObjects];
+  EXPECT_EQ(1u, [cache evictionCount]);
+}
+
 }  // namespace
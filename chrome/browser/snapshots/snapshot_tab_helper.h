@@ -47,6 +47,11 @@ class SnapshotTabHelper : public web::WebStateObserver,
   // snapshot does not exist.
   void RetrieveColorSnapshot(void (^callback)(UIImage*));
 
+  // Retrieves a downscaled color snapshot for the current page, suitable for
+  // the tab grid, invoking |callback| with the image. Behaves like
+  // RetrieveColorSnapshot() otherwise.
+  void RetrieveThumbnailSnapshot(void (^callback)(UIImage*));
+
   // Retrieves a grey snapshot for the current page, invoking |callback|
   // with the image. The callback may be called synchronously is there is
   // a cached snapshot available in memory, otherwise it will be invoked
@@ -65,6 +65,11 @@ void SnapshotTabHelper::RetrieveColorSnapshot(void (^callback)(UIImage*)) {
   [snapshot_generator_ retrieveSnapshot:callback];
 }
 
+void SnapshotTabHelper::RetrieveThumbnailSnapshot(
+    void (^callback)(UIImage*)) {
+  [snapshot_generator_ retrieveThumbnail:callback];
+}
+
 void SnapshotTabHelper::RetrieveGreySnapshot(void (^callback)(UIImage*)) {
   [snapshot_generator_ retrieveGreySnapshot:callback];
 }
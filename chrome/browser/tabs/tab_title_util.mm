@@ -22,7 +22,10 @@ namespace tab_util {
 
 NSString* GetTabTitle(web::WebState* web_state) {
   base::string16 title;
-  web::NavigationManager* navigationManager = web_state->GetNavigationManager();
+  // An unrealized WebState has no download task, do not realize it only to
+  // get its title.
+  web::NavigationManager* navigationManager =
+      web_state->IsRealized() ? web_state->GetNavigationManager() : nullptr;
   DownloadManagerTabHelper* downloadTabHelper =
       DownloadManagerTabHelper::FromWebState(web_state);
   if (navigationManager && downloadTabHelper &&
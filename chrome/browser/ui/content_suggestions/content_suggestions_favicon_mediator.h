@@ -58,6 +58,10 @@ initWithContentService:
 - (void)fetchFaviconForSuggestions:(nonnull ContentSuggestionsItem*)item
                         inCategory:(ntp_snippets::Category)category;
 
+// Records the usage of the LargeIconCache since the mediator was created.
+// Called when the NTP is dismissed.
+- (void)recordLargeIconCacheMetrics;
+
 @end
 
 #endif  // IOS_CHROME_BROWSER_UI_CONTENT_SUGGESTIONS_CONTENT_SUGGESTIONS_FAVICON_MEDIATOR_H_
@@ -5,10 +5,12 @@
 #import "ios/chrome/browser/ui/content_suggestions/content_suggestions_favicon_mediator.h"
 
 #include "base/bind.h"
+#include "base/metrics/histogram_functions.h"
 #include "components/favicon/core/large_icon_service.h"
 #include "components/ntp_snippets/category.h"
 #include "components/ntp_snippets/content_suggestions_service.h"
 #include "ios/chrome/browser/application_context.h"
+#include "ios/chrome/browser/favicon/large_icon_cache.h"
 #import "ios/chrome/browser/ui/content_suggestions/cells/content_suggestions_item.h"
 #import "ios/chrome/browser/ui/content_suggestions/cells/content_suggestions_most_visited_item.h"
 #import "ios/chrome/browser/ui/content_suggestions/content_suggestions_data_sink.h"
@@ -32,6 +34,13 @@ const CGFloat kMostVisitedFaviconSize = 48;
 // Size below which the provider returns a colored tile instead of an image.
 const CGFloat kMostVisitedFaviconMinimalSize = 32;
 
+// Histograms recording the usage of the LargeIconCache while the NTP is shown.
+const char kLargeIconCacheHitRateHistogram[] = "IOS.NTP.LargeIconCache.HitRate";
+const char kLargeIconCacheEvictionCountHistogram[] =
+    "IOS.NTP.LargeIconCache.EvictionCount";
+const char kLargeIconCacheMemoryUsageHistogram[] =
+    "IOS.NTP.LargeIconCache.MemoryUsage";
+
 }  // namespace
 
 @interface ContentSuggestionsFaviconMediator () {
@@ -39,6 +48,10 @@ const CGFloat kMostVisitedFaviconMinimalSize = 32;
   // copied when receiving the first non-empty data. This copy is used to make
   // sure only the data received the first time is logged, and only once.
   ntp_tiles::NTPTilesVector _mostVisitedDataForLogging;
+  // Cache of the most visited favicons, and its statistics when the mediator
+  // was created, so that only the usage of this NTP is recorded.
+  LargeIconCache* _largeIconCache;
+  LargeIconCache::Stats _largeIconCacheInitialStats;
 }
 
 // The ContentSuggestionsService, serving suggestions.
@@ -78,6 +91,9 @@ initWithContentService:(ntp_snippets::ContentSuggestionsService*)contentService
     // overwritten for every new results and the size of the favicon fetched for
     // the suggestions is much smaller.
     _mostVisitedAttributesProvider.cache = largeIconCache;
+    _largeIconCache = largeIconCache;
+    if (_largeIconCache)
+      _largeIconCacheInitialStats = _largeIconCache->stats();
 
     _suggestionsAttributesProvider = [[FaviconAttributesProvider alloc]
         initWithFaviconSize:kSuggestionsFaviconSize
@@ -138,6 +154,27 @@ initWithContentService:(ntp_snippets::ContentSuggestionsService*)contentService
                                                         completion:completion];
 }
 
+- (void)recordLargeIconCacheMetrics {
+  if (!_largeIconCache)
+    return;
+
+  const LargeIconCache::Stats& stats = _largeIconCache->stats();
+  const int hitCount = stats.hit_count - _largeIconCacheInitialStats.hit_count;
+  const int lookupCount = hitCount + stats.miss_count -
+                          _largeIconCacheInitialStats.miss_count;
+  if (lookupCount > 0) {
+    base::UmaHistogramPercentage(kLargeIconCacheHitRateHistogram,
+                                 100 * hitCount / lookupCount);
+  }
+  base::UmaHistogramCounts100(
+      kLargeIconCacheEvictionCountHistogram,
+      stats.eviction_count - _largeIconCacheInitialStats.eviction_count);
+  base::UmaHistogramMemoryKB(
+      kLargeIconCacheMemoryUsageHistogram,
+      static_cast<int>(_largeIconCache->memory_usage() / 1024));
+  _largeIconCacheInitialStats = stats;
+}
+
 #pragma mark - Private.
 
 // Fetches the favicon image for the |item|, based on the
@@ -210,6 +210,7 @@ const NSInteger kMaxNumMostVisitedTiles = 4;
 }
 
 - (void)disconnect {
+  [self.faviconMediator recordLargeIconCacheMetrics];
   _prefChangeRegistrar.reset();
   _prefObserverBridge.reset();
   _discoverFeedProviderObserverBridge.reset();
@@ -83,6 +83,8 @@
         completion(attributes);
       };
 
+  CGFloat faviconSize = [UIScreen mainScreen].scale * self.faviconSize;
+  CGFloat minFaviconSize = [UIScreen mainScreen].scale * self.minSize;
   __weak FaviconAttributesProvider* weakSelf = self;
   void (^faviconBlockSaveToCache)(const favicon_base::LargeIconResult&) =
       ^(const favicon_base::LargeIconResult& result) {
@@ -91,21 +93,19 @@
         FaviconAttributesProvider* strongSelf = weakSelf;
         if (strongSelf.cache &&
             (result.bitmap.is_valid() || result.fallback_icon_style)) {
-          strongSelf.cache->SetCachedResult(blockURL, result);
+          strongSelf.cache->SetCachedResult(blockURL, faviconSize, result);
         }
       };
 
   if (self.cache) {
-    std::unique_ptr<favicon_base::LargeIconResult> cached_result =
-        self.cache->GetCachedResult(URL);
-    if (cached_result) {
-      faviconBlock(*cached_result);
+    scoped_refptr<const LargeIconCacheEntry> cached_entry =
+        self.cache->GetCachedResult(URL, faviconSize);
+    if (cached_entry) {
+      faviconBlock(cached_entry->result());
     }
   }
 
   // Always call LargeIconService in case the favicon was updated.
-  CGFloat faviconSize = [UIScreen mainScreen].scale * self.faviconSize;
-  CGFloat minFaviconSize = [UIScreen mainScreen].scale * self.minSize;
   self.largeIconService->GetLargeIconRawBitmapOrFallbackStyleForPageUrl(
       URL, minFaviconSize, faviconSize,
       base::BindRepeating(faviconBlockSaveToCache), &_faviconTaskTracker);
@@ -9,6 +9,7 @@
 #include <memory>
 
 #include "base/bind.h"
+#include "base/metrics/histogram_functions.h"
 #include "base/metrics/histogram_macros.h"
 #include "base/metrics/user_metrics.h"
 #include "base/metrics/user_metrics_action.h"
@@ -19,6 +20,8 @@
 #include "ios/chrome/browser/chrome_url_constants.h"
 #import "ios/chrome/browser/chrome_url_util.h"
 #import "ios/chrome/browser/drag_and_drop/drag_item_util.h"
+#import "ios/chrome/browser/favicon/favicon_loader.h"
+#include "ios/chrome/browser/favicon/ios_chrome_favicon_loader_factory.h"
 #include "ios/chrome/browser/main/browser.h"
 #import "ios/chrome/browser/main/browser_util.h"
 #import "ios/chrome/browser/sessions/session_restoration_browser_agent.h"
@@ -35,10 +38,12 @@
 #import "ios/chrome/browser/web_state_list/web_state_list_observer_bridge.h"
 #import "ios/chrome/browser/web_state_list/web_state_list_serialization.h"
 #include "ios/chrome/browser/web_state_list/web_state_opener.h"
+#import "ios/chrome/common/ui/favicon/favicon_attributes.h"
 #import "ios/web/public/navigation/navigation_manager.h"
 #import "ios/web/public/web_state.h"
 #import "ios/web/public/web_state_observer_bridge.h"
 #import "net/base/mac/url_conversions.h"
+#include "ui/gfx/favicon_size.h"
 #include "ui/gfx/image/image.h"
 
 #if !defined(__has_feature) || !__has_feature(objc_arc)
@@ -136,6 +141,10 @@ web::WebState* GetWebStateWithId(WebStateList* web_state_list,
   std::unique_ptr<web::WebStateObserverBridge> _webStateObserverBridge;
   std::unique_ptr<ScopedObserver<web::WebState, web::WebStateObserver>>
       _scopedWebStateObserver;
+  // The snapshot cache whose statistics were last recorded, and the
+  // statistics at that time.
+  __weak SnapshotCache* _recordedSnapshotCache;
+  SnapshotCacheMemoryStatistics _recordedSnapshotCacheStatistics;
 }
 
 - (instancetype)initWithConsumer:(id<GridConsumer>)consumer {
@@ -507,7 +516,7 @@ web::WebState* GetWebStateWithId(WebStateList* web_state_list,
   }
   web::WebState* webState = GetWebStateWithId(self.webStateList, identifier);
   if (webState) {
-    SnapshotTabHelper::FromWebState(webState)->RetrieveColorSnapshot(
+    SnapshotTabHelper::FromWebState(webState)->RetrieveThumbnailSnapshot(
         ^(UIImage* image) {
           completion(image);
         });
@@ -530,6 +539,20 @@ web::WebState* GetWebStateWithId(WebStateList* web_state_list,
           : [UIImage imageNamed:@"default_world_favicon_regular"];
   completion(defaultFavicon);
 
+  // Unrealized WebStates have no navigation item to hold their favicon, load
+  // it from the favicon database instead of realizing them.
+  if (!webState->IsRealized()) {
+    ChromeBrowserState* browserState =
+        ChromeBrowserState::FromBrowserState(webState->GetBrowserState());
+    IOSChromeFaviconLoaderFactory::GetForBrowserState(browserState)
+        ->FaviconForPageUrlOrHost(webState->GetVisibleURL(), gfx::kFaviconSize,
+                                  ^(FaviconAttributes* attributes) {
+                                    if (attributes.faviconImage)
+                                      completion(attributes.faviconImage);
+                                  });
+    return;
+  }
+
   favicon::FaviconDriver* faviconDriver =
       favicon::WebFaviconDriver::FromWebState(webState);
   if (faviconDriver) {
@@ -555,6 +578,7 @@ web::WebState* GetWebStateWithId(WebStateList* web_state_list,
 
 - (void)clearPreloadedSnapshots {
   [self.appearanceCache removeAllObjects];
+  [self recordSnapshotCacheStatistics];
 }
 
 #pragma mark - Private
@@ -585,6 +609,35 @@ web::WebState* GetWebStateWithId(WebStateList* web_state_list,
   }
 }
 
+// Records the statistics of the in-memory snapshot cache since they were last
+// recorded, used to tune its limits.
+- (void)recordSnapshotCacheStatistics {
+  SnapshotCache* snapshotCache = self.snapshotCache;
+  if (!snapshotCache)
+    return;
+  SnapshotCacheMemoryStatistics statistics = [snapshotCache memoryStatistics];
+  // The counters of the cache are cumulative, only record what changed since
+  // the previous report.
+  SnapshotCacheMemoryStatistics previous;
+  if (snapshotCache == _recordedSnapshotCache)
+    previous = _recordedSnapshotCacheStatistics;
+  _recordedSnapshotCache = snapshotCache;
+  _recordedSnapshotCacheStatistics = statistics;
+
+  const NSUInteger hitCount = statistics.hit_count - previous.hit_count;
+  const NSUInteger lookupCount =
+      hitCount + statistics.miss_count - previous.miss_count;
+  if (lookupCount) {
+    base::UmaHistogramPercentage("IOS.TabGrid.SnapshotCache.HitRatio",
+                                 static_cast<int>(hitCount * 100 / lookupCount));
+  }
+  base::UmaHistogramCounts1000(
+      "IOS.TabGrid.SnapshotCache.Evictions",
+      statistics.eviction_count - previous.eviction_count);
+  base::UmaHistogramMemoryKB("IOS.TabGrid.SnapshotCache.Size",
+                             statistics.total_bytes / 1024);
+}
+
 // Returns a SnapshotCache for the current browser.
 - (SnapshotCache*)snapshotCache {
   if (!self.browser)
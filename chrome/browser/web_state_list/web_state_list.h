@@ -6,6 +6,7 @@
 #define IOS_CHROME_BROWSER_WEB_STATE_LIST_WEB_STATE_LIST_H_
 
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "base/auto_reset.h"
@@ -171,13 +172,20 @@ class WebStateList {
   // Adds an observer to the model.
   void AddObserver(WebStateListObserver* observer);
 
+  // Adds an observer to the model which is notified once per batch operation,
+  // with WebStateListChangedInBatch(), instead of once per mutation performed
+  // during the batch. Outside of batch operations, it is notified like the
+  // other observers.
+  void AddCoalescingObserver(WebStateListObserver* observer);
+
   // Removes an observer from the model.
   void RemoveObserver(WebStateListObserver* observer);
 
   // Performs mutating operations on the WebStateList as batched operation.
   // The observers will be notified by WillBeginBatchOperation() before the
   // |operation| callback is executed and by BatchOperationEnded() after it
-  // has completed.
+  // has completed. The coalescing observers are notified of the changes by
+  // WebStateListChangedInBatch() just before BatchOperationEnded().
   void PerformBatchOperation(base::OnceCallback<void(WebStateList*)> operation);
 
   // Invalid index.
@@ -243,6 +251,23 @@ class WebStateList {
   // specified index to null.
   void ClearOpenersReferencing(int index);
 
+  // Returns the index of |wrapper|, which must be in the list.
+  int GetIndexOfWrapper(const WebStateWrapper* wrapper) const;
+
+  // Records that the index of the WebStates starting at |index| changed.
+  void InvalidateIndicesFrom(int index);
+
+  // Adds or removes |wrapper| from the index of the WebStates by opener.
+  void AddToOpenerIndex(WebStateWrapper* wrapper);
+  void RemoveFromOpenerIndex(WebStateWrapper* wrapper);
+
+  // Invokes |method| with |args| on the observers to notify of a mutation:
+  // all of them, except the coalescing observers during a batch operation.
+  template <typename... MethodArgs, typename... Args>
+  void NotifyObservers(void (WebStateListObserver::*method)(WebStateList*,
+                                                             MethodArgs...),
+                       Args&&... args);
+
   // Notify the observers if the active WebState change. |reason| is the value
   // passed to the WebStateListObservers.
   void NotifyIfActiveWebStateChanged(web::WebState* old_web_state,
@@ -272,6 +297,29 @@ class WebStateList {
   // List of observers notified of changes to the model.
   base::ObserverList<WebStateListObserver, true>::Unchecked observers_;
 
+  // List of observers notified once per batch operation.
+  base::ObserverList<WebStateListObserver, true>::Unchecked
+      coalescing_observers_;
+
+  // Index before the current batch operation of each WebState, or -1 for the
+  // WebStates inserted during the batch. Only tracked if there are coalescing
+  // observers.
+  std::vector<int> batch_origins_;
+  bool tracking_batch_origins_ = false;
+
+  // Index of the active WebState before the current batch operation.
+  int batch_initial_active_index_ = kInvalidIndex;
+
+  // Secondary indexes of |web_state_wrappers_|, so that lookups don't need to
+  // scan the whole list. The wrappers cache their index, which is valid for
+  // the wrappers before |first_stale_index_| and updated lazily for the
+  // others.
+  std::unordered_map<const web::WebState*, WebStateWrapper*>
+      wrappers_by_web_state_;
+  std::unordered_map<const web::WebState*, std::vector<WebStateWrapper*>>
+      wrappers_by_opener_;
+  mutable int first_stale_index_ = 0;
+
   // Index of the currently active WebState, kInvalidIndex if no such WebState.
   int active_index_ = kInvalidIndex;
 
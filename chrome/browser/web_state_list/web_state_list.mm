@@ -9,6 +9,7 @@
 
 #include "base/auto_reset.h"
 #include "base/check_op.h"
+#import "ios/chrome/browser/web_state_list/web_state_list_change_set.h"
 #import "ios/chrome/browser/web_state_list/web_state_list_delegate.h"
 #import "ios/chrome/browser/web_state_list/web_state_list_observer.h"
 #import "ios/chrome/browser/web_state_list/web_state_list_order_controller.h"
@@ -42,6 +43,11 @@ class WebStateList::WebStateWrapper {
 
   web::WebState* web_state() const { return web_state_.get(); }
 
+  // Gets and sets the index of the wrapper in the WebStateList, as last
+  // computed by the WebStateList.
+  int index() const { return index_; }
+  void set_index(int index) { index_ = index; }
+
   // Returns ownership of the wrapped WebState.
   std::unique_ptr<web::WebState> ReleaseWebState();
 
@@ -65,6 +71,7 @@ class WebStateList::WebStateWrapper {
  private:
   std::unique_ptr<web::WebState> web_state_;
   WebStateOpener opener_;
+  int index_ = kInvalidIndex;
 
   DISALLOW_COPY_AND_ASSIGN(WebStateWrapper);
 };
@@ -152,11 +159,10 @@ web::WebState* WebStateList::GetWebStateAt(int index) const {
 
 int WebStateList::GetIndexOfWebState(const web::WebState* web_state) const {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
-  for (int index = 0; index < count(); ++index) {
-    if (web_state_wrappers_[index]->web_state() == web_state)
-      return index;
-  }
-  return kInvalidIndex;
+  auto iter = wrappers_by_web_state_.find(web_state);
+  if (iter == wrappers_by_web_state_.end())
+    return kInvalidIndex;
+  return GetIndexOfWrapper(iter->second);
 }
 
 int WebStateList::GetIndexOfWebStateWithURL(const GURL& url) const {
@@ -189,7 +195,10 @@ void WebStateList::SetOpenerOfWebStateAt(int index, WebStateOpener opener) {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
   DCHECK(ContainsIndex(index));
   DCHECK(ContainsIndex(GetIndexOfWebState(opener.opener)));
-  web_state_wrappers_[index]->SetOpener(opener);
+  WebStateWrapper* wrapper = web_state_wrappers_[index].get();
+  RemoveFromOpenerIndex(wrapper);
+  wrapper->SetOpener(opener);
+  AddToOpenerIndex(wrapper);
 }
 
 int WebStateList::GetIndexOfNextWebStateOpenedBy(const web::WebState* opener,
@@ -286,15 +295,21 @@ int WebStateList::InsertWebStateImpl(int index,
   delegate_->WillAddWebState(web_state.get());
 
   web::WebState* web_state_ptr = web_state.get();
-  web_state_wrappers_.insert(
-      web_state_wrappers_.begin() + index,
-      std::make_unique<WebStateWrapper>(std::move(web_state)));
+  auto wrapper = std::make_unique<WebStateWrapper>(std::move(web_state));
+  wrapper->set_index(index);
+  wrappers_by_web_state_[web_state_ptr] = wrapper.get();
+  web_state_wrappers_.insert(web_state_wrappers_.begin() + index,
+                             std::move(wrapper));
+  InvalidateIndicesFrom(index);
 
   if (active_index_ >= index)
     ++active_index_;
 
-  for (auto& observer : observers_)
-    observer.WebStateInsertedAt(this, web_state_ptr, index, activating);
+  if (tracking_batch_origins_)
+    batch_origins_.insert(batch_origins_.begin() + index, -1);
+
+  NotifyObservers(&WebStateListObserver::WebStateInsertedAt, web_state_ptr,
+                  index, activating);
 
   if (opener.opener)
     SetOpenerOfWebStateAt(index, opener);
@@ -319,6 +334,7 @@ void WebStateList::MoveWebStateAtImpl(int from_index, int to_index) {
   web_state_wrappers_.erase(web_state_wrappers_.begin() + from_index);
   web_state_wrappers_.insert(web_state_wrappers_.begin() + to_index,
                              std::move(web_state_wrapper));
+  InvalidateIndicesFrom(std::min(from_index, to_index));
 
   if (active_index_ == from_index) {
     active_index_ = to_index;
@@ -330,8 +346,14 @@ void WebStateList::MoveWebStateAtImpl(int from_index, int to_index) {
       active_index_ += delta;
   }
 
-  for (auto& observer : observers_)
-    observer.WebStateMoved(this, web_state, from_index, to_index);
+  if (tracking_batch_origins_) {
+    const int origin = batch_origins_[from_index];
+    batch_origins_.erase(batch_origins_.begin() + from_index);
+    batch_origins_.insert(batch_origins_.begin() + to_index, origin);
+  }
+
+  NotifyObservers(&WebStateListObserver::WebStateMoved, web_state, from_index,
+                  to_index);
 }
 
 std::unique_ptr<web::WebState> WebStateList::ReplaceWebStateAtImpl(
@@ -345,14 +367,20 @@ std::unique_ptr<web::WebState> WebStateList::ReplaceWebStateAtImpl(
 
   ClearOpenersReferencing(index);
 
+  WebStateWrapper* wrapper = web_state_wrappers_[index].get();
+  RemoveFromOpenerIndex(wrapper);
+  wrappers_by_web_state_.erase(wrapper->web_state());
+
   web::WebState* web_state_ptr = web_state.get();
   std::unique_ptr<web::WebState> old_web_state =
-      web_state_wrappers_[index]->ReplaceWebState(std::move(web_state));
+      wrapper->ReplaceWebState(std::move(web_state));
+  wrappers_by_web_state_[web_state_ptr] = wrapper;
 
-  for (auto& observer : observers_) {
-    observer.WebStateReplacedAt(this, old_web_state.get(), web_state_ptr,
-                                index);
-  }
+  if (tracking_batch_origins_)
+    batch_origins_[index] = -1;
+
+  NotifyObservers(&WebStateListObserver::WebStateReplacedAt,
+                  old_web_state.get(), web_state_ptr, index);
 
   // When the active WebState is replaced, notify the observers as nearly
   // all of them needs to treat a replacement as the selection changed.
@@ -368,8 +396,8 @@ std::unique_ptr<web::WebState> WebStateList::DetachWebStateAtImpl(int index) {
   DCHECK(locked_);
   DCHECK(ContainsIndex(index));
   web::WebState* web_state = web_state_wrappers_[index]->web_state();
-  for (auto& observer : observers_)
-    observer.WillDetachWebStateAt(this, web_state, index);
+  NotifyObservers(&WebStateListObserver::WillDetachWebStateAt, web_state,
+                  index);
 
   // Update the active index to prevent observer from seeing an invalid WebState
   // as the active one but only send the WebStateActivatedAt notification after
@@ -379,15 +407,21 @@ std::unique_ptr<web::WebState> WebStateList::DetachWebStateAtImpl(int index) {
       order_controller_->DetermineNewActiveIndex(active_index_, index);
 
   ClearOpenersReferencing(index);
+  WebStateWrapper* wrapper = web_state_wrappers_[index].get();
+  RemoveFromOpenerIndex(wrapper);
+  wrappers_by_web_state_.erase(web_state);
+
   std::unique_ptr<web::WebState> detached_web_state =
-      web_state_wrappers_[index]->ReleaseWebState();
+      wrapper->ReleaseWebState();
   web_state_wrappers_.erase(web_state_wrappers_.begin() + index);
+  InvalidateIndicesFrom(index);
+  if (tracking_batch_origins_)
+    batch_origins_.erase(batch_origins_.begin() + index);
 
   // Check that the active element (if there is one) is valid.
   DCHECK(active_index_ == kInvalidIndex || ContainsIndex(active_index_));
 
-  for (auto& observer : observers_)
-    observer.WebStateDetachedAt(this, web_state, index);
+  NotifyObservers(&WebStateListObserver::WebStateDetachedAt, web_state, index);
 
   if (active_web_state_was_closed) {
     NotifyIfActiveWebStateChanged(web_state,
@@ -404,10 +438,8 @@ void WebStateList::CloseWebStateAtImpl(int index, int close_flags) {
   std::unique_ptr<web::WebState> detached_web_state =
       DetachWebStateAtImpl(index);
   const bool user_action = IsClosingFlagSet(close_flags, CLOSE_USER_ACTION);
-  for (auto& observer : observers_) {
-    observer.WillCloseWebStateAt(this, detached_web_state.get(), index,
-                                 user_action);
-  }
+  NotifyObservers(&WebStateListObserver::WillCloseWebStateAt,
+                  detached_web_state.get(), index, user_action);
 
   // Dropping detached_web_state will destroy it.
 }
@@ -448,9 +480,16 @@ void WebStateList::AddObserver(WebStateListObserver* observer) {
   observers_.AddObserver(observer);
 }
 
+void WebStateList::AddCoalescingObserver(WebStateListObserver* observer) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  DCHECK(!batch_operation_in_progress_);
+  coalescing_observers_.AddObserver(observer);
+}
+
 void WebStateList::RemoveObserver(WebStateListObserver* observer) {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
   observers_.RemoveObserver(observer);
+  coalescing_observers_.RemoveObserver(observer);
 }
 
 void WebStateList::PerformBatchOperation(
@@ -462,19 +501,109 @@ void WebStateList::PerformBatchOperation(
 
   for (auto& observer : observers_)
     observer.WillBeginBatchOperation(this);
+  for (auto& observer : coalescing_observers_)
+    observer.WillBeginBatchOperation(this);
+
+  // Track where each WebState comes from to compute the changes at the end.
+  const int initial_count = count();
+  tracking_batch_origins_ = coalescing_observers_.might_have_observers();
+  if (tracking_batch_origins_) {
+    batch_origins_.resize(initial_count);
+    for (int index = 0; index < initial_count; ++index)
+      batch_origins_[index] = index;
+    batch_initial_active_index_ = active_index_;
+  }
+
   if (!operation.is_null())
     std::move(operation).Run(this);
+
+  if (tracking_batch_origins_) {
+    tracking_batch_origins_ = false;
+    const bool active_web_state_changed =
+        active_index_ == kInvalidIndex
+            ? batch_initial_active_index_ != kInvalidIndex
+            : batch_origins_[active_index_] == -1 ||
+                  batch_origins_[active_index_] != batch_initial_active_index_;
+    const WebStateListChangeSet change_set(initial_count, batch_origins_,
+                                           active_web_state_changed);
+    batch_origins_.clear();
+    for (auto& observer : coalescing_observers_)
+      observer.WebStateListChangedInBatch(this, change_set);
+  }
+
   for (auto& observer : observers_)
     observer.BatchOperationEnded(this);
+  for (auto& observer : coalescing_observers_)
+    observer.BatchOperationEnded(this);
 }
 
 void WebStateList::ClearOpenersReferencing(int index) {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
   web::WebState* old_web_state = web_state_wrappers_[index]->web_state();
-  for (auto& web_state_wrapper : web_state_wrappers_) {
-    if (web_state_wrapper->opener().opener == old_web_state)
-      web_state_wrapper->SetOpener(WebStateOpener());
+  auto children = wrappers_by_opener_.find(old_web_state);
+  if (children == wrappers_by_opener_.end())
+    return;
+
+  for (WebStateWrapper* web_state_wrapper : children->second)
+    web_state_wrapper->SetOpener(WebStateOpener());
+  wrappers_by_opener_.erase(children);
+}
+
+int WebStateList::GetIndexOfWrapper(const WebStateWrapper* wrapper) const {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  // The wrappers whose index is before |first_stale_index_| are not moved by
+  // the mutations which happened since the index was computed.
+  if (wrapper->index() < first_stale_index_) {
+    DCHECK_EQ(web_state_wrappers_[wrapper->index()].get(), wrapper);
+    return wrapper->index();
   }
+
+  for (int index = first_stale_index_; index < count(); ++index)
+    web_state_wrappers_[index]->set_index(index);
+  first_stale_index_ = count();
+
+  DCHECK(ContainsIndex(wrapper->index()));
+  DCHECK_EQ(web_state_wrappers_[wrapper->index()].get(), wrapper);
+  return wrapper->index();
+}
+
+void WebStateList::InvalidateIndicesFrom(int index) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  first_stale_index_ = std::min(first_stale_index_, index);
+}
+
+void WebStateList::AddToOpenerIndex(WebStateWrapper* wrapper) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  const web::WebState* opener = wrapper->opener().opener;
+  if (opener)
+    wrappers_by_opener_[opener].push_back(wrapper);
+}
+
+void WebStateList::RemoveFromOpenerIndex(WebStateWrapper* wrapper) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  auto children = wrappers_by_opener_.find(wrapper->opener().opener);
+  if (children == wrappers_by_opener_.end())
+    return;
+
+  std::vector<WebStateWrapper*>& wrappers = children->second;
+  wrappers.erase(std::remove(wrappers.begin(), wrappers.end(), wrapper),
+                 wrappers.end());
+  if (wrappers.empty())
+    wrappers_by_opener_.erase(children);
+}
+
+template <typename... MethodArgs, typename... Args>
+void WebStateList::NotifyObservers(
+    void (WebStateListObserver::*method)(WebStateList*, MethodArgs...),
+    Args&&... args) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  for (auto& observer : observers_)
+    (observer.*method)(this, args...);
+
+  if (batch_operation_in_progress_)
+    return;
+  for (auto& observer : coalescing_observers_)
+    (observer.*method)(this, args...);
 }
 
 void WebStateList::NotifyIfActiveWebStateChanged(
@@ -485,10 +614,8 @@ void WebStateList::NotifyIfActiveWebStateChanged(
   if (old_web_state == new_web_state)
     return;
 
-  for (auto& observer : observers_) {
-    observer.WebStateActivatedAt(this, old_web_state, new_web_state,
-                                 active_index_, reason);
-  }
+  NotifyObservers(&WebStateListObserver::WebStateActivatedAt, old_web_state,
+                  new_web_state, active_index_, reason);
 }
 
 int WebStateList::GetIndexOfNthWebStateOpenedBy(const web::WebState* opener,
@@ -504,22 +631,32 @@ int WebStateList::GetIndexOfNthWebStateOpenedBy(const web::WebState* opener,
       use_group ? opener->GetNavigationManager()->GetLastCommittedItemIndex()
                 : -1;
 
-  int found_index = kInvalidIndex;
-  const int list_length = count();
-  for (int i = 1; i < list_length; ++i) {
-    const int index = (start_index + i) % list_length;
-    DCHECK_NE(index, start_index);
+  auto children = wrappers_by_opener_.find(opener);
+  if (children == wrappers_by_opener_.end())
+    return kInvalidIndex;
 
-    const auto& wrapper = web_state_wrappers_[index];
+  // Offsets from |start_index| of the matching WebStates, wrapping around the
+  // end of the list.
+  std::vector<int> offsets;
+  const int list_length = count();
+  for (const WebStateWrapper* wrapper : children->second) {
     if (!wrapper->WasOpenedBy(opener, opener_navigation_index, use_group))
       continue;
 
-    found_index = index;
-    if (--n == 0)
-      break;
+    const int offset =
+        (GetIndexOfWrapper(wrapper) - start_index + list_length) % list_length;
+    if (offset != 0)
+      offsets.push_back(offset);
   }
 
-  return found_index;
+  if (offsets.empty())
+    return kInvalidIndex;
+
+  // If there are less than |n| matching WebStates, return the last one.
+  const size_t position =
+      std::min(static_cast<size_t>(n - 1), offsets.size() - 1);
+  std::nth_element(offsets.begin(), offsets.begin() + position, offsets.end());
+  return (start_index + offsets[position]) % list_length;
 }
 
 // static
@@ -0,0 +1,66 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef IOS_CHROME_BROWSER_WEB_STATE_LIST_WEB_STATE_LIST_CHANGE_SET_H_
+#define IOS_CHROME_BROWSER_WEB_STATE_LIST_WEB_STATE_LIST_CHANGE_SET_H_
+
+#include <vector>
+
+// Describes how a WebStateList changed during a batch operation, as the
+// difference between its content before and after the batch. Removed indices
+// refer to the list before the batch, inserted indices to the list after the
+// batch, like the batch updates of a UICollectionView.
+class WebStateListChangeSet {
+ public:
+  // A range of |count| consecutive indices starting at |index|.
+  struct Range {
+    int index = 0;
+    int count = 0;
+  };
+
+  // A WebState present before and after the batch, whose position changed
+  // relatively to the other WebStates present before and after the batch.
+  struct Move {
+    int from_index = 0;
+    int to_index = 0;
+  };
+
+  // Creates the change set of a list of |old_count| WebStates which now
+  // contains WebStates coming from |origins|: |origins[i]| is the index before
+  // the batch of the WebState now at index |i|, or -1 if it was inserted
+  // during the batch. |active_web_state_changed| tells whether the active
+  // WebState is different after the batch.
+  WebStateListChangeSet(int old_count,
+                        const std::vector<int>& origins,
+                        bool active_web_state_changed);
+  WebStateListChangeSet(const WebStateListChangeSet&);
+  WebStateListChangeSet& operator=(const WebStateListChangeSet&);
+  ~WebStateListChangeSet();
+
+  // Returns whether the list is unchanged.
+  bool empty() const;
+
+  // The removed WebStates, as increasing ranges of indices before the batch.
+  const std::vector<Range>& removed() const { return removed_; }
+
+  // The inserted WebStates, as increasing ranges of indices after the batch.
+  // This includes the WebStates which replaced others.
+  const std::vector<Range>& inserted() const { return inserted_; }
+
+  // The moved WebStates, in increasing order of |to_index|. The moves are
+  // kept to a minimum: the WebStates whose relative order did not change are
+  // not moved.
+  const std::vector<Move>& moved() const { return moved_; }
+
+  // Whether the active WebState is different after the batch.
+  bool active_web_state_changed() const { return active_web_state_changed_; }
+
+ private:
+  std::vector<Range> removed_;
+  std::vector<Range> inserted_;
+  std::vector<Move> moved_;
+  bool active_web_state_changed_ = false;
+};
+
+#endif  // IOS_CHROME_BROWSER_WEB_STATE_LIST_WEB_STATE_LIST_CHANGE_SET_H_
@@ -0,0 +1,112 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/chrome/browser/web_state_list/web_state_list_change_set.h"
+
+#include <algorithm>
+
+#include "base/check_op.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace {
+
+// Appends |index| to |ranges|, extending the last range if it ends just
+// before |index|.
+void AppendIndex(std::vector<WebStateListChangeSet::Range>* ranges,
+                 int index) {
+  if (!ranges->empty() &&
+      ranges->back().index + ranges->back().count == index) {
+    ranges->back().count++;
+    return;
+  }
+  WebStateListChangeSet::Range range;
+  range.index = index;
+  range.count = 1;
+  ranges->push_back(range);
+}
+
+// Returns whether each element of |values| is part of a longest strictly
+// increasing subsequence of |values|.
+std::vector<bool> GetLongestIncreasingSubsequence(
+    const std::vector<int>& values) {
+  // |tails[k]| is the position in |values| of the smallest value ending an
+  // increasing subsequence of length k + 1, |previous[i]| the position of the
+  // element before |values[i]| in the longest subsequence ending with it.
+  std::vector<int> tails;
+  std::vector<int> previous(values.size(), -1);
+  for (size_t i = 0; i < values.size(); i++) {
+    auto it = std::lower_bound(tails.begin(), tails.end(), values[i],
+                               [&values](int position, int value) {
+                                 return values[position] < value;
+                               });
+    if (it != tails.begin())
+      previous[i] = *(it - 1);
+    if (it == tails.end()) {
+      tails.push_back(i);
+    } else {
+      *it = i;
+    }
+  }
+
+  std::vector<bool> in_subsequence(values.size(), false);
+  for (int i = tails.empty() ? -1 : tails.back(); i != -1; i = previous[i])
+    in_subsequence[i] = true;
+  return in_subsequence;
+}
+
+}  // namespace
+
+WebStateListChangeSet::WebStateListChangeSet(int old_count,
+                                             const std::vector<int>& origins,
+                                             bool active_web_state_changed)
+    : active_web_state_changed_(active_web_state_changed) {
+  std::vector<bool> kept(old_count, false);
+  std::vector<int> kept_origins;
+  std::vector<int> kept_indices;
+  for (size_t index = 0; index < origins.size(); index++) {
+    const int origin = origins[index];
+    if (origin == -1) {
+      AppendIndex(&inserted_, index);
+      continue;
+    }
+    DCHECK_LT(origin, old_count);
+    DCHECK(!kept[origin]);
+    kept[origin] = true;
+    kept_origins.push_back(origin);
+    kept_indices.push_back(index);
+  }
+
+  for (int origin = 0; origin < old_count; origin++) {
+    if (!kept[origin])
+      AppendIndex(&removed_, origin);
+  }
+
+  // The WebStates forming the longest sequence still in the same relative
+  // order stay in place, the others are moved.
+  std::vector<bool> in_place = GetLongestIncreasingSubsequence(kept_origins);
+  for (size_t i = 0; i < kept_origins.size(); i++) {
+    if (in_place[i])
+      continue;
+    Move move;
+    move.from_index = kept_origins[i];
+    move.to_index = kept_indices[i];
+    moved_.push_back(move);
+  }
+}
+
+WebStateListChangeSet::WebStateListChangeSet(const WebStateListChangeSet&) =
+    default;
+
+WebStateListChangeSet& WebStateListChangeSet::operator=(
+    const WebStateListChangeSet&) = default;
+
+WebStateListChangeSet::~WebStateListChangeSet() = default;
+
+bool WebStateListChangeSet::empty() const {
+  return removed_.empty() && inserted_.empty() && moved_.empty() &&
+         !active_web_state_changed_;
+}
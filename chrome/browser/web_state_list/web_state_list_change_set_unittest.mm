@@ -0,0 +1,97 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/chrome/browser/web_state_list/web_state_list_change_set.h"
+
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/platform_test.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+using WebStateListChangeSetTest = PlatformTest;
+
+// Tests that an unchanged list produces an empty change set.
+TEST_F(WebStateListChangeSetTest, Unchanged) {
+  WebStateListChangeSet change_set(3, {0, 1, 2}, false);
+  EXPECT_TRUE(change_set.empty());
+  EXPECT_TRUE(change_set.removed().empty());
+  EXPECT_TRUE(change_set.inserted().empty());
+  EXPECT_TRUE(change_set.moved().empty());
+
+  EXPECT_FALSE(WebStateListChangeSet(3, {0, 1, 2}, true).empty());
+}
+
+// Tests that consecutive removed and inserted indices are grouped in ranges.
+TEST_F(WebStateListChangeSetTest, RemovedAndInsertedRanges) {
+  // Before: A B C D E, after: A X Y D Z.
+  WebStateListChangeSet change_set(5, {0, -1, -1, 3, -1}, false);
+
+  ASSERT_EQ(2U, change_set.removed().size());
+  EXPECT_EQ(1, change_set.removed()[0].index);
+  EXPECT_EQ(2, change_set.removed()[0].count);
+  EXPECT_EQ(4, change_set.removed()[1].index);
+  EXPECT_EQ(1, change_set.removed()[1].count);
+
+  ASSERT_EQ(2U, change_set.inserted().size());
+  EXPECT_EQ(1, change_set.inserted()[0].index);
+  EXPECT_EQ(2, change_set.inserted()[0].count);
+  EXPECT_EQ(4, change_set.inserted()[1].index);
+  EXPECT_EQ(1, change_set.inserted()[1].count);
+
+  EXPECT_TRUE(change_set.moved().empty());
+}
+
+// Tests that closing all the WebStates and restoring new ones is reported as
+// two ranges.
+TEST_F(WebStateListChangeSetTest, CloseAllAndRestore) {
+  WebStateListChangeSet change_set(1000, std::vector<int>(800, -1), true);
+
+  ASSERT_EQ(1U, change_set.removed().size());
+  EXPECT_EQ(0, change_set.removed()[0].index);
+  EXPECT_EQ(1000, change_set.removed()[0].count);
+  ASSERT_EQ(1U, change_set.inserted().size());
+  EXPECT_EQ(0, change_set.inserted()[0].index);
+  EXPECT_EQ(800, change_set.inserted()[0].count);
+  EXPECT_TRUE(change_set.moved().empty());
+  EXPECT_TRUE(change_set.active_web_state_changed());
+}
+
+// Tests that moving a single WebState is reported as a single move, whatever
+// the distance.
+TEST_F(WebStateListChangeSetTest, SingleMove) {
+  // Before: A B C D E, after: B C D E A.
+  WebStateListChangeSet change_set(5, {1, 2, 3, 4, 0}, false);
+  EXPECT_TRUE(change_set.removed().empty());
+  EXPECT_TRUE(change_set.inserted().empty());
+  ASSERT_EQ(1U, change_set.moved().size());
+  EXPECT_EQ(0, change_set.moved()[0].from_index);
+  EXPECT_EQ(4, change_set.moved()[0].to_index);
+}
+
+// Tests that the number of moves is minimal when the order of the remaining
+// WebStates is shuffled.
+TEST_F(WebStateListChangeSetTest, MinimalMoves) {
+  // Before: A B C D E F, after: D A B F C. E is removed, the longest sequence
+  // in the same order is A B C, so D and F are moved.
+  WebStateListChangeSet change_set(6, {3, 0, 1, 5, 2}, false);
+
+  ASSERT_EQ(1U, change_set.removed().size());
+  EXPECT_EQ(4, change_set.removed()[0].index);
+  EXPECT_EQ(1, change_set.removed()[0].count);
+  EXPECT_TRUE(change_set.inserted().empty());
+
+  ASSERT_EQ(2U, change_set.moved().size());
+  EXPECT_EQ(3, change_set.moved()[0].from_index);
+  EXPECT_EQ(0, change_set.moved()[0].to_index);
+  EXPECT_EQ(5, change_set.moved()[1].from_index);
+  EXPECT_EQ(3, change_set.moved()[1].to_index);
+}
+
+// Tests that a reversed list keeps a single WebState in place.
+TEST_F(WebStateListChangeSetTest, Reversed) {
+  WebStateListChangeSet change_set(4, {3, 2, 1, 0}, false);
+  EXPECT_EQ(3U, change_set.moved().size());
+}
@@ -8,6 +8,7 @@
 #include "base/macros.h"
 
 class WebStateList;
+class WebStateListChangeSet;
 
 namespace web {
 class WebState;
@@ -100,6 +101,14 @@ class WebStateListObserver {
   // closed at once).
   virtual void BatchOperationEnded(WebStateList* web_state_list);
 
+  // Invoked after the batched operations, before BatchOperationEnded(), on the
+  // observers added with WebStateList::AddCoalescingObserver(). Those observers
+  // are not notified of the individual operations of the batch, |change_set|
+  // describes all of them at once.
+  virtual void WebStateListChangedInBatch(
+      WebStateList* web_state_list,
+      const WebStateListChangeSet& change_set);
+
  private:
   DISALLOW_COPY_AND_ASSIGN(WebStateListObserver);
 };
@@ -51,3 +51,7 @@ void WebStateListObserver::WillBeginBatchOperation(
     WebStateList* web_state_list) {}
 
 void WebStateListObserver::BatchOperationEnded(WebStateList* web_state_list) {}
+
+void WebStateListObserver::WebStateListChangedInBatch(
+    WebStateList* web_state_list,
+    const WebStateListChangeSet& change_set) {}
@@ -0,0 +1,211 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/chrome/browser/web_state_list/web_state_list.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/macros.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/timer/elapsed_timer.h"
+#import "ios/chrome/browser/web_state_list/fake_web_state_list_delegate.h"
+#import "ios/chrome/browser/web_state_list/web_state_list_change_set.h"
+#import "ios/chrome/browser/web_state_list/web_state_list_observer.h"
+#import "ios/chrome/browser/web_state_list/web_state_opener.h"
+#include "ios/chrome/test/base/perf_test_ios.h"
+#import "ios/web/public/test/fakes/test_web_state.h"
+#include "url/gurl.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace {
+
+// Number of tabs closed and restored.
+const int kTabCount = 1000;
+
+// Number of observers of the WebStateList, similar to what a Browser has.
+const int kObserverCount = 10;
+
+// Number of lookups measured for each list size.
+const int kLookupCount = 1000;
+
+// Returns the URL of the tab at |index|.
+GURL GetTabURL(int index) {
+  return GURL("https://www.example.com/tab/" + base::NumberToString(index));
+}
+
+// Observer mirroring the content of the WebStateList after each change, like
+// the tab grid or the session saving do.
+class MirroringObserver : public WebStateListObserver {
+ public:
+  MirroringObserver() = default;
+
+  // WebStateListObserver implementation.
+  void WebStateInsertedAt(WebStateList* web_state_list,
+                          web::WebState* web_state,
+                          int index,
+                          bool activating) override {
+    Update(web_state_list);
+  }
+
+  void WebStateMoved(WebStateList* web_state_list,
+                     web::WebState* web_state,
+                     int from_index,
+                     int to_index) override {
+    Update(web_state_list);
+  }
+
+  void WebStateDetachedAt(WebStateList* web_state_list,
+                          web::WebState* web_state,
+                          int index) override {
+    Update(web_state_list);
+  }
+
+  void WebStateActivatedAt(WebStateList* web_state_list,
+                           web::WebState* old_web_state,
+                           web::WebState* new_web_state,
+                           int active_index,
+                           ActiveWebStateChangeReason reason) override {
+    Update(web_state_list);
+  }
+
+  void WebStateListChangedInBatch(
+      WebStateList* web_state_list,
+      const WebStateListChangeSet& change_set) override {
+    if (!change_set.empty())
+      Update(web_state_list);
+  }
+
+ private:
+  void Update(WebStateList* web_state_list) {
+    mirror_.resize(web_state_list->count());
+    for (int index = 0; index < web_state_list->count(); ++index)
+      mirror_[index] = web_state_list->GetWebStateAt(index);
+  }
+
+  std::vector<web::WebState*> mirror_;
+
+  DISALLOW_COPY_AND_ASSIGN(MirroringObserver);
+};
+
+class WebStateListPerfTest : public PerfTest {
+ protected:
+  WebStateListPerfTest() : PerfTest("WebStateList") {}
+
+  // Measures closing all the tabs and restoring them in a single batch, with
+  // |kObserverCount| observers which are coalescing if |coalescing| is true.
+  void MeasureCloseAllAndRestore(bool coalescing) {
+    FakeWebStateListDelegate delegate;
+    WebStateList web_state_list(&delegate);
+    std::vector<std::unique_ptr<MirroringObserver>> observers;
+    for (int i = 0; i < kObserverCount; ++i) {
+      observers.push_back(std::make_unique<MirroringObserver>());
+      if (coalescing) {
+        web_state_list.AddCoalescingObserver(observers.back().get());
+      } else {
+        web_state_list.AddObserver(observers.back().get());
+      }
+    }
+    web_state_list.PerformBatchOperation(base::BindOnce(&InsertTabs));
+
+    base::ElapsedTimer timer;
+    web_state_list.PerformBatchOperation(
+        base::BindOnce([](WebStateList* web_state_list) {
+          // CloseAllWebStates() can't be used as batches don't nest.
+          while (!web_state_list->empty()) {
+            web_state_list->CloseWebStateAt(web_state_list->count() - 1,
+                                            WebStateList::CLOSE_NO_FLAGS);
+          }
+          InsertTabs(web_state_list);
+        }));
+    LogPerfTiming(std::string(coalescing ? "Coalescing" : "Per-item") +
+                      " observers close all and restore " +
+                      base::NumberToString(kTabCount) + " tabs",
+                  timer.Elapsed());
+
+    EXPECT_EQ(kTabCount, web_state_list.count());
+    for (const auto& observer : observers)
+      web_state_list.RemoveObserver(observer.get());
+    web_state_list.CloseAllWebStates(WebStateList::CLOSE_NO_FLAGS);
+  }
+
+  // Appends |kTabCount| WebStates to |web_state_list|, activating the last.
+  static void InsertTabs(WebStateList* web_state_list) {
+    for (int i = 0; i < kTabCount; ++i) {
+      auto web_state = std::make_unique<web::TestWebState>();
+      web_state->SetCurrentURL(GetTabURL(i));
+      web_state_list->InsertWebState(
+          WebStateList::kInvalidIndex, std::move(web_state),
+          i == kTabCount - 1 ? WebStateList::INSERT_ACTIVATE
+                             : WebStateList::INSERT_NO_FLAGS,
+          WebStateOpener());
+    }
+  }
+
+  // Measures the lookups by WebState, by URL and by opener in a list of
+  // |tab_count| tabs, where each group of 10 tabs was opened by the first tab
+  // of the group.
+  void MeasureLookups(int tab_count) {
+    FakeWebStateListDelegate delegate;
+    WebStateList web_state_list(&delegate);
+    for (int i = 0; i < tab_count; ++i) {
+      auto web_state = std::make_unique<web::TestWebState>();
+      web_state->SetCurrentURL(GetTabURL(i));
+      WebStateOpener opener;
+      if (i % 10 != 0)
+        opener = WebStateOpener(web_state_list.GetWebStateAt(i - i % 10), 0);
+      web_state_list.InsertWebState(i, std::move(web_state),
+                                    WebStateList::INSERT_FORCE_INDEX, opener);
+    }
+    web_state_list.ActivateWebStateAt(0);
+    const std::string suffix =
+        " in " + base::NumberToString(tab_count) + " tabs";
+
+    // Look for the tabs at the end of the list, the worst case of a scan.
+    base::ElapsedTimer web_state_timer;
+    for (int i = 0; i < kLookupCount; ++i) {
+      const int index = tab_count - 1 - i % 10;
+      EXPECT_EQ(index, web_state_list.GetIndexOfWebState(
+                           web_state_list.GetWebStateAt(index)));
+    }
+    LogPerfTiming("GetIndexOfWebState" + suffix,
+                  web_state_timer.Elapsed() / kLookupCount);
+
+    base::ElapsedTimer url_timer;
+    for (int i = 0; i < kLookupCount; ++i) {
+      const int index = tab_count - 1 - i % 10;
+      EXPECT_EQ(index, web_state_list.GetIndexOfInactiveWebStateWithURL(
+                           GetTabURL(index)));
+    }
+    LogPerfTiming("GetIndexOfInactiveWebStateWithURL" + suffix,
+                  url_timer.Elapsed() / kLookupCount);
+
+    base::ElapsedTimer opener_timer;
+    const int opener_index = tab_count - 10;
+    web::WebState* opener = web_state_list.GetWebStateAt(opener_index);
+    for (int i = 0; i < kLookupCount; ++i) {
+      EXPECT_EQ(opener_index + 1, web_state_list.GetIndexOfNextWebStateOpenedBy(
+                                      opener, opener_index, false));
+    }
+    LogPerfTiming("GetIndexOfNextWebStateOpenedBy" + suffix,
+                  opener_timer.Elapsed() / kLookupCount);
+  }
+};
+
+TEST_F(WebStateListPerfTest, Lookups) {
+  for (int tab_count : {10, 100, 1000, 5000})
+    MeasureLookups(tab_count);
+}
+
+TEST_F(WebStateListPerfTest, CloseAllAndRestore) {
+  MeasureCloseAllAndRestore(/*coalescing=*/false);
+  MeasureCloseAllAndRestore(/*coalescing=*/true);
+}
+
+}  // namespace
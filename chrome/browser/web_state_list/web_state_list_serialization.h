@@ -12,6 +12,7 @@
 #include "base/callback_forward.h"
 
 @class CRWSessionStorage;
+@class SessionManifestIOS;
 @class SessionWindowIOS;
 class WebStateList;
 
@@ -26,6 +27,24 @@ using WebStateFactory =
 // Returns an array of serialised sessions.
 SessionWindowIOS* SerializeWebStateList(WebStateList* web_state_list);
 
+// Returns the serialised session of the WebState at |index| in
+// |web_state_list|. The session records the opener of the WebState.
+CRWSessionStorage* SerializeWebStateAt(WebStateList* web_state_list,
+                                       int index);
+
+// Returns the serialised session of |web_state|, without its opener. Used when
+// the opener is saved in the manifest of the WebStateList.
+CRWSessionStorage* SerializeWebStateWithoutOpener(web::WebState* web_state);
+
+// Returns the manifest of |web_state_list|, i.e. the tab ID and the opener of
+// each WebState, and the active index. Unlike SerializeWebStateList() this
+// does not serialize the WebStates.
+SessionManifestIOS* SerializeWebStateListManifest(WebStateList* web_state_list);
+
+// Returns the unique identifier of |web_state|, which is stable across cold
+// starts.
+NSString* GetTabIdOfWebState(web::WebState* web_state);
+
 // Restores a |web_state_list| from |session_window| using |web_state_factory|
 // to create the restored WebStates.
 void DeserializeWebStateList(WebStateList* web_state_list,
@@ -12,7 +12,9 @@
 #include "base/callback.h"
 #include "base/check_op.h"
 #import "base/mac/foundation_util.h"
+#import "ios/chrome/browser/sessions/session_manifest_ios.h"
 #import "ios/chrome/browser/sessions/session_window_ios.h"
+#import "ios/chrome/browser/web/tab_id_tab_helper.h"
 #import "ios/chrome/browser/web_state_list/web_state_list.h"
 #import "ios/chrome/browser/web_state_list/web_state_opener.h"
 #import "ios/web/public/session/serializable_user_data_manager.h"
@@ -27,42 +29,100 @@ namespace {
 // the WebStates stored in the WebStateList.
 NSString* const kOpenerIndexKey = @"OpenerIndex";
 NSString* const kOpenerNavigationIndexKey = @"OpenerNavigationIndex";
+
+// Returns the active index of |web_state_list| as stored in the session.
+NSUInteger GetSelectedIndex(WebStateList* web_state_list) {
+  return web_state_list->active_index() != WebStateList::kInvalidIndex
+             ? static_cast<NSUInteger>(web_state_list->active_index())
+             : static_cast<NSUInteger>(NSNotFound);
+}
 }  // namespace
 
+CRWSessionStorage* SerializeWebStateAt(WebStateList* web_state_list,
+                                       int index) {
+  web::WebState* web_state = web_state_list->GetWebStateAt(index);
+  WebStateOpener opener = web_state_list->GetOpenerOfWebStateAt(index);
+
+  web::SerializableUserDataManager* user_data_manager =
+      web::SerializableUserDataManager::FromWebState(web_state);
+
+  int opener_index = WebStateList::kInvalidIndex;
+  if (opener.opener) {
+    opener_index = web_state_list->GetIndexOfWebState(opener.opener);
+    DCHECK_NE(opener_index, WebStateList::kInvalidIndex);
+    user_data_manager->AddSerializableData(@(opener_index), kOpenerIndexKey);
+    user_data_manager->AddSerializableData(@(opener.navigation_index),
+                                           kOpenerNavigationIndexKey);
+  } else {
+    user_data_manager->AddSerializableData([NSNull null], kOpenerIndexKey);
+    user_data_manager->AddSerializableData([NSNull null],
+                                           kOpenerNavigationIndexKey);
+  }
+
+  return web_state->BuildSessionStorage();
+}
+
+CRWSessionStorage* SerializeWebStateWithoutOpener(web::WebState* web_state) {
+  // Clear the opener which may have been saved by SerializeWebStateAt().
+  web::SerializableUserDataManager* user_data_manager =
+      web::SerializableUserDataManager::FromWebState(web_state);
+  user_data_manager->AddSerializableData([NSNull null], kOpenerIndexKey);
+  user_data_manager->AddSerializableData([NSNull null],
+                                         kOpenerNavigationIndexKey);
+
+  return web_state->BuildSessionStorage();
+}
+
 SessionWindowIOS* SerializeWebStateList(WebStateList* web_state_list) {
   NSMutableArray<CRWSessionStorage*>* serialized_session =
       [NSMutableArray arrayWithCapacity:web_state_list->count()];
 
   for (int index = 0; index < web_state_list->count(); ++index) {
-    web::WebState* web_state = web_state_list->GetWebStateAt(index);
-    WebStateOpener opener = web_state_list->GetOpenerOfWebStateAt(index);
+    [serialized_session addObject:SerializeWebStateAt(web_state_list, index)];
+  }
+
+  return [[SessionWindowIOS alloc]
+      initWithSessions:[serialized_session copy]
+         selectedIndex:GetSelectedIndex(web_state_list)];
+}
 
-    web::SerializableUserDataManager* user_data_manager =
-        web::SerializableUserDataManager::FromWebState(web_state);
+SessionManifestIOS* SerializeWebStateListManifest(
+    WebStateList* web_state_list) {
+  const int count = web_state_list->count();
+  NSMutableArray<NSString*>* tab_ids =
+      [NSMutableArray arrayWithCapacity:count];
+  NSMutableArray<NSNumber*>* opener_indexes =
+      [NSMutableArray arrayWithCapacity:count];
+  NSMutableArray<NSNumber*>* opener_navigation_indexes =
+      [NSMutableArray arrayWithCapacity:count];
 
-    int opener_index = WebStateList::kInvalidIndex;
+  for (int index = 0; index < count; ++index) {
+    [tab_ids
+        addObject:GetTabIdOfWebState(web_state_list->GetWebStateAt(index))];
+
+    WebStateOpener opener = web_state_list->GetOpenerOfWebStateAt(index);
     if (opener.opener) {
-      opener_index = web_state_list->GetIndexOfWebState(opener.opener);
+      const int opener_index =
+          web_state_list->GetIndexOfWebState(opener.opener);
       DCHECK_NE(opener_index, WebStateList::kInvalidIndex);
-      user_data_manager->AddSerializableData(@(opener_index), kOpenerIndexKey);
-      user_data_manager->AddSerializableData(@(opener.navigation_index),
-                                             kOpenerNavigationIndexKey);
+      [opener_indexes addObject:@(opener_index)];
+      [opener_navigation_indexes addObject:@(opener.navigation_index)];
     } else {
-      user_data_manager->AddSerializableData([NSNull null], kOpenerIndexKey);
-      user_data_manager->AddSerializableData([NSNull null],
-                                             kOpenerNavigationIndexKey);
+      [opener_indexes addObject:@(-1)];
+      [opener_navigation_indexes addObject:@(-1)];
     }
-
-    [serialized_session addObject:web_state->BuildSessionStorage()];
   }
 
-  NSUInteger selectedIndex =
-      web_state_list->active_index() != WebStateList::kInvalidIndex
-          ? static_cast<NSUInteger>(web_state_list->active_index())
-          : static_cast<NSUInteger>(NSNotFound);
+  return [[SessionManifestIOS alloc]
+               initWithTabIDs:tab_ids
+                openerIndexes:opener_indexes
+      openerNavigationIndexes:opener_navigation_indexes
+                selectedIndex:GetSelectedIndex(web_state_list)];
+}
 
-  return [[SessionWindowIOS alloc] initWithSessions:[serialized_session copy]
-                                      selectedIndex:selectedIndex];
+NSString* GetTabIdOfWebState(web::WebState* web_state) {
+  TabIdTabHelper::CreateForWebState(web_state);
+  return TabIdTabHelper::FromWebState(web_state)->tab_id();
 }
 
 void DeserializeWebStateList(WebStateList* web_state_list,
@@ -78,16 +138,28 @@ void DeserializeWebStateList(WebStateList* web_state_list,
 
   // Restore the WebStates opener-opened relationship.
   for (int index = old_count; index < web_state_list->count(); ++index) {
-    web::WebState* web_state = web_state_list->GetWebStateAt(index);
-    web::SerializableUserDataManager* user_data_manager =
-        web::SerializableUserDataManager::FromWebState(web_state);
+    NSNumber* boxed_opener_index = nil;
+    NSNumber* boxed_opener_navigation_index = nil;
+    if (session_window.openerIndexes) {
+      // Sessions saved with one file per tab keep the openers in the manifest.
+      const NSUInteger session_index = index - old_count;
+      if ([session_window.openerIndexes[session_index] intValue] >= 0) {
+        boxed_opener_index = session_window.openerIndexes[session_index];
+        boxed_opener_navigation_index =
+            session_window.openerNavigationIndexes[session_index];
+      }
+    } else {
+      web::WebState* web_state = web_state_list->GetWebStateAt(index);
+      web::SerializableUserDataManager* user_data_manager =
+          web::SerializableUserDataManager::FromWebState(web_state);
 
-    NSNumber* boxed_opener_index = base::mac::ObjCCast<NSNumber>(
-        user_data_manager->GetValueForSerializationKey(kOpenerIndexKey));
+      boxed_opener_index = base::mac::ObjCCast<NSNumber>(
+          user_data_manager->GetValueForSerializationKey(kOpenerIndexKey));
 
-    NSNumber* boxed_opener_navigation_index = base::mac::ObjCCast<NSNumber>(
-        user_data_manager->GetValueForSerializationKey(
-            kOpenerNavigationIndexKey));
+      boxed_opener_navigation_index = base::mac::ObjCCast<NSNumber>(
+          user_data_manager->GetValueForSerializationKey(
+              kOpenerNavigationIndexKey));
+    }
 
     if (!boxed_opener_index || !boxed_opener_navigation_index)
       continue;
@@ -4,11 +4,15 @@
 
 #import "ios/chrome/browser/web_state_list/web_state_list.h"
 
+#include <vector>
+
 #include "base/macros.h"
 #include "base/supports_user_data.h"
 #import "ios/chrome/browser/web_state_list/fake_web_state_list_delegate.h"
+#import "ios/chrome/browser/web_state_list/web_state_list_change_set.h"
 #import "ios/chrome/browser/web_state_list/web_state_list_observer.h"
 #import "ios/chrome/browser/web_state_list/web_state_opener.h"
+#import "ios/web/public/test/fakes/fake_navigation_context.h"
 #import "ios/web/public/test/fakes/test_navigation_manager.h"
 #import "ios/web/public/test/fakes/test_web_state.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -124,6 +128,63 @@ class WebStateListTestObserver : public WebStateListObserver {
   DISALLOW_COPY_AND_ASSIGN(WebStateListTestObserver);
 };
 
+// WebStateList observer that records the notifications received by a
+// coalescing observer.
+class WebStateListCoalescingTestObserver : public WebStateListObserver {
+ public:
+  WebStateListCoalescingTestObserver() = default;
+
+  // Returns the number of notifications of individual mutations.
+  int mutation_count() const { return mutation_count_; }
+
+  // Returns the change sets received by WebStateListChangedInBatch.
+  const std::vector<WebStateListChangeSet>& change_sets() const {
+    return change_sets_;
+  }
+
+  // WebStateListObserver implementation.
+  void WebStateInsertedAt(WebStateList* web_state_list,
+                          web::WebState* web_state,
+                          int index,
+                          bool activating) override {
+    mutation_count_++;
+  }
+
+  void WebStateMoved(WebStateList* web_state_list,
+                     web::WebState* web_state,
+                     int from_index,
+                     int to_index) override {
+    mutation_count_++;
+  }
+
+  void WebStateDetachedAt(WebStateList* web_state_list,
+                          web::WebState* web_state,
+                          int index) override {
+    mutation_count_++;
+  }
+
+  void WebStateActivatedAt(WebStateList* web_state_list,
+                           web::WebState* old_web_state,
+                           web::WebState* new_web_state,
+                           int active_index,
+                           ActiveWebStateChangeReason reason) override {
+    mutation_count_++;
+  }
+
+  void WebStateListChangedInBatch(
+      WebStateList* web_state_list,
+      const WebStateListChangeSet& change_set) override {
+    EXPECT_TRUE(web_state_list->IsBatchInProgress());
+    change_sets_.push_back(change_set);
+  }
+
+ private:
+  int mutation_count_ = 0;
+  std::vector<WebStateListChangeSet> change_sets_;
+
+  DISALLOW_COPY_AND_ASSIGN(WebStateListCoalescingTestObserver);
+};
+
 // A fake NavigationManager used to test opener-opened relationship in the
 // WebStateList.
 class FakeNavigationManager : public web::TestNavigationManager {
@@ -356,6 +417,89 @@ TEST_F(WebStateListTest, GetIndexOfInactiveWebStateWithURL) {
   EXPECT_EQ(2, web_state_list_.GetIndexOfInactiveWebStateWithURL(GURL(kURL0)));
 }
 
+// Tests that finding a webstate by URL takes the navigations into account.
+TEST_F(WebStateListTest, GetIndexOfWebStateWithURLAfterNavigation) {
+  AppendNewWebState(kURL0);
+  AppendNewWebState(kURL1);
+  EXPECT_EQ(1, web_state_list_.GetIndexOfWebStateWithURL(GURL(kURL1)));
+
+  // Navigate the first webstate to the URL of the second.
+  web::TestWebState* web_state =
+      static_cast<web::TestWebState*>(web_state_list_.GetWebStateAt(0));
+  web::FakeNavigationContext navigation_context;
+  web_state->SetCurrentURL(GURL(kURL1));
+  web_state->OnNavigationFinished(&navigation_context);
+
+  EXPECT_EQ(WebStateList::kInvalidIndex,
+            web_state_list_.GetIndexOfWebStateWithURL(GURL(kURL0)));
+  EXPECT_EQ(0, web_state_list_.GetIndexOfWebStateWithURL(GURL(kURL1)));
+
+  // Replaced and detached webstates are no longer found.
+  std::unique_ptr<web::WebState> old_web_state =
+      web_state_list_.ReplaceWebStateAt(0, CreateWebState(kURL2));
+  EXPECT_EQ(1, web_state_list_.GetIndexOfWebStateWithURL(GURL(kURL1)));
+  EXPECT_EQ(0, web_state_list_.GetIndexOfWebStateWithURL(GURL(kURL2)));
+
+  std::unique_ptr<web::WebState> detached_web_state =
+      web_state_list_.DetachWebStateAt(0);
+  EXPECT_EQ(WebStateList::kInvalidIndex,
+            web_state_list_.GetIndexOfWebStateWithURL(GURL(kURL2)));
+  EXPECT_EQ(0, web_state_list_.GetIndexOfWebStateWithURL(GURL(kURL1)));
+}
+
+// Tests that finding a webstate by URL takes into account the changes of its
+// visible URL which are not notified, such as a pending item.
+TEST_F(WebStateListTest, GetIndexOfWebStateWithURLAfterVisibleURLChange) {
+  AppendNewWebState(kURL0);
+  AppendNewWebState(kURL1);
+  EXPECT_EQ(0, web_state_list_.GetIndexOfWebStateWithURL(GURL(kURL0)));
+
+  web::TestWebState* web_state =
+      static_cast<web::TestWebState*>(web_state_list_.GetWebStateAt(0));
+  web_state->SetVisibleURL(GURL(kURL2));
+  EXPECT_EQ(WebStateList::kInvalidIndex,
+            web_state_list_.GetIndexOfWebStateWithURL(GURL(kURL0)));
+  EXPECT_EQ(0, web_state_list_.GetIndexOfWebStateWithURL(GURL(kURL2)));
+
+  web_state->SetVisibleURL(GURL(kURL0));
+  EXPECT_EQ(0, web_state_list_.GetIndexOfWebStateWithURL(GURL(kURL0)));
+  EXPECT_EQ(WebStateList::kInvalidIndex,
+            web_state_list_.GetIndexOfWebStateWithURL(GURL(kURL2)));
+}
+
+// Tests that the index of the webstates is correct after moving, replacing
+// and detaching webstates.
+TEST_F(WebStateListTest, GetIndexOfWebStateAfterMutations) {
+  for (const char* url : {kURL0, kURL1, kURL2, kURL3, kURL0, kURL1})
+    AppendNewWebState(url);
+
+  web_state_list_.MoveWebStateAt(0, 4);
+  web_state_list_.MoveWebStateAt(5, 1);
+  std::unique_ptr<web::WebState> old_web_state =
+      web_state_list_.ReplaceWebStateAt(2, CreateWebState(kURL3));
+  std::unique_ptr<web::WebState> detached_web_state =
+      web_state_list_.DetachWebStateAt(3);
+  web_state_list_.InsertWebState(0, CreateWebState(kURL2),
+                                 WebStateList::INSERT_FORCE_INDEX,
+                                 WebStateOpener());
+
+  EXPECT_EQ(WebStateList::kInvalidIndex,
+            web_state_list_.GetIndexOfWebState(old_web_state.get()));
+  EXPECT_EQ(WebStateList::kInvalidIndex,
+            web_state_list_.GetIndexOfWebState(detached_web_state.get()));
+  for (int index = 0; index < web_state_list_.count(); ++index) {
+    web::WebState* web_state = web_state_list_.GetWebStateAt(index);
+    EXPECT_EQ(index, web_state_list_.GetIndexOfWebState(web_state));
+
+    // The first webstate with the same URL is at or before |index|.
+    const int url_index =
+        web_state_list_.GetIndexOfWebStateWithURL(web_state->GetVisibleURL());
+    EXPECT_LE(url_index, index);
+    EXPECT_EQ(web_state->GetVisibleURL(),
+              web_state_list_.GetWebStateAt(url_index)->GetVisibleURL());
+  }
+}
+
 // Tests that inserted webstates correctly inherit openers.
 TEST_F(WebStateListTest, InsertInheritOpener) {
   AppendNewWebState(kURL0);
@@ -758,3 +902,75 @@ TEST_F(WebStateListTest, PerformBatchOperation_IsBatchInProgress) {
   EXPECT_FALSE(web_state_list_.IsBatchInProgress());
   EXPECT_TRUE(captured_batch_in_progress);
 }
+
+// Tests that coalescing observers are notified once per batch operation.
+TEST_F(WebStateListTest, PerformBatchOperation_CoalescingObserver) {
+  AppendNewWebState(kURL0);
+  AppendNewWebState(kURL1);
+  AppendNewWebState(kURL2);
+  web_state_list_.ActivateWebStateAt(0);
+
+  WebStateListCoalescingTestObserver coalescing_observer;
+  web_state_list_.AddCoalescingObserver(&coalescing_observer);
+
+  observer_.ResetStatistics();
+  web_state_list_.PerformBatchOperation(
+      base::BindOnce(^(WebStateList* web_state_list) {
+        web_state_list->CloseWebStateAt(1, WebStateList::CLOSE_NO_FLAGS);
+        web_state_list->MoveWebStateAt(1, 0);
+        web_state_list->InsertWebState(
+            WebStateList::kInvalidIndex, CreateWebState(kURL3),
+            WebStateList::INSERT_ACTIVATE, WebStateOpener());
+      }));
+
+  // The regular observers are still notified of each mutation.
+  EXPECT_TRUE(observer_.web_state_detached_called());
+  EXPECT_TRUE(observer_.web_state_moved_called());
+  EXPECT_TRUE(observer_.web_state_inserted_called());
+
+  EXPECT_EQ(0, coalescing_observer.mutation_count());
+  ASSERT_EQ(1U, coalescing_observer.change_sets().size());
+  const WebStateListChangeSet& change_set =
+      coalescing_observer.change_sets()[0];
+
+  // Before: 0 1 2, after: 2 0 3.
+  ASSERT_EQ(1U, change_set.removed().size());
+  EXPECT_EQ(1, change_set.removed()[0].index);
+  EXPECT_EQ(1, change_set.removed()[0].count);
+  ASSERT_EQ(1U, change_set.inserted().size());
+  EXPECT_EQ(2, change_set.inserted()[0].index);
+  EXPECT_EQ(1, change_set.inserted()[0].count);
+  ASSERT_EQ(1U, change_set.moved().size());
+  EXPECT_EQ(2, change_set.moved()[0].from_index);
+  EXPECT_EQ(0, change_set.moved()[0].to_index);
+  EXPECT_TRUE(change_set.active_web_state_changed());
+
+  // Outside of batch operations, coalescing observers are notified of each
+  // mutation.
+  web_state_list_.CloseWebStateAt(0, WebStateList::CLOSE_NO_FLAGS);
+  EXPECT_EQ(1, coalescing_observer.mutation_count());
+
+  web_state_list_.RemoveObserver(&coalescing_observer);
+}
+
+// Tests that a batch operation which does not change the list is reported to
+// coalescing observers as an empty change set.
+TEST_F(WebStateListTest, PerformBatchOperation_CoalescingObserverNoChange) {
+  AppendNewWebState(kURL0);
+  AppendNewWebState(kURL1);
+  web_state_list_.ActivateWebStateAt(1);
+
+  WebStateListCoalescingTestObserver coalescing_observer;
+  web_state_list_.AddCoalescingObserver(&coalescing_observer);
+
+  web_state_list_.PerformBatchOperation(
+      base::BindOnce(^(WebStateList* web_state_list) {
+        web_state_list->MoveWebStateAt(0, 1);
+        web_state_list->MoveWebStateAt(1, 0);
+      }));
+
+  ASSERT_EQ(1U, coalescing_observer.change_sets().size());
+  EXPECT_TRUE(coalescing_observer.change_sets()[0].empty());
+
+  web_state_list_.RemoveObserver(&coalescing_observer);
+}
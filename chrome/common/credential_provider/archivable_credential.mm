@@ -20,6 +20,11 @@ NSString* const kACServiceNameKey = @"serviceName";
 NSString* const kACUserKey = @"user";
 NSString* const kACValidationIdentifierKey = @"validationIdentifier";
 
+// Returns whether |a| and |b| are both nil or equal.
+BOOL AreEqualOrBothNil(NSString* a, NSString* b) {
+  return a == b || [a isEqualToString:b];
+}
+
 }  // namespace
 
 @implementation ArchivableCredential
@@ -63,16 +68,18 @@ NSString* const kACValidationIdentifierKey = @"validationIdentifier";
       return NO;
     }
     ArchivableCredential* otherCredential = (ArchivableCredential*)other;
-    return
-        [self.favicon isEqual:otherCredential.favicon] &&
-        [self.keychainIdentifier isEqual:otherCredential.keychainIdentifier] &&
-        self.rank == otherCredential.rank &&
-        [self.recordIdentifier isEqual:otherCredential.recordIdentifier] &&
-        [self.serviceIdentifier isEqual:otherCredential.serviceIdentifier] &&
-        [self.serviceName isEqual:otherCredential.serviceName] &&
-        [self.user isEqual:otherCredential.user] &&
-        [self.validationIdentifier
-            isEqual:otherCredential.validationIdentifier];
+    return AreEqualOrBothNil(self.favicon, otherCredential.favicon) &&
+           AreEqualOrBothNil(self.keychainIdentifier,
+                             otherCredential.keychainIdentifier) &&
+           self.rank == otherCredential.rank &&
+           AreEqualOrBothNil(self.recordIdentifier,
+                             otherCredential.recordIdentifier) &&
+           AreEqualOrBothNil(self.serviceIdentifier,
+                             otherCredential.serviceIdentifier) &&
+           AreEqualOrBothNil(self.serviceName, otherCredential.serviceName) &&
+           AreEqualOrBothNil(self.user, otherCredential.user) &&
+           AreEqualOrBothNil(self.validationIdentifier,
+                             otherCredential.validationIdentifier);
   }
 }
 
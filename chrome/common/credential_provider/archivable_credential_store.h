@@ -16,6 +16,13 @@
 // to update the data on disk. All operations will be held in memory until saved
 // to disk, making it possible to batch multiple operations.
 //
+// The file is a log of records, each archiving one credential or the removal
+// of one credential, with its own format version. Saving appends the records
+// of the credentials changed since the last save, and rewrites the file with
+// one record per credential once most of its records are outdated. Files
+// written by previous versions, which archived all the credentials at once,
+// are still loaded and rewritten on the next save.
+//
 // Only supports |Credentials| of class |ArchivableCredential|.
 @interface ArchivableCredentialStore : NSObject <CredentialStore>
 
@@ -28,6 +35,13 @@
 - (instancetype)initWithFileURL:(NSURL*)fileURL NS_DESIGNATED_INITIALIZER;
 - (instancetype)init NS_UNAVAILABLE;
 
+// Adds or replaces |credentials| and removes the credentials with
+// |recordIdentifiers|, if present, in a single operation. Use
+// |-saveDataWithCompletion:| to update the data on disk.
+- (void)addOrUpdateCredentials:(NSArray<id<Credential>>*)credentials
+    removeCredentialsWithRecordIdentifiers:
+        (NSArray<NSString*>*)recordIdentifiers;
+
 @end
 
 #endif  // IOS_CHROME_COMMON_CREDENTIAL_PROVIDER_ARCHIVABLE_CREDENTIAL_STORE_H_
@@ -4,7 +4,14 @@
 
 #import "ios/chrome/common/credential_provider/archivable_credential_store.h"
 
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
 #include "base/check.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
 #include "base/mac/foundation_util.h"
 #include "base/notreached.h"
 #include "base/strings/sys_string_conversions.h"
@@ -14,6 +21,85 @@
 #error "This file requires ARC support."
 #endif
 
+namespace {
+
+// Bytes at the start of a file written as a log of records. The files written
+// by previous versions are keyed archives, which start with "bplist".
+const char kFileMagic[] = {'C', 'P', 'C', 'S'};
+
+// Type of a record, written in its first byte.
+enum RecordType : uint8_t {
+  // The record archives a credential, which replaces the previous one with the
+  // same record identifier.
+  kRecordTypeCredential = 1,
+  // The record removes the credential with its record identifier.
+  kRecordTypeRemoval = 2,
+};
+
+// Version of the format of the records written by this version, in the second
+// byte of each record. The records with an unknown version are skipped.
+const uint8_t kRecordVersion = 1;
+
+// Size of the header of a record: its type, its version, and the lengths of its
+// record identifier and of its payload.
+const size_t kRecordHeaderSize = 2 + 2 * sizeof(uint32_t);
+
+// The file is rewritten when it would contain more records than this, or than
+// twice the number of credentials.
+const NSUInteger kMinRecordCountBeforeCompaction = 64;
+
+// Appends a record of |type| for |recordIdentifier| with |payload| to |data|.
+void AppendRecord(NSMutableData* data,
+                  RecordType type,
+                  NSString* recordIdentifier,
+                  NSData* payload) {
+  NSData* identifier =
+      [recordIdentifier dataUsingEncoding:NSUTF8StringEncoding];
+  const uint8_t header[] = {type, kRecordVersion};
+  const uint32_t identifierLength =
+      CFSwapInt32HostToLittle(static_cast<uint32_t>(identifier.length));
+  const uint32_t payloadLength =
+      CFSwapInt32HostToLittle(static_cast<uint32_t>(payload.length));
+  [data appendBytes:header length:sizeof(header)];
+  [data appendBytes:&identifierLength length:sizeof(identifierLength)];
+  [data appendBytes:&payloadLength length:sizeof(payloadLength)];
+  [data appendData:identifier];
+  if (payload) {
+    [data appendData:payload];
+  }
+}
+
+// Appends to |data| the record of |recordIdentifier|, which archives
+// |credential|, or removes it if |credential| is nil. Returns NO if
+// |credential| can't be archived.
+BOOL AppendRecordForCredential(NSMutableData* data,
+                               NSString* recordIdentifier,
+                               ArchivableCredential* credential,
+                               NSError** error) {
+  if (!credential) {
+    AppendRecord(data, kRecordTypeRemoval, recordIdentifier, nil);
+    return YES;
+  }
+  NSData* payload = [NSKeyedArchiver archivedDataWithRootObject:credential
+                                          requiringSecureCoding:YES
+                                                          error:error];
+  DCHECK(!*error) << base::SysNSStringToUTF8((*error).description);
+  if (!payload) {
+    return NO;
+  }
+  AppendRecord(data, kRecordTypeCredential, recordIdentifier, payload);
+  return YES;
+}
+
+// Reads a little-endian uint32_t at |offset| in |bytes|.
+uint32_t ReadUInt32(const uint8_t* bytes, size_t offset) {
+  uint32_t value;
+  memcpy(&value, bytes + offset, sizeof(value));
+  return CFSwapInt32LittleToHost(value);
+}
+
+}  // namespace
+
 @interface ArchivableCredentialStore ()
 
 // Working queue used to sync the mutable set operations.
@@ -26,6 +112,18 @@
 @property(nonatomic, strong)
     NSMutableDictionary<NSString*, ArchivableCredential*>* memoryStorage;
 
+// The record identifiers of the credentials added, updated or removed since the
+// last save.
+@property(nonatomic, strong) NSMutableSet<NSString*>* changedRecordIdentifiers;
+
+// Number of records in the file.
+@property(nonatomic, assign) NSUInteger fileRecordCount;
+
+// Whether the file must be rewritten on the next save, because it doesn't
+// exist, has the format of a previous version, or all the credentials were
+// removed.
+@property(nonatomic, assign) BOOL needsCompaction;
+
 @end
 
 @implementation ArchivableCredentialStore
@@ -40,10 +138,35 @@
     }
     _fileURL = fileURL;
     _workingQueue = dispatch_queue_create(nullptr, DISPATCH_QUEUE_CONCURRENT);
+    _changedRecordIdentifiers = [[NSMutableSet alloc] init];
   }
   return self;
 }
 
+- (void)addOrUpdateCredentials:(NSArray<id<Credential>>*)credentials
+    removeCredentialsWithRecordIdentifiers:
+        (NSArray<NSString*>*)recordIdentifiers {
+  for (id<Credential> credential in credentials) {
+    DCHECK(credential.recordIdentifier)
+        << "credential must have a record identifier";
+  }
+  NSArray<id<Credential>>* credentialsCopy = [credentials copy];
+  NSArray<NSString*>* recordIdentifiersCopy = [recordIdentifiers copy];
+  dispatch_barrier_async(self.workingQueue, ^{
+    for (NSString* recordIdentifier in recordIdentifiersCopy) {
+      if (self.memoryStorage[recordIdentifier]) {
+        self.memoryStorage[recordIdentifier] = nil;
+        [self.changedRecordIdentifiers addObject:recordIdentifier];
+      }
+    }
+    for (id<Credential> credential in credentialsCopy) {
+      self.memoryStorage[credential.recordIdentifier] =
+          base::mac::ObjCCastStrict<ArchivableCredential>(credential);
+      [self.changedRecordIdentifiers addObject:credential.recordIdentifier];
+    }
+  });
+}
+
 #pragma mark - CredentialStore
 
 - (NSArray<id<Credential>>*)credentials {
@@ -71,29 +194,17 @@
     }
 
     NSError* error = nil;
-    NSData* data =
-        [NSKeyedArchiver archivedDataWithRootObject:self.memoryStorage
-                              requiringSecureCoding:YES
-                                              error:&error];
-    DCHECK(!error) << base::SysNSStringToUTF8(error.description);
-    if (error) {
-      executeCompletionIfPresent(error);
-      return;
+    NSMutableDictionary<NSString*, ArchivableCredential*>* storage =
+        self.memoryStorage;
+    const NSUInteger maxRecordCount =
+        std::max(kMinRecordCountBeforeCompaction, 2 * storage.count);
+    if (self.needsCompaction ||
+        self.fileRecordCount + self.changedRecordIdentifiers.count >
+            maxRecordCount) {
+      error = [self writeAllRecords];
+    } else if (self.changedRecordIdentifiers.count) {
+      error = [self appendChangedRecords];
     }
-
-    [[NSFileManager defaultManager]
-               createDirectoryAtURL:self.fileURL.URLByDeletingLastPathComponent
-        withIntermediateDirectories:YES
-                         attributes:nil
-                              error:&error];
-
-    if (error) {
-      executeCompletionIfPresent(error);
-      return;
-    }
-
-    [data writeToURL:self.fileURL options:NSDataWritingAtomic error:&error];
-    DCHECK(!error) << base::SysNSStringToUTF8(error.description);
     executeCompletionIfPresent(error);
   });
 }
@@ -101,6 +212,8 @@
 - (void)removeAllCredentials {
   dispatch_barrier_async(self.workingQueue, ^{
     [self.memoryStorage removeAllObjects];
+    [self.changedRecordIdentifiers removeAllObjects];
+    self.needsCompaction = YES;
   });
 }
 
@@ -112,12 +225,20 @@
         << "Credential already exists in the storage";
     self.memoryStorage[credential.recordIdentifier] =
         base::mac::ObjCCastStrict<ArchivableCredential>(credential);
+    [self.changedRecordIdentifiers addObject:credential.recordIdentifier];
   });
 }
 
 - (void)updateCredential:(id<Credential>)credential {
-  [self removeCredentialWithRecordIdentifier:credential.recordIdentifier];
-  [self addCredential:credential];
+  DCHECK(credential.recordIdentifier)
+      << "credential must have a record identifier";
+  dispatch_barrier_async(self.workingQueue, ^{
+    DCHECK(self.memoryStorage[credential.recordIdentifier])
+        << "Credential doesn't exist in the storage";
+    self.memoryStorage[credential.recordIdentifier] =
+        base::mac::ObjCCastStrict<ArchivableCredential>(credential);
+    [self.changedRecordIdentifiers addObject:credential.recordIdentifier];
+  });
 }
 
 - (void)removeCredentialWithRecordIdentifier:(NSString*)recordIdentifier {
@@ -126,6 +247,7 @@
     DCHECK(self.memoryStorage[recordIdentifier])
         << "Credential doesn't exist in the storage";
     self.memoryStorage[recordIdentifier] = nil;
+    [self.changedRecordIdentifiers addObject:recordIdentifier];
   });
 }
 
@@ -165,6 +287,7 @@
   if (error) {
     if (error.code == NSFileReadNoSuchFileError) {
       // File has not been created, return a fresh mutable set.
+      self.needsCompaction = YES;
       return [[NSMutableDictionary alloc] init];
     }
     NOTREACHED();
@@ -173,6 +296,13 @@
                                        options:0
                                          error:&error];
   DCHECK(!error) << base::SysNSStringToUTF8(error.description);
+  if (data.length >= sizeof(kFileMagic) &&
+      !memcmp(data.bytes, kFileMagic, sizeof(kFileMagic))) {
+    return [self loadRecordsFromData:data];
+  }
+
+  // The file was written by a previous version.
+  self.needsCompaction = YES;
   NSSet* classes = [NSSet setWithObjects:[ArchivableCredential class],
                                          [NSMutableDictionary class], nil];
   NSMutableDictionary<NSString*, ArchivableCredential*>* dictionary =
@@ -180,7 +310,137 @@
                                           fromData:data
                                              error:&error];
   DCHECK(!error) << base::SysNSStringToUTF8(error.description);
+  return dictionary ? [dictionary mutableCopy]
+                    : [[NSMutableDictionary alloc] init];
+}
+
+// Returns the credentials archived in the records of |data|.
+- (NSMutableDictionary<NSString*, ArchivableCredential*>*)loadRecordsFromData:
+    (NSData*)data {
+  NSMutableDictionary<NSString*, ArchivableCredential*>* dictionary =
+      [[NSMutableDictionary alloc] init];
+  const uint8_t* bytes = static_cast<const uint8_t*>(data.bytes);
+  const size_t length = data.length;
+  size_t offset = sizeof(kFileMagic);
+  NSUInteger recordCount = 0;
+  while (offset < length) {
+    if (length - offset < kRecordHeaderSize) {
+      break;
+    }
+    const uint8_t type = bytes[offset];
+    const uint8_t version = bytes[offset + 1];
+    const size_t identifierLength = ReadUInt32(bytes, offset + 2);
+    const size_t payloadLength =
+        ReadUInt32(bytes, offset + 2 + sizeof(uint32_t));
+    const size_t identifierOffset = offset + kRecordHeaderSize;
+    if (length - identifierOffset < identifierLength ||
+        length - identifierOffset - identifierLength < payloadLength) {
+      break;
+    }
+    offset = identifierOffset + identifierLength + payloadLength;
+    recordCount++;
+    if (version != kRecordVersion) {
+      continue;
+    }
+
+    NSString* recordIdentifier =
+        [[NSString alloc] initWithBytes:bytes + identifierOffset
+                                 length:identifierLength
+                               encoding:NSUTF8StringEncoding];
+    if (!recordIdentifier.length) {
+      continue;
+    }
+    if (type == kRecordTypeRemoval) {
+      dictionary[recordIdentifier] = nil;
+      continue;
+    }
+    DCHECK_EQ(kRecordTypeCredential, type);
+    NSData* payload = [data
+        subdataWithRange:NSMakeRange(identifierOffset + identifierLength,
+                                     payloadLength)];
+    NSError* error = nil;
+    ArchivableCredential* credential =
+        [NSKeyedUnarchiver unarchivedObjectOfClass:[ArchivableCredential class]
+                                          fromData:payload
+                                             error:&error];
+    DCHECK(!error) << base::SysNSStringToUTF8(error.description);
+    dictionary[recordIdentifier] = credential;
+  }
+
+  if (offset != length) {
+    // The last record was not completely written, e.g. because the app was
+    // killed while saving. Rewrite the file so that the next records are not
+    // appended after it.
+    self.needsCompaction = YES;
+  }
+  self.fileRecordCount = recordCount;
   return dictionary;
 }
 
+// Rewrites the file with one record per credential. Returns the error, if any.
+- (NSError*)writeAllRecords {
+#if !defined(NDEBUG)
+  dispatch_assert_queue(self.workingQueue);
+#endif  // !defined(NDEBUG)
+  NSError* error = nil;
+  NSMutableDictionary<NSString*, ArchivableCredential*>* storage =
+      self.memoryStorage;
+  NSMutableData* data = [NSMutableData dataWithBytes:kFileMagic
+                                              length:sizeof(kFileMagic)];
+  for (NSString* recordIdentifier in storage) {
+    if (!AppendRecordForCredential(data, recordIdentifier,
+                                   storage[recordIdentifier], &error)) {
+      return error;
+    }
+  }
+
+  [[NSFileManager defaultManager]
+             createDirectoryAtURL:self.fileURL.URLByDeletingLastPathComponent
+      withIntermediateDirectories:YES
+                       attributes:nil
+                            error:&error];
+  if (error) {
+    return error;
+  }
+
+  [data writeToURL:self.fileURL options:NSDataWritingAtomic error:&error];
+  DCHECK(!error) << base::SysNSStringToUTF8(error.description);
+  if (!error) {
+    self.fileRecordCount = storage.count;
+    self.needsCompaction = NO;
+    [self.changedRecordIdentifiers removeAllObjects];
+  }
+  return error;
+}
+
+// Appends the records of the credentials changed since the last save to the
+// file. Returns the error, if any.
+- (NSError*)appendChangedRecords {
+#if !defined(NDEBUG)
+  dispatch_assert_queue(self.workingQueue);
+#endif  // !defined(NDEBUG)
+  NSError* error = nil;
+  NSMutableData* data = [NSMutableData data];
+  for (NSString* recordIdentifier in self.changedRecordIdentifiers) {
+    if (!AppendRecordForCredential(data, recordIdentifier,
+                                   self.memoryStorage[recordIdentifier],
+                                   &error)) {
+      return error;
+    }
+  }
+
+  base::FilePath path = base::mac::NSStringToFilePath(self.fileURL.path);
+  if (!base::AppendToFile(path, static_cast<const char*>(data.bytes),
+                          static_cast<int>(data.length))) {
+    // The file may be partially written, rewrite it on the next save.
+    self.needsCompaction = YES;
+    return [NSError errorWithDomain:NSCocoaErrorDomain
+                               code:NSFileWriteUnknownError
+                           userInfo:nil];
+  }
+  self.fileRecordCount += self.changedRecordIdentifiers.count;
+  [self.changedRecordIdentifiers removeAllObjects];
+  return nil;
+}
+
 @end
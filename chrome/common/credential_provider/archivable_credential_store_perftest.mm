@@ -0,0 +1,129 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/chrome/common/credential_provider/archivable_credential_store.h"
+
+#include <string>
+
+#include "base/strings/string_number_conversions.h"
+#import "base/test/ios/wait_util.h"
+#include "base/timer/elapsed_timer.h"
+#import "ios/chrome/common/credential_provider/archivable_credential.h"
+#include "ios/chrome/test/base/perf_test_ios.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace {
+
+using base::test::ios::WaitUntilConditionOrTimeout;
+using base::test::ios::kWaitForFileOperationTimeout;
+
+// Number of saved passwords of a user with many passwords.
+const int kCredentialCount = 5000;
+
+NSURL* TestStorageFileURL() {
+  NSURL* temporaryDirectory = [NSURL fileURLWithPath:NSTemporaryDirectory()];
+  return [temporaryDirectory
+      URLByAppendingPathComponent:@"credentials_perftest"];
+}
+
+// Returns a credential with the record identifier and user of |index|.
+ArchivableCredential* TestCredential(int index, NSString* user) {
+  NSString* suffix = [NSString stringWithFormat:@"%d", index];
+  NSString* recordIdentifier =
+      [@"https://example.com/|user|" stringByAppendingString:suffix];
+  return [[ArchivableCredential alloc]
+           initWithFavicon:nil
+        keychainIdentifier:[@"keychain" stringByAppendingString:suffix]
+                      rank:index
+          recordIdentifier:recordIdentifier
+         serviceIdentifier:@"https://example.com/"
+               serviceName:@"example.com"
+                      user:[user stringByAppendingString:suffix]
+      validationIdentifier:nil];
+}
+
+class ArchivableCredentialStorePerfTest : public PerfTest {
+ protected:
+  ArchivableCredentialStorePerfTest()
+      : PerfTest("Archivable credential store") {}
+
+  void SetUp() override {
+    PerfTest::SetUp();
+    [[NSFileManager defaultManager] removeItemAtURL:TestStorageFileURL()
+                                              error:nil];
+  }
+
+  void TearDown() override {
+    [[NSFileManager defaultManager] removeItemAtURL:TestStorageFileURL()
+                                              error:nil];
+    PerfTest::TearDown();
+  }
+
+  // Saves |store| and returns the time until the save completed.
+  base::TimeDelta SaveAndWait(ArchivableCredentialStore* store) {
+    base::ElapsedTimer timer;
+    __block BOOL saved = NO;
+    [store saveDataWithCompletion:^(NSError* error) {
+      EXPECT_FALSE(error);
+      saved = YES;
+    }];
+    EXPECT_TRUE(WaitUntilConditionOrTimeout(kWaitForFileOperationTimeout, ^{
+      return saved;
+    }));
+    return timer.Elapsed();
+  }
+
+  // Returns the time to load the credentials from the file, as the extension
+  // does when it is launched.
+  base::TimeDelta Load() {
+    ArchivableCredentialStore* store = [[ArchivableCredentialStore alloc]
+        initWithFileURL:TestStorageFileURL()];
+    base::ElapsedTimer timer;
+    EXPECT_EQ(static_cast<NSUInteger>(kCredentialCount),
+              store.credentials.count);
+    return timer.Elapsed();
+  }
+};
+
+// Measures the time to load the credentials at launch, and to save a single
+// password change.
+TEST_F(ArchivableCredentialStorePerfTest, LoadAndSave) {
+  const std::string count = base::NumberToString(kCredentialCount);
+  ArchivableCredentialStore* store =
+      [[ArchivableCredentialStore alloc] initWithFileURL:TestStorageFileURL()];
+  NSMutableArray<ArchivableCredential*>* credentials = [NSMutableArray array];
+  for (int i = 0; i < kCredentialCount; i++) {
+    [credentials addObject:TestCredential(i, @"user")];
+  }
+  [store addOrUpdateCredentials:credentials
+      removeCredentialsWithRecordIdentifiers:nil];
+  LogPerfTiming("Save " + count + " credentials", SaveAndWait(store));
+  LogPerfTiming("Load " + count + " credentials", Load());
+
+  [store addOrUpdateCredentials:@[ TestCredential(0, @"other_user") ]
+      removeCredentialsWithRecordIdentifiers:nil];
+  LogPerfTiming("Save 1 change to " + count + " credentials",
+                SaveAndWait(store));
+  LogPerfTiming("Load " + count + " credentials after 1 change", Load());
+
+  // Files written by previous versions archive all the credentials at once.
+  NSMutableDictionary<NSString*, ArchivableCredential*>* dictionary =
+      [NSMutableDictionary dictionary];
+  for (ArchivableCredential* credential in credentials) {
+    dictionary[credential.recordIdentifier] = credential;
+  }
+  base::ElapsedTimer timer;
+  NSData* data = [NSKeyedArchiver archivedDataWithRootObject:dictionary
+                                       requiringSecureCoding:YES
+                                                       error:nil];
+  ASSERT_TRUE([data writeToURL:TestStorageFileURL() atomically:YES]);
+  LogPerfTiming("Save " + count + " credentials in the legacy format",
+                timer.Elapsed());
+  LogPerfTiming("Load " + count + " credentials in the legacy format", Load());
+}
+
+}  // namespace
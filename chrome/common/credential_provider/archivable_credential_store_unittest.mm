@@ -4,6 +4,8 @@
 
 #import "ios/chrome/common/credential_provider/archivable_credential_store.h"
 
+#include <algorithm>
+
 #import "base/test/ios/wait_util.h"
 #import "ios/chrome/common/credential_provider/archivable_credential.h"
 #include "testing/gtest_mac.h"
@@ -49,6 +51,37 @@ ArchivableCredential* TestCredential() {
                                   validationIdentifier:@"validationIdentifier"];
 }
 
+// Returns a credential with the record identifier |index| and the user |user|.
+ArchivableCredential* TestCredentialWithIndex(int index,
+                                              NSString* user = @"user") {
+  NSString* recordIdentifier = [NSString stringWithFormat:@"%d", index];
+  return [[ArchivableCredential alloc] initWithFavicon:nil
+                                    keychainIdentifier:@"keychainIdentifier"
+                                                  rank:index
+                                      recordIdentifier:recordIdentifier
+                                     serviceIdentifier:@"serviceIdentifier"
+                                           serviceName:@"serviceName"
+                                                  user:user
+                                  validationIdentifier:nil];
+}
+
+// Saves |credentialStore| and waits for the save to complete.
+void SaveAndWait(ArchivableCredentialStore* credentialStore) {
+  __block BOOL blockWaitCompleted = false;
+  [credentialStore saveDataWithCompletion:^(NSError* error) {
+    EXPECT_FALSE(error);
+    blockWaitCompleted = true;
+  }];
+  EXPECT_TRUE(WaitUntilConditionOrTimeout(kWaitForFileOperationTimeout, ^bool {
+    return blockWaitCompleted;
+  }));
+}
+
+// Returns the size of the store file.
+NSUInteger StorageFileSize() {
+  return [NSData dataWithContentsOfURL:testStorageFileURL()].length;
+}
+
 // Tests that an ArchivableCredentialStore can be created.
 TEST_F(ArchivableCredentialStoreTest, create) {
   ArchivableCredentialStore* credentialStore =
@@ -157,4 +190,115 @@ TEST_F(ArchivableCredentialStoreTest, createFolder) {
   [deepFolderURL checkResourceIsReachableAndReturnError:&error];
   EXPECT_FALSE(error);
 }
+
+// Tests that the credentials changed after a save are appended to the file, and
+// that a fresh store loads the last version of each credential.
+TEST_F(ArchivableCredentialStoreTest, persistChanges) {
+  ArchivableCredentialStore* credentialStore =
+      [[ArchivableCredentialStore alloc] initWithFileURL:testStorageFileURL()];
+  [credentialStore addOrUpdateCredentials:@[
+    TestCredentialWithIndex(0), TestCredentialWithIndex(1),
+    TestCredentialWithIndex(2)
+  ]
+      removeCredentialsWithRecordIdentifiers:nil];
+  SaveAndWait(credentialStore);
+  NSUInteger fileSize = StorageFileSize();
+
+  ArchivableCredential* updatedCredential =
+      TestCredentialWithIndex(1, @"other_user");
+  [credentialStore addOrUpdateCredentials:@[ updatedCredential ]
+      removeCredentialsWithRecordIdentifiers:@[
+        TestCredentialWithIndex(2).recordIdentifier
+      ]];
+  SaveAndWait(credentialStore);
+  // The file was appended to, not rewritten.
+  EXPECT_LT(fileSize, StorageFileSize());
+
+  ArchivableCredentialStore* freshCredentialStore =
+      [[ArchivableCredentialStore alloc] initWithFileURL:testStorageFileURL()];
+  EXPECT_EQ(2u, freshCredentialStore.credentials.count);
+  EXPECT_NSEQ(TestCredentialWithIndex(0),
+              [freshCredentialStore
+                  credentialWithRecordIdentifier:TestCredentialWithIndex(0)
+                                                     .recordIdentifier]);
+  EXPECT_NSEQ(updatedCredential,
+              [freshCredentialStore
+                  credentialWithRecordIdentifier:updatedCredential
+                                                     .recordIdentifier]);
+  EXPECT_FALSE([freshCredentialStore
+      credentialWithRecordIdentifier:TestCredentialWithIndex(2)
+                                         .recordIdentifier]);
+}
+
+// Tests that the file is rewritten once most of its records are outdated.
+TEST_F(ArchivableCredentialStoreTest, compact) {
+  ArchivableCredentialStore* credentialStore =
+      [[ArchivableCredentialStore alloc] initWithFileURL:testStorageFileURL()];
+  [credentialStore addCredential:TestCredentialWithIndex(0)];
+  SaveAndWait(credentialStore);
+  NSUInteger fileSize = StorageFileSize();
+
+  // Each save appends a record, until the file is rewritten.
+  NSUInteger maxFileSize = 0;
+  for (int i = 0; i < 100; i++) {
+    [credentialStore updateCredential:TestCredentialWithIndex(0)];
+    SaveAndWait(credentialStore);
+    maxFileSize = std::max(maxFileSize, StorageFileSize());
+  }
+  EXPECT_LT(fileSize, maxFileSize);
+  EXPECT_GT(maxFileSize, StorageFileSize());
+
+  ArchivableCredentialStore* freshCredentialStore =
+      [[ArchivableCredentialStore alloc] initWithFileURL:testStorageFileURL()];
+  EXPECT_EQ(1u, freshCredentialStore.credentials.count);
+}
+
+// Tests that a file written by previous versions, which archived all the
+// credentials at once, is loaded and rewritten with records.
+TEST_F(ArchivableCredentialStoreTest, loadLegacyFile) {
+  ArchivableCredential* credential = TestCredential();
+  NSDictionary<NSString*, ArchivableCredential*>* dictionary =
+      @{credential.recordIdentifier : credential};
+  NSData* data = [NSKeyedArchiver
+      archivedDataWithRootObject:[dictionary mutableCopy]
+           requiringSecureCoding:YES
+                           error:nil];
+  ASSERT_TRUE([data writeToURL:testStorageFileURL() atomically:YES]);
+
+  ArchivableCredentialStore* credentialStore =
+      [[ArchivableCredentialStore alloc] initWithFileURL:testStorageFileURL()];
+  EXPECT_EQ(1u, credentialStore.credentials.count);
+  [credentialStore addCredential:TestCredentialWithIndex(0)];
+  SaveAndWait(credentialStore);
+
+  ArchivableCredentialStore* freshCredentialStore =
+      [[ArchivableCredentialStore alloc] initWithFileURL:testStorageFileURL()];
+  EXPECT_EQ(2u, freshCredentialStore.credentials.count);
+  EXPECT_NSEQ(credential,
+              [freshCredentialStore
+                  credentialWithRecordIdentifier:credential.recordIdentifier]);
+}
+
+// Tests that a record partially written is ignored.
+TEST_F(ArchivableCredentialStoreTest, truncatedRecord) {
+  ArchivableCredentialStore* credentialStore =
+      [[ArchivableCredentialStore alloc] initWithFileURL:testStorageFileURL()];
+  [credentialStore addCredential:TestCredentialWithIndex(0)];
+  SaveAndWait(credentialStore);
+  NSUInteger fileSize = StorageFileSize();
+  [credentialStore addCredential:TestCredentialWithIndex(1)];
+  SaveAndWait(credentialStore);
+
+  NSData* data = [NSData dataWithContentsOfURL:testStorageFileURL()];
+  ASSERT_LT(fileSize + 1, data.length);
+  ASSERT_TRUE([[data subdataWithRange:NSMakeRange(0, data.length - 1)]
+      writeToURL:testStorageFileURL()
+      atomically:YES]);
+
+  ArchivableCredentialStore* freshCredentialStore =
+      [[ArchivableCredentialStore alloc] initWithFileURL:testStorageFileURL()];
+  EXPECT_EQ(1u, freshCredentialStore.credentials.count);
+  EXPECT_NSEQ(TestCredentialWithIndex(0),
+              freshCredentialStore.credentials.firstObject);
+}
 }
@@ -116,4 +116,22 @@ TEST_F(ArchivableCredentialTest, equality) {
 
   EXPECT_NSNE(credential, nil);
 }
+
+// Tests that ArchivableCredentials without favicon or validation identifier are
+// equal.
+TEST_F(ArchivableCredentialTest, equalityWithNilProperties) {
+  ArchivableCredential* (^credentialWithoutFavicon)(void) = ^{
+    return [[ArchivableCredential alloc] initWithFavicon:nil
+                                      keychainIdentifier:@"keychainIdentifier"
+                                                    rank:5
+                                        recordIdentifier:@"recordIdentifier"
+                                       serviceIdentifier:@"serviceIdentifier"
+                                             serviceName:@"serviceName"
+                                                    user:@"user"
+                                    validationIdentifier:nil];
+  };
+  EXPECT_NSEQ(credentialWithoutFavicon(), credentialWithoutFavicon());
+  EXPECT_NSNE(TestCredential(), credentialWithoutFavicon());
+  EXPECT_NSNE(credentialWithoutFavicon(), TestCredential());
+}
 }
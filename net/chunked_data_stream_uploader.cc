@@ -4,13 +4,29 @@
 
 #include "ios/net/chunked_data_stream_uploader.h"
 
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
 #include "base/check_op.h"
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
 
 namespace net {
 
+namespace {
+
+// Maximum size of a chunk read from the delegate in queue mode.
+const size_t kMaxQueuedChunkSize = 64 * 1024;
+
+}  // namespace
+
 ChunkedDataStreamUploader::ChunkedDataStreamUploader(Delegate* delegate)
+    : ChunkedDataStreamUploader(delegate, 0) {}
+
+ChunkedDataStreamUploader::ChunkedDataStreamUploader(Delegate* delegate,
+                                                     size_t max_queued_bytes)
     : UploadDataStream(true, 0),
       delegate_(delegate),
       pending_read_buffer_(nullptr),
@@ -18,6 +34,10 @@ ChunkedDataStreamUploader::ChunkedDataStreamUploader(Delegate* delegate)
       pending_internal_read_(false),
       is_final_chunk_(false),
       is_front_of_stream_(true),
+      max_queued_bytes_(max_queued_bytes),
+      front_chunk_offset_(0),
+      queued_bytes_(0),
+      queue_stats_(),
       weak_factory_(this) {
   DCHECK(delegate_);
 }
@@ -40,6 +60,9 @@ int ChunkedDataStreamUploader::ReadInternal(net::IOBuffer* buffer,
   pending_read_buffer_ = buffer;
   pending_read_buffer_length_ = buffer_length;
 
+  if (max_queued_bytes_)
+    return UploadFromQueue();
+
   // Read the stream if input data comes first.
   return Upload();
 }
@@ -55,6 +78,14 @@ void ChunkedDataStreamUploader::ResetInternal() {
 void ChunkedDataStreamUploader::UploadWhenReady(bool is_final_chunk) {
   is_final_chunk_ = is_final_chunk;
 
+  if (max_queued_bytes_) {
+    if (!FillQueue())
+      return;
+    if (pending_internal_read_)
+      UploadFromQueue();
+    return;
+  }
+
   // Put the data if internal read comes first.
   if (pending_internal_read_) {
     Upload();
@@ -96,4 +127,70 @@ int ChunkedDataStreamUploader::Upload() {
   return bytes_read;
 }
 
+int ChunkedDataStreamUploader::UploadFromQueue() {
+  DCHECK(pending_read_buffer_);
+
+  is_front_of_stream_ = false;
+  int bytes_read = 0;
+
+  if (!queued_chunks_.empty()) {
+    const std::vector<char>& chunk = queued_chunks_.front();
+    bytes_read = static_cast<int>(
+        std::min(chunk.size() - front_chunk_offset_,
+                 static_cast<size_t>(pending_read_buffer_length_)));
+    memcpy(pending_read_buffer_->data(), chunk.data() + front_chunk_offset_,
+           bytes_read);
+    front_chunk_offset_ += bytes_read;
+    queued_bytes_ -= bytes_read;
+    if (front_chunk_offset_ == chunk.size()) {
+      queued_chunks_.pop_front();
+      front_chunk_offset_ = 0;
+    }
+  } else if (is_final_chunk_) {
+    SetIsFinalChunk();
+  } else {
+    pending_internal_read_ = true;
+    return ERR_IO_PENDING;
+  }
+
+  pending_read_buffer_ = nullptr;
+  pending_read_buffer_length_ = 0;
+
+  // Space was freed in the queue, resume reading from the delegate.
+  if (bytes_read > 0 && !FillQueue())
+    return bytes_read;
+
+  if (pending_internal_read_) {
+    pending_internal_read_ = false;
+    OnReadCompleted(bytes_read);
+  }
+  return bytes_read;
+}
+
+bool ChunkedDataStreamUploader::FillQueue() {
+  base::WeakPtr<ChunkedDataStreamUploader> weak_this = GetWeakPtr();
+  while (!is_final_chunk_ && queued_bytes_ < max_queued_bytes_) {
+    std::vector<char> chunk(
+        std::min(kMaxQueuedChunkSize, max_queued_bytes_ - queued_bytes_));
+    const int bytes_read =
+        delegate_->OnRead(chunk.data(), static_cast<int>(chunk.size()));
+    // The delegate may delete the uploader when it fails to read the stream.
+    if (!weak_this)
+      return false;
+    // No data is available for now, reading resumes with the next call to
+    // UploadWhenReady().
+    if (bytes_read <= 0)
+      return true;
+
+    chunk.resize(bytes_read);
+    queued_bytes_ += bytes_read;
+    queued_chunks_.push_back(std::move(chunk));
+    queue_stats_.chunks_queued++;
+    queue_stats_.bytes_queued += bytes_read;
+  }
+  if (!is_final_chunk_)
+    queue_stats_.producer_stalls++;
+  return true;
+}
+
 }  // namespace net
@@ -5,10 +5,13 @@
 #ifndef IOS_NET_CHUNKED_DATA_STREAM_UPLOADER_H_
 #define IOS_NET_CHUNKED_DATA_STREAM_UPLOADER_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <memory>
+#include <vector>
 
+#include "base/containers/circular_deque.h"
 #include "base/macros.h"
 #include "base/memory/weak_ptr.h"
 #include "net/base/upload_data_stream.h"
@@ -20,8 +23,27 @@ class IOBuffer;
 // NSMutableURLRequest HTTPBodyStream. Called on the network thread. It's
 // responsible to coordinate the internal callbacks from network layer with the
 // NSInputStream data. Rewind is not supported.
+//
+// By default, data is only read from the delegate when the network layer asks
+// for it, one chunk at a time. In queue mode, the uploader reads data from the
+// delegate as soon as it is available, into a queue of chunks bounded by a
+// maximum number of bytes, so that the stream producer and the network layer
+// do not wait on each other. When the queue is full the uploader stops
+// reading from the delegate, and resumes once the network layer consumed
+// queued data.
 class ChunkedDataStreamUploader : public net::UploadDataStream {
  public:
+  // Counters describing the use of the queue in queue mode.
+  struct QueueStats {
+    // Number of chunks read from the delegate into the queue.
+    size_t chunks_queued;
+    // Number of bytes read from the delegate into the queue.
+    size_t bytes_queued;
+    // Number of times reading from the delegate stopped because the queue was
+    // full.
+    size_t producer_stalls;
+  };
+
   class Delegate {
    public:
     Delegate() {}
@@ -36,6 +58,9 @@ class ChunkedDataStreamUploader : public net::UploadDataStream {
   };
 
   ChunkedDataStreamUploader(Delegate* delegate);
+  // Creates an uploader in queue mode which keeps up to |max_queued_bytes|
+  // of data read from |delegate| until the network layer reads it.
+  ChunkedDataStreamUploader(Delegate* delegate, size_t max_queued_bytes);
   ~ChunkedDataStreamUploader() override;
 
   // Interface for iOS layer to try to upload data. If there already has a
@@ -50,10 +75,21 @@ class ChunkedDataStreamUploader : public net::UploadDataStream {
     return weak_factory_.GetWeakPtr();
   }
 
+  // Returns the counters of the queue. All zero if not in queue mode.
+  const QueueStats& queue_stats() const { return queue_stats_; }
+
  private:
   // Internal function to implement data upload to network layer.
   int Upload();
 
+  // Queue mode version of Upload(), which copies queued data to the network
+  // layer buffer.
+  int UploadFromQueue();
+
+  // Reads data from the delegate until the queue is full or the delegate has
+  // no data available. Returns false if the uploader was deleted while reading.
+  bool FillQueue();
+
   // net::UploadDataStream implementation:
   int InitInternal(const NetLogWithSource& net_log) override;
   int ReadInternal(IOBuffer* buffer, int buffer_length) override;
@@ -76,6 +112,18 @@ class ChunkedDataStreamUploader : public net::UploadDataStream {
   // for stream upload.
   bool is_front_of_stream_;
 
+  // Maximum number of queued bytes, or zero if not in queue mode.
+  const size_t max_queued_bytes_;
+
+  // Chunks of data read from the delegate but not yet read by the network
+  // layer, the offset of the unread data in the front chunk and the number of
+  // unread bytes in all chunks.
+  base::circular_deque<std::vector<char>> queued_chunks_;
+  size_t front_chunk_offset_;
+  size_t queued_bytes_;
+
+  QueueStats queue_stats_;
+
   base::WeakPtrFactory<ChunkedDataStreamUploader> weak_factory_;
 
   DISALLOW_COPY_AND_ASSIGN(ChunkedDataStreamUploader);
@@ -0,0 +1,159 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ios/net/chunked_data_stream_uploader.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/test/task_environment.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "base/timer/elapsed_timer.h"
+#include "net/base/net_errors.h"
+#include "net/test/embedded_test_server/embedded_test_server.h"
+#include "net/test/embedded_test_server/http_request.h"
+#include "net/test/embedded_test_server/http_response.h"
+#include "net/traffic_annotation/network_traffic_annotation_test_helper.h"
+#include "net/url_request/url_request.h"
+#include "net/url_request/url_request_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace net {
+
+namespace {
+
+// Size of the uploaded body.
+const size_t kBodySize = 64 * 1024 * 1024;
+// Size of the data made available by the producer at once, as an
+// NSInputStream filled by a form upload.
+const size_t kBurstSize = 16 * 1024;
+// Maximum number of queued bytes in queue mode.
+const size_t kMaxQueuedBytes = 256 * 1024;
+
+// Produces |kBodySize| bytes in bursts of |kBurstSize| bytes, posting a task
+// for each burst as the events of an NSInputStream.
+class BurstProducer : public ChunkedDataStreamUploader::Delegate {
+ public:
+  BurstProducer() : data_(kBurstSize, 'a') {}
+
+  void Start(base::WeakPtr<ChunkedDataStreamUploader> uploader) {
+    uploader_ = uploader;
+    ProduceBurst();
+  }
+
+  int OnRead(char* buffer, int buffer_length) override {
+    if (!available_bytes_)
+      return ERR_IO_PENDING;
+    size_t bytes_read =
+        std::min(available_bytes_, static_cast<size_t>(buffer_length));
+    memcpy(buffer, data_.data(), bytes_read);
+    available_bytes_ -= bytes_read;
+    return static_cast<int>(bytes_read);
+  }
+
+ private:
+  void ProduceBurst() {
+    if (!uploader_)
+      return;
+    if (produced_bytes_ == kBodySize) {
+      if (available_bytes_) {
+        PostProduceBurst();
+        return;
+      }
+      uploader_->UploadWhenReady(true);
+      return;
+    }
+    // Like an NSInputStream, the producer does not buffer more than one burst.
+    if (!available_bytes_) {
+      available_bytes_ = kBurstSize;
+      produced_bytes_ += kBurstSize;
+    }
+    uploader_->UploadWhenReady(false);
+    PostProduceBurst();
+  }
+
+  void PostProduceBurst() {
+    base::ThreadTaskRunnerHandle::Get()->PostTask(
+        FROM_HERE,
+        base::BindOnce(&BurstProducer::ProduceBurst, base::Unretained(this)));
+  }
+
+  const std::string data_;
+  size_t produced_bytes_ = 0;
+  size_t available_bytes_ = 0;
+  base::WeakPtr<ChunkedDataStreamUploader> uploader_;
+};
+
+std::unique_ptr<test_server::HttpResponse> HandleUpload(
+    const test_server::HttpRequest& request) {
+  auto response = std::make_unique<test_server::BasicHttpResponse>();
+  response->set_content(std::to_string(request.content.size()));
+  return response;
+}
+
+class ChunkedDataStreamUploaderPerfTest : public testing::Test {
+ protected:
+  ChunkedDataStreamUploaderPerfTest()
+      : task_environment_(base::test::TaskEnvironment::MainThreadType::IO) {
+    test_server_.RegisterRequestHandler(base::BindRepeating(&HandleUpload));
+    EXPECT_TRUE(test_server_.Start());
+  }
+
+  // Uploads the body with an uploader keeping up to |max_queued_bytes| and
+  // reports the throughput under |story|.
+  void MeasureUpload(const std::string& story, size_t max_queued_bytes) {
+    BurstProducer producer;
+    auto uploader = std::make_unique<ChunkedDataStreamUploader>(
+        &producer, max_queued_bytes);
+    base::WeakPtr<ChunkedDataStreamUploader> weak_uploader =
+        uploader->GetWeakPtr();
+
+    TestDelegate delegate;
+    std::unique_ptr<URLRequest> request = context_.CreateRequest(
+        test_server_.GetURL("/upload"), DEFAULT_PRIORITY, &delegate,
+        TRAFFIC_ANNOTATION_FOR_TESTS);
+    request->set_method("POST");
+    request->set_upload(std::move(uploader));
+
+    base::ElapsedTimer timer;
+    request->Start();
+    producer.Start(weak_uploader);
+    delegate.RunUntilComplete();
+    base::TimeDelta elapsed = timer.Elapsed();
+
+    EXPECT_EQ(OK, delegate.request_status());
+    EXPECT_EQ(std::to_string(kBodySize), delegate.data_received());
+
+    perf_test::PerfResultReporter reporter("ChunkedDataStreamUploader.", story);
+    reporter.RegisterImportantMetric("throughput", "MBps");
+    reporter.AddResult("throughput",
+                       kBodySize / (1024.0 * 1024.0) / elapsed.InSecondsF());
+  }
+
+  base::test::TaskEnvironment task_environment_;
+  test_server::EmbeddedTestServer test_server_;
+  TestURLRequestContext context_;
+};
+
+// Measures an upload reading the producer only when the network layer asks
+// for data.
+TEST_F(ChunkedDataStreamUploaderPerfTest, SingleChunk) {
+  MeasureUpload("single_chunk", 0);
+}
+
+// Measures an upload queueing the producer data ahead of the network layer.
+TEST_F(ChunkedDataStreamUploaderPerfTest, Queue) {
+  MeasureUpload("queue", kMaxQueuedBytes);
+}
+
+}  // namespace
+
+}  // namespace net
@@ -4,8 +4,10 @@
 
 #include "ios/net/chunked_data_stream_uploader.h"
 
+#include <algorithm>
 #include <array>
 #include <memory>
+#include <string>
 
 #include "base/bind.h"
 #include "net/base/io_buffer.h"
@@ -49,6 +51,30 @@ class MockChunkedDataStreamUploaderDelegate
   int data_length_;
 };
 
+// Mock delegate providing the data of a stream, which may be read partially.
+class MockStreamUploaderDelegate : public ChunkedDataStreamUploader::Delegate {
+ public:
+  MockStreamUploaderDelegate() {}
+  ~MockStreamUploaderDelegate() override {}
+
+  int OnRead(char* buffer, int buffer_length) override {
+    if (available_data_.empty())
+      return ERR_IO_PENDING;
+    int bytes_read =
+        std::min(buffer_length, static_cast<int>(available_data_.size()));
+    memcpy(buffer, available_data_.data(), bytes_read);
+    available_data_.erase(0, bytes_read);
+    return bytes_read;
+  }
+
+  void AppendData(const std::string& data) { available_data_ += data; }
+
+  size_t available_data_size() const { return available_data_.size(); }
+
+ private:
+  std::string available_data_;
+};
+
 class ChunkedDataStreamUploaderTest : public PlatformTest {
  public:
   ChunkedDataStreamUploaderTest() : callback_count(0) {
@@ -228,4 +254,77 @@ TEST_F(ChunkedDataStreamUploaderTest, MixedScenarioTest) {
   EXPECT_EQ(2, callback_count);
 }
 
+// Tests that in queue mode, data is read from the application layer before the
+// network layer asks for it, and is then read in order.
+TEST_F(ChunkedDataStreamUploaderTest, QueueModeReadsAhead) {
+  MockStreamUploaderDelegate delegate;
+  ChunkedDataStreamUploader uploader(&delegate, kDefaultIOBufferSize);
+  uploader.Init(base::BindRepeating([](int) {}), net::NetLogWithSource());
+
+  delegate.AppendData("Hello ");
+  uploader.UploadWhenReady(false);
+  delegate.AppendData("world!");
+  uploader.UploadWhenReady(false);
+  EXPECT_EQ(0u, delegate.available_data_size());
+  EXPECT_EQ(2u, uploader.queue_stats().chunks_queued);
+
+  auto buffer = base::MakeRefCounted<net::IOBuffer>(kDefaultIOBufferSize);
+  int bytes_read = uploader.Read(
+      buffer.get(), kDefaultIOBufferSize,
+      base::BindRepeating(&ChunkedDataStreamUploaderTest::CompletionCallback,
+                          base::Unretained(this)));
+  EXPECT_EQ("Hello ", std::string(buffer->data(), bytes_read));
+  bytes_read = uploader.Read(
+      buffer.get(), kDefaultIOBufferSize,
+      base::BindRepeating(&ChunkedDataStreamUploaderTest::CompletionCallback,
+                          base::Unretained(this)));
+  EXPECT_EQ("world!", std::string(buffer->data(), bytes_read));
+
+  // The queue is empty, the read is pending until the upload finishes.
+  int ret = uploader.Read(
+      buffer.get(), kDefaultIOBufferSize,
+      base::BindRepeating(&ChunkedDataStreamUploaderTest::CompletionCallback,
+                          base::Unretained(this)));
+  EXPECT_EQ(ERR_IO_PENDING, ret);
+  uploader.UploadWhenReady(true);
+  EXPECT_TRUE(uploader.IsEOF());
+  EXPECT_EQ(1, callback_count);
+}
+
+// Tests that in queue mode, reading from the application layer stops when the
+// queue is full and resumes when the network layer reads queued data.
+TEST_F(ChunkedDataStreamUploaderTest, QueueModeBackpressure) {
+  MockStreamUploaderDelegate delegate;
+  const size_t kMaxQueuedBytes = 8;
+  ChunkedDataStreamUploader uploader(&delegate, kMaxQueuedBytes);
+  uploader.Init(base::BindRepeating([](int) {}), net::NetLogWithSource());
+
+  delegate.AppendData("0123456789abcdef");
+  uploader.UploadWhenReady(false);
+  EXPECT_EQ(8u, delegate.available_data_size());
+  EXPECT_EQ(1u, uploader.queue_stats().producer_stalls);
+
+  // Reading a part of the queue lets the uploader read more data.
+  auto buffer = base::MakeRefCounted<net::IOBuffer>(4);
+  int bytes_read = uploader.Read(
+      buffer.get(), 4,
+      base::BindRepeating(&ChunkedDataStreamUploaderTest::CompletionCallback,
+                          base::Unretained(this)));
+  EXPECT_EQ("0123", std::string(buffer->data(), bytes_read));
+  EXPECT_EQ(4u, delegate.available_data_size());
+
+  std::string uploaded_data;
+  while (uploaded_data.size() < 12) {
+    bytes_read = uploader.Read(
+        buffer.get(), 4,
+        base::BindRepeating(&ChunkedDataStreamUploaderTest::CompletionCallback,
+                            base::Unretained(this)));
+    ASSERT_GT(bytes_read, 0);
+    uploaded_data.append(buffer->data(), bytes_read);
+  }
+  EXPECT_EQ("456789abcdef", uploaded_data);
+  EXPECT_EQ(16u, uploader.queue_stats().bytes_queued);
+  EXPECT_EQ(0, callback_count);
+}
+
 }  // namespace net
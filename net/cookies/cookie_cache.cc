@@ -6,10 +6,43 @@
 
 #include <algorithm>
 
+#include "base/strings/string_piece.h"
+#include "net/base/registry_controlled_domains/registry_controlled_domain.h"
 #include "net/cookies/cookie_options.h"
 
 namespace net {
 
+namespace {
+
+// Returns the registrable domain of |host|, or |host| itself if it does not
+// have one (e.g. for IP addresses). A leading dot, as found in the domain of
+// domain cookies, is ignored.
+std::string RegistrableDomain(base::StringPiece host) {
+  if (!host.empty() && host[0] == '.')
+    host.remove_prefix(1);
+  std::string domain = registry_controlled_domains::GetDomainAndRegistry(
+      host, registry_controlled_domains::INCLUDE_PRIVATE_REGISTRIES);
+  return domain.empty() ? host.as_string() : domain;
+}
+
+// Returns whether |cookie| would be sent with a request for |url|.
+bool IsCookieSentForURL(const net::CanonicalCookie& cookie, const GURL& url) {
+  return cookie.IsDomainMatch(url.host()) && cookie.IsOnPath(url.path()) &&
+         (!cookie.IsSecure() || url.SchemeIsCryptographic());
+}
+
+}  // namespace
+
+CookieCache::CookieChanges::CookieChanges() = default;
+
+CookieCache::CookieChanges::CookieChanges(CookieChanges&& other) = default;
+
+CookieCache::CookieChanges::~CookieChanges() = default;
+
+CookieCache::CacheEntry::CacheEntry() = default;
+
+CookieCache::CacheEntry::~CacheEntry() = default;
+
 CookieCache::CookieCache() {
 }
 
@@ -21,9 +54,69 @@ bool CookieCache::Update(const GURL& url,
                          const std::vector<net::CanonicalCookie>& new_cookies,
                          std::vector<net::CanonicalCookie>* out_removed_cookies,
                          std::vector<net::CanonicalCookie>* out_added_cookies) {
-  CookieKey key(url, name);
-  CookieSet old_set = cache_[key];
   CookieSet new_set(new_cookies.begin(), new_cookies.end());
+  return UpdateEntry(&GetEntry(CookieKey(url, name)), std::move(new_set),
+                     out_removed_cookies, out_added_cookies);
+}
+
+std::map<CookieCache::CookieKey, CookieCache::CookieChanges>
+CookieCache::UpdateAll(const std::vector<net::CanonicalCookie>& all_cookies) {
+  std::set<std::string> cached_names;
+  for (const auto& cache_entry : cache_)
+    cached_names.insert(cache_entry.first.second);
+
+  // Group the cookies which may be cached by (registrable domain, name).
+  std::map<std::pair<std::string, std::string>,
+           std::vector<const net::CanonicalCookie*>>
+      cookie_groups;
+  for (const net::CanonicalCookie& cookie : all_cookies) {
+    if (cached_names.count(cookie.Name()) == 0)
+      continue;
+    cookie_groups[std::make_pair(RegistrableDomain(cookie.Domain()),
+                                 cookie.Name())]
+        .push_back(&cookie);
+  }
+
+  std::map<CookieKey, CookieChanges> changes;
+  for (auto& cache_entry : cache_) {
+    const CookieKey& key = cache_entry.first;
+    CookieSet new_set;
+    auto group_it = cookie_groups.find(
+        std::make_pair(cache_entry.second.registrable_domain, key.second));
+    if (group_it != cookie_groups.end()) {
+      for (const net::CanonicalCookie* cookie : group_it->second) {
+        if (IsCookieSentForURL(*cookie, key.first))
+          new_set.insert(*cookie);
+      }
+    }
+
+    CookieChanges key_changes;
+    if (UpdateEntry(&cache_entry.second, std::move(new_set),
+                    &key_changes.removed_cookies,
+                    &key_changes.added_cookies)) {
+      changes.emplace(key, std::move(key_changes));
+    }
+  }
+  return changes;
+}
+
+CookieCache::CacheEntry& CookieCache::GetEntry(const CookieKey& key) {
+  auto it = cache_.find(key);
+  if (it != cache_.end())
+    return it->second;
+
+  CacheEntry& entry = cache_[key];
+  entry.registrable_domain = RegistrableDomain(key.first.host_piece());
+  return entry;
+}
+
+// static
+bool CookieCache::UpdateEntry(
+    CacheEntry* entry,
+    CookieSet new_set,
+    std::vector<net::CanonicalCookie>* out_removed_cookies,
+    std::vector<net::CanonicalCookie>* out_added_cookies) {
+  const CookieSet& old_set = entry->cookies;
 
   // Compute the changes and the removals.
   CookieSet added_cookies;
@@ -40,7 +133,7 @@ bool CookieCache::Update(const GURL& url,
   if (added_cookies.empty() && removed_cookies.empty())
     return false;
 
-  cache_[key] = new_set;
+  entry->cookies = std::move(new_set);
   if (out_removed_cookies) {
     out_removed_cookies->insert(out_removed_cookies->end(),
                                 removed_cookies.begin(), removed_cookies.end());
@@ -9,6 +9,7 @@
 #include <set>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "base/macros.h"
 #include "net/cookies/canonical_cookie.h"
@@ -21,8 +22,24 @@ namespace net {
 // provides one operation, Update(), which updates the set of cookies for a
 // (url, name) pair and returns whether the new set for that (url, name) pair is
 // different from the old set.
+// Cached (url, name) pairs are indexed by the registrable domain of the url, so
+// that UpdateAll() can update every pair from a single list of all cookies.
 class CookieCache {
  public:
+  // Identifies the cookies named |second| that would be sent with requests for
+  // the url |first|.
+  typedef std::pair<GURL, std::string> CookieKey;
+
+  // The cookies added and removed for a CookieKey by UpdateAll().
+  struct CookieChanges {
+    CookieChanges();
+    CookieChanges(CookieChanges&& other);
+    ~CookieChanges();
+
+    std::vector<net::CanonicalCookie> removed_cookies;
+    std::vector<net::CanonicalCookie> added_cookies;
+  };
+
   CookieCache();
   ~CookieCache();
 
@@ -46,6 +63,16 @@ class CookieCache {
               std::vector<net::CanonicalCookie>* out_removed_cookies,
               std::vector<net::CanonicalCookie>* out_added_cookies);
 
+  // Updates every (url, name) pair present in the cache from |all_cookies|,
+  // which must hold all the cookies of the cookie store. Cookies are grouped
+  // by registrable domain and name in a single pass, and each pair is only
+  // matched against the cookies of its group.
+  //
+  // Returns the added and removed cookies of each pair whose set of cookies
+  // changed. Pairs which did not change are not returned.
+  std::map<CookieKey, CookieChanges> UpdateAll(
+      const std::vector<net::CanonicalCookie>& all_cookies);
+
  private:
   // Compares two cookies, returning true if |lhs| comes before |rhs| in the
   // partial ordering defined for CookieSet. This effectively does a
@@ -65,8 +92,30 @@ class CookieCache {
   };
 
   typedef std::set<net::CanonicalCookie, CookieComparator> CookieSet;
-  typedef std::pair<GURL, std::string> CookieKey;
-  typedef std::map<CookieKey, CookieSet> CookieKeyPathMap;
+
+  // Cached cookies for a CookieKey.
+  struct CacheEntry {
+    CacheEntry();
+    ~CacheEntry();
+
+    // Registrable domain of the url of the key, used to group keys in
+    // UpdateAll().
+    std::string registrable_domain;
+    CookieSet cookies;
+  };
+  typedef std::map<CookieKey, CacheEntry> CookieKeyPathMap;
+
+  // Returns the entry for |key|, creating it if needed.
+  CacheEntry& GetEntry(const CookieKey& key);
+
+  // Replaces the cookies of |entry| with |new_set| if they differ, appending
+  // the differences to |out_removed_cookies| and |out_added_cookies| if not
+  // NULL. Returns whether the cookies differed.
+  static bool UpdateEntry(
+      CacheEntry* entry,
+      CookieSet new_set,
+      std::vector<net::CanonicalCookie>* out_removed_cookies,
+      std::vector<net::CanonicalCookie>* out_added_cookies);
 
   CookieKeyPathMap cache_;
 
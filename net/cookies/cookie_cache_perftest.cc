@@ -0,0 +1,130 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ios/net/cookies/cookie_cache.h"
+
+#include <string>
+#include <vector>
+
+#include "base/strings/stringprintf.h"
+#include "base/timer/elapsed_timer.h"
+#include "net/cookies/canonical_cookie.h"
+#include "net/cookies/cookie_constants.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+#include "url/gurl.h"
+
+namespace net {
+
+namespace {
+
+// Number of (url, name) pairs with a change hook.
+const int kHookCount = 1000;
+// Number of cookies in the store.
+const int kCookieCount = 5000;
+// Number of distinct registrable domains.
+const int kDomainCount = 200;
+// Number of distinct cookie names per domain.
+const int kNameCount = 10;
+
+CanonicalCookie MakeCookie(int index, const std::string& value) {
+  std::string domain =
+      base::StringPrintf(".site%d.com", index % kDomainCount);
+  std::string name = base::StringPrintf("name%d", index % kNameCount);
+  std::string path = base::StringPrintf("/path%d", index % 3);
+  return CanonicalCookie(name, value, domain, path, base::Time(), base::Time(),
+                         base::Time(), false, false,
+                         net::CookieSameSite::NO_RESTRICTION,
+                         net::COOKIE_PRIORITY_DEFAULT, false);
+}
+
+CookieCache::CookieKey MakeKey(int index) {
+  return CookieCache::CookieKey(
+      GURL(base::StringPrintf("https://www.site%d.com/path%d",
+                              index % kDomainCount, index % 3)),
+      base::StringPrintf("name%d", (index / kDomainCount) % kNameCount));
+}
+
+std::vector<CanonicalCookie> MakeCookies(const std::string& value) {
+  std::vector<CanonicalCookie> cookies;
+  for (int i = 0; i < kCookieCount; i++)
+    cookies.push_back(MakeCookie(i, value));
+  return cookies;
+}
+
+// Returns the cookies of |all_cookies| which would be fetched for |key| by an
+// individual lookup.
+std::vector<CanonicalCookie> CookiesForKey(
+    const CookieCache::CookieKey& key,
+    const std::vector<CanonicalCookie>& all_cookies) {
+  std::vector<CanonicalCookie> cookies;
+  for (const CanonicalCookie& cookie : all_cookies) {
+    if (cookie.Name() == key.second && cookie.IsDomainMatch(key.first.host()) &&
+        cookie.IsOnPath(key.first.path())) {
+      cookies.push_back(cookie);
+    }
+  }
+  return cookies;
+}
+
+class CookieCachePerfTest : public testing::Test {
+ protected:
+  CookieCachePerfTest() {
+    for (int i = 0; i < kHookCount; i++)
+      keys_.push_back(MakeKey(i));
+  }
+
+  void ReportTime(const std::string& story, base::TimeDelta elapsed) {
+    perf_test::PerfResultReporter reporter("CookieCache.", story);
+    reporter.RegisterImportantMetric("update_time", "ms");
+    reporter.AddResult("update_time", elapsed);
+  }
+
+  std::vector<CookieCache::CookieKey> keys_;
+};
+
+// Updates each hooked pair with its own lookup over all cookies, as done when
+// one cookie fetch is issued per hook.
+TEST_F(CookieCachePerfTest, UpdatePerKey) {
+  CookieCache cache;
+  std::vector<CanonicalCookie> initial_cookies = MakeCookies("a");
+  for (const auto& key : keys_) {
+    cache.Update(key.first, key.second, CookiesForKey(key, initial_cookies),
+                 nullptr, nullptr);
+  }
+
+  std::vector<CanonicalCookie> changed_cookies = MakeCookies("b");
+  base::ElapsedTimer timer;
+  int changed_keys = 0;
+  for (const auto& key : keys_) {
+    std::vector<CanonicalCookie> removed;
+    std::vector<CanonicalCookie> added;
+    if (cache.Update(key.first, key.second,
+                     CookiesForKey(key, changed_cookies), &removed, &added)) {
+      changed_keys++;
+    }
+  }
+  ReportTime("per_key", timer.Elapsed());
+  EXPECT_GT(changed_keys, 0);
+}
+
+// Updates all hooked pairs with a single pass over all cookies.
+TEST_F(CookieCachePerfTest, UpdateAll) {
+  CookieCache cache;
+  std::vector<CanonicalCookie> no_cookies;
+  for (const auto& key : keys_)
+    cache.Update(key.first, key.second, no_cookies, nullptr, nullptr);
+  cache.UpdateAll(MakeCookies("a"));
+
+  std::vector<CanonicalCookie> changed_cookies = MakeCookies("b");
+  base::ElapsedTimer timer;
+  std::map<CookieCache::CookieKey, CookieCache::CookieChanges> changes =
+      cache.UpdateAll(changed_cookies);
+  ReportTime("batched", timer.Elapsed());
+  EXPECT_GT(changes.size(), 0U);
+}
+
+}  // namespace
+
+}  // namespace net
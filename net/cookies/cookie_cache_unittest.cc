@@ -24,6 +24,17 @@ CanonicalCookie MakeCookie(const GURL& url,
                          net::COOKIE_PRIORITY_DEFAULT, false);
 }
 
+CanonicalCookie MakeDomainCookie(const std::string& domain,
+                                 const std::string& path,
+                                 const std::string& name,
+                                 const std::string& value,
+                                 bool secure) {
+  return CanonicalCookie(name, value, domain, path, base::Time(), base::Time(),
+                         base::Time(), secure, false,
+                         net::CookieSameSite::NO_RESTRICTION,
+                         net::COOKIE_PRIORITY_DEFAULT, false);
+}
+
 }  // namespace
 
 using CookieCacheTest = PlatformTest;
@@ -169,4 +180,72 @@ TEST_F(CookieCacheTest, MultipleNames) {
   EXPECT_FALSE(cache.Update(cookieurl, "abc", cookies, nullptr, nullptr));
 }
 
+TEST_F(CookieCacheTest, UpdateAllReportsChangesPerKey) {
+  CookieCache cache;
+  const GURL google_url("http://www.google.com");
+  const GURL example_url("http://www.example.com");
+  std::vector<CanonicalCookie> no_cookies;
+  EXPECT_FALSE(cache.Update(google_url, "abc", no_cookies, nullptr, nullptr));
+  EXPECT_FALSE(cache.Update(google_url, "def", no_cookies, nullptr, nullptr));
+  EXPECT_FALSE(cache.Update(example_url, "abc", no_cookies, nullptr, nullptr));
+
+  std::vector<CanonicalCookie> all_cookies;
+  all_cookies.push_back(MakeCookie(google_url, "abc", "1"));
+  all_cookies.push_back(
+      MakeDomainCookie(".google.com", "/", "def", "2", false));
+  all_cookies.push_back(
+      MakeCookie(GURL("http://other.example.com"), "abc", "3"));
+  all_cookies.push_back(MakeCookie(google_url, "ghi", "4"));
+
+  std::map<CookieCache::CookieKey, CookieCache::CookieChanges> changes =
+      cache.UpdateAll(all_cookies);
+  ASSERT_EQ(2U, changes.size());
+  const CookieCache::CookieChanges& abc_changes =
+      changes[CookieCache::CookieKey(google_url, "abc")];
+  EXPECT_TRUE(abc_changes.removed_cookies.empty());
+  ASSERT_EQ(1U, abc_changes.added_cookies.size());
+  EXPECT_EQ("1", abc_changes.added_cookies[0].Value());
+  const CookieCache::CookieChanges& def_changes =
+      changes[CookieCache::CookieKey(google_url, "def")];
+  EXPECT_TRUE(def_changes.removed_cookies.empty());
+  ASSERT_EQ(1U, def_changes.added_cookies.size());
+  EXPECT_EQ("2", def_changes.added_cookies[0].Value());
+
+  // Nothing changed.
+  EXPECT_TRUE(cache.UpdateAll(all_cookies).empty());
+
+  // Remove the "abc" cookie.
+  all_cookies.erase(all_cookies.begin());
+  changes = cache.UpdateAll(all_cookies);
+  ASSERT_EQ(1U, changes.size());
+  const CookieCache::CookieChanges& removed_changes =
+      changes[CookieCache::CookieKey(google_url, "abc")];
+  EXPECT_TRUE(removed_changes.added_cookies.empty());
+  ASSERT_EQ(1U, removed_changes.removed_cookies.size());
+  EXPECT_EQ("1", removed_changes.removed_cookies[0].Value());
+}
+
+TEST_F(CookieCacheTest, UpdateAllMatchesPathAndScheme) {
+  CookieCache cache;
+  const GURL test_url("http://www.google.com/foo");
+  std::vector<CanonicalCookie> no_cookies;
+  EXPECT_FALSE(cache.Update(test_url, "abc", no_cookies, nullptr, nullptr));
+
+  std::vector<CanonicalCookie> all_cookies;
+  all_cookies.push_back(
+      MakeDomainCookie("www.google.com", "/bar", "abc", "1", false));
+  all_cookies.push_back(
+      MakeDomainCookie("www.google.com", "/foo", "abc", "2", true));
+  EXPECT_TRUE(cache.UpdateAll(all_cookies).empty());
+
+  all_cookies.push_back(
+      MakeDomainCookie("www.google.com", "/", "abc", "3", false));
+  std::map<CookieCache::CookieKey, CookieCache::CookieChanges> changes =
+      cache.UpdateAll(all_cookies);
+  ASSERT_EQ(1U, changes.size());
+  const CookieCache::CookieChanges& key_changes = changes.begin()->second;
+  ASSERT_EQ(1U, key_changes.added_cookies.size());
+  EXPECT_EQ("3", key_changes.added_cookies[0].Value());
+}
+
 }  // namespace net
@@ -10,6 +10,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -73,6 +74,27 @@ class CookieStoreIOS : public net::CookieStore,
 
   enum CookiePolicy { ALLOW, BLOCK };
 
+  // Counters describing how system cookies were copied to the backing
+  // CookieMonster by WriteToCookieMonster().
+  struct CookieMonsterSyncStats {
+    // Number of synchronizations which replaced all the cookies.
+    size_t full_syncs = 0;
+    // Number of synchronizations which only wrote the changed cookies.
+    size_t incremental_syncs = 0;
+    // Number of cookies inserted, updated and deleted by incremental
+    // synchronizations.
+    size_t cookies_inserted = 0;
+    size_t cookies_updated = 0;
+    size_t cookies_deleted = 0;
+    // Number of cookies which incremental synchronizations did not convert nor
+    // write because they were unchanged since the previous synchronization.
+    size_t cookies_unchanged = 0;
+    // Number of cookies written by incremental synchronizations which
+    // CookieMonster rejected, forcing the next synchronization to replace all
+    // the cookies.
+    size_t rejected_cookies = 0;
+  };
+
   // Must be called when the state of
   // |NSHTTPCookieStorage sharedHTTPCookieStorage| changes.
   // Affects only those CookieStoreIOS instances that are backed by
@@ -82,6 +104,11 @@ class CookieStoreIOS : public net::CookieStore,
   // Only one cookie store may enable metrics.
   void SetMetricsEnabled();
 
+  // Returns the counters of the synchronizations to the backing CookieMonster.
+  const CookieMonsterSyncStats& cookie_monster_sync_stats() const {
+    return cookie_monster_sync_stats_;
+  }
+
   // Implementation of the net::CookieStore interface.
   void SetCanonicalCookieAsync(std::unique_ptr<CanonicalCookie> cookie,
                                const GURL& source_url,
@@ -173,12 +200,29 @@ class CookieStoreIOS : public net::CookieStore,
       const std::string& name,
       CookieChangeCallback callback) WARN_UNUSED_RESULT;
 
+  // Identifies a cookie by its (domain, path, name).
+  typedef std::tuple<std::string, std::string, std::string> SyncedCookieKey;
+
   // Returns true if the system cookie store policy is
   // |NSHTTPCookieAcceptPolicyAlways|.
   bool SystemCookiesAllowed();
-  // Copies the cookies to the backing CookieMonster.
+  // Copies the cookies to the backing CookieMonster. Only the cookies which
+  // changed since the previous call are written, unless the backing
+  // CookieMonster was never written or diverged from the system cookies, in
+  // which case all the cookies are replaced.
   virtual void WriteToCookieMonster(NSArray* system_cookies);
 
+  // Called when the backing CookieMonster set a cookie written by an
+  // incremental synchronization. Forces the next synchronization to replace
+  // all the cookies if the cookie was rejected.
+  void OnSyncedCookieSet(net::CookieAccessResult access_result);
+
+  // Replaces all the cookies of the backing CookieMonster with
+  // |system_cookies|, whose keys and fingerprints are in |fingerprints|.
+  void WriteAllToCookieMonster(
+      NSArray* system_cookies,
+      const std::map<SyncedCookieKey, size_t>& fingerprints);
+
   // Inherited CookieNotificationObserver methods.
   void OnSystemCookiesChanged() override;
 
@@ -199,6 +243,15 @@ class CookieStoreIOS : public net::CookieStore,
   bool metrics_enabled_;
   base::CancelableOnceClosure flush_closure_;
 
+  // The fingerprints of the cookies last written to |cookie_monster_| by
+  // WriteToCookieMonster().
+  std::map<SyncedCookieKey, size_t> synced_cookies_;
+  // Whether |cookie_monster_| holds the cookies of |synced_cookies_|. False
+  // until WriteToCookieMonster() has written all the system cookies, and
+  // whenever |cookie_monster_| rejected one of the written cookies.
+  bool cookie_monster_synced_ = false;
+  CookieMonsterSyncStats cookie_monster_sync_stats_;
+
   // Cookie notification methods.
   // The cookie cache is updated from both the system store and the
   // CookieStoreIOS' own mutators. Changes when the CookieStoreIOS is
@@ -233,15 +286,19 @@ class CookieStoreIOS : public net::CookieStore,
                               const std::vector<net::CanonicalCookie>& cookies,
                               net::CookieChangeCause cause);
 
-  // Called by this CookieStoreIOS' internal CookieMonster instance when
-  // UpdateCachesFromCookieMonster completes. Updates the cookie cache and runs
-  // callbacks if the cache changed.
-  void GotCookieListFor(const std::pair<GURL, std::string> key,
-                        const net::CookieAccessResultList& cookies,
-                        const net::CookieAccessResultList& excluded_cookies);
+  // Updates the cookie cache for all (url, name) pairs that have hooks
+  // registered from the complete list of system cookies |nscookies|, and runs
+  // the callbacks of the pairs which changed.
+  void UpdateCachesFromSystemCookies(NSArray<NSHTTPCookie*>* nscookies);
+
+  // Updates the cookie cache for all (url, name) pairs that have hooks
+  // registered from the complete list of |cookies|, and runs the callbacks of
+  // the pairs which changed.
+  void UpdateCachesFromCookies(const net::CookieList& cookies);
 
-  // Fetches new values for all (url, name) pairs that have hooks registered,
-  // asynchronously invoking callbacks if necessary.
+  // Fetches all cookies from this CookieStoreIOS' internal CookieMonster once
+  // to update all (url, name) pairs that have hooks registered, asynchronously
+  // invoking callbacks if necessary.
   void UpdateCachesFromCookieMonster();
 
   // Callback-wrapping:
@@ -7,10 +7,13 @@
 #import <Foundation/Foundation.h>
 #include <stddef.h>
 
+#include <set>
+
 #include "base/bind.h"
 #include "base/check_op.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
+#include "base/hash/hash.h"
 #include "base/location.h"
 #include "base/mac/foundation_util.h"
 #include "base/macros.h"
@@ -19,6 +22,7 @@
 #include "base/notreached.h"
 #include "base/observer_list.h"
 #include "base/sequenced_task_runner.h"
+#include "base/strings/stringprintf.h"
 #include "base/strings/sys_string_conversions.h"
 #include "base/task_runner_util.h"
 #include "base/threading/thread_restrictions.h"
@@ -29,10 +33,12 @@
 #import "ios/net/cookies/system_cookie_util.h"
 #include "ios/net/ios_net_buildflags.h"
 #import "net/base/mac/url_conversions.h"
+#include "net/cookies/cookie_constants.h"
 #include "net/cookies/cookie_util.h"
 #include "net/cookies/parsed_cookie.h"
 #include "net/log/net_log.h"
 #include "url/gurl.h"
+#include "url/third_party/mozilla/url_parse.h"
 
 #if !defined(__has_feature) || !__has_feature(objc_arc)
 #error "This file requires ARC support."
@@ -114,14 +120,39 @@ base::OnceClosure BindSetCookiesCallback(
   return set_callback;
 }
 
-// Adds cookies in |cookies| with name |name| to |filtered|.
-void OnlyCookiesWithName(const net::CookieAccessResultList& cookies,
-                         const std::string& name,
-                         net::CookieList* filtered) {
-  for (const auto& cookie_with_access_result : cookies) {
-    if (cookie_with_access_result.cookie.Name() == name)
-      filtered->push_back(cookie_with_access_result.cookie);
-  }
+// Returns the (domain, path, name) identifying |cookie|.
+std::tuple<std::string, std::string, std::string> SyncKeyForSystemCookie(
+    NSHTTPCookie* cookie) {
+  return std::make_tuple(base::SysNSStringToUTF8(cookie.domain),
+                         base::SysNSStringToUTF8(cookie.path),
+                         base::SysNSStringToUTF8(cookie.name));
+}
+
+// Returns a hash of the attributes of |cookie| which are copied to
+// CookieMonster.
+size_t FingerprintForSystemCookie(NSHTTPCookie* cookie) {
+  std::string attributes = base::StringPrintf(
+      "%s\n%s\n%s\n%s\n%f\n%d%d",
+      base::SysNSStringToUTF8(cookie.domain).c_str(),
+      base::SysNSStringToUTF8(cookie.path).c_str(),
+      base::SysNSStringToUTF8(cookie.name).c_str(),
+      base::SysNSStringToUTF8(cookie.value).c_str(),
+      cookie.expiresDate.timeIntervalSince1970, cookie.isSecure,
+      cookie.isHTTPOnly);
+  return base::FastHash(base::as_bytes(base::make_span(attributes)));
+}
+
+// Returns an expired cookie which, once set, deletes the cookie identified by
+// |key| from CookieMonster regardless of its value.
+std::unique_ptr<net::CanonicalCookie> ExpiredCookieForSyncKey(
+    const std::tuple<std::string, std::string, std::string>& key) {
+  return net::CanonicalCookie::FromStorage(
+      std::get<2>(key), std::string(), std::get<0>(key), std::get<1>(key),
+      base::Time::Now(), base::Time::UnixEpoch(), base::Time(),
+      true /* secure */, false /* httponly */,
+      net::CookieSameSite::NO_RESTRICTION, net::COOKIE_PRIORITY_DEFAULT,
+      false /* same_party */, net::CookieSourceScheme::kUnset,
+      url::PORT_UNSPECIFIED);
 }
 
 }  // namespace
@@ -444,6 +475,88 @@ bool CookieStoreIOS::SystemCookiesAllowed() {
 
 void CookieStoreIOS::WriteToCookieMonster(NSArray* system_cookies) {
   DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  NSUInteger cookie_count = [system_cookies count];
+
+  // Find the cookies which changed since the previous synchronization.
+  std::map<SyncedCookieKey, size_t> fingerprints;
+  NSMutableArray<NSHTTPCookie*>* changed_cookies = [NSMutableArray array];
+  for (NSHTTPCookie* cookie in system_cookies) {
+    SyncedCookieKey key = SyncKeyForSystemCookie(cookie);
+    size_t fingerprint = FingerprintForSystemCookie(cookie);
+    fingerprints[key] = fingerprint;
+    auto it = synced_cookies_.find(key);
+    if (it == synced_cookies_.end() || it->second != fingerprint)
+      [changed_cookies addObject:cookie];
+  }
+  std::vector<SyncedCookieKey> deleted_keys;
+  for (const auto& synced_cookie : synced_cookies_) {
+    if (fingerprints.count(synced_cookie.first) == 0)
+      deleted_keys.push_back(synced_cookie.first);
+  }
+
+  // Replace all the cookies if |cookie_monster_| may not match
+  // |synced_cookies_|.
+  if (!cookie_monster_synced_) {
+    WriteAllToCookieMonster(system_cookies, fingerprints);
+    return;
+  }
+
+  for (const SyncedCookieKey& key : deleted_keys) {
+    if (std::unique_ptr<net::CanonicalCookie> expired_cookie =
+            ExpiredCookieForSyncKey(key)) {
+      GURL source_url = cookie_util::CookieOriginToURL(
+          expired_cookie->Domain(), expired_cookie->IsSecure());
+      cookie_monster_->SetCanonicalCookieAsync(
+          std::move(expired_cookie), source_url,
+          net::CookieOptions::MakeAllInclusive(), SetCookiesCallback());
+    }
+    synced_cookies_.erase(key);
+  }
+
+  for (NSHTTPCookie* cookie in changed_cookies) {
+    SyncedCookieKey key = SyncKeyForSystemCookie(cookie);
+    auto it = synced_cookies_.find(key);
+    if (it != synced_cookies_.end()) {
+      cookie_monster_sync_stats_.cookies_updated++;
+    } else {
+      cookie_monster_sync_stats_.cookies_inserted++;
+    }
+
+    // Setting a cookie replaces the previous version with the same key. If the
+    // cookie can no longer be converted, the previous version is deleted.
+    std::unique_ptr<net::CanonicalCookie> canonical_cookie =
+        CanonicalCookieFromSystemCookie(
+            cookie, system_store_->GetCookieCreationTime(cookie));
+    if (!canonical_cookie && it != synced_cookies_.end())
+      canonical_cookie = ExpiredCookieForSyncKey(key);
+    if (canonical_cookie) {
+      GURL source_url = cookie_util::CookieOriginToURL(
+          canonical_cookie->Domain(), canonical_cookie->IsSecure());
+      cookie_monster_->SetCanonicalCookieAsync(
+          std::move(canonical_cookie), source_url,
+          net::CookieOptions::MakeAllInclusive(),
+          base::BindOnce(&CookieStoreIOS::OnSyncedCookieSet,
+                         weak_factory_.GetWeakPtr()));
+    }
+    synced_cookies_[key] = fingerprints[key];
+  }
+
+  cookie_monster_sync_stats_.incremental_syncs++;
+  cookie_monster_sync_stats_.cookies_deleted += deleted_keys.size();
+  cookie_monster_sync_stats_.cookies_unchanged +=
+      cookie_count - changed_cookies.count;
+
+  // Update metrics.
+  if (metrics_enabled_) {
+    UMA_HISTOGRAM_COUNTS_10000("CookieIOS.CookieWrittenCount",
+                               changed_cookies.count + deleted_keys.size());
+  }
+}
+
+void CookieStoreIOS::WriteAllToCookieMonster(
+    NSArray* system_cookies,
+    const std::map<SyncedCookieKey, size_t>& fingerprints) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
   // Copy the cookies from the global cookie store to |cookie_monster_|.
   // Unlike the system store, CookieMonster requires unique creation times.
   net::CookieList cookie_list;
@@ -457,10 +570,22 @@ void CookieStoreIOS::WriteToCookieMonster(NSArray* system_cookies) {
     }
   }
   cookie_monster_->SetAllCookiesAsync(cookie_list, SetCookiesCallback());
+  synced_cookies_ = fingerprints;
+  cookie_monster_synced_ = true;
+  cookie_monster_sync_stats_.full_syncs++;
 
   // Update metrics.
   if (metrics_enabled_)
-    UMA_HISTOGRAM_COUNTS_10000("CookieIOS.CookieWrittenCount", cookie_count);
+    UMA_HISTOGRAM_COUNTS_10000("CookieIOS.CookieWrittenCount",
+                               cookie_list.size());
+}
+
+void CookieStoreIOS::OnSyncedCookieSet(net::CookieAccessResult access_result) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  if (!access_result.status.IsInclude()) {
+    cookie_monster_synced_ = false;
+    cookie_monster_sync_stats_.rejected_cookies++;
+  }
 }
 
 void CookieStoreIOS::DeleteCookiesMatchingInfoAsync(
@@ -520,10 +645,11 @@ void CookieStoreIOS::DeleteCookiesMatchingPredicateAsync(
 void CookieStoreIOS::OnSystemCookiesChanged() {
   DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
 
-  for (const auto& hook_map_entry : hook_map_) {
-    std::pair<GURL, std::string> key = hook_map_entry.first;
-    UpdateCacheForCookieFromSystem(key.first, key.second,
-                                   /*run_callbacks=*/true);
+  // Fetch the system cookies once for all the hooks rather than once per hook.
+  if (!hook_map_.empty()) {
+    system_store_->GetAllCookiesAsync(
+        base::BindOnce(&CookieStoreIOS::UpdateCachesFromSystemCookies,
+                       weak_factory_.GetWeakPtr()));
   }
 
   // Do not schedule a flush if one is already scheduled.
@@ -627,34 +753,51 @@ void CookieStoreIOS::RunCallbacksForCookies(
   }
 }
 
-void CookieStoreIOS::GotCookieListFor(
-    const std::pair<GURL, std::string> key,
-    const net::CookieAccessResultList& cookies,
-    const net::CookieAccessResultList& excluded_cookies) {
+void CookieStoreIOS::UpdateCachesFromSystemCookies(
+    NSArray<NSHTTPCookie*>* nscookies) {
   DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
 
-  net::CookieList filtered;
-  OnlyCookiesWithName(cookies, key.second, &filtered);
-  std::vector<net::CanonicalCookie> removed_cookies;
-  std::vector<net::CanonicalCookie> added_cookies;
-  if (cookie_cache_->Update(key.first, key.second, filtered, &removed_cookies,
-                            &added_cookies)) {
-    RunCallbacksForCookies(key.first, key.second, removed_cookies,
+  // Only convert the cookies which may be cached.
+  std::set<std::string> hooked_names;
+  for (const auto& hook_map_entry : hook_map_)
+    hooked_names.insert(hook_map_entry.first.second);
+
+  net::CookieList cookies;
+  for (NSHTTPCookie* nscookie in nscookies) {
+    if (hooked_names.count(base::SysNSStringToUTF8(nscookie.name)) == 0)
+      continue;
+    if (std::unique_ptr<net::CanonicalCookie> canonical_cookie =
+            CanonicalCookieFromSystemCookie(
+                nscookie, system_store_->GetCookieCreationTime(nscookie))) {
+      cookies.push_back(*std::move(canonical_cookie));
+    }
+  }
+  UpdateCachesFromCookies(cookies);
+}
+
+void CookieStoreIOS::UpdateCachesFromCookies(const net::CookieList& cookies) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  std::map<CookieCache::CookieKey, CookieCache::CookieChanges> changes =
+      cookie_cache_->UpdateAll(cookies);
+  for (const auto& key_changes : changes) {
+    const CookieCache::CookieKey& key = key_changes.first;
+    RunCallbacksForCookies(key.first, key.second,
+                           key_changes.second.removed_cookies,
                            net::CookieChangeCause::UNKNOWN_DELETION);
-    RunCallbacksForCookies(key.first, key.second, added_cookies,
+    RunCallbacksForCookies(key.first, key.second,
+                           key_changes.second.added_cookies,
                            net::CookieChangeCause::INSERTED);
   }
 }
 
 void CookieStoreIOS::UpdateCachesFromCookieMonster() {
   DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
-  for (const auto& hook_map_entry : hook_map_) {
-    std::pair<GURL, std::string> key = hook_map_entry.first;
-    GetCookieListCallback callback = base::BindOnce(
-        &CookieStoreIOS::GotCookieListFor, weak_factory_.GetWeakPtr(), key);
-    cookie_monster_->GetCookieListWithOptionsAsync(
-        key.first, net::CookieOptions::MakeAllInclusive(), std::move(callback));
-  }
+  if (hook_map_.empty())
+    return;
+
+  cookie_monster_->GetAllCookiesAsync(
+      base::BindOnce(&CookieStoreIOS::UpdateCachesFromCookies,
+                     weak_factory_.GetWeakPtr()));
 }
 
 void CookieStoreIOS::UpdateCachesAfterSet(SetCookiesCallback callback,
@@ -548,4 +548,64 @@ TEST_F(CookieStoreIOSTest, RemoveCallback) {
   DeleteSystemCookie(kTestCookieURLFooBar, "abc");
 }
 
+// Tests that flushing the store only writes the cookies which changed since
+// the previous flush to the backing CookieMonster.
+TEST_F(CookieStoreIOSTest, FlushStoreWritesChangedCookies) {
+  SetSystemCookie(kTestCookieURLFooBar, "abc", "def");
+  SetSystemCookie(kTestCookieURLFooBaz, "abc", "def");
+  SetSystemCookie(kTestCookieURLFoo, "abc", "def");
+  SetSystemCookie(kTestCookieURLBarBar, "abc", "def");
+
+  // The first flush replaces all the cookies.
+  store_->FlushStore(base::DoNothing());
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(1U, store_->cookie_monster_sync_stats().full_syncs);
+  EXPECT_EQ(0U, store_->cookie_monster_sync_stats().incremental_syncs);
+
+  // Only the changed cookie is written by the next flush.
+  SetSystemCookie(kTestCookieURLFooBar, "abc", "ghi");
+  store_->FlushStore(base::DoNothing());
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(1U, store_->cookie_monster_sync_stats().full_syncs);
+  EXPECT_EQ(1U, store_->cookie_monster_sync_stats().incremental_syncs);
+  EXPECT_EQ(0U, store_->cookie_monster_sync_stats().cookies_inserted);
+  EXPECT_EQ(1U, store_->cookie_monster_sync_stats().cookies_updated);
+  EXPECT_EQ(0U, store_->cookie_monster_sync_stats().cookies_deleted);
+  EXPECT_EQ(3U, store_->cookie_monster_sync_stats().cookies_unchanged);
+
+  // Deleted cookies are removed from the CookieMonster.
+  DeleteSystemCookie(kTestCookieURLBarBar, "abc");
+  store_->FlushStore(base::DoNothing());
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(2U, store_->cookie_monster_sync_stats().incremental_syncs);
+  EXPECT_EQ(1U, store_->cookie_monster_sync_stats().cookies_deleted);
+  EXPECT_EQ(6U, store_->cookie_monster_sync_stats().cookies_unchanged);
+
+  DeleteSystemCookie(kTestCookieURLFooBar, "abc");
+  DeleteSystemCookie(kTestCookieURLFooBaz, "abc");
+  DeleteSystemCookie(kTestCookieURLFoo, "abc");
+}
+
+// Tests that flushing the store writes the changed cookies one by one even when
+// most cookies changed, as long as the CookieMonster did not diverge.
+TEST_F(CookieStoreIOSTest, FlushStoreWritesChangedCookiesWhenMostChanged) {
+  SetSystemCookie(kTestCookieURLFooBar, "abc", "def");
+  SetSystemCookie(kTestCookieURLFooBaz, "abc", "def");
+  store_->FlushStore(base::DoNothing());
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(1U, store_->cookie_monster_sync_stats().full_syncs);
+
+  SetSystemCookie(kTestCookieURLFooBar, "abc", "ghi");
+  SetSystemCookie(kTestCookieURLFooBaz, "abc", "ghi");
+  store_->FlushStore(base::DoNothing());
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(1U, store_->cookie_monster_sync_stats().full_syncs);
+  EXPECT_EQ(1U, store_->cookie_monster_sync_stats().incremental_syncs);
+  EXPECT_EQ(2U, store_->cookie_monster_sync_stats().cookies_updated);
+  EXPECT_EQ(0U, store_->cookie_monster_sync_stats().rejected_cookies);
+
+  DeleteSystemCookie(kTestCookieURLFooBar, "abc");
+  DeleteSystemCookie(kTestCookieURLFooBaz, "abc");
+}
+
 }  // namespace net
@@ -27,6 +27,7 @@
 #import "ios/net/http_protocol_logging.h"
 #include "ios/net/nsurlrequest_util.h"
 #import "ios/net/protocol_handler_util.h"
+#import "ios/net/read_buffer_pool.h"
 #include "net/base/auth.h"
 #include "net/base/elements_upload_data_stream.h"
 #include "net/base/io_buffer.h"
@@ -56,6 +57,10 @@ const int kIOBufferMinSize = 64 * 1024;
 // Maximum size of the buffer used to read the net::URLRequest.
 const int kIOBufferMaxSize = 16 * kIOBufferMinSize;  // 1MB
 
+// Maximum number of bytes of a chunked upload read from the HTTPBodyStream
+// and not yet sent.
+const size_t kChunkedUploadMaxQueuedBytes = 4 * kIOBufferMinSize;  // 256KB
+
 // Global instance of the HTTPProtocolHandlerDelegate.
 net::HTTPProtocolHandlerDelegate* g_protocol_handler_delegate = nullptr;
 
@@ -198,7 +203,8 @@ class HttpProtocolHandlerCore
 
   // The NSURLProtocol client.
   id<CRNNetworkClientProtocol> client_ = nil;
-  std::unique_ptr<char, base::FreeDeleter> read_buffer_;
+  // Buffer taken from ReadBufferPool::GetInstance().
+  ReadBufferPool::Buffer read_buffer_;
   int read_buffer_size_ = kIOBufferMinSize;
   scoped_refptr<WrappedIOBuffer> read_buffer_wrapper_;
   NSMutableURLRequest* request_ = nil;
@@ -276,21 +282,25 @@ void HttpProtocolHandlerCore::HandleStreamEvent(NSStream* stream,
         break;
       }
 
-      NSInteger length;
       // TODO(crbug.com/738025): Dynamically change the size of the read buffer
-      // to improve the read (POST) performance, see AllocateReadBuffer(), &
-      // avoid unnecessary data copy.
-      length = [base::mac::ObjCCastStrict<NSInputStream>(stream)
-               read:reinterpret_cast<unsigned char*>(read_buffer_.get())
-          maxLength:read_buffer_size_];
+      // to improve the read (POST) performance, see AllocateReadBuffer().
+      // The data is read into a pooled buffer, and only the bytes read are
+      // copied to the buffer owned by the reader.
+      const int buffer_size = read_buffer_size_;
+      ReadBufferPool::Buffer buffer =
+          ReadBufferPool::GetInstance()->TakeBuffer(buffer_size);
+      NSInteger length = [base::mac::ObjCCastStrict<NSInputStream>(stream)
+               read:reinterpret_cast<unsigned char*>(buffer.get())
+          maxLength:buffer_size];
       if (length > 0) {
-        std::vector<char> owned_data(read_buffer_.get(),
-                                     read_buffer_.get() + length);
+        std::vector<char> owned_data(buffer.get(), buffer.get() + length);
         post_data_readers_.push_back(
             std::make_unique<UploadOwnedBytesElementReader>(&owned_data));
       } else if (length < 0) {  // Error
         StopRequestWithError(stream.streamError.code, ERR_FAILED);
       }
+      ReadBufferPool::GetInstance()->ReturnBuffer(std::move(buffer),
+                                                  buffer_size);
       break;
     }
     case NSStreamEventNone:
@@ -479,9 +489,10 @@ void HttpProtocolHandlerCore::OnReadCompleted(URLRequest* request,
   uint64_t total_bytes_read = 0;
   while (bytes_read > 0) {
     total_bytes_read += bytes_read;
-    // The NSData will take the ownership of |read_buffer_|.
-    NSData* data =
-        [NSData dataWithBytesNoCopy:read_buffer_.release() length:bytes_read];
+    // The NSData will take the ownership of |read_buffer_| and return it to
+    // the pool when it is deallocated.
+    NSData* data = ReadBufferPool::GetInstance()->CreateData(
+        std::move(read_buffer_), read_buffer_size_, bytes_read);
     // If the data is not encoded in UTF8, the NSString is nil.
     DVLOG(3) << "To client:" << std::endl
              << base::SysNSStringToUTF8([[NSString alloc]
@@ -507,6 +518,12 @@ void HttpProtocolHandlerCore::OnReadCompleted(URLRequest* request,
 }
 
 void HttpProtocolHandlerCore::AllocateReadBuffer(int last_read_data_size) {
+  // The current buffer must be returned to the pool under the size it was
+  // taken with, before |read_buffer_size_| changes.
+  if (read_buffer_) {
+    ReadBufferPool::GetInstance()->ReturnBuffer(std::move(read_buffer_),
+                                                read_buffer_size_);
+  }
   if (last_read_data_size == read_buffer_size_) {
     // If the whole buffer was filled with data then increase the buffer size
     // for the next read but don't exceed |kIOBufferMaxSize|.
@@ -517,7 +534,7 @@ void HttpProtocolHandlerCore::AllocateReadBuffer(int last_read_data_size) {
     // |kIOBufferMinSize|.
     read_buffer_size_ = std::max(read_buffer_size_ / 2, kIOBufferMinSize);
   }
-  read_buffer_.reset(static_cast<char*>(malloc(read_buffer_size_)));
+  read_buffer_ = ReadBufferPool::GetInstance()->TakeBuffer(read_buffer_size_);
   read_buffer_wrapper_ = base::MakeRefCounted<WrappedIOBuffer>(
       static_cast<const char*>(read_buffer_.get()));
 }
@@ -526,6 +543,8 @@ HttpProtocolHandlerCore::~HttpProtocolHandlerCore() {
   DCHECK(thread_checker_.CalledOnValidThread());
   DCHECK(!net_request_);
   DCHECK(!http_body_stream_delegate_);
+  ReadBufferPool::GetInstance()->ReturnBuffer(std::move(read_buffer_),
+                                              read_buffer_size_);
 }
 
 // static
@@ -629,7 +648,8 @@ void HttpProtocolHandlerCore::Start(id<CRNNetworkClientProtocol> base_client) {
     }
 
     std::unique_ptr<ChunkedDataStreamUploader> uploader =
-        std::make_unique<ChunkedDataStreamUploader>(this);
+        std::make_unique<ChunkedDataStreamUploader>(
+            this, kChunkedUploadMaxQueuedBytes);
     chunked_uploader_ = uploader->GetWeakPtr();
     net_request_->set_upload(std::move(uploader));
   } else if ([request_ HTTPBody]) {
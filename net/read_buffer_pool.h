@@ -0,0 +1,86 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef IOS_NET_READ_BUFFER_POOL_H_
+#define IOS_NET_READ_BUFFER_POOL_H_
+
+#import <Foundation/Foundation.h>
+
+#include <stddef.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "base/memory/free_deleter.h"
+#include "base/synchronization/lock.h"
+#include "base/thread_annotations.h"
+
+namespace net {
+
+// A pool of the buffers used to read the responses of network requests.
+//
+// Buffers are grouped in power-of-two size classes. They are taken on the
+// network thread, handed to the client wrapped in an NSData, and returned to
+// the pool by the NSData deallocator once the client releases the data, which
+// may happen on any thread. Up to |max_retained_bytes| of buffers are kept for
+// reuse, so that large downloads do not allocate a new buffer for every read.
+class ReadBufferPool {
+ public:
+  typedef std::unique_ptr<char, base::FreeDeleter> Buffer;
+
+  // Counters describing the use of the pool.
+  struct Stats {
+    // Number of buffers which had to be allocated.
+    size_t allocations = 0;
+    // Number of buffers which were reused instead of being allocated.
+    size_t allocations_avoided = 0;
+    // Total size of the reused buffers.
+    size_t bytes_recycled = 0;
+  };
+
+  // Returns the pool shared by the network requests.
+  static ReadBufferPool* GetInstance();
+
+  explicit ReadBufferPool(size_t max_retained_bytes);
+  ~ReadBufferPool();
+
+  // Returns the size class of a request for |size| bytes, which is the
+  // smallest power of two greater than or equal to |size|.
+  static size_t GetSizeClass(size_t size);
+
+  // Returns a buffer of GetSizeClass(|size|) bytes.
+  Buffer TakeBuffer(size_t size);
+
+  // Returns |buffer|, whose size is |capacity|, to the pool. |buffer| is freed
+  // if the pool already retains too many bytes.
+  void ReturnBuffer(Buffer buffer, size_t capacity);
+
+  // Returns an NSData wrapping the first |length| bytes of |buffer|. |buffer|,
+  // whose size is |capacity|, is returned to the pool when the NSData is
+  // deallocated. The pool must outlive the returned NSData.
+  NSData* CreateData(Buffer buffer, size_t capacity, size_t length);
+
+  // Returns a copy of the counters.
+  Stats GetStats() const;
+
+  // Returns the total size of the buffers kept for reuse.
+  size_t GetRetainedBytes() const;
+
+ private:
+  ReadBufferPool(const ReadBufferPool&) = delete;
+  ReadBufferPool& operator=(const ReadBufferPool&) = delete;
+
+  const size_t max_retained_bytes_;
+
+  mutable base::Lock lock_;
+  // Buffers kept for reuse, by size class.
+  std::map<size_t, std::vector<Buffer>> free_buffers_ GUARDED_BY(lock_);
+  size_t retained_bytes_ GUARDED_BY(lock_) = 0;
+  Stats stats_ GUARDED_BY(lock_);
+};
+
+}  // namespace net
+
+#endif  // IOS_NET_READ_BUFFER_POOL_H_
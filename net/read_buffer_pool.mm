@@ -0,0 +1,101 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/net/read_buffer_pool.h"
+
+#include <stdlib.h>
+
+#include <utility>
+
+#include "base/bits.h"
+#include "base/check_op.h"
+#include "base/no_destructor.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace net {
+
+namespace {
+
+// Maximum total size of the buffers kept by the shared pool. This is enough to
+// keep a couple of the largest read buffers used by HttpProtocolHandlerCore.
+const size_t kSharedPoolMaxRetainedBytes = 4 * 1024 * 1024;
+
+}  // namespace
+
+// static
+ReadBufferPool* ReadBufferPool::GetInstance() {
+  static base::NoDestructor<ReadBufferPool> instance(
+      kSharedPoolMaxRetainedBytes);
+  return instance.get();
+}
+
+ReadBufferPool::ReadBufferPool(size_t max_retained_bytes)
+    : max_retained_bytes_(max_retained_bytes) {}
+
+ReadBufferPool::~ReadBufferPool() = default;
+
+// static
+size_t ReadBufferPool::GetSizeClass(size_t size) {
+  DCHECK_GT(size, 0u);
+  return size_t{1} << base::bits::Log2Ceiling(static_cast<uint32_t>(size));
+}
+
+ReadBufferPool::Buffer ReadBufferPool::TakeBuffer(size_t size) {
+  const size_t capacity = GetSizeClass(size);
+  {
+    base::AutoLock auto_lock(lock_);
+    auto it = free_buffers_.find(capacity);
+    if (it != free_buffers_.end() && !it->second.empty()) {
+      Buffer buffer = std::move(it->second.back());
+      it->second.pop_back();
+      retained_bytes_ -= capacity;
+      stats_.allocations_avoided++;
+      stats_.bytes_recycled += capacity;
+      return buffer;
+    }
+    stats_.allocations++;
+  }
+  return Buffer(static_cast<char*>(malloc(capacity)));
+}
+
+void ReadBufferPool::ReturnBuffer(Buffer buffer, size_t capacity) {
+  DCHECK_EQ(capacity, GetSizeClass(capacity));
+  if (!buffer)
+    return;
+
+  base::AutoLock auto_lock(lock_);
+  if (retained_bytes_ + capacity > max_retained_bytes_)
+    return;
+  free_buffers_[capacity].push_back(std::move(buffer));
+  retained_bytes_ += capacity;
+}
+
+NSData* ReadBufferPool::CreateData(Buffer buffer,
+                                   size_t capacity,
+                                   size_t length) {
+  DCHECK_LE(length, capacity);
+  char* bytes = buffer.release();
+  return [[NSData alloc] initWithBytesNoCopy:bytes
+                                      length:length
+                                 deallocator:^(void* data, NSUInteger) {
+                                   ReturnBuffer(
+                                       Buffer(static_cast<char*>(data)),
+                                       capacity);
+                                 }];
+}
+
+ReadBufferPool::Stats ReadBufferPool::GetStats() const {
+  base::AutoLock auto_lock(lock_);
+  return stats_;
+}
+
+size_t ReadBufferPool::GetRetainedBytes() const {
+  base::AutoLock auto_lock(lock_);
+  return retained_bytes_;
+}
+
+}  // namespace net
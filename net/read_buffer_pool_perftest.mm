@@ -0,0 +1,75 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/net/read_buffer_pool.h"
+
+#import <Foundation/Foundation.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <utility>
+
+#include "base/timer/elapsed_timer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace net {
+
+namespace {
+
+// Size of each read, the largest buffer used by HttpProtocolHandlerCore.
+const size_t kReadSize = 1024 * 1024;
+// Number of reads, as for a 512MB download.
+const int kReadCount = 512;
+
+class ReadBufferPoolPerfTest : public testing::Test {
+ protected:
+  void ReportTime(const std::string& story, base::TimeDelta elapsed) {
+    perf_test::PerfResultReporter reporter("ReadBufferPool.", story);
+    reporter.RegisterImportantMetric("read_time", "ms");
+    reporter.AddResult("read_time", elapsed);
+  }
+};
+
+// Wraps a newly allocated buffer in an NSData for every read, as done before
+// the read buffers were pooled.
+TEST_F(ReadBufferPoolPerfTest, MallocPerRead) {
+  base::ElapsedTimer timer;
+  for (int i = 0; i < kReadCount; i++) {
+    @autoreleasepool {
+      char* buffer = static_cast<char*>(malloc(kReadSize));
+      memset(buffer, i, kReadSize);
+      NSData* data = [NSData dataWithBytesNoCopy:buffer length:kReadSize];
+      EXPECT_EQ(kReadSize, data.length);
+    }
+  }
+  ReportTime("malloc", timer.Elapsed());
+}
+
+// Wraps a pooled buffer in an NSData for every read.
+TEST_F(ReadBufferPoolPerfTest, PooledBuffers) {
+  ReadBufferPool pool(4 * kReadSize);
+  base::ElapsedTimer timer;
+  for (int i = 0; i < kReadCount; i++) {
+    @autoreleasepool {
+      ReadBufferPool::Buffer buffer = pool.TakeBuffer(kReadSize);
+      memset(buffer.get(), i, kReadSize);
+      NSData* data = pool.CreateData(std::move(buffer), kReadSize, kReadSize);
+      EXPECT_EQ(kReadSize, data.length);
+    }
+  }
+  ReportTime("pooled", timer.Elapsed());
+  EXPECT_EQ(static_cast<size_t>(kReadCount - 1),
+            pool.GetStats().allocations_avoided);
+}
+
+}  // namespace
+
+}  // namespace net
@@ -0,0 +1,88 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/net/read_buffer_pool.h"
+
+#import <Foundation/Foundation.h>
+
+#include <string.h>
+
+#include <utility>
+
+#include "testing/platform_test.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace net {
+
+namespace {
+
+const size_t kBufferSize = 64 * 1024;
+
+}  // namespace
+
+using ReadBufferPoolTest = PlatformTest;
+
+// Tests that requested sizes are rounded up to a power of two.
+TEST_F(ReadBufferPoolTest, SizeClasses) {
+  EXPECT_EQ(1u, ReadBufferPool::GetSizeClass(1));
+  EXPECT_EQ(kBufferSize, ReadBufferPool::GetSizeClass(kBufferSize));
+  EXPECT_EQ(2 * kBufferSize, ReadBufferPool::GetSizeClass(kBufferSize + 1));
+}
+
+// Tests that a returned buffer is reused for a request of the same size
+// class.
+TEST_F(ReadBufferPoolTest, ReuseReturnedBuffer) {
+  ReadBufferPool pool(4 * kBufferSize);
+  ReadBufferPool::Buffer buffer = pool.TakeBuffer(kBufferSize);
+  char* bytes = buffer.get();
+  pool.ReturnBuffer(std::move(buffer), kBufferSize);
+  EXPECT_EQ(kBufferSize, pool.GetRetainedBytes());
+
+  // A buffer of another size class is allocated.
+  ReadBufferPool::Buffer other_buffer = pool.TakeBuffer(2 * kBufferSize);
+  EXPECT_NE(bytes, other_buffer.get());
+
+  EXPECT_EQ(bytes, pool.TakeBuffer(kBufferSize - 1).get());
+  EXPECT_EQ(0u, pool.GetRetainedBytes());
+
+  ReadBufferPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(2u, stats.allocations);
+  EXPECT_EQ(1u, stats.allocations_avoided);
+  EXPECT_EQ(kBufferSize, stats.bytes_recycled);
+}
+
+// Tests that the pool does not retain more than its maximum size.
+TEST_F(ReadBufferPoolTest, MaxRetainedBytes) {
+  ReadBufferPool pool(kBufferSize);
+  ReadBufferPool::Buffer first_buffer = pool.TakeBuffer(kBufferSize);
+  ReadBufferPool::Buffer second_buffer = pool.TakeBuffer(kBufferSize);
+  pool.ReturnBuffer(std::move(first_buffer), kBufferSize);
+  pool.ReturnBuffer(std::move(second_buffer), kBufferSize);
+  EXPECT_EQ(kBufferSize, pool.GetRetainedBytes());
+}
+
+// Tests that the buffer of an NSData is returned to the pool when the NSData
+// is deallocated.
+TEST_F(ReadBufferPoolTest, DataReturnsBuffer) {
+  ReadBufferPool pool(4 * kBufferSize);
+  ReadBufferPool::Buffer buffer = pool.TakeBuffer(kBufferSize);
+  char* bytes = buffer.get();
+  memcpy(bytes, "data", 4);
+
+  @autoreleasepool {
+    NSData* data = pool.CreateData(std::move(buffer), kBufferSize, 4);
+    EXPECT_EQ(4u, data.length);
+    EXPECT_EQ(0, memcmp(data.bytes, "data", 4));
+    EXPECT_EQ(0u, pool.GetRetainedBytes());
+    data = nil;
+  }
+
+  EXPECT_EQ(kBufferSize, pool.GetRetainedBytes());
+  EXPECT_EQ(bytes, pool.TakeBuffer(kBufferSize).get());
+}
+
+}  // namespace net
@@ -6,6 +6,7 @@
 #define IOS_WEB_COMMON_FEATURES_H_
 
 #include "base/feature_list.h"
+#include "base/metrics/field_trial_params.h"
 
 namespace web {
 namespace features {
@@ -14,6 +15,19 @@ namespace features {
 // obtained from "session-size" Finch parameter.
 extern const base::Feature kReduceSessionSize;
 
+// When enabled, the session history injected in restore_session.html encodes
+// each URL relative to the previous one.
+extern const base::Feature kCompactRestoreSessionEncoding;
+
+// When enabled, the page scripts are loaded from the bundle once per process,
+// and the scripts composed with the embedder scripts are reused until their
+// inputs change.
+extern const base::Feature kCachePageScripts;
+
+// When enabled, the certificate policies are queried on the UI thread when a
+// rejected certificate is evaluated, instead of on the IO thread.
+extern const base::Feature kQueryCertificatePoliciesOnUIThread;
+
 // Used to crash the browser if unexpected URL change is detected.
 // https://crbug.com/841105.
 extern const base::Feature kCrashOnUnexpectedURLChange;
@@ -71,6 +85,15 @@ extern const base::Feature kIOSLegacyTLSInterstitial;
 // that supports it.
 extern const base::Feature kWebViewNativeContextMenu;
 
+// When enabled, downloads to a file are fetched as several byte ranges in
+// parallel when the server supports it, and resume where they stopped after a
+// failure or a cancellation.
+extern const base::Feature kSegmentedDownloads;
+
+// The maximum number of byte ranges fetched in parallel by a segmented
+// download.
+extern const base::FeatureParam<int> kSegmentedDownloadsMaxSegments;
+
 // When true, for each navigation, the default user agent is chosen by the
 // WebClient GetDefaultUserAgent() method. If it is false, the mobile version
 // is requested by default.
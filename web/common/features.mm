@@ -14,6 +14,15 @@ namespace features {
 const base::Feature kReduceSessionSize{"ReduceSessionSize",
                                        base::FEATURE_DISABLED_BY_DEFAULT};
 
+const base::Feature kCompactRestoreSessionEncoding{
+    "CompactRestoreSessionEncoding", base::FEATURE_DISABLED_BY_DEFAULT};
+
+const base::Feature kCachePageScripts{"CachePageScripts",
+                                     base::FEATURE_DISABLED_BY_DEFAULT};
+
+const base::Feature kQueryCertificatePoliciesOnUIThread{
+    "QueryCertificatePoliciesOnUIThread", base::FEATURE_DISABLED_BY_DEFAULT};
+
 const base::Feature kCrashOnUnexpectedURLChange{
     "CrashOnUnexpectedURLChange", base::FEATURE_ENABLED_BY_DEFAULT};
 
@@ -55,6 +64,12 @@ const base::Feature kIOSLegacyTLSInterstitial{
 const base::Feature kWebViewNativeContextMenu{
     "WebViewNativeContextMenu", base::FEATURE_DISABLED_BY_DEFAULT};
 
+const base::Feature kSegmentedDownloads{"SegmentedDownloads",
+                                        base::FEATURE_DISABLED_BY_DEFAULT};
+
+const base::FeatureParam<int> kSegmentedDownloadsMaxSegments{
+    &kSegmentedDownloads, "max_segments", 4};
+
 bool UseWebClientDefaultUserAgent() {
   if (@available(iOS 13, *)) {
     return base::FeatureList::IsEnabled(kUseDefaultUserAgentInWebClient);
@@ -6,6 +6,7 @@
 
 #include "base/strings/sys_string_conversions.h"
 #import "ios/web/download/download_session_cookie_storage.h"
+#import "ios/web/download/segmented_download_job.h"
 #include "ios/web/public/browser_state.h"
 #import "ios/web/public/download/download_controller_delegate.h"
 #import "ios/web/public/web_client.h"
@@ -18,6 +19,10 @@
 
 namespace {
 const char kDownloadControllerKey = 0;
+
+// Whether the files left by the segmented downloads of the previous runs were
+// checked for deletion.
+bool g_stale_segmented_download_files_deleted = false;
 }  // namespace
 
 namespace web {
@@ -34,7 +39,16 @@ DownloadController* DownloadController::FromBrowserState(
       browser_state->GetUserData(&kDownloadControllerKey));
 }
 
-DownloadControllerImpl::DownloadControllerImpl() = default;
+DownloadControllerImpl::DownloadControllerImpl() {
+  // The segmented downloads of the previous runs are resumed by a new download
+  // of the same resource, but the files which were not used for a while are
+  // unlikely to be. This is done even if the feature was disabled since.
+  if (!g_stale_segmented_download_files_deleted) {
+    g_stale_segmented_download_files_deleted = true;
+    SegmentedDownloadJob::DeleteStaleFiles(
+        SegmentedDownloadJob::GetTempDirectory());
+  }
+}
 
 DownloadControllerImpl::~DownloadControllerImpl() {
   DCHECK_CALLED_ON_VALID_SEQUENCE(my_sequence_checker_);
@@ -2,19 +2,33 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <atomic>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "base/bind.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
 #include "base/run_loop.h"
+#include "base/strings/stringprintf.h"
 #include "base/strings/utf_string_conversions.h"
+#include "base/synchronization/lock.h"
+#include "base/task/thread_pool.h"
+#include "base/task/thread_pool/thread_pool_instance.h"
 #import "base/test/ios/wait_util.h"
+#include "base/test/scoped_feature_list.h"
+#include "ios/web/common/features.h"
 #import "ios/web/public/download/download_controller.h"
 #import "ios/web/public/download/download_task.h"
 #include "ios/web/public/test/fakes/fake_download_controller_delegate.h"
 #import "ios/web/public/test/navigation_test_util.h"
 #import "ios/web/public/test/web_test_with_web_state.h"
 #import "ios/web/public/web_client.h"
+#include "net/base/net_errors.h"
+#include "net/http/http_byte_range.h"
 #include "net/http/http_request_headers.h"
+#include "net/http/http_util.h"
 #include "net/test/embedded_test_server/embedded_test_server.h"
 #include "net/test/embedded_test_server/http_request.h"
 #include "net/test/embedded_test_server/http_response.h"
@@ -52,6 +66,11 @@ std::unique_ptr<net::test_server::HttpResponse> GetDownloadResponse(
   return result;
 }
 
+// Size of the resource downloaded as segments. Large enough to be split in
+// several segments.
+const int kSegmentedContentSize = 3 * 1024 * 1024;
+const char kSegmentedETag[] = "\"segmented\"";
+
 }  // namespace
 
 // Test fixture for DownloadController, DownloadControllerDelegate and
@@ -112,4 +131,203 @@ TEST_F(DownloadTest, SucessfullDownload) {
   EXPECT_EQ(kContent, task->GetResponseWriter()->AsStringWriter()->data());
 }
 
+// Test fixture for downloads fetched as several byte ranges.
+class SegmentedDownloadTest : public WebTestWithWebState {
+ protected:
+  SegmentedDownloadTest() : delegate_(download_controller()) {
+    feature_list_.InitAndEnableFeature(features::kSegmentedDownloads);
+    for (int i = 0; i < kSegmentedContentSize; i++)
+      content_.push_back(static_cast<char>(i % 251));
+    server_.RegisterRequestHandler(base::BindRepeating(
+        &SegmentedDownloadTest::GetResponse, base::Unretained(this)));
+  }
+
+  DownloadController* download_controller() {
+    return DownloadController::FromBrowserState(GetBrowserState());
+  }
+
+  // Serves |content_|, honoring the Range header. The first request for a range
+  // starting at |drop_offset_| is cut after half of the range, and the first
+  // request for a range starting at |hang_offset_| never gets a response.
+  std::unique_ptr<net::test_server::HttpResponse> GetResponse(
+      const net::test_server::HttpRequest& request) {
+    auto range_header = request.headers.find(net::HttpRequestHeaders::kRange);
+    std::vector<net::HttpByteRange> ranges;
+    if (range_header == request.headers.end() ||
+        !net::HttpUtil::ParseRangeHeader(range_header->second, &ranges) ||
+        ranges.size() != 1 || !ranges[0].ComputeBounds(content_.size())) {
+      auto result = std::make_unique<net::test_server::BasicHttpResponse>();
+      result->set_code(net::HTTP_OK);
+      result->set_content(content_);
+      result->AddCustomHeader("Content-Type", kMimeType);
+      result->AddCustomHeader("Content-Disposition", kContentDisposition);
+      result->AddCustomHeader("ETag", kSegmentedETag);
+      return result;
+    }
+
+    range_request_count_++;
+    const int64_t first = ranges[0].first_byte_position();
+    const int64_t last = ranges[0].last_byte_position();
+    {
+      base::AutoLock auto_lock(requested_ranges_lock_);
+      requested_ranges_.emplace_back(first, last);
+    }
+    if (first == hang_offset_ && !hung_.exchange(true))
+      return std::make_unique<net::test_server::HungResponse>();
+
+    const int64_t length = last - first + 1;
+    std::string headers = base::StringPrintf(
+        "HTTP/1.1 206 Partial Content\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Range: bytes %lld-%lld/%zu\r\n"
+        "Content-Length: %lld\r\n"
+        "Accept-Ranges: bytes\r\n"
+        "ETag: %s\r\n",
+        kMimeType, static_cast<long long>(first), static_cast<long long>(last),
+        content_.size(), static_cast<long long>(length), kSegmentedETag);
+    int64_t sent_length = length;
+    if (first == drop_offset_ && !dropped_.exchange(true)) {
+      // The server closes the connection after the response, before all the
+      // announced bytes are sent.
+      sent_length = length / 2;
+    }
+    return std::make_unique<net::test_server::RawHttpResponse>(
+        headers, content_.substr(first, sent_length));
+  }
+
+  // Loads the download URL and returns the created task.
+  DownloadTask* LoadDownloadUrl() {
+    if (!server_.Started() && !server_.Start())
+      return nullptr;
+    const size_t task_count = delegate_.alive_download_tasks().size();
+    test::LoadUrl(web_state(), server_.GetURL("/"));
+    if (!WaitUntilConditionOrTimeout(kWaitForDownloadTimeout, ^{
+          return delegate_.alive_download_tasks().size() > task_count;
+        })) {
+      return nullptr;
+    }
+    return delegate_.alive_download_tasks().back().second.get();
+  }
+
+  // Returns the ranges requested so far, and forgets them.
+  std::vector<std::pair<int64_t, int64_t>> TakeRequestedRanges() {
+    std::vector<std::pair<int64_t, int64_t>> ranges;
+    base::AutoLock auto_lock(requested_ranges_lock_);
+    ranges.swap(requested_ranges_);
+    return ranges;
+  }
+
+  // Creates a writer for |path|.
+  std::unique_ptr<net::URLFetcherResponseWriter> CreateWriter(
+      const base::FilePath& path) {
+    auto writer = std::make_unique<net::URLFetcherFileWriter>(
+        base::ThreadPool::CreateSequencedTaskRunner({base::MayBlock()}), path);
+    __block bool initialized = false;
+    writer->Initialize(base::BindOnce(^(int error) {
+      EXPECT_EQ(net::OK, error);
+      initialized = true;
+    }));
+    EXPECT_TRUE(WaitUntilConditionOrTimeout(kWaitForDownloadTimeout, ^{
+      base::RunLoop().RunUntilIdle();
+      return initialized;
+    }));
+    return writer;
+  }
+
+  base::test::ScopedFeatureList feature_list_;
+  std::string content_;
+  std::atomic<int> range_request_count_{0};
+  int64_t drop_offset_ = -1;
+  std::atomic<bool> dropped_{false};
+  int64_t hang_offset_ = -1;
+  std::atomic<bool> hung_{false};
+  base::Lock requested_ranges_lock_;
+  std::vector<std::pair<int64_t, int64_t>> requested_ranges_;
+  net::EmbeddedTestServer server_;
+  FakeDownloadControllerDelegate delegate_;
+};
+
+// Tests that a segmented download completes with the whole resource, even if
+// the connection of a segment drops.
+TEST_F(SegmentedDownloadTest, DownloadWithDroppedConnection) {
+  // The second segment starts after 1MB.
+  drop_offset_ = kSegmentedContentSize / 3;
+  DownloadTask* task = LoadDownloadUrl();
+  ASSERT_TRUE(task);
+
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  base::FilePath path = temp_dir.GetPath().AppendASCII("download.test");
+  task->Start(CreateWriter(path));
+  ASSERT_TRUE(WaitUntilConditionOrTimeout(kWaitForPageLoadTimeout, ^{
+    base::RunLoop().RunUntilIdle();
+    return task->IsDone();
+  }));
+
+  EXPECT_EQ(net::OK, task->GetErrorCode());
+  EXPECT_EQ(kSegmentedContentSize, task->GetTotalBytes());
+  EXPECT_EQ(100, task->GetPercentComplete());
+  EXPECT_EQ(206, task->GetHttpCode());
+  EXPECT_TRUE(dropped_);
+  // One probe, three segments and the rest of the dropped segment.
+  EXPECT_EQ(5, range_request_count_);
+
+  std::string downloaded;
+  ASSERT_TRUE(WaitUntilConditionOrTimeout(kWaitForDownloadTimeout, ^{
+    base::RunLoop().RunUntilIdle();
+    return base::ReadFileToString(path, &downloaded) &&
+           downloaded.size() == content_.size();
+  }));
+  EXPECT_EQ(content_, downloaded);
+}
+
+// Tests that a new download of a resource whose download was cancelled only
+// requests the ranges which were not received.
+TEST_F(SegmentedDownloadTest, ResumeAfterCancel) {
+  // The second of the three segments is not served before the cancellation.
+  const int64_t segment_length = kSegmentedContentSize / 3;
+  hang_offset_ = segment_length;
+  DownloadTask* task = LoadDownloadUrl();
+  ASSERT_TRUE(task);
+
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  base::FilePath path = temp_dir.GetPath().AppendASCII("download.test");
+  task->Start(CreateWriter(path));
+  ASSERT_TRUE(WaitUntilConditionOrTimeout(kWaitForPageLoadTimeout, ^{
+    base::RunLoop().RunUntilIdle();
+    return task->GetReceivedBytes() == 2 * segment_length;
+  }));
+  EXPECT_TRUE(hung_);
+  task->Cancel();
+  // Let the cancelled job save its journal and release its files.
+  base::ThreadPoolInstance::Get()->FlushForTesting();
+  TakeRequestedRanges();
+
+  // Download the resource again, with a new task.
+  DownloadTask* new_task = LoadDownloadUrl();
+  ASSERT_TRUE(new_task);
+  ASSERT_NE(task, new_task);
+  new_task->Start(CreateWriter(path));
+  ASSERT_TRUE(WaitUntilConditionOrTimeout(kWaitForPageLoadTimeout, ^{
+    base::RunLoop().RunUntilIdle();
+    return new_task->IsDone();
+  }));
+  EXPECT_EQ(net::OK, new_task->GetErrorCode());
+  EXPECT_EQ(kSegmentedContentSize, new_task->GetTotalBytes());
+
+  // Only the probe and the missing segment are requested.
+  std::vector<std::pair<int64_t, int64_t>> expected_ranges = {
+      {0, 0}, {segment_length, 2 * segment_length - 1}};
+  EXPECT_EQ(expected_ranges, TakeRequestedRanges());
+
+  std::string downloaded;
+  ASSERT_TRUE(WaitUntilConditionOrTimeout(kWaitForDownloadTimeout, ^{
+    base::RunLoop().RunUntilIdle();
+    return base::ReadFileToString(path, &downloaded) &&
+           downloaded.size() == content_.size();
+  }));
+  EXPECT_EQ(content_, downloaded);
+}
+
 }  // namespace web
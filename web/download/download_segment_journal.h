@@ -0,0 +1,93 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef IOS_WEB_DOWNLOAD_DOWNLOAD_SEGMENT_JOURNAL_H_
+#define IOS_WEB_DOWNLOAD_DOWNLOAD_SEGMENT_JOURNAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "base/optional.h"
+#include "url/gurl.h"
+
+namespace base {
+class FilePath;
+}  // namespace base
+
+namespace web {
+
+// Progress of a download fetched as several byte ranges. The journal is saved
+// next to the downloaded data so the download can resume where it stopped
+// after a failure, a cancellation or a crash.
+class DownloadSegmentJournal {
+ public:
+  // A byte range of the downloaded resource.
+  struct Segment {
+    // Offset of the first byte of the segment.
+    int64_t offset = 0;
+    // Size of the segment.
+    int64_t length = 0;
+    // Number of bytes of the segment already written, from |offset|.
+    int64_t received = 0;
+
+    bool IsComplete() const { return received >= length; }
+  };
+
+  // Creates a journal for the resource at |url| of |total_bytes|, split in
+  // |segment_count| segments of similar size. |validator| is the ETag or the
+  // Last-Modified header of the resource, used to check that the resource did
+  // not change before resuming.
+  DownloadSegmentJournal(const GURL& url,
+                         const std::string& validator,
+                         int64_t total_bytes,
+                         int segment_count);
+  DownloadSegmentJournal(const DownloadSegmentJournal&);
+  DownloadSegmentJournal& operator=(const DownloadSegmentJournal&);
+  ~DownloadSegmentJournal();
+
+  // Returns the journal saved at |path|, or nullopt if there is none or if it
+  // is invalid.
+  static base::Optional<DownloadSegmentJournal> Load(
+      const base::FilePath& path);
+
+  // Saves the journal at |path|, replacing the previous version atomically.
+  // Returns false on failure.
+  bool Save(const base::FilePath& path) const;
+
+  // Returns whether the journal describes the given resource.
+  bool Matches(const GURL& url,
+               const std::string& validator,
+               int64_t total_bytes) const;
+
+  // Records that |bytes| were written at the end of the received part of the
+  // segment at |index|.
+  void OnDataWritten(size_t index, int64_t bytes);
+
+  // Returns the number of bytes written in all the segments.
+  int64_t GetReceivedBytes() const;
+
+  // Returns whether all the segments are complete.
+  bool IsComplete() const;
+
+  const GURL& url() const { return url_; }
+  const std::string& validator() const { return validator_; }
+  int64_t total_bytes() const { return total_bytes_; }
+  const std::vector<Segment>& segments() const { return segments_; }
+
+ private:
+  // Creates an empty journal, filled by Load().
+  DownloadSegmentJournal();
+
+  GURL url_;
+  std::string validator_;
+  int64_t total_bytes_ = 0;
+  std::vector<Segment> segments_;
+};
+
+}  // namespace web
+
+#endif  // IOS_WEB_DOWNLOAD_DOWNLOAD_SEGMENT_JOURNAL_H_
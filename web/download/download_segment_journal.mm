@@ -0,0 +1,171 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/web/download/download_segment_journal.h"
+
+#include <algorithm>
+
+#include "base/check_op.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/important_file_writer.h"
+#include "base/json/json_reader.h"
+#include "base/json/json_writer.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/values.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace web {
+
+namespace {
+
+// Serialization keys. 64-bit values are stored as strings as base::Value only
+// supports 32-bit integers.
+const char kUrlKey[] = "url";
+const char kValidatorKey[] = "validator";
+const char kTotalBytesKey[] = "total_bytes";
+const char kSegmentsKey[] = "segments";
+const char kOffsetKey[] = "offset";
+const char kLengthKey[] = "length";
+const char kReceivedKey[] = "received";
+
+// Reads the 64-bit value stored at |key| in |dict|. Returns false if missing or
+// negative.
+bool ReadInt64(const base::Value& dict, const char* key, int64_t* value) {
+  const std::string* string_value = dict.FindStringKey(key);
+  return string_value && base::StringToInt64(*string_value, value) &&
+         *value >= 0;
+}
+
+}  // namespace
+
+DownloadSegmentJournal::DownloadSegmentJournal() = default;
+
+DownloadSegmentJournal::DownloadSegmentJournal(const GURL& url,
+                                               const std::string& validator,
+                                               int64_t total_bytes,
+                                               int segment_count)
+    : url_(url), validator_(validator), total_bytes_(total_bytes) {
+  DCHECK_GT(total_bytes, 0);
+  DCHECK_GT(segment_count, 0);
+  const int64_t count = std::min<int64_t>(segment_count, total_bytes);
+  const int64_t segment_length = total_bytes / count;
+  for (int64_t i = 0; i < count; i++) {
+    Segment segment;
+    segment.offset = i * segment_length;
+    // The last segment ends with the resource.
+    segment.length =
+        i + 1 == count ? total_bytes - segment.offset : segment_length;
+    segments_.push_back(segment);
+  }
+}
+
+DownloadSegmentJournal::DownloadSegmentJournal(const DownloadSegmentJournal&) =
+    default;
+
+DownloadSegmentJournal& DownloadSegmentJournal::operator=(
+    const DownloadSegmentJournal&) = default;
+
+DownloadSegmentJournal::~DownloadSegmentJournal() = default;
+
+// static
+base::Optional<DownloadSegmentJournal> DownloadSegmentJournal::Load(
+    const base::FilePath& path) {
+  std::string json;
+  if (!base::ReadFileToString(path, &json))
+    return base::nullopt;
+
+  base::Optional<base::Value> value = base::JSONReader::Read(json);
+  if (!value || !value->is_dict())
+    return base::nullopt;
+
+  DownloadSegmentJournal journal;
+  const std::string* url = value->FindStringKey(kUrlKey);
+  const std::string* validator = value->FindStringKey(kValidatorKey);
+  const base::Value* segments =
+      value->FindKeyOfType(kSegmentsKey, base::Value::Type::LIST);
+  if (!url || !validator || !segments ||
+      !ReadInt64(*value, kTotalBytesKey, &journal.total_bytes_)) {
+    return base::nullopt;
+  }
+  journal.url_ = GURL(*url);
+  journal.validator_ = *validator;
+
+  // The segments must cover the resource without overlapping.
+  int64_t next_offset = 0;
+  for (const base::Value& segment_value : segments->GetList()) {
+    Segment segment;
+    if (!segment_value.is_dict() ||
+        !ReadInt64(segment_value, kOffsetKey, &segment.offset) ||
+        !ReadInt64(segment_value, kLengthKey, &segment.length) ||
+        !ReadInt64(segment_value, kReceivedKey, &segment.received) ||
+        segment.offset != next_offset || segment.received > segment.length) {
+      return base::nullopt;
+    }
+    next_offset += segment.length;
+    journal.segments_.push_back(segment);
+  }
+  if (!journal.url_.is_valid() || next_offset != journal.total_bytes_)
+    return base::nullopt;
+
+  return journal;
+}
+
+bool DownloadSegmentJournal::Save(const base::FilePath& path) const {
+  base::Value segments(base::Value::Type::LIST);
+  for (const Segment& segment : segments_) {
+    base::Value segment_value(base::Value::Type::DICTIONARY);
+    segment_value.SetStringKey(kOffsetKey,
+                               base::NumberToString(segment.offset));
+    segment_value.SetStringKey(kLengthKey,
+                               base::NumberToString(segment.length));
+    segment_value.SetStringKey(kReceivedKey,
+                               base::NumberToString(segment.received));
+    segments.Append(std::move(segment_value));
+  }
+
+  base::Value value(base::Value::Type::DICTIONARY);
+  value.SetStringKey(kUrlKey, url_.spec());
+  value.SetStringKey(kValidatorKey, validator_);
+  value.SetStringKey(kTotalBytesKey, base::NumberToString(total_bytes_));
+  value.SetKey(kSegmentsKey, std::move(segments));
+
+  std::string json;
+  return base::JSONWriter::Write(value, &json) &&
+         base::ImportantFileWriter::WriteFileAtomically(path, json);
+}
+
+bool DownloadSegmentJournal::Matches(const GURL& url,
+                                     const std::string& validator,
+                                     int64_t total_bytes) const {
+  // Without a validator, there is no way to know if the resource changed.
+  return !validator.empty() && url_ == url && validator_ == validator &&
+         total_bytes_ == total_bytes;
+}
+
+void DownloadSegmentJournal::OnDataWritten(size_t index, int64_t bytes) {
+  DCHECK_LT(index, segments_.size());
+  Segment& segment = segments_[index];
+  DCHECK_LE(segment.received + bytes, segment.length);
+  segment.received += bytes;
+}
+
+int64_t DownloadSegmentJournal::GetReceivedBytes() const {
+  int64_t received_bytes = 0;
+  for (const Segment& segment : segments_)
+    received_bytes += segment.received;
+  return received_bytes;
+}
+
+bool DownloadSegmentJournal::IsComplete() const {
+  return std::all_of(segments_.begin(), segments_.end(),
+                     [](const Segment& segment) {
+                       return segment.IsComplete();
+                     });
+}
+
+}  // namespace web
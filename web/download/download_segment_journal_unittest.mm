@@ -0,0 +1,120 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/web/download/download_segment_journal.h"
+
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/platform_test.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace web {
+
+namespace {
+
+const char kUrl[] = "https://example.test/file.zip";
+const char kValidator[] = "\"etag\"";
+
+}  // namespace
+
+class DownloadSegmentJournalTest : public PlatformTest {
+ protected:
+  void SetUp() override {
+    PlatformTest::SetUp();
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.GetPath().AppendASCII("download.journal");
+  }
+
+  base::ScopedTempDir temp_dir_;
+  base::FilePath path_;
+};
+
+// Tests that the resource is split in contiguous segments of similar size.
+TEST_F(DownloadSegmentJournalTest, Segments) {
+  DownloadSegmentJournal journal(GURL(kUrl), kValidator, 10, 3);
+  ASSERT_EQ(3U, journal.segments().size());
+  EXPECT_EQ(0, journal.segments()[0].offset);
+  EXPECT_EQ(3, journal.segments()[0].length);
+  EXPECT_EQ(3, journal.segments()[1].offset);
+  EXPECT_EQ(3, journal.segments()[1].length);
+  EXPECT_EQ(6, journal.segments()[2].offset);
+  EXPECT_EQ(4, journal.segments()[2].length);
+  EXPECT_EQ(0, journal.GetReceivedBytes());
+  EXPECT_FALSE(journal.IsComplete());
+
+  // There are never more segments than bytes.
+  DownloadSegmentJournal small_journal(GURL(kUrl), kValidator, 2, 4);
+  EXPECT_EQ(2U, small_journal.segments().size());
+}
+
+// Tests that written data is recorded per segment.
+TEST_F(DownloadSegmentJournalTest, DataWritten) {
+  DownloadSegmentJournal journal(GURL(kUrl), kValidator, 10, 2);
+  journal.OnDataWritten(0, 5);
+  journal.OnDataWritten(1, 2);
+  EXPECT_EQ(7, journal.GetReceivedBytes());
+  EXPECT_TRUE(journal.segments()[0].IsComplete());
+  EXPECT_FALSE(journal.IsComplete());
+
+  journal.OnDataWritten(1, 3);
+  EXPECT_TRUE(journal.IsComplete());
+}
+
+// Tests that a saved journal is loaded with the same progress.
+TEST_F(DownloadSegmentJournalTest, SaveAndLoad) {
+  // Values larger than 32 bits are preserved.
+  const int64_t kTotalBytes = 5LL * 1024 * 1024 * 1024;
+  DownloadSegmentJournal journal(GURL(kUrl), kValidator, kTotalBytes, 4);
+  journal.OnDataWritten(2, 12345);
+  ASSERT_TRUE(journal.Save(path_));
+
+  base::Optional<DownloadSegmentJournal> loaded =
+      DownloadSegmentJournal::Load(path_);
+  ASSERT_TRUE(loaded);
+  EXPECT_EQ(GURL(kUrl), loaded->url());
+  EXPECT_EQ(kValidator, loaded->validator());
+  EXPECT_EQ(kTotalBytes, loaded->total_bytes());
+  ASSERT_EQ(4U, loaded->segments().size());
+  for (size_t i = 0; i < 4; i++) {
+    EXPECT_EQ(journal.segments()[i].offset, loaded->segments()[i].offset);
+    EXPECT_EQ(journal.segments()[i].length, loaded->segments()[i].length);
+    EXPECT_EQ(journal.segments()[i].received, loaded->segments()[i].received);
+  }
+}
+
+// Tests that missing or corrupted journals are not loaded.
+TEST_F(DownloadSegmentJournalTest, LoadInvalid) {
+  EXPECT_FALSE(DownloadSegmentJournal::Load(path_));
+
+  ASSERT_TRUE(base::WriteFile(path_, "{\"url\":"));
+  EXPECT_FALSE(DownloadSegmentJournal::Load(path_));
+
+  // Segments which do not cover the resource.
+  ASSERT_TRUE(base::WriteFile(
+      path_,
+      "{\"url\":\"https://example.test/\",\"validator\":\"v\","
+      "\"total_bytes\":\"10\",\"segments\":[{\"offset\":\"0\","
+      "\"length\":\"4\",\"received\":\"0\"}]}"));
+  EXPECT_FALSE(DownloadSegmentJournal::Load(path_));
+}
+
+// Tests that a journal only matches the resource it was created for.
+TEST_F(DownloadSegmentJournalTest, Matches) {
+  DownloadSegmentJournal journal(GURL(kUrl), kValidator, 10, 2);
+  EXPECT_TRUE(journal.Matches(GURL(kUrl), kValidator, 10));
+  EXPECT_FALSE(journal.Matches(GURL("https://example.test/"), kValidator, 10));
+  EXPECT_FALSE(journal.Matches(GURL(kUrl), "\"other\"", 10));
+  EXPECT_FALSE(journal.Matches(GURL(kUrl), kValidator, 11));
+
+  // Resources without validator can not be resumed.
+  DownloadSegmentJournal no_validator_journal(GURL(kUrl), "", 10, 2);
+  EXPECT_FALSE(no_validator_journal.Matches(GURL(kUrl), "", 10));
+}
+
+}  // namespace web
@@ -9,8 +9,10 @@
 
 #include "base/callback_forward.h"
 #include "base/macros.h"
+#include "base/memory/scoped_refptr.h"
 #include "base/memory/weak_ptr.h"
 #include "base/observer_list.h"
+#include "base/time/time.h"
 #import "ios/web/public/download/download_task.h"
 #include "url/gurl.h"
 
@@ -24,6 +26,8 @@ class URLRequestContextGetter;
 namespace web {
 
 class DownloadTaskObserver;
+class DownloadWriteQueue;
+class SegmentedDownloadJob;
 class WebState;
 
 // Implements DownloadTask interface. Uses background NSURLSession as
@@ -101,10 +105,36 @@ class DownloadTaskImpl : public DownloadTask {
   // Starts the download with given cookies.
   void StartWithCookies(NSArray<NSHTTPCookie*>* cookies);
 
+  // Downloads the file with a single NSURLSessionTask.
+  void StartSessionTask(NSArray<NSHTTPCookie*>* cookies);
+
+  // Downloads the file as several byte ranges with a SegmentedDownloadJob.
+  void StartSegmentedDownload(NSArray<NSHTTPCookie*>* cookies);
+
+  // Called with the progress of |segmented_download_job_|.
+  void OnSegmentedDownloadProgress(int64_t received_bytes,
+                                   int64_t total_bytes);
+
+  // Called when |segmented_download_job_| is over. Falls back to a single
+  // NSURLSessionTask if the server does not support byte ranges.
+  void OnSegmentedDownloadCompleted(NSArray<NSHTTPCookie*>* cookies,
+                                    int error_code);
+
+  // Updates the properties of this task from the NSURLSessionTask.
+  void UpdateProperties(NSURLSessionTask* task, NSError* error);
+
   // Starts parsing data:// url. Separate code path is used because
   // NSURLSession does not support data URLs.
   void StartDataUrlParsing();
 
+  // Called when some downloaded data was written. Calls are coalesced by
+  // |write_queue_|.
+  void OnDataWritten();
+
+  // Records the throughput of the download and the time spent on the UI thread
+  // to write it.
+  void RecordWriteMetrics();
+
   // Called when download task was updated.
   void OnDownloadUpdated();
 
@@ -139,6 +169,14 @@ class DownloadTaskImpl : public DownloadTask {
   NSURLSession* session_ = nil;
   NSURLSessionTask* session_task_ = nil;
 
+  // Downloads the file when segmented downloads are enabled.
+  std::unique_ptr<SegmentedDownloadJob> segmented_download_job_;
+
+  // Passes the downloaded data to |writer_|.
+  scoped_refptr<DownloadWriteQueue> write_queue_;
+  // Time when the download started, used for metrics.
+  base::TimeTicks download_start_time_;
+
   // Observes UIApplicationWillResignActiveNotification notifications.
   id<NSObject> observer_ = nil;
 
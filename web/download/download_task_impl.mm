@@ -8,9 +8,15 @@
 #import <WebKit/WebKit.h>
 
 #include "base/bind.h"
+#include "base/feature_list.h"
+#include "base/files/file_path.h"
+#include "base/metrics/histogram_macros.h"
 #include "base/strings/sys_string_conversions.h"
 #include "base/task/post_task.h"
 #import "ios/net/cookies/system_cookie_util.h"
+#include "ios/web/common/features.h"
+#import "ios/web/download/download_write_queue.h"
+#import "ios/web/download/segmented_download_job.h"
 #import "ios/web/net/cookies/wk_cookie_util.h"
 #include "ios/web/public/browser_state.h"
 #import "ios/web/public/download/download_task_observer.h"
@@ -38,14 +44,21 @@ using web::WebThread;
 
 namespace {
 
-// Updates DownloadTaskImpl properties. |terminal_callback| is true if this is
-// the last update for this DownloadTaskImpl.
-using PropertiesBlock = void (^)(NSURLSessionTask*,
-                                 NSError*,
-                                 bool terminal_callback);
-// Writes buffer and calls |completionHandler| when done.
-using DataBlock = void (^)(scoped_refptr<net::IOBufferWithSize> buffer,
-                           void (^completionHandler)());
+// Maximum amount of downloaded data waiting to be written before the
+// NSURLSession delegate queue is blocked.
+const int64_t kMaxPendingWriteBytes = 8 * 1024 * 1024;
+
+// Minimum delay between two progress updates while downloading.
+constexpr base::TimeDelta kProgressUpdateInterval =
+    base::TimeDelta::FromMilliseconds(100);
+
+// Suffix of the identifier of the NSURLSession used by segmented downloads.
+NSString* const kSegmentedDownloadsSessionSuffix = @".segments";
+
+// Updates DownloadTaskImpl properties and finishes the download.
+using CompletionBlock = void (^)(NSURLSessionTask*, NSError*);
+// Writes a chunk of downloaded data. Called on the NSURLSession delegate queue.
+using DataBlock = void (^)(NSData*);
 
 // Translates an CFNetwork error code to a net error code. Returns 0 if |error|
 // is nil.
@@ -59,13 +72,6 @@ int GetNetErrorCodeFromNSError(NSError* error, NSURL* url) {
   return error_code;
 }
 
-// Creates a new buffer from raw |data| and |size|.
-scoped_refptr<net::IOBufferWithSize> GetBuffer(const void* data, size_t size) {
-  auto buffer = base::MakeRefCounted<net::IOBufferWithSize>(size);
-  memcpy(buffer->data(), data, size);
-  return buffer;
-}
-
 // Percent complete for the given NSURLSessionTask within [0..100] range.
 int GetTaskPercentComplete(NSURLSessionTask* task) {
   DCHECK(task);
@@ -85,31 +91,32 @@ int GetTaskPercentComplete(NSURLSessionTask* task) {
 // the client. Client of this delegate can pass blocks to receive the updates.
 @interface CRWURLSessionDelegate : NSObject<NSURLSessionDataDelegate>
 
-// Called when DownloadTaskImpl should update its properties (is_done,
-// error_code, total_bytes, and percent_complete) and call OnDownloadUpdated
-// callback.
-@property(nonatomic, readonly) PropertiesBlock propertiesBlock;
+// Called on the UI thread when the download has completed, to update the
+// DownloadTaskImpl properties (is_done, error_code, total_bytes, and
+// percent_complete) and finish the download.
+@property(nonatomic, readonly) CompletionBlock completionBlock;
 
-// Called when DownloadTaskImpl should write a chunk of downloaded data.
+// Called on the delegate queue when DownloadTaskImpl should write a chunk of
+// downloaded data.
 @property(nonatomic, readonly) DataBlock dataBlock;
 
 - (instancetype)init NS_UNAVAILABLE;
-- (instancetype)initWithPropertiesBlock:(PropertiesBlock)propertiesBlock
+- (instancetype)initWithCompletionBlock:(CompletionBlock)completionBlock
                               dataBlock:(DataBlock)dataBlock
     NS_DESIGNATED_INITIALIZER;
 @end
 
 @implementation CRWURLSessionDelegate
 
-@synthesize propertiesBlock = _propertiesBlock;
+@synthesize completionBlock = _completionBlock;
 @synthesize dataBlock = _dataBlock;
 
-- (instancetype)initWithPropertiesBlock:(PropertiesBlock)propertiesBlock
+- (instancetype)initWithCompletionBlock:(CompletionBlock)completionBlock
                               dataBlock:(DataBlock)dataBlock {
-  DCHECK(propertiesBlock);
+  DCHECK(completionBlock);
   DCHECK(dataBlock);
   if ((self = [super init])) {
-    _propertiesBlock = propertiesBlock;
+    _completionBlock = completionBlock;
     _dataBlock = dataBlock;
   }
   return self;
@@ -121,41 +128,17 @@ int GetTaskPercentComplete(NSURLSessionTask* task) {
   __weak CRWURLSessionDelegate* weakSelf = self;
   base::PostTask(FROM_HERE, {WebThread::UI}, base::BindOnce(^{
                    CRWURLSessionDelegate* strongSelf = weakSelf;
-                   if (strongSelf.propertiesBlock)
-                     strongSelf.propertiesBlock(task, error,
-                                                /*terminal_callback=*/true);
+                   if (strongSelf.completionBlock)
+                     strongSelf.completionBlock(task, error);
                  }));
 }
 
 - (void)URLSession:(NSURLSession*)session
           dataTask:(NSURLSessionDataTask*)task
     didReceiveData:(NSData*)data {
-  // Block this background queue until the the data is written.
-  dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
-  __weak CRWURLSessionDelegate* weakSelf = self;
-  using Bytes = const void* _Nonnull;
-  [data enumerateByteRangesUsingBlock:^(Bytes bytes, NSRange range, BOOL*) {
-    auto buffer = GetBuffer(bytes, range.length);
-    base::PostTask(FROM_HERE, {WebThread::UI}, base::BindOnce(^{
-                     CRWURLSessionDelegate* strongSelf = weakSelf;
-                     if (!strongSelf.dataBlock) {
-                       dispatch_semaphore_signal(semaphore);
-                       return;
-                     }
-                     strongSelf.dataBlock(std::move(buffer), ^{
-                       // Data was written to disk, unblock queue to
-                       // read the next chunk of downloaded data.
-                       dispatch_semaphore_signal(semaphore);
-                     });
-                   }));
-    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
-  }];
-  base::PostTask(FROM_HERE, {WebThread::UI}, base::BindOnce(^{
-                   CRWURLSessionDelegate* strongSelf = weakSelf;
-                   if (strongSelf.propertiesBlock)
-                     weakSelf.propertiesBlock(task, nil,
-                                              /*terminal_callback=*/false);
-                 }));
+  // May block this background queue if too much data is waiting to be written.
+  // Progress is reported once the data is written.
+  self.dataBlock(data);
 }
 
 - (void)URLSession:(NSURLSession*)session
@@ -193,6 +176,11 @@ DownloadTaskImpl::DownloadTaskImpl(WebState* web_state,
   DCHECK(web_state_);
   DCHECK(delegate_);
 
+  write_queue_ = base::MakeRefCounted<DownloadWriteQueue>(
+      kMaxPendingWriteBytes, kProgressUpdateInterval,
+      base::BindRepeating(&DownloadTaskImpl::OnDataWritten,
+                          weak_factory_.GetWeakPtr()));
+
   observer_ = [NSNotificationCenter.defaultCenter
       addObserverForName:UIApplicationWillResignActiveNotification
                   object:nil
@@ -220,6 +208,8 @@ void DownloadTaskImpl::ShutDown() {
   DCHECK_CURRENTLY_ON(web::WebThread::UI);
   [session_task_ cancel];
   session_task_ = nil;
+  segmented_download_job_.reset();
+  write_queue_->Cancel();
   delegate_ = nullptr;
 }
 
@@ -244,6 +234,8 @@ void DownloadTaskImpl::Start(
   if (original_url_.SchemeIs(url::kDataScheme)) {
     StartDataUrlParsing();
   } else {
+    write_queue_->Start(writer_.get());
+    download_start_time_ = base::TimeTicks::Now();
     GetCookies(base::BindRepeating(&DownloadTaskImpl::StartWithCookies,
                                    weak_factory_.GetWeakPtr()));
   }
@@ -253,6 +245,11 @@ void DownloadTaskImpl::Cancel() {
   DCHECK_CURRENTLY_ON(web::WebThread::UI);
   [session_task_ cancel];
   session_task_ = nil;
+  if (segmented_download_job_) {
+    segmented_download_job_->Cancel();
+    segmented_download_job_.reset();
+  }
+  write_queue_->Cancel();
   state_ = State::kCancelled;
   OnDownloadUpdated();
 }
@@ -352,62 +349,48 @@ NSURLSession* DownloadTaskImpl::CreateSession(NSString* identifier,
   DCHECK_CURRENTLY_ON(web::WebThread::UI);
   DCHECK(identifier.length);
   base::WeakPtr<DownloadTaskImpl> weak_this = weak_factory_.GetWeakPtr();
+  scoped_refptr<DownloadWriteQueue> write_queue = write_queue_;
   id<NSURLSessionDataDelegate> session_delegate = [[CRWURLSessionDelegate alloc]
-      initWithPropertiesBlock:^(NSURLSessionTask* task, NSError* error,
-                                bool terminal_callback) {
+      initWithCompletionBlock:^(NSURLSessionTask* task, NSError* error) {
         if (!weak_this.get()) {
           return;
         }
 
-        error_code_ =
-            GetNetErrorCodeFromNSError(error, task.currentRequest.URL);
-        percent_complete_ = GetTaskPercentComplete(task);
-        received_bytes_ = task.countOfBytesReceived;
-        if (total_bytes_ == -1 || task.countOfBytesExpectedToReceive) {
-          // countOfBytesExpectedToReceive can be 0 if the device is offline.
-          // In that case total_bytes_ should remain unchanged if the total
-          // bytes count is already known.
-          total_bytes_ = task.countOfBytesExpectedToReceive;
-        }
-        if (task.response.MIMEType) {
-          mime_type_ = base::SysNSStringToUTF8(task.response.MIMEType);
-        }
-        if ([task.response isKindOfClass:[NSHTTPURLResponse class]]) {
-          http_code_ =
-              static_cast<NSHTTPURLResponse*>(task.response).statusCode;
-        }
+        UpdateProperties(task, error);
 
-        if (!terminal_callback) {
-          OnDownloadUpdated();
-          // Download is still in progress, nothing to do here.
-          return;
-        }
-
-        // Download has finished, so finalize the writer and signal completion.
-        auto callback = base::BindOnce(&DownloadTaskImpl::OnDownloadFinished,
-                                       weak_factory_.GetWeakPtr());
-        if (writer_->Finish(error_code_, std::move(callback)) !=
-            net::ERR_IO_PENDING) {
-          OnDownloadFinished(error_code_);
-        }
+        // Download has finished, so finalize the writer once all the data is
+        // written and signal completion.
+        write_queue_->Finish(
+            error_code_, base::BindOnce(&DownloadTaskImpl::OnDownloadFinished,
+                                        weak_factory_.GetWeakPtr()));
       }
-      dataBlock:^(scoped_refptr<net::IOBufferWithSize> buffer,
-                  void (^completion_handler)()) {
-        if (weak_this.get()) {
-          net::CompletionOnceCallback callback = base::BindOnce(^(int) {
-            completion_handler();
-          });
-          if (writer_->Write(buffer.get(), buffer->size(),
-                             std::move(callback)) == net::ERR_IO_PENDING) {
-            return;
-          }
-        }
-        completion_handler();
+      dataBlock:^(NSData* data) {
+        write_queue->Append(data);
       }];
   return delegate_->CreateSession(identifier, cookies, session_delegate,
                                   /*queue=*/nil);
 }
 
+void DownloadTaskImpl::UpdateProperties(NSURLSessionTask* task,
+                                        NSError* error) {
+  DCHECK_CURRENTLY_ON(web::WebThread::UI);
+  error_code_ = GetNetErrorCodeFromNSError(error, task.currentRequest.URL);
+  percent_complete_ = GetTaskPercentComplete(task);
+  received_bytes_ = task.countOfBytesReceived;
+  if (total_bytes_ == -1 || task.countOfBytesExpectedToReceive) {
+    // countOfBytesExpectedToReceive can be 0 if the device is offline.
+    // In that case total_bytes_ should remain unchanged if the total
+    // bytes count is already known.
+    total_bytes_ = task.countOfBytesExpectedToReceive;
+  }
+  if (task.response.MIMEType) {
+    mime_type_ = base::SysNSStringToUTF8(task.response.MIMEType);
+  }
+  if ([task.response isKindOfClass:[NSHTTPURLResponse class]]) {
+    http_code_ = static_cast<NSHTTPURLResponse*>(task.response).statusCode;
+  }
+}
+
 void DownloadTaskImpl::GetCookies(
     base::OnceCallback<void(NSArray<NSHTTPCookie*>*)> callback) {
   DCHECK_CURRENTLY_ON(WebThread::UI);
@@ -440,23 +423,91 @@ void DownloadTaskImpl::StartWithCookies(NSArray<NSHTTPCookie*>* cookies) {
   DCHECK_CURRENTLY_ON(web::WebThread::UI);
   DCHECK(writer_);
 
+  has_performed_background_download_ =
+      UIApplication.sharedApplication.applicationState !=
+      UIApplicationStateActive;
+
+  // Byte ranges can only be written to a file, and only make sense for GET.
+  if (base::FeatureList::IsEnabled(features::kSegmentedDownloads) &&
+      writer_->AsFileWriter() && [GetHttpMethod() isEqualToString:@"GET"]) {
+    StartSegmentedDownload(cookies);
+  } else {
+    StartSessionTask(cookies);
+  }
+  OnDownloadUpdated();
+}
+
+void DownloadTaskImpl::StartSessionTask(NSArray<NSHTTPCookie*>* cookies) {
+  DCHECK_CURRENTLY_ON(web::WebThread::UI);
   if (!session_) {
     session_ = CreateSession(identifier_, cookies);
     DCHECK(session_);
   }
 
-  has_performed_background_download_ =
-      UIApplication.sharedApplication.applicationState !=
-      UIApplicationStateActive;
-
   NSURL* url = net::NSURLWithGURL(GetOriginalUrl());
   NSMutableURLRequest* request = [[NSMutableURLRequest alloc] initWithURL:url];
   request.HTTPMethod = GetHttpMethod();
   session_task_ = [session_ dataTaskWithRequest:request];
   [session_task_ resume];
+}
+
+void DownloadTaskImpl::StartSegmentedDownload(
+    NSArray<NSHTTPCookie*>* cookies) {
+  DCHECK_CURRENTLY_ON(web::WebThread::UI);
+  segmented_download_job_ = std::make_unique<SegmentedDownloadJob>(
+      GetOriginalUrl(), SegmentedDownloadJob::GetTempDirectory(),
+      writer_->AsFileWriter()->file_path(),
+      features::kSegmentedDownloadsMaxSegments.Get(), kMaxPendingWriteBytes);
+
+  NSString* identifier =
+      [identifier_ stringByAppendingString:kSegmentedDownloadsSessionSuffix];
+  Delegate* delegate = delegate_;
+  segmented_download_job_->Start(
+      base::BindOnce(^(id<NSURLSessionDataDelegate> session_delegate) {
+        return delegate->CreateSession(identifier, cookies, session_delegate,
+                                       /*queue=*/nil);
+      }),
+      base::BindRepeating(&DownloadTaskImpl::OnSegmentedDownloadProgress,
+                          weak_factory_.GetWeakPtr()),
+      base::BindOnce(&DownloadTaskImpl::OnSegmentedDownloadCompleted,
+                     weak_factory_.GetWeakPtr(), cookies));
+}
+
+void DownloadTaskImpl::OnSegmentedDownloadProgress(int64_t received_bytes,
+                                                   int64_t total_bytes) {
+  DCHECK_CURRENTLY_ON(web::WebThread::UI);
+  received_bytes_ = received_bytes;
+  total_bytes_ = total_bytes;
+  percent_complete_ =
+      total_bytes ? static_cast<int>(100 * received_bytes / total_bytes) : 100;
   OnDownloadUpdated();
 }
 
+void DownloadTaskImpl::OnSegmentedDownloadCompleted(
+    NSArray<NSHTTPCookie*>* cookies,
+    int error_code) {
+  DCHECK_CURRENTLY_ON(web::WebThread::UI);
+  std::unique_ptr<SegmentedDownloadJob> job =
+      std::move(segmented_download_job_);
+  if (error_code == net::ERR_NOT_IMPLEMENTED) {
+    StartSessionTask(cookies);
+    return;
+  }
+
+  if (job->http_code() != -1)
+    http_code_ = job->http_code();
+  if (!job->mime_type().empty())
+    mime_type_ = job->mime_type();
+  error_code_ = error_code;
+
+  // The data is already at the path of the writer, which only has to close its
+  // file.
+  auto callback = base::BindOnce(&DownloadTaskImpl::OnDownloadFinished,
+                                 weak_factory_.GetWeakPtr());
+  if (writer_->Finish(error_code, std::move(callback)) != net::ERR_IO_PENDING)
+    OnDownloadFinished(error_code);
+}
+
 void DownloadTaskImpl::StartDataUrlParsing() {
   mime_type_.clear();
   std::string charset;
@@ -475,6 +526,31 @@ void DownloadTaskImpl::StartDataUrlParsing() {
   }
 }
 
+void DownloadTaskImpl::OnDataWritten() {
+  DCHECK_CURRENTLY_ON(web::WebThread::UI);
+  if (!session_task_)
+    return;
+  // Download is still in progress, only update the properties.
+  UpdateProperties(session_task_, /*error=*/nil);
+  OnDownloadUpdated();
+}
+
+void DownloadTaskImpl::RecordWriteMetrics() {
+  const int64_t bytes_written = write_queue_->bytes_written();
+  const base::TimeDelta download_time =
+      base::TimeTicks::Now() - download_start_time_;
+  if (!bytes_written || download_time.is_zero())
+    return;
+
+  UMA_HISTOGRAM_COUNTS_1M(
+      "Download.IOSDownloadThroughput",
+      static_cast<int>(bytes_written / 1024 / download_time.InSecondsF()));
+  UMA_HISTOGRAM_MEDIUM_TIMES("Download.IOSDownloadUIThreadTime",
+                             write_queue_->ui_thread_time());
+  UMA_HISTOGRAM_COUNTS_1M("Download.IOSDownloadUIThreadTaskCount",
+                          write_queue_->ui_thread_task_count());
+}
+
 void DownloadTaskImpl::OnDownloadUpdated() {
   for (auto& observer : observers_)
     observer.OnDownloadUpdated(this);
@@ -488,6 +564,8 @@ void DownloadTaskImpl::OnDownloadFinished(int error_code) {
   // writer isn't a fileWriter as for Passkit downloads for example.
   if (writer_->AsFileWriter())
     writer_->AsFileWriter()->DisownFile();
+  if (error_code == net::OK && !download_start_time_.is_null())
+    RecordWriteMetrics();
   error_code_ = error_code;
   state_ = State::kComplete;
   session_task_ = nil;
@@ -0,0 +1,158 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef IOS_WEB_DOWNLOAD_DOWNLOAD_WRITE_QUEUE_H_
+#define IOS_WEB_DOWNLOAD_DOWNLOAD_WRITE_QUEUE_H_
+
+#include <stdint.h>
+
+#include <deque>
+
+#include "base/callback.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "net/base/completion_once_callback.h"
+
+@class NSData;
+
+namespace net {
+class DrainableIOBuffer;
+class URLFetcherResponseWriter;
+}  // namespace net
+
+namespace web {
+
+// Passes the data received by a download to its net::URLFetcherResponseWriter.
+// Data is appended on the NSURLSession delegate queue and handed to the writer,
+// without being copied, on the UI thread which owns the writer. The UI thread
+// only runs a task when the writer is idle and data is pending, rather than
+// once per received chunk, and progress updates are coalesced. Appending only
+// blocks the delegate queue while too much data is waiting to be written.
+class DownloadWriteQueue
+    : public base::RefCountedThreadSafe<DownloadWriteQueue> {
+ public:
+  // |max_pending_bytes| is the amount of appended data above which Append()
+  // blocks until some data is written. |progress_callback| is called on the UI
+  // thread after some data is written, at most once per
+  // |progress_update_interval|.
+  DownloadWriteQueue(int64_t max_pending_bytes,
+                     base::TimeDelta progress_update_interval,
+                     base::RepeatingClosure progress_callback);
+
+  // Starts handing data to |writer|, dropping any data from a previous
+  // download. |writer| is used until Start() is called again, and must stay
+  // valid until then or until the queue is no longer used. Must be called on
+  // the UI thread.
+  void Start(net::URLFetcherResponseWriter* writer);
+
+  // Appends |data| to be written, without copying it. Blocks the calling thread
+  // while the pending data exceeds |max_pending_bytes|. Must not be called on
+  // the UI thread.
+  void Append(NSData* data);
+
+  // Calls URLFetcherResponseWriter::Finish once all the appended data is
+  // written, and then |callback| with the result. Must be called on the UI
+  // thread.
+  void Finish(int net_error, net::CompletionOnceCallback callback);
+
+  // Drops the data waiting to be written and unblocks Append(). The data
+  // appended later is ignored until Start() is called again. Must be called on
+  // the UI thread.
+  void Cancel();
+
+  // The number of bytes written since Start(). Must be called on the UI
+  // thread.
+  int64_t bytes_written() const { return bytes_written_; }
+
+  // The time spent and the number of tasks run on the UI thread to write data
+  // since Start(). Must be called on the UI thread.
+  base::TimeDelta ui_thread_time() const { return ui_thread_time_; }
+  int ui_thread_task_count() const { return ui_thread_task_count_; }
+
+ private:
+  friend class base::RefCountedThreadSafe<DownloadWriteQueue>;
+  ~DownloadWriteQueue();
+
+  // Posts a task to write the pending data, unless one is already posted.
+  // |lock_| must be held.
+  void ScheduleWriteLocked();
+
+  // Writes the pending data.
+  void WritePendingData();
+
+  // Called when the writer asynchronously wrote |result| bytes.
+  void OnWriteCompleted(int generation, int result);
+
+  // Writes pending data until the writer is busy or all data is written, then
+  // finishes the writer if requested.
+  void WriteLoop();
+
+  // Moves the next pending chunk of data to |buffer_|. Returns false if no data
+  // is pending.
+  bool PopPendingData();
+
+  // Updates the state after the writer wrote |result| bytes of |buffer_|.
+  void DidWrite(int result);
+
+  // Calls URLFetcherResponseWriter::Finish.
+  void FinishWriter();
+
+  // Called when the writer is finished.
+  void OnWriterFinished(int generation, int result);
+
+  // Schedules a call to |progress_callback_|, unless one is already scheduled.
+  void ScheduleProgressUpdate();
+
+  // Calls |progress_callback_| if the queue was not restarted or finished
+  // since the call was scheduled.
+  void NotifyProgress(int generation);
+
+  const int64_t max_pending_bytes_;
+  const base::TimeDelta progress_update_interval_;
+  const base::RepeatingClosure progress_callback_;
+
+  // Protects the members below, accessed on both the delegate queue and the UI
+  // thread.
+  base::Lock lock_;
+  // Signaled when the pending data goes below |max_pending_bytes_|.
+  base::ConditionVariable space_available_;
+  // Data appended and not yet handed to the writer.
+  std::deque<NSData*> pending_data_;
+  // Size of the data appended and not yet written, including |buffer_|.
+  int64_t pending_bytes_ = 0;
+  // Whether appended data is accepted.
+  bool accepting_data_ = false;
+  // Whether a task to write the pending data is posted.
+  bool write_scheduled_ = false;
+
+  // Members below are only accessed on the UI thread.
+  net::URLFetcherResponseWriter* writer_ = nullptr;
+  // Incremented on Start() and Cancel() to ignore the pending callbacks.
+  int generation_ = 0;
+  // The chunk of data being written.
+  scoped_refptr<net::DrainableIOBuffer> buffer_;
+  // Whether the writer is asynchronously writing |buffer_|.
+  bool writing_ = false;
+  // The first write error, which fails the download.
+  int write_error_ = 0;
+  // Error and callback passed to Finish(), if called.
+  int finish_error_ = 0;
+  net::CompletionOnceCallback finish_callback_;
+  // Whether URLFetcherResponseWriter::Finish was called.
+  bool finishing_writer_ = false;
+  bool progress_update_scheduled_ = false;
+  base::TimeTicks last_progress_update_;
+  int64_t bytes_written_ = 0;
+  base::TimeDelta ui_thread_time_;
+  int ui_thread_task_count_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(DownloadWriteQueue);
+};
+
+}  // namespace web
+
+#endif  // IOS_WEB_DOWNLOAD_DOWNLOAD_WRITE_QUEUE_H_
@@ -0,0 +1,262 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/web/download/download_write_queue.h"
+
+#import <Foundation/Foundation.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/task/post_task.h"
+#include "base/timer/elapsed_timer.h"
+#include "ios/web/public/thread/web_task_traits.h"
+#include "ios/web/public/thread/web_thread.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/url_request/url_fetcher_response_writer.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace web {
+
+namespace {
+
+// IOBuffer pointing to the bytes of an NSData, which it retains.
+class NSDataIOBuffer : public net::WrappedIOBuffer {
+ public:
+  explicit NSDataIOBuffer(NSData* data)
+      : net::WrappedIOBuffer(static_cast<const char*>(data.bytes)),
+        data_(data) {}
+
+ private:
+  ~NSDataIOBuffer() override = default;
+
+  NSData* data_;
+};
+
+}  // namespace
+
+DownloadWriteQueue::DownloadWriteQueue(
+    int64_t max_pending_bytes,
+    base::TimeDelta progress_update_interval,
+    base::RepeatingClosure progress_callback)
+    : max_pending_bytes_(max_pending_bytes),
+      progress_update_interval_(progress_update_interval),
+      progress_callback_(std::move(progress_callback)),
+      space_available_(&lock_) {
+  DCHECK_GT(max_pending_bytes_, 0);
+}
+
+DownloadWriteQueue::~DownloadWriteQueue() = default;
+
+void DownloadWriteQueue::Start(net::URLFetcherResponseWriter* writer) {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  DCHECK(writer);
+  Cancel();
+  writer_ = writer;
+  write_error_ = net::OK;
+  last_progress_update_ = base::TimeTicks();
+  bytes_written_ = 0;
+  ui_thread_time_ = base::TimeDelta();
+  ui_thread_task_count_ = 0;
+
+  base::AutoLock auto_lock(lock_);
+  accepting_data_ = true;
+}
+
+void DownloadWriteQueue::Append(NSData* data) {
+  DCHECK(!WebThread::CurrentlyOn(WebThread::UI));
+  if (!data.length)
+    return;
+
+  base::AutoLock auto_lock(lock_);
+  while (accepting_data_ && pending_bytes_ >= max_pending_bytes_)
+    space_available_.Wait();
+  if (!accepting_data_)
+    return;
+
+  // Split the data in contiguous chunks, which does not copy the bytes.
+  [data enumerateByteRangesUsingBlock:^(const void* _Nonnull, NSRange range,
+                                        BOOL*) {
+    pending_data_.push_back(range.length == data.length
+                                ? data
+                                : [data subdataWithRange:range]);
+  }];
+  pending_bytes_ += data.length;
+  ScheduleWriteLocked();
+}
+
+void DownloadWriteQueue::Finish(int net_error,
+                                net::CompletionOnceCallback callback) {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  DCHECK(writer_);
+  DCHECK(!finish_callback_);
+  finish_error_ = net_error;
+  finish_callback_ = std::move(callback);
+  WriteLoop();
+}
+
+void DownloadWriteQueue::Cancel() {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  generation_++;
+  buffer_ = nullptr;
+  writing_ = false;
+  finish_callback_.Reset();
+  finishing_writer_ = false;
+  progress_update_scheduled_ = false;
+
+  base::AutoLock auto_lock(lock_);
+  accepting_data_ = false;
+  pending_data_.clear();
+  pending_bytes_ = 0;
+  space_available_.Broadcast();
+}
+
+void DownloadWriteQueue::ScheduleWriteLocked() {
+  lock_.AssertAcquired();
+  if (write_scheduled_)
+    return;
+  write_scheduled_ = true;
+  base::PostTask(FROM_HERE, {WebThread::UI},
+                 base::BindOnce(&DownloadWriteQueue::WritePendingData, this));
+}
+
+void DownloadWriteQueue::WritePendingData() {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  base::ElapsedTimer timer;
+  {
+    base::AutoLock auto_lock(lock_);
+    write_scheduled_ = false;
+  }
+  WriteLoop();
+  ui_thread_task_count_++;
+  ui_thread_time_ += timer.Elapsed();
+}
+
+void DownloadWriteQueue::OnWriteCompleted(int generation, int result) {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  if (generation != generation_)
+    return;
+
+  base::ElapsedTimer timer;
+  writing_ = false;
+  DidWrite(result);
+  WriteLoop();
+  ui_thread_task_count_++;
+  ui_thread_time_ += timer.Elapsed();
+}
+
+void DownloadWriteQueue::WriteLoop() {
+  while (writer_ && !writing_) {
+    if (!buffer_ && !PopPendingData()) {
+      if (finish_callback_ && !finishing_writer_)
+        FinishWriter();
+      return;
+    }
+
+    int result = writer_->Write(
+        buffer_.get(), buffer_->BytesRemaining(),
+        base::BindOnce(&DownloadWriteQueue::OnWriteCompleted, this,
+                       generation_));
+    if (result == net::ERR_IO_PENDING) {
+      writing_ = true;
+      return;
+    }
+    DidWrite(result);
+  }
+}
+
+bool DownloadWriteQueue::PopPendingData() {
+  DCHECK(!buffer_);
+  NSData* data = nil;
+  {
+    base::AutoLock auto_lock(lock_);
+    if (pending_data_.empty())
+      return false;
+    data = pending_data_.front();
+    pending_data_.pop_front();
+  }
+  buffer_ = base::MakeRefCounted<net::DrainableIOBuffer>(
+      base::MakeRefCounted<NSDataIOBuffer>(data), data.length);
+  return true;
+}
+
+void DownloadWriteQueue::DidWrite(int result) {
+  DCHECK(buffer_);
+  if (result <= 0) {
+    // The download can't succeed, drop the remaining data. Finish() still
+    // needs to be called to clean up the writer.
+    if (write_error_ == net::OK)
+      write_error_ = result ? result : net::ERR_FAILED;
+    buffer_ = nullptr;
+    base::AutoLock auto_lock(lock_);
+    accepting_data_ = false;
+    pending_data_.clear();
+    pending_bytes_ = 0;
+    space_available_.Broadcast();
+    return;
+  }
+
+  buffer_->DidConsume(result);
+  bytes_written_ += result;
+  if (!buffer_->BytesRemaining()) {
+    const int size = buffer_->size();
+    buffer_ = nullptr;
+    base::AutoLock auto_lock(lock_);
+    pending_bytes_ -= size;
+    if (pending_bytes_ < max_pending_bytes_)
+      space_available_.Signal();
+  }
+  ScheduleProgressUpdate();
+}
+
+void DownloadWriteQueue::FinishWriter() {
+  finishing_writer_ = true;
+  const int net_error =
+      finish_error_ == net::OK ? write_error_ : finish_error_;
+  const int result = writer_->Finish(
+      net_error, base::BindOnce(&DownloadWriteQueue::OnWriterFinished, this,
+                                generation_));
+  if (result != net::ERR_IO_PENDING)
+    OnWriterFinished(generation_, result);
+}
+
+void DownloadWriteQueue::OnWriterFinished(int generation, int result) {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  if (generation != generation_ || !finish_callback_)
+    return;
+  std::move(finish_callback_).Run(result);
+}
+
+void DownloadWriteQueue::ScheduleProgressUpdate() {
+  if (progress_update_scheduled_ || finish_callback_)
+    return;
+  progress_update_scheduled_ = true;
+  const base::TimeDelta delay =
+      std::max(base::TimeDelta(), last_progress_update_ +
+                                      progress_update_interval_ -
+                                      base::TimeTicks::Now());
+  base::PostDelayedTask(
+      FROM_HERE, {WebThread::UI},
+      base::BindOnce(&DownloadWriteQueue::NotifyProgress, this, generation_),
+      delay);
+}
+
+void DownloadWriteQueue::NotifyProgress(int generation) {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  if (generation != generation_)
+    return;
+  progress_update_scheduled_ = false;
+  // Once finishing, the completion notifies the progress.
+  if (finish_callback_)
+    return;
+  last_progress_update_ = base::TimeTicks::Now();
+  progress_callback_.Run();
+}
+
+}  // namespace web
@@ -0,0 +1,213 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/web/download/download_write_queue.h"
+
+#import <Foundation/Foundation.h>
+
+#include "base/bind.h"
+#include "base/run_loop.h"
+#import "base/test/ios/wait_util.h"
+#include "ios/web/public/test/web_task_environment.h"
+#include "net/base/completion_once_callback.h"
+#include "net/base/net_errors.h"
+#include "net/url_request/url_fetcher_response_writer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/platform_test.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+using base::test::ios::kWaitForDownloadTimeout;
+using base::test::ios::WaitUntilConditionOrTimeout;
+
+namespace web {
+
+namespace {
+
+// Returns an NSData with the bytes of |string|.
+NSData* GetData(const char* string) {
+  return [NSData dataWithBytes:string length:strlen(string)];
+}
+
+// A writer whose Finish() fails synchronously with |error|.
+class FailingFinishWriter : public net::URLFetcherStringWriter {
+ public:
+  explicit FailingFinishWriter(int error) : error_(error) {}
+
+  // net::URLFetcherResponseWriter:
+  int Finish(int net_error, net::CompletionOnceCallback callback) override {
+    return error_;
+  }
+
+ private:
+  const int error_;
+};
+
+}  // namespace
+
+class DownloadWriteQueueTest : public PlatformTest {
+ protected:
+  DownloadWriteQueueTest()
+      : delegate_queue_(dispatch_queue_create(nullptr, DISPATCH_QUEUE_SERIAL)) {
+  }
+
+  // Creates and starts the queue.
+  void StartQueue(int64_t max_pending_bytes,
+                  base::TimeDelta progress_update_interval) {
+    queue_ = base::MakeRefCounted<DownloadWriteQueue>(
+        max_pending_bytes, progress_update_interval,
+        base::BindRepeating(&DownloadWriteQueueTest::OnProgress,
+                            base::Unretained(this)));
+    queue_->Start(&writer_);
+  }
+
+  // Appends |string| to the queue from the delegate queue, and waits for the
+  // call to return.
+  void AppendSync(const char* string) {
+    NSData* data = GetData(string);
+    scoped_refptr<DownloadWriteQueue> queue = queue_;
+    dispatch_sync(delegate_queue_, ^{
+      queue->Append(data);
+    });
+  }
+
+  // Appends |string| to the queue from the delegate queue, without waiting.
+  void AppendAsync(const char* string) {
+    NSData* data = GetData(string);
+    scoped_refptr<DownloadWriteQueue> queue = queue_;
+    dispatch_async(delegate_queue_, ^{
+      queue->Append(data);
+    });
+  }
+
+  // Waits until the writer contains |data|.
+  bool WaitForWrittenData(const std::string& data) {
+    return WaitUntilConditionOrTimeout(kWaitForDownloadTimeout, ^{
+      base::RunLoop().RunUntilIdle();
+      return writer_.data() == data;
+    });
+  }
+
+  void OnProgress() { progress_count_++; }
+
+  web::WebTaskEnvironment task_environment_;
+  net::URLFetcherStringWriter writer_;
+  dispatch_queue_t delegate_queue_;
+  scoped_refptr<DownloadWriteQueue> queue_;
+  int progress_count_ = 0;
+};
+
+// Tests that appended data is written in order and the writer finished.
+TEST_F(DownloadWriteQueueTest, WriteAndFinish) {
+  StartQueue(/*max_pending_bytes=*/1024, base::TimeDelta());
+  AppendAsync("foo");
+  AppendAsync("bar");
+  ASSERT_TRUE(WaitForWrittenData("foobar"));
+  EXPECT_EQ(6, queue_->bytes_written());
+  EXPECT_LT(0, progress_count_);
+
+  __block int finish_result = 1;
+  queue_->Finish(net::OK, base::BindOnce(^(int result) {
+                   finish_result = result;
+                 }));
+  EXPECT_EQ(net::OK, finish_result);
+}
+
+// Tests that a synchronous failure of the writer's Finish() is reported.
+TEST_F(DownloadWriteQueueTest, FinishFailsSynchronously) {
+  FailingFinishWriter writer(net::ERR_FILE_NO_SPACE);
+  queue_ = base::MakeRefCounted<DownloadWriteQueue>(
+      /*max_pending_bytes=*/1024, base::TimeDelta(),
+      base::BindRepeating(&DownloadWriteQueueTest::OnProgress,
+                          base::Unretained(this)));
+  queue_->Start(&writer);
+  AppendSync("foo");
+
+  __block int finish_result = net::OK;
+  __block bool finished = false;
+  queue_->Finish(net::OK, base::BindOnce(^(int result) {
+                   finish_result = result;
+                   finished = true;
+                 }));
+  ASSERT_TRUE(WaitUntilConditionOrTimeout(kWaitForDownloadTimeout, ^{
+    base::RunLoop().RunUntilIdle();
+    return finished;
+  }));
+  EXPECT_EQ("foo", writer.data());
+  EXPECT_EQ(net::ERR_FILE_NO_SPACE, finish_result);
+}
+
+// Tests that the data appended while the UI thread is busy is written by a
+// single task, with a single progress update.
+TEST_F(DownloadWriteQueueTest, CoalescedWrites) {
+  StartQueue(/*max_pending_bytes=*/1024, base::TimeDelta::FromSeconds(1));
+  AppendSync("a");
+  AppendSync("b");
+  AppendSync("c");
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ("abc", writer_.data());
+  EXPECT_EQ(1, queue_->ui_thread_task_count());
+  EXPECT_EQ(1, progress_count_);
+
+  // The next progress update is delayed.
+  AppendSync("d");
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ("abcd", writer_.data());
+  EXPECT_EQ(1, progress_count_);
+}
+
+// Tests that Finish() waits for the pending data to be written.
+TEST_F(DownloadWriteQueueTest, FinishWithPendingData) {
+  StartQueue(/*max_pending_bytes=*/1024, base::TimeDelta());
+  AppendSync("foo");
+
+  __block bool finished = false;
+  queue_->Finish(net::OK, base::BindOnce(^(int result) {
+                   EXPECT_EQ(net::OK, result);
+                   finished = true;
+                 }));
+  ASSERT_TRUE(WaitUntilConditionOrTimeout(kWaitForDownloadTimeout, ^{
+    base::RunLoop().RunUntilIdle();
+    return finished;
+  }));
+  EXPECT_EQ("foo", writer_.data());
+  // The completion replaces the progress update.
+  EXPECT_EQ(0, progress_count_);
+}
+
+// Tests that cancelling drops the pending data and ignores the data appended
+// later.
+TEST_F(DownloadWriteQueueTest, Cancel) {
+  StartQueue(/*max_pending_bytes=*/1024, base::TimeDelta());
+  AppendSync("foo");
+  queue_->Cancel();
+  AppendSync("bar");
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ("", writer_.data());
+  EXPECT_EQ(0, progress_count_);
+}
+
+// Tests that Append() blocks while too much data is pending, and is unblocked
+// when the data is written.
+TEST_F(DownloadWriteQueueTest, BoundedPendingData) {
+  StartQueue(/*max_pending_bytes=*/2, base::TimeDelta());
+  AppendSync("foo");
+
+  // The delegate queue is blocked until "foo" is written.
+  AppendAsync("bar");
+  __block bool appended = false;
+  dispatch_async(delegate_queue_, ^{
+    appended = true;
+  });
+  EXPECT_FALSE(appended);
+
+  ASSERT_TRUE(WaitForWrittenData("foobar"));
+  EXPECT_TRUE(WaitUntilConditionOrTimeout(kWaitForDownloadTimeout, ^{
+    return appended;
+  }));
+}
+
+}  // namespace web
@@ -0,0 +1,165 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef IOS_WEB_DOWNLOAD_SEGMENTED_DOWNLOAD_JOB_H_
+#define IOS_WEB_DOWNLOAD_SEGMENTED_DOWNLOAD_JOB_H_
+
+#import <Foundation/Foundation.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/memory/scoped_refptr.h"
+#include "base/memory/weak_ptr.h"
+#include "base/sequenced_task_runner.h"
+#include "url/gurl.h"
+
+@class CRWSegmentedDownloadSessionDelegate;
+
+namespace web {
+
+// Downloads a resource to a file as several byte ranges fetched concurrently.
+// The progress is recorded in a DownloadSegmentJournal next to the partially
+// downloaded file. Both are named after the URL and the validator of the
+// resource, so a new job for the same resource resumes where the previous one
+// stopped, even after a crash. A range whose connection drops is fetched again
+// from where it stopped. Must be used on the UI thread.
+class SegmentedDownloadJob {
+ public:
+  // Creates the NSURLSession used for the download, with |delegate|.
+  using SessionFactory =
+      base::OnceCallback<NSURLSession*(id<NSURLSessionDataDelegate> delegate)>;
+  // Called with the number of bytes downloaded so far, and the size of the
+  // resource.
+  using ProgressCallback =
+      base::RepeatingCallback<void(int64_t received_bytes,
+                                   int64_t total_bytes)>;
+  // Called when the download is over with a net error code.
+  // net::ERR_NOT_IMPLEMENTED means that nothing was downloaded, because the
+  // server does not support byte ranges or because another job is downloading
+  // the same resource.
+  using CompletionCallback = base::OnceCallback<void(int net_error)>;
+
+  // The partially downloaded file and its journal are kept in
+  // |temp_directory|. The resource is moved to |destination| once downloaded.
+  // The delegate queue of the session is blocked while more than
+  // |max_pending_write_bytes| of received data is waiting to be written.
+  SegmentedDownloadJob(const GURL& url,
+                       const base::FilePath& temp_directory,
+                       const base::FilePath& destination,
+                       int max_segments,
+                       int64_t max_pending_write_bytes);
+  ~SegmentedDownloadJob();
+
+  // Returns the directory where the jobs keep the partially downloaded files.
+  static base::FilePath GetTempDirectory();
+
+  // Deletes the partially downloaded files and journals left in
+  // |temp_directory| which were not modified for a week, and are not used by
+  // a job.
+  static void DeleteStaleFiles(const base::FilePath& temp_directory);
+
+  // Starts or resumes the download.
+  void Start(SessionFactory session_factory,
+             ProgressCallback progress_callback,
+             CompletionCallback completion_callback);
+
+  // Stops the download. The partially downloaded file is kept, so that a new
+  // job resumes it. The completion callback is not called.
+  void Cancel();
+
+  // The HTTP status code and the MIME type of the resource, once the server
+  // replied to the first request.
+  int http_code() const { return http_code_; }
+  const std::string& mime_type() const { return mime_type_; }
+
+ private:
+  // Owns the partially downloaded file and the journal. Lives on
+  // |file_task_runner_|.
+  class Core;
+
+  // Amount of received data waiting to be written by |core_|. Shared with the
+  // delegate queue.
+  class PendingWrites;
+
+  // Result of opening the partially downloaded file.
+  struct OpenResult;
+
+  // A byte range being downloaded.
+  struct Segment {
+    int64_t offset = 0;
+    int64_t length = 0;
+    // Number of bytes received when the current request was started.
+    int64_t received = 0;
+    // Number of consecutive requests which failed without progress.
+    int retry_count = 0;
+    bool complete = false;
+    NSURLSessionTask* task = nil;
+  };
+
+  // Called on the UI thread when |task| has completed.
+  void OnTaskCompleted(NSURLSessionTask* task, NSError* error);
+
+  // Checks the response to the first request, which tells whether the server
+  // supports ranges, the size of the resource and its validator.
+  void OnProbeCompleted(NSURLSessionTask* task, NSError* error);
+
+  // Called when the data file is ready, with its journal, or when it could not
+  // be opened.
+  void OnFileOpened(OpenResult result);
+
+  // Requests the bytes of the segment at |index| from |start|.
+  void StartSegmentTask(size_t index, int64_t start);
+
+  // Called when the request for the segment at |index| completed, with
+  // |received| bytes of the segment written.
+  void OnSegmentTaskCompleted(size_t index, int net_error, int64_t received);
+
+  // Called with the number of bytes written by |core_|.
+  void OnProgress(int64_t received_bytes);
+
+  // Stops the requests. The partially downloaded file is deleted if
+  // |delete_files|, else its journal is saved.
+  void Stop(bool delete_files);
+
+  // Ends the download with |net_error|. The partially downloaded file is kept
+  // unless the resource changed.
+  void Fail(int net_error);
+
+  // Called when the downloaded file is moved to |destination_|.
+  void OnFinished(int net_error);
+
+  const GURL url_;
+  const int max_segments_;
+  scoped_refptr<base::SequencedTaskRunner> file_task_runner_;
+  std::unique_ptr<Core, base::OnTaskRunnerDeleter> core_;
+  scoped_refptr<PendingWrites> pending_writes_;
+
+  NSURLSession* session_ = nil;
+  CRWSegmentedDownloadSessionDelegate* session_delegate_ = nil;
+  NSURLSessionTask* probe_task_ = nil;
+  ProgressCallback progress_callback_;
+  CompletionCallback completion_callback_;
+
+  int http_code_ = -1;
+  std::string mime_type_;
+  std::string validator_;
+  int64_t total_bytes_ = -1;
+  std::vector<Segment> segments_;
+
+  base::WeakPtrFactory<SegmentedDownloadJob> weak_factory_{this};
+
+  DISALLOW_COPY_AND_ASSIGN(SegmentedDownloadJob);
+};
+
+}  // namespace web
+
+#endif  // IOS_WEB_DOWNLOAD_SEGMENTED_DOWNLOAD_JOB_H_
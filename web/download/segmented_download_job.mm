@@ -0,0 +1,799 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/web/download/segmented_download_job.h"
+
+#include <algorithm>
+#include <set>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/files/file.h"
+#include "base/files/file_enumerator.h"
+#include "base/files/file_util.h"
+#include "base/hash/sha1.h"
+#import "base/mac/foundation_util.h"
+#include "base/memory/ref_counted.h"
+#include "base/no_destructor.h"
+#include "base/optional.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/sys_string_conversions.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/task/post_task.h"
+#include "base/task/thread_pool.h"
+#include "base/task_runner_util.h"
+#include "base/time/time.h"
+#import "ios/net/http_response_headers_util.h"
+#import "ios/web/download/download_segment_journal.h"
+#include "ios/web/public/thread/web_task_traits.h"
+#include "ios/web/public/thread/web_thread.h"
+#import "ios/web/web_view/error_translation_util.h"
+#import "net/base/mac/url_conversions.h"
+#include "net/base/net_errors.h"
+#include "net/http/http_response_headers.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+using web::WebThread;
+
+namespace {
+
+// Directory where partially downloaded files are kept, in the temporary
+// directory.
+const char kTempDirectoryName[] = "SegmentedDownloads";
+
+// Partially downloaded files which were not modified for this long are
+// deleted.
+constexpr base::TimeDelta kMaxTempFileAge = base::TimeDelta::FromDays(7);
+
+// Status code of a response to a range request.
+const NSInteger kHttpPartialContent = 206;
+
+// Segments smaller than this are not worth a connection of their own.
+const int64_t kMinSegmentLength = 1024 * 1024;
+
+// Number of consecutive failed requests for a segment, without any data
+// received, after which the download fails.
+const int kMaxSegmentRetryCount = 3;
+
+// The journal is saved each time this amount of data is written.
+const int64_t kJournalSaveInterval = 4 * 1024 * 1024;
+
+// Minimum delay between two progress updates.
+constexpr base::TimeDelta kProgressUpdateInterval =
+    base::TimeDelta::FromMilliseconds(100);
+
+// Called on the delegate queue with data received for |task|.
+using SegmentDataBlock = void (^)(NSURLSessionTask* task, NSData* data);
+// Called on the UI thread when |task| has completed.
+using SegmentCompletionBlock = void (^)(NSURLSessionTask* task,
+                                        NSError* error);
+
+// Returns the index of the segment downloaded by |task|, or -1 if |task| does
+// not download a segment.
+int GetSegmentIndex(NSURLSessionTask* task) {
+  int index = -1;
+  if (!task.taskDescription ||
+      !base::StringToInt(base::SysNSStringToUTF8(task.taskDescription),
+                         &index)) {
+    return -1;
+  }
+  return index;
+}
+
+// Translates |error| to a net error code. Returns net::OK if |error| is nil.
+int GetNetErrorCode(NSError* error, NSURL* url) {
+  int error_code = net::OK;
+  if (error && !web::GetNetErrorFromIOSErrorCode(error.code, &error_code, url))
+    error_code = net::ERR_FAILED;
+  return error_code;
+}
+
+// Returns whether the partially downloaded file can be resumed after the
+// download failed with |net_error|. It can't if the resource changed.
+bool CanResumeAfterError(int net_error) {
+  return net_error != net::ERR_INVALID_RESPONSE;
+}
+
+// Returns the name of the partially downloaded file of the resource at |url|
+// with |validator|, without extension. The name is the same for all the jobs
+// downloading the resource, so that they resume each other.
+std::string GetTempFileName(const GURL& url, const std::string& validator) {
+  const std::string key = url.spec() + '\n' + validator;
+  return base::HexEncode(base::SHA1HashString(key).data(), base::kSHA1Length);
+}
+
+// Names of the partially downloaded files used by a job. The jobs use their
+// files on different sequences.
+struct InUseTempFiles {
+  base::Lock lock;
+  std::set<std::string> names;
+};
+
+InUseTempFiles& GetInUseTempFiles() {
+  static base::NoDestructor<InUseTempFiles> in_use_temp_files;
+  return *in_use_temp_files;
+}
+
+// Marks the files named |name| as used. Returns false if they are already
+// used.
+bool MarkTempFilesInUse(const std::string& name) {
+  InUseTempFiles& in_use = GetInUseTempFiles();
+  base::AutoLock auto_lock(in_use.lock);
+  return in_use.names.insert(name).second;
+}
+
+void UnmarkTempFilesInUse(const std::string& name) {
+  InUseTempFiles& in_use = GetInUseTempFiles();
+  base::AutoLock auto_lock(in_use.lock);
+  in_use.names.erase(name);
+}
+
+// Deletes the files in |directory| last modified before |time|, unless they are
+// used by a job.
+void DeleteTempFilesModifiedBefore(const base::FilePath& directory,
+                                   base::Time time) {
+  base::FileEnumerator enumerator(directory, /*recursive=*/false,
+                                  base::FileEnumerator::FILES);
+  for (base::FilePath path = enumerator.Next(); !path.empty();
+       path = enumerator.Next()) {
+    if (enumerator.GetInfo().GetLastModifiedTime() >= time)
+      continue;
+    const std::string name = path.BaseName().RemoveExtension().AsUTF8Unsafe();
+    if (!MarkTempFilesInUse(name))
+      continue;
+    base::DeleteFile(path);
+    UnmarkTempFilesInUse(name);
+  }
+}
+
+}  // namespace
+
+// NSURLSessionDataDelegate for SegmentedDownloadJob. Only accepts partial
+// content responses, so a server ignoring the requested range does not corrupt
+// the downloaded file.
+@interface CRWSegmentedDownloadSessionDelegate
+    : NSObject <NSURLSessionDataDelegate>
+
+- (instancetype)init NS_UNAVAILABLE;
+- (instancetype)initWithDataBlock:(SegmentDataBlock)dataBlock
+                  completionBlock:(SegmentCompletionBlock)completionBlock
+    NS_DESIGNATED_INITIALIZER;
+
+// Stops calling the blocks.
+- (void)invalidate;
+
+@end
+
+@implementation CRWSegmentedDownloadSessionDelegate {
+  SegmentDataBlock _dataBlock;
+  SegmentCompletionBlock _completionBlock;
+}
+
+- (instancetype)initWithDataBlock:(SegmentDataBlock)dataBlock
+                  completionBlock:(SegmentCompletionBlock)completionBlock {
+  DCHECK(dataBlock);
+  DCHECK(completionBlock);
+  if ((self = [super init])) {
+    _dataBlock = dataBlock;
+    _completionBlock = completionBlock;
+  }
+  return self;
+}
+
+- (void)invalidate {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  _completionBlock = nil;
+}
+
+- (void)URLSession:(NSURLSession*)session
+              dataTask:(NSURLSessionDataTask*)task
+    didReceiveResponse:(NSURLResponse*)response
+     completionHandler:
+         (void (^)(NSURLSessionResponseDisposition))completionHandler {
+  NSHTTPURLResponse* HTTPResponse =
+      base::mac::ObjCCast<NSHTTPURLResponse>(response);
+  completionHandler(HTTPResponse.statusCode == kHttpPartialContent
+                        ? NSURLSessionResponseAllow
+                        : NSURLSessionResponseCancel);
+}
+
+- (void)URLSession:(NSURLSession*)session
+          dataTask:(NSURLSessionDataTask*)task
+    didReceiveData:(NSData*)data {
+  _dataBlock(task, data);
+}
+
+- (void)URLSession:(NSURLSession*)session
+                    task:(NSURLSessionTask*)task
+    didCompleteWithError:(nullable NSError*)error {
+  __weak CRWSegmentedDownloadSessionDelegate* weakSelf = self;
+  base::PostTask(FROM_HERE, {WebThread::UI}, base::BindOnce(^{
+                   CRWSegmentedDownloadSessionDelegate* strongSelf = weakSelf;
+                   if (strongSelf && strongSelf->_completionBlock)
+                     strongSelf->_completionBlock(task, error);
+                 }));
+}
+
+- (void)URLSession:(NSURLSession*)session
+    didReceiveChallenge:(NSURLAuthenticationChallenge*)challenge
+      completionHandler:(void (^)(NSURLSessionAuthChallengeDisposition,
+                                  NSURLCredential* _Nullable))handler {
+  // TODO(crbug.com/780911): use CRWCertVerificationController to get
+  // CertAcceptPolicy for this |challenge|.
+  handler(NSURLSessionAuthChallengeRejectProtectionSpace, nil);
+}
+
+@end
+
+namespace web {
+
+class SegmentedDownloadJob::PendingWrites
+    : public base::RefCountedThreadSafe<PendingWrites> {
+ public:
+  explicit PendingWrites(int64_t max_bytes)
+      : max_bytes_(max_bytes), space_available_(&lock_) {
+    DCHECK_GT(max_bytes_, 0);
+  }
+
+  // Adds |bytes| to the pending data. Blocks the calling thread while the
+  // pending data exceeds the limit. Returns false if the job was stopped, in
+  // which case the data must be dropped.
+  bool Add(int64_t bytes) {
+    base::AutoLock auto_lock(lock_);
+    while (!stopped_ && bytes_ >= max_bytes_)
+      space_available_.Wait();
+    if (stopped_)
+      return false;
+    bytes_ += bytes;
+    return true;
+  }
+
+  // Removes |bytes| written or dropped from the pending data.
+  void Remove(int64_t bytes) {
+    base::AutoLock auto_lock(lock_);
+    bytes_ -= bytes;
+    DCHECK_GE(bytes_, 0);
+    space_available_.Broadcast();
+  }
+
+  // Unblocks Add() and makes it drop the data from now on.
+  void Stop() {
+    base::AutoLock auto_lock(lock_);
+    stopped_ = true;
+    space_available_.Broadcast();
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<PendingWrites>;
+  ~PendingWrites() = default;
+
+  const int64_t max_bytes_;
+  base::Lock lock_;
+  base::ConditionVariable space_available_;
+  int64_t bytes_ = 0;
+  bool stopped_ = false;
+
+  DISALLOW_COPY_AND_ASSIGN(PendingWrites);
+};
+
+struct SegmentedDownloadJob::OpenResult {
+  // net::ERR_NOT_IMPLEMENTED if another job uses the partially downloaded
+  // file of the resource.
+  int net_error = net::OK;
+  base::Optional<DownloadSegmentJournal> journal;
+};
+
+class SegmentedDownloadJob::Core {
+ public:
+  Core(const base::FilePath& temp_directory,
+       const base::FilePath& destination,
+       base::WeakPtr<SegmentedDownloadJob> job)
+      : temp_directory_(temp_directory), destination_(destination), job_(job) {}
+
+  ~Core() {
+    Suspend();
+    if (!name_.empty())
+      UnmarkTempFilesInUse(name_);
+  }
+
+  base::WeakPtr<Core> GetWeakPtr() { return weak_factory_.GetWeakPtr(); }
+
+  // Writes |data| with |core|, if it is still alive, and removes it from
+  // |pending_writes|.
+  static void WriteAndRelease(base::WeakPtr<Core> core,
+                              scoped_refptr<PendingWrites> pending_writes,
+                              size_t index,
+                              NSData* data) {
+    if (core)
+      core->Write(index, data);
+    pending_writes->Remove(data.length);
+  }
+
+  // Opens the partially downloaded file of the resource left by a previous
+  // job if its journal matches, or creates a new one. The journal is nullopt
+  // on failure.
+  OpenResult Open(const GURL& url,
+                  const std::string& validator,
+                  int64_t total_bytes,
+                  int segment_count) {
+    OpenResult result;
+    const std::string name = GetTempFileName(url, validator);
+    if (!MarkTempFilesInUse(name)) {
+      result.net_error = net::ERR_NOT_IMPLEMENTED;
+      return result;
+    }
+    name_ = name;
+    data_path_ = temp_directory_.Append(name_ + ".download");
+    journal_path_ = temp_directory_.Append(name_ + ".journal");
+
+    // Without validator, the resource may have changed since the file was
+    // written.
+    base::Optional<DownloadSegmentJournal> journal =
+        DownloadSegmentJournal::Load(journal_path_);
+    if (!validator.empty() && journal &&
+        journal->Matches(url, validator, total_bytes)) {
+      file_.Initialize(data_path_,
+                       base::File::FLAG_OPEN | base::File::FLAG_WRITE);
+      if (file_.IsValid() && file_.GetLength() == total_bytes) {
+        journal_ = std::move(journal);
+        result.journal = journal_;
+        return result;
+      }
+      file_.Close();
+    }
+
+    // Start from scratch. The file is sparse, only the written ranges use
+    // storage.
+    if (!base::CreateDirectory(temp_directory_))
+      return result;
+    file_.Initialize(data_path_, base::File::FLAG_CREATE_ALWAYS |
+                                     base::File::FLAG_WRITE);
+    if (!file_.IsValid() || !file_.SetLength(total_bytes)) {
+      file_.Close();
+      return result;
+    }
+    journal_ = DownloadSegmentJournal(url, validator, total_bytes,
+                                      segment_count);
+    if (!journal_->Save(journal_path_)) {
+      file_.Close();
+      journal_.reset();
+      return result;
+    }
+    result.journal = journal_;
+    return result;
+  }
+
+  // Writes |data| after the bytes already received for the segment at
+  // |index|.
+  void Write(size_t index, NSData* data) {
+    if (!file_.IsValid() || write_error_ != net::OK)
+      return;
+
+    const DownloadSegmentJournal::Segment& segment =
+        journal_->segments()[index];
+    // Ignore the bytes after the end of the segment.
+    const int64_t length = std::min<int64_t>(
+        data.length, segment.length - segment.received);
+    __block int64_t offset = segment.offset + segment.received;
+    __block int64_t remaining = length;
+    __block bool success = true;
+    [data enumerateByteRangesUsingBlock:^(const void* bytes, NSRange range,
+                                          BOOL* stop) {
+      const int size = static_cast<int>(std::min<int64_t>(range.length,
+                                                          remaining));
+      if (file_.Write(offset, static_cast<const char*>(bytes), size) != size) {
+        success = false;
+        *stop = YES;
+        return;
+      }
+      offset += size;
+      remaining -= size;
+      *stop = remaining == 0;
+    }];
+    if (!success) {
+      write_error_ = net::ERR_FILE_NO_SPACE;
+      return;
+    }
+
+    journal_->OnDataWritten(index, length);
+    unsaved_bytes_ += length;
+    if (unsaved_bytes_ >= kJournalSaveInterval)
+      SaveJournal();
+
+    // The progress is also updated when a segment completes, so that it is
+    // exact while the other segments are stalled.
+    const base::TimeTicks now = base::TimeTicks::Now();
+    if (now - last_progress_update_ >= kProgressUpdateInterval ||
+        segment.IsComplete()) {
+      last_progress_update_ = now;
+      base::PostTask(FROM_HERE, {WebThread::UI},
+                     base::BindOnce(&SegmentedDownloadJob::OnProgress, job_,
+                                    journal_->GetReceivedBytes()));
+    }
+  }
+
+  // Returns the number of bytes written for the segment at |index|, or -1 if
+  // the data could not be written.
+  int64_t GetReceivedBytes(size_t index) const {
+    if (!journal_ || write_error_ != net::OK)
+      return -1;
+    return journal_->segments()[index].received;
+  }
+
+  // Moves the downloaded file to its destination and deletes the journal.
+  int Finish() {
+    if (!journal_ || write_error_ != net::OK)
+      return net::ERR_FILE_NO_SPACE;
+    if (!journal_->IsComplete())
+      return net::ERR_CONTENT_LENGTH_MISMATCH;
+
+    // A later job only has to move the file if it can't be moved now.
+    SaveJournal();
+    file_.Close();
+    journal_.reset();
+    if (!base::ReplaceFile(data_path_, destination_, nullptr))
+      return net::ERR_ACCESS_DENIED;
+    base::DeleteFile(journal_path_);
+    return net::OK;
+  }
+
+  // Saves the journal and closes the file, so that a later job for the same
+  // resource resumes the download.
+  void Suspend() {
+    if (journal_)
+      SaveJournal();
+    file_.Close();
+  }
+
+  // Closes and deletes the partially downloaded file and its journal, if they
+  // were opened.
+  void Delete() {
+    journal_.reset();
+    file_.Close();
+    if (name_.empty())
+      return;
+    base::DeleteFile(data_path_);
+    base::DeleteFile(journal_path_);
+  }
+
+ private:
+  void SaveJournal() {
+    // Make sure the data is on disk before recording it in the journal.
+    file_.Flush();
+    journal_->Save(journal_path_);
+    unsaved_bytes_ = 0;
+  }
+
+  const base::FilePath temp_directory_;
+  const base::FilePath destination_;
+  // Name of the files marked in use by this job, empty until they are opened.
+  std::string name_;
+  base::FilePath data_path_;
+  base::FilePath journal_path_;
+  base::WeakPtr<SegmentedDownloadJob> job_;
+  base::File file_;
+  base::Optional<DownloadSegmentJournal> journal_;
+  int write_error_ = net::OK;
+  int64_t unsaved_bytes_ = 0;
+  base::TimeTicks last_progress_update_;
+  base::WeakPtrFactory<Core> weak_factory_{this};
+
+  DISALLOW_COPY_AND_ASSIGN(Core);
+};
+
+SegmentedDownloadJob::SegmentedDownloadJob(
+    const GURL& url,
+    const base::FilePath& temp_directory,
+    const base::FilePath& destination,
+    int max_segments,
+    int64_t max_pending_write_bytes)
+    : url_(url),
+      max_segments_(max_segments),
+      file_task_runner_(base::ThreadPool::CreateSequencedTaskRunner(
+          {base::MayBlock(), base::TaskPriority::USER_VISIBLE,
+           base::TaskShutdownBehavior::BLOCK_SHUTDOWN})),
+      core_(nullptr, base::OnTaskRunnerDeleter(file_task_runner_)),
+      pending_writes_(
+          base::MakeRefCounted<PendingWrites>(max_pending_write_bytes)) {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  DCHECK_GT(max_segments_, 0);
+  core_.reset(
+      new Core(temp_directory, destination, weak_factory_.GetWeakPtr()));
+}
+
+SegmentedDownloadJob::~SegmentedDownloadJob() {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  [session_delegate_ invalidate];
+  [session_ invalidateAndCancel];
+  pending_writes_->Stop();
+}
+
+// static
+base::FilePath SegmentedDownloadJob::GetTempDirectory() {
+  return base::mac::NSStringToFilePath(NSTemporaryDirectory())
+      .Append(kTempDirectoryName);
+}
+
+// static
+void SegmentedDownloadJob::DeleteStaleFiles(
+    const base::FilePath& temp_directory) {
+  base::ThreadPool::PostTask(
+      FROM_HERE,
+      {base::MayBlock(), base::TaskPriority::BEST_EFFORT,
+       base::TaskShutdownBehavior::CONTINUE_ON_SHUTDOWN},
+      base::BindOnce(&DeleteTempFilesModifiedBefore, temp_directory,
+                     base::Time::Now() - kMaxTempFileAge));
+}
+
+void SegmentedDownloadJob::Start(SessionFactory session_factory,
+                                 ProgressCallback progress_callback,
+                                 CompletionCallback completion_callback) {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  DCHECK(!session_);
+  progress_callback_ = std::move(progress_callback);
+  completion_callback_ = std::move(completion_callback);
+
+  // Data is passed straight from the delegate queue to the file sequence.
+  // The delegate queue waits when the file sequence falls behind, which stops
+  // reading from the network.
+  scoped_refptr<base::SequencedTaskRunner> file_task_runner =
+      file_task_runner_;
+  scoped_refptr<PendingWrites> pending_writes = pending_writes_;
+  base::WeakPtr<Core> core = core_->GetWeakPtr();
+  base::WeakPtr<SegmentedDownloadJob> weak_this = weak_factory_.GetWeakPtr();
+  session_delegate_ = [[CRWSegmentedDownloadSessionDelegate alloc]
+      initWithDataBlock:^(NSURLSessionTask* task, NSData* data) {
+        int index = GetSegmentIndex(task);
+        if (index < 0 || !pending_writes->Add(data.length))
+          return;
+        file_task_runner->PostTask(
+            FROM_HERE, base::BindOnce(&Core::WriteAndRelease, core,
+                                      pending_writes, index, data));
+      }
+      completionBlock:^(NSURLSessionTask* task, NSError* error) {
+        if (weak_this)
+          weak_this->OnTaskCompleted(task, error);
+      }];
+  session_ = std::move(session_factory).Run(session_delegate_);
+
+  // Probe the server with a single byte range request.
+  NSMutableURLRequest* request =
+      [[NSMutableURLRequest alloc] initWithURL:net::NSURLWithGURL(url_)];
+  [request setValue:@"bytes=0-0" forHTTPHeaderField:@"Range"];
+  probe_task_ = [session_ dataTaskWithRequest:request];
+  [probe_task_ resume];
+}
+
+void SegmentedDownloadJob::OnTaskCompleted(NSURLSessionTask* task,
+                                           NSError* error) {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  if (!completion_callback_)
+    return;
+
+  if (task == probe_task_) {
+    probe_task_ = nil;
+    OnProbeCompleted(task, error);
+    return;
+  }
+
+  const int index = GetSegmentIndex(task);
+  if (index < 0 || static_cast<size_t>(index) >= segments_.size() ||
+      segments_[index].task != task) {
+    return;
+  }
+  segments_[index].task = nil;
+
+  NSHTTPURLResponse* response =
+      base::mac::ObjCCast<NSHTTPURLResponse>(task.response);
+  if (response && response.statusCode != kHttpPartialContent) {
+    // The resource changed since the download started.
+    Fail(net::ERR_INVALID_RESPONSE);
+    return;
+  }
+
+  // Writes for |task| are all posted to the file sequence by now, so the
+  // reply has the final size of the segment.
+  const int net_error = GetNetErrorCode(error, task.currentRequest.URL);
+  base::PostTaskAndReplyWithResult(
+      file_task_runner_.get(), FROM_HERE,
+      base::BindOnce(&Core::GetReceivedBytes, core_->GetWeakPtr(), index),
+      base::BindOnce(&SegmentedDownloadJob::OnSegmentTaskCompleted,
+                     weak_factory_.GetWeakPtr(), index, net_error));
+}
+
+void SegmentedDownloadJob::OnProbeCompleted(NSURLSessionTask* task,
+                                            NSError* error) {
+  NSHTTPURLResponse* response =
+      base::mac::ObjCCast<NSHTTPURLResponse>(task.response);
+  if (!response) {
+    Fail(GetNetErrorCode(error, task.currentRequest.URL));
+    return;
+  }
+
+  http_code_ = response.statusCode;
+  if (response.MIMEType)
+    mime_type_ = base::SysNSStringToUTF8(response.MIMEType);
+
+  scoped_refptr<net::HttpResponseHeaders> headers =
+      net::CreateHeadersFromNSHTTPURLResponse(response);
+  int64_t first_byte = 0;
+  int64_t last_byte = 0;
+  std::string accept_ranges;
+  headers->GetNormalizedHeader("Accept-Ranges", &accept_ranges);
+  if (response.statusCode != kHttpPartialContent ||
+      base::EqualsCaseInsensitiveASCII(accept_ranges, "none") ||
+      !headers->GetContentRangeFor206(&first_byte, &last_byte,
+                                      &total_bytes_) ||
+      total_bytes_ <= 0) {
+    std::move(completion_callback_).Run(net::ERR_NOT_IMPLEMENTED);
+    return;
+  }
+
+  // Only a strong ETag guarantees that the bytes did not change.
+  std::string etag;
+  if (headers->GetNormalizedHeader("ETag", &etag) &&
+      !base::StartsWith(etag, "W/", base::CompareCase::SENSITIVE)) {
+    validator_ = etag;
+  } else {
+    headers->GetNormalizedHeader("Last-Modified", &validator_);
+  }
+
+  const int segment_count = static_cast<int>(std::max<int64_t>(
+      1, std::min<int64_t>(max_segments_, total_bytes_ / kMinSegmentLength)));
+  base::PostTaskAndReplyWithResult(
+      file_task_runner_.get(), FROM_HERE,
+      base::BindOnce(&Core::Open, core_->GetWeakPtr(), url_, validator_,
+                     total_bytes_, segment_count),
+      base::BindOnce(&SegmentedDownloadJob::OnFileOpened,
+                     weak_factory_.GetWeakPtr()));
+}
+
+void SegmentedDownloadJob::OnFileOpened(OpenResult result) {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  if (!completion_callback_)
+    return;
+  if (result.net_error != net::OK) {
+    Fail(result.net_error);
+    return;
+  }
+  if (!result.journal) {
+    Fail(net::ERR_FILE_NO_SPACE);
+    return;
+  }
+  const DownloadSegmentJournal& journal = *result.journal;
+
+  progress_callback_.Run(journal.GetReceivedBytes(), total_bytes_);
+  for (const DownloadSegmentJournal::Segment& journal_segment :
+       journal.segments()) {
+    Segment segment;
+    segment.offset = journal_segment.offset;
+    segment.length = journal_segment.length;
+    segment.received = journal_segment.received;
+    segment.complete = journal_segment.IsComplete();
+    segments_.push_back(segment);
+  }
+
+  if (journal.IsComplete()) {
+    OnSegmentTaskCompleted(0, net::OK, segments_[0].length);
+    return;
+  }
+  for (size_t index = 0; index < segments_.size(); index++) {
+    if (!segments_[index].complete)
+      StartSegmentTask(index, segments_[index].received);
+  }
+}
+
+void SegmentedDownloadJob::StartSegmentTask(size_t index, int64_t received) {
+  Segment& segment = segments_[index];
+  segment.received = received;
+
+  NSMutableURLRequest* request =
+      [[NSMutableURLRequest alloc] initWithURL:net::NSURLWithGURL(url_)];
+  std::string range = base::StringPrintf(
+      "bytes=%lld-%lld", static_cast<long long>(segment.offset + received),
+      static_cast<long long>(segment.offset + segment.length - 1));
+  [request setValue:base::SysUTF8ToNSString(range)
+      forHTTPHeaderField:@"Range"];
+  if (!validator_.empty()) {
+    // The server returns the whole resource, which is rejected, if it
+    // changed.
+    [request setValue:base::SysUTF8ToNSString(validator_)
+        forHTTPHeaderField:@"If-Range"];
+  }
+
+  segment.task = [session_ dataTaskWithRequest:request];
+  segment.task.taskDescription = base::SysUTF8ToNSString(
+      base::NumberToString(index));
+  [segment.task resume];
+}
+
+void SegmentedDownloadJob::OnSegmentTaskCompleted(size_t index,
+                                                  int net_error,
+                                                  int64_t received) {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  if (!completion_callback_)
+    return;
+  if (received < 0) {
+    Fail(net::ERR_FILE_NO_SPACE);
+    return;
+  }
+
+  Segment& segment = segments_[index];
+  if (received >= segment.length) {
+    segment.complete = true;
+    const bool all_complete =
+        std::all_of(segments_.begin(), segments_.end(),
+                    [](const Segment& segment) { return segment.complete; });
+    if (all_complete) {
+      [session_ finishTasksAndInvalidate];
+      base::PostTaskAndReplyWithResult(
+          file_task_runner_.get(), FROM_HERE,
+          base::BindOnce(&Core::Finish, core_->GetWeakPtr()),
+          base::BindOnce(&SegmentedDownloadJob::OnFinished,
+                         weak_factory_.GetWeakPtr()));
+    }
+    return;
+  }
+
+  // The connection dropped or the server closed it early. Request the rest of
+  // the segment, unless the previous attempts did not get any data.
+  segment.retry_count =
+      received > segment.received ? 0 : segment.retry_count + 1;
+  if (segment.retry_count > kMaxSegmentRetryCount) {
+    Fail(net_error == net::OK ? net::ERR_CONTENT_LENGTH_MISMATCH : net_error);
+    return;
+  }
+  StartSegmentTask(index, received);
+}
+
+void SegmentedDownloadJob::OnProgress(int64_t received_bytes) {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  if (completion_callback_)
+    progress_callback_.Run(received_bytes, total_bytes_);
+}
+
+void SegmentedDownloadJob::Cancel() {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  Stop(/*delete_files=*/false);
+  completion_callback_.Reset();
+}
+
+void SegmentedDownloadJob::Stop(bool delete_files) {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  [session_delegate_ invalidate];
+  [session_ invalidateAndCancel];
+  session_ = nil;
+  pending_writes_->Stop();
+  // The data received so far is already posted to the file sequence.
+  file_task_runner_->PostTask(
+      FROM_HERE, delete_files
+                     ? base::BindOnce(&Core::Delete, core_->GetWeakPtr())
+                     : base::BindOnce(&Core::Suspend, core_->GetWeakPtr()));
+}
+
+void SegmentedDownloadJob::Fail(int net_error) {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  DCHECK_NE(net::OK, net_error);
+  Stop(/*delete_files=*/!CanResumeAfterError(net_error));
+  std::move(completion_callback_).Run(net_error);
+}
+
+void SegmentedDownloadJob::OnFinished(int net_error) {
+  DCHECK_CURRENTLY_ON(WebThread::UI);
+  if (!completion_callback_)
+    return;
+  // On failure, the file is kept with its journal, so that the next job for
+  // the resource resumes it.
+  if (net_error == net::OK)
+    progress_callback_.Run(total_bytes_, total_bytes_);
+  std::move(completion_callback_).Run(net_error);
+}
+
+}  // namespace web
@@ -0,0 +1,89 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef IOS_WEB_JS_MESSAGING_PAGE_SCRIPT_CACHE_H_
+#define IOS_WEB_JS_MESSAGING_PAGE_SCRIPT_CACHE_H_
+
+#import <Foundation/Foundation.h>
+
+#include <stdint.h>
+
+#include "base/macros.h"
+#include "base/no_destructor.h"
+
+namespace web {
+
+// Name of UMA histogram to log whether a page script was returned from the
+// cache, for each lookup.
+extern const char kPageScriptCacheHit[];
+
+// Name of UMA histogram to log the size, in bytes, of each page script returned
+// from the cache, i.e. the bytes that were not read from disk or copied to
+// compose the script again.
+extern const char kPageScriptCacheBytesSaved[];
+
+// Process-wide cache of the page scripts injected in the web views. It keeps
+// the content of the bundled script resources, so that each of them is read
+// from disk once, and the scripts composed from them, so that they are not
+// composed again while their inputs, e.g. the embedder scripts or the cookie
+// blocking mode of a browser state, don't change.
+//
+// Must be used on the main thread.
+class PageScriptCache {
+ public:
+  // Statistics of the cache since it was created or cleared.
+  struct Stats {
+    // Number of scripts returned from the cache.
+    int hit_count = 0;
+    // Number of scripts that had to be loaded or composed.
+    int miss_count = 0;
+    // Size of the scripts returned from the cache, i.e. the bytes that were
+    // not read from disk or copied to compose a script again.
+    int64_t bytes_saved = 0;
+  };
+
+  static PageScriptCache* GetInstance();
+
+  // Returns the content of the bundled resource |script_file_name|, which is
+  // loaded with |load| the first time.
+  NSString* GetResource(NSString* script_file_name, NSString* (^load)(void));
+
+  // Returns the script identified by |script_identifier| composed from
+  // |inputs|. The script is composed with |compose| the first time, or if the
+  // script was composed from different |inputs|.
+  NSString* GetComposedScript(NSString* script_identifier,
+                              NSArray<NSString*>* inputs,
+                              NSString* (^compose)(void));
+
+  const Stats& stats() const { return stats_; }
+
+  // Drops all the scripts and resets the statistics.
+  void Clear();
+
+ private:
+  friend class base::NoDestructor<PageScriptCache>;
+
+  PageScriptCache();
+  ~PageScriptCache();
+
+  // Updates the statistics for a script returned from the cache.
+  void RecordHit(NSString* script);
+
+  // Updates the statistics for a script that had to be loaded or composed.
+  void RecordMiss();
+
+  // Content of the bundled resources, by name.
+  NSMutableDictionary<NSString*, NSString*>* resources_;
+  // Composed scripts, by identifier and by inputs.
+  NSMutableDictionary<NSString*,
+                      NSMutableDictionary<NSArray<NSString*>*, NSString*>*>*
+      composed_scripts_;
+  Stats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(PageScriptCache);
+};
+
+}  // namespace web
+
+#endif  // IOS_WEB_JS_MESSAGING_PAGE_SCRIPT_CACHE_H_
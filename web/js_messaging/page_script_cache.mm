@@ -0,0 +1,100 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/web/js_messaging/page_script_cache.h"
+
+#include "base/check.h"
+#include "base/metrics/histogram_functions.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace web {
+
+namespace {
+
+// Maximum number of sets of inputs for which a script is kept. A script
+// usually has one set of inputs per browser state, but is never recomposed for
+// the previous inputs once the embedder script changed.
+const NSUInteger kMaxComposedScriptsPerIdentifier = 4;
+
+}  // namespace
+
+const char kPageScriptCacheHit[] = "IOS.PageScriptCache.Hit";
+const char kPageScriptCacheBytesSaved[] = "IOS.PageScriptCache.BytesSaved";
+
+// static
+PageScriptCache* PageScriptCache::GetInstance() {
+  static base::NoDestructor<PageScriptCache> instance;
+  return instance.get();
+}
+
+PageScriptCache::PageScriptCache()
+    : resources_([NSMutableDictionary dictionary]),
+      composed_scripts_([NSMutableDictionary dictionary]) {}
+
+PageScriptCache::~PageScriptCache() = default;
+
+NSString* PageScriptCache::GetResource(NSString* script_file_name,
+                                       NSString* (^load)(void)) {
+  DCHECK([NSThread isMainThread]);
+  NSString* script = resources_[script_file_name];
+  if (script) {
+    RecordHit(script);
+    return script;
+  }
+
+  RecordMiss();
+  script = [load() copy];
+  if (script)
+    resources_[script_file_name] = script;
+  return script;
+}
+
+NSString* PageScriptCache::GetComposedScript(NSString* script_identifier,
+                                             NSArray<NSString*>* inputs,
+                                             NSString* (^compose)(void)) {
+  DCHECK([NSThread isMainThread]);
+  NSMutableDictionary<NSArray<NSString*>*, NSString*>* scripts =
+      composed_scripts_[script_identifier];
+  NSString* script = scripts[inputs];
+  if (script) {
+    RecordHit(script);
+    return script;
+  }
+
+  RecordMiss();
+  script = [compose() copy];
+  if (!scripts) {
+    scripts = [NSMutableDictionary dictionary];
+    composed_scripts_[script_identifier] = scripts;
+  } else if (scripts.count >= kMaxComposedScriptsPerIdentifier) {
+    [scripts removeAllObjects];
+  }
+  scripts[[inputs copy]] = script;
+  return script;
+}
+
+void PageScriptCache::Clear() {
+  DCHECK([NSThread isMainThread]);
+  [resources_ removeAllObjects];
+  [composed_scripts_ removeAllObjects];
+  stats_ = Stats();
+}
+
+void PageScriptCache::RecordHit(NSString* script) {
+  const int64_t bytes_saved = script.length * sizeof(unichar);
+  stats_.hit_count++;
+  stats_.bytes_saved += bytes_saved;
+  base::UmaHistogramBoolean(kPageScriptCacheHit, true);
+  base::UmaHistogramCounts1M(kPageScriptCacheBytesSaved, bytes_saved);
+}
+
+void PageScriptCache::RecordMiss() {
+  stats_.miss_count++;
+  base::UmaHistogramBoolean(kPageScriptCacheHit, false);
+}
+
+}  // namespace web
@@ -0,0 +1,79 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import <Foundation/Foundation.h>
+
+#include <memory>
+
+#include "base/test/scoped_feature_list.h"
+#include "base/timer/elapsed_timer.h"
+#include "ios/web/common/features.h"
+#import "ios/web/js_messaging/page_script_cache.h"
+#include "ios/web/public/test/fakes/test_browser_state.h"
+#include "ios/web/public/test/web_test.h"
+#import "ios/web/public/web_state.h"
+#import "ios/web/web_state/ui/wk_web_view_configuration_provider.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace web {
+
+namespace {
+
+// Number of WebStates created for each measure.
+const int kRepeatCount = 20;
+
+// Returns the reporter for the story with or without the cache.
+perf_test::PerfResultReporter GetReporter(bool cached) {
+  perf_test::PerfResultReporter reporter(
+      "PageScriptCache", cached ? "cached_scripts" : "uncached_scripts");
+  reporter.RegisterImportantMetric("web_state_creation_time", "us");
+  reporter.RegisterImportantMetric("cache_hits", "count");
+  reporter.RegisterImportantMetric("bytes_saved", "bytes");
+  return reporter;
+}
+
+}  // namespace
+
+using PageScriptCachePerfTest = WebTest;
+
+// Measures the time to create a WebState and the configuration of its web
+// view, with its user scripts, in a new browser state, with and without the
+// page script cache.
+TEST_F(PageScriptCachePerfTest, WebStateCreation) {
+  for (bool cached : {false, true}) {
+    base::test::ScopedFeatureList feature_list;
+    feature_list.InitWithFeatureState(features::kCachePageScripts, cached);
+    PageScriptCache::GetInstance()->Clear();
+
+    base::TimeDelta total_time;
+    for (int i = 0; i < kRepeatCount; i++) {
+      // Each browser state has its own configuration, so its user scripts are
+      // created with the first WebState.
+      auto browser_state = std::make_unique<TestBrowserState>();
+      base::ElapsedTimer timer;
+      std::unique_ptr<WebState> web_state =
+          WebState::Create(WebState::CreateParams(browser_state.get()));
+      EXPECT_TRUE(WKWebViewConfigurationProvider::FromBrowserState(
+                      browser_state.get())
+                      .GetWebViewConfiguration());
+      total_time += timer.Elapsed();
+    }
+
+    const PageScriptCache::Stats& stats =
+        PageScriptCache::GetInstance()->stats();
+    perf_test::PerfResultReporter reporter = GetReporter(cached);
+    reporter.AddResult("web_state_creation_time",
+                       total_time.InMicrosecondsF() / kRepeatCount);
+    reporter.AddResult("cache_hits", static_cast<size_t>(stats.hit_count));
+    reporter.AddResult("bytes_saved", static_cast<size_t>(stats.bytes_saved));
+  }
+  PageScriptCache::GetInstance()->Clear();
+}
+
+}  // namespace web
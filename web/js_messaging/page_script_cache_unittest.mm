@@ -0,0 +1,98 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/web/js_messaging/page_script_cache.h"
+
+#include "base/test/metrics/histogram_tester.h"
+#import "testing/gtest_mac.h"
+#include "testing/platform_test.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace web {
+
+class PageScriptCacheTest : public PlatformTest {
+ protected:
+  PageScriptCacheTest() { cache_->Clear(); }
+  ~PageScriptCacheTest() override { cache_->Clear(); }
+
+  PageScriptCache* cache_ = PageScriptCache::GetInstance();
+};
+
+// Tests that a resource is loaded once.
+TEST_F(PageScriptCacheTest, Resource) {
+  base::HistogramTester histogram_tester;
+  __block int load_count = 0;
+  NSString* (^load)(void) = ^{
+    load_count++;
+    return @"script";
+  };
+
+  EXPECT_NSEQ(@"script", cache_->GetResource(@"resource", load));
+  EXPECT_NSEQ(@"script", cache_->GetResource(@"resource", load));
+  EXPECT_EQ(1, load_count);
+  EXPECT_NSEQ(@"other", cache_->GetResource(@"other_resource", ^{
+    return @"other";
+  }));
+
+  EXPECT_EQ(1, cache_->stats().hit_count);
+  EXPECT_EQ(2, cache_->stats().miss_count);
+  EXPECT_EQ(static_cast<int64_t>(6 * sizeof(unichar)),
+            cache_->stats().bytes_saved);
+  histogram_tester.ExpectBucketCount(kPageScriptCacheHit, true, 1);
+  histogram_tester.ExpectBucketCount(kPageScriptCacheHit, false, 2);
+  histogram_tester.ExpectUniqueSample(kPageScriptCacheBytesSaved,
+                                      6 * sizeof(unichar), 1);
+}
+
+// Tests that a composed script is composed again only when its inputs change.
+TEST_F(PageScriptCacheTest, ComposedScript) {
+  __block int compose_count = 0;
+  __block NSString* input = @"a";
+  NSString* (^get_script)(void) = ^{
+    return cache_->GetComposedScript(@"script", @[ input ], ^{
+      compose_count++;
+      return [@"composed " stringByAppendingString:input];
+    });
+  };
+
+  EXPECT_NSEQ(@"composed a", get_script());
+  EXPECT_NSEQ(@"composed a", get_script());
+  EXPECT_EQ(1, compose_count);
+
+  input = @"b";
+  EXPECT_NSEQ(@"composed b", get_script());
+  EXPECT_EQ(2, compose_count);
+
+  // The script composed from the previous inputs is still cached.
+  input = @"a";
+  EXPECT_NSEQ(@"composed a", get_script());
+  EXPECT_EQ(2, compose_count);
+
+  EXPECT_EQ(2, cache_->stats().hit_count);
+  EXPECT_EQ(2, cache_->stats().miss_count);
+}
+
+// Tests that clearing the cache drops the scripts and the statistics.
+TEST_F(PageScriptCacheTest, Clear) {
+  __block int load_count = 0;
+  NSString* (^load)(void) = ^{
+    load_count++;
+    return @"script";
+  };
+  cache_->GetResource(@"resource", load);
+  cache_->GetResource(@"resource", load);
+
+  cache_->Clear();
+  EXPECT_EQ(0, cache_->stats().hit_count);
+  EXPECT_EQ(0, cache_->stats().miss_count);
+  EXPECT_EQ(0, cache_->stats().bytes_saved);
+
+  cache_->GetResource(@"resource", load);
+  EXPECT_EQ(2, load_count);
+}
+
+}  // namespace web
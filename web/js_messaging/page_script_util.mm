@@ -4,10 +4,13 @@
 
 #import "ios/web/js_messaging/page_script_util.h"
 
+#include "base/feature_list.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
 #include "base/mac/bundle_locations.h"
 #include "base/strings/sys_string_conversions.h"
+#include "ios/web/common/features.h"
+#import "ios/web/js_messaging/page_script_cache.h"
 #include "ios/web/public/browser_state.h"
 #include "ios/web/public/browsing_data/cookie_blocking_mode.h"
 #import "ios/web/public/web_client.h"
@@ -51,12 +54,9 @@ NSString* EscapedQuotedString(NSString* string) {
   return [string stringByReplacingOccurrencesOfString:@"'" withString:@"\\'"];
 }
 
-}  // namespace
-
-namespace web {
-
-NSString* GetPageScript(NSString* script_file_name) {
-  DCHECK(script_file_name);
+// Returns the JavaScript loaded from the bundled resource file with the given
+// name (excluding extension).
+NSString* LoadPageScript(NSString* script_file_name) {
   NSString* path =
       [base::mac::FrameworkBundle() pathForResource:script_file_name
                                              ofType:@"js"];
@@ -72,23 +72,54 @@ NSString* GetPageScript(NSString* script_file_name) {
   return content;
 }
 
+// Returns the script identified by |script_identifier|, composed by |compose|
+// from |inputs|. The script is wrapped to be injected only once, using
+// |script_identifier| as the prefix of its JavaScript var. It is reused while
+// |inputs| don't change if the page scripts are cached.
+NSString* GetInjectableOnceScript(NSString* script_identifier,
+                                  NSArray<NSString*>* inputs,
+                                  NSString* (^compose)(void)) {
+  NSString* (^compose_injectable_once)(void) = ^{
+    return MakeScriptInjectableOnce(script_identifier, compose());
+  };
+  if (!base::FeatureList::IsEnabled(web::features::kCachePageScripts))
+    return compose_injectable_once();
+  return web::PageScriptCache::GetInstance()->GetComposedScript(
+      script_identifier, inputs, compose_injectable_once);
+}
+
+}  // namespace
+
+namespace web {
+
+NSString* GetPageScript(NSString* script_file_name) {
+  DCHECK(script_file_name);
+  if (!base::FeatureList::IsEnabled(features::kCachePageScripts))
+    return LoadPageScript(script_file_name);
+  return PageScriptCache::GetInstance()->GetResource(script_file_name, ^{
+    return LoadPageScript(script_file_name);
+  });
+}
+
 NSString* GetDocumentStartScriptForMainFrame(BrowserState* browser_state) {
   DCHECK(GetWebClient());
   NSString* embedder_page_script =
       GetWebClient()->GetDocumentStartScriptForMainFrame(browser_state);
   DCHECK(embedder_page_script);
 
-  NSString* web_bundle = GetPageScript(@"main_frame_web_bundle");
-  DCHECK(web_bundle);
-
-  NSString* script =
-      [NSString stringWithFormat:@"%@; %@", web_bundle, embedder_page_script];
-  return MakeScriptInjectableOnce(@"start_main_frame", script);
+  return GetInjectableOnceScript(
+      @"start_main_frame", @[ embedder_page_script ], ^{
+        NSString* web_bundle = GetPageScript(@"main_frame_web_bundle");
+        DCHECK(web_bundle);
+        return [NSString
+            stringWithFormat:@"%@; %@", web_bundle, embedder_page_script];
+      });
 }
 
 NSString* GetDocumentEndScriptForMainFrame(BrowserState* browser_state) {
-  NSString* script = GetPageScript(@"main_frame_document_end_web_bundle");
-  return MakeScriptInjectableOnce(@"end_main_frame", script);
+  return GetInjectableOnceScript(@"end_main_frame", @[], ^{
+    return GetPageScript(@"main_frame_document_end_web_bundle");
+  });
 }
 
 NSString* GetDocumentStartScriptForAllFrames(BrowserState* browser_state) {
@@ -96,7 +127,6 @@ NSString* GetDocumentStartScriptForAllFrames(BrowserState* browser_state) {
   NSString* embedder_page_script =
       GetWebClient()->GetDocumentStartScriptForAllFrames(browser_state);
   DCHECK(embedder_page_script);
-  NSString* web_bundle = GetPageScript(@"all_frames_web_bundle");
   NSString* injectedCookieState = @"allow";
   switch (browser_state->GetCookieBlockingMode()) {
     case CookieBlockingMode::kBlock:
@@ -109,24 +139,27 @@ NSString* GetDocumentStartScriptForAllFrames(BrowserState* browser_state) {
       injectedCookieState = @"allow";
       break;
   }
-  web_bundle =
-      [web_bundle stringByReplacingOccurrencesOfString:@"$(COOKIE_STATE)"
-                                            withString:injectedCookieState];
-  NSString* script =
-      [NSString stringWithFormat:@"%@; %@", web_bundle, embedder_page_script];
-  return MakeScriptInjectableOnce(@"start_all_frames", script);
+  return GetInjectableOnceScript(
+      @"start_all_frames", @[ embedder_page_script, injectedCookieState ], ^{
+        NSString* web_bundle = [GetPageScript(@"all_frames_web_bundle")
+            stringByReplacingOccurrencesOfString:@"$(COOKIE_STATE)"
+                                      withString:injectedCookieState];
+        return [NSString
+            stringWithFormat:@"%@; %@", web_bundle, embedder_page_script];
+      });
 }
 
 NSString* GetDocumentEndScriptForAllFrames(BrowserState* browser_state) {
   NSString* plugin_not_supported_text =
       base::SysUTF16ToNSString(GetWebClient()->GetPluginNotSupportedText());
 
-  NSString* script = [GetPageScript(@"all_frames_document_end_web_bundle")
-      stringByReplacingOccurrencesOfString:@"$(PLUGIN_NOT_SUPPORTED_TEXT)"
-                                withString:EscapedQuotedString(
-                                               plugin_not_supported_text)];
-
-  return MakeScriptInjectableOnce(@"end_all_frames", script);
+  return GetInjectableOnceScript(
+      @"end_all_frames", @[ plugin_not_supported_text ], ^{
+        NSString* escaped_text = EscapedQuotedString(plugin_not_supported_text);
+        return [GetPageScript(@"all_frames_document_end_web_bundle")
+            stringByReplacingOccurrencesOfString:@"$(PLUGIN_NOT_SUPPORTED_TEXT)"
+                                      withString:escaped_text];
+      });
 }
 
 }  // namespace web
@@ -10,7 +10,10 @@
 
 #include "base/strings/sys_string_conversions.h"
 #import "base/test/ios/wait_util.h"
+#include "base/test/scoped_feature_list.h"
+#include "ios/web/common/features.h"
 #import "ios/web/common/web_view_creation_util.h"
+#import "ios/web/js_messaging/page_script_cache.h"
 #include "ios/web/public/browsing_data/cookie_blocking_mode.h"
 #include "ios/web/public/test/fakes/test_browser_state.h"
 #import "ios/web/public/test/fakes/test_web_client.h"
@@ -59,6 +62,27 @@ TEST_F(PageScriptUtilTest, WKEmbedderScript) {
               test::ExecuteJavaScript(web_view, @"typeof __gCrEmbedder"));
 }
 
+// Tests that the cached scripts are reused, and composed again when the
+// embedder script changes.
+TEST_F(PageScriptUtilTest, CachedScripts) {
+  base::test::ScopedFeatureList feature_list;
+  feature_list.InitAndEnableFeature(features::kCachePageScripts);
+  PageScriptCache::GetInstance()->Clear();
+
+  GetWebClient()->SetEarlyPageScript(@"__gCrEmbedder = 1;");
+  NSString* script = GetDocumentStartScriptForMainFrame(GetBrowserState());
+  EXPECT_EQ(script, GetDocumentStartScriptForMainFrame(GetBrowserState()));
+  EXPECT_LT(0, PageScriptCache::GetInstance()->stats().hit_count);
+
+  GetWebClient()->SetEarlyPageScript(@"__gCrEmbedder = 2;");
+  NSString* updated_script =
+      GetDocumentStartScriptForMainFrame(GetBrowserState());
+  EXPECT_NSNE(script, updated_script);
+  EXPECT_LT(0U, [updated_script rangeOfString:@"__gCrEmbedder = 2;"].length);
+
+  PageScriptCache::GetInstance()->Clear();
+}
+
 // Tests that the correct replacement has been made for the cookie blocking
 // state in the DocumentStartScriptForAllFrames.
 TEST_F(PageScriptUtilTest, AllFrameStartCookieReplacement) {
@@ -0,0 +1,153 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import <Foundation/Foundation.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversions.h"
+#import "base/test/ios/wait_util.h"
+#include "base/test/scoped_feature_list.h"
+#include "base/timer/elapsed_timer.h"
+#include "ios/web/common/features.h"
+#import "ios/web/navigation/navigation_item_impl.h"
+#import "ios/web/navigation/wk_navigation_util.h"
+#import "ios/web/public/navigation/navigation_manager.h"
+#import "ios/web/public/session/crw_navigation_item_storage.h"
+#import "ios/web/public/session/crw_session_storage.h"
+#import "ios/web/public/test/web_test_with_web_state.h"
+#import "ios/web/public/web_state.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+using base::test::ios::kWaitForPageLoadTimeout;
+using base::test::ios::WaitUntilConditionOrTimeout;
+
+namespace web {
+
+namespace {
+
+// Number of entries in the restored history.
+const int kHistorySize = 50;
+
+// Number of times each measure is repeated.
+const int kRepeatCount = 10;
+
+// Returns the URL of the entry at |index| of the restored history. Entries are
+// grouped by site, like a typical browsing history.
+GURL GetHistoryUrl(int index) {
+  return GURL(base::StringPrintf(
+      "https://www.site%d.test/articles/2020/10/article-%d.html?ref=home",
+      index / 10, index));
+}
+
+// Returns the title of the entry at |index| of the restored history.
+base::string16 GetHistoryTitle(int index) {
+  return base::ASCIIToUTF16(
+      base::StringPrintf("A long title for the article number %d", index));
+}
+
+// Returns the reporter for the story of the given encoding.
+perf_test::PerfResultReporter GetReporter(bool compact) {
+  perf_test::PerfResultReporter reporter(
+      "SessionRestore", compact ? "compact_encoding" : "legacy_encoding");
+  reporter.RegisterImportantMetric("url_length", "bytes");
+  reporter.RegisterImportantMetric("url_creation_time", "us");
+  reporter.RegisterImportantMetric("restore_time", "ms");
+  return reporter;
+}
+
+}  // namespace
+
+// Compares the restoration of a session history with the compact
+// restore_session.html URL encoding and with the legacy one.
+class SessionRestorePerfTest : public WebTestWithWebState {
+ protected:
+  // Enables the compact encoding if |compact| is true.
+  void SetCompactEncoding(bool compact) {
+    feature_list_.reset();
+    feature_list_ = std::make_unique<base::test::ScopedFeatureList>();
+    feature_list_->InitWithFeatureState(
+        features::kCompactRestoreSessionEncoding, compact);
+  }
+
+  // Restores a session of kHistorySize entries in a new WebState and returns
+  // the time until the restoration is over.
+  base::TimeDelta MeasureRestore() {
+    NSMutableArray<CRWNavigationItemStorage*>* item_storages =
+        [NSMutableArray arrayWithCapacity:kHistorySize];
+    for (int i = 0; i < kHistorySize; i++) {
+      CRWNavigationItemStorage* item = [[CRWNavigationItemStorage alloc] init];
+      item.URL = GetHistoryUrl(i);
+      item.title = GetHistoryTitle(i);
+      [item_storages addObject:item];
+    }
+    CRWSessionStorage* session_storage = [[CRWSessionStorage alloc] init];
+    session_storage.itemStorages = item_storages;
+    session_storage.lastCommittedItemIndex = kHistorySize - 1;
+    session_storage.userAgentType = UserAgentType::MOBILE;
+
+    base::ElapsedTimer timer;
+    WebState::CreateParams params(GetBrowserState());
+    std::unique_ptr<WebState> web_state =
+        WebState::CreateWithStorageSession(params, session_storage);
+    web_state->SetKeepRenderProcessAlive(true);
+    NavigationManager* navigation_manager = web_state->GetNavigationManager();
+    navigation_manager->LoadIfNecessary();
+    EXPECT_TRUE(WaitUntilConditionOrTimeout(kWaitForPageLoadTimeout, ^{
+      return navigation_manager->GetItemCount() == kHistorySize &&
+             !navigation_manager->IsRestoreSessionInProgress();
+    }));
+    return timer.Elapsed();
+  }
+
+  std::unique_ptr<base::test::ScopedFeatureList> feature_list_;
+};
+
+// Measures the size and the creation time of the restore_session.html URL.
+TEST_F(SessionRestorePerfTest, CreateRestoreSessionUrl) {
+  std::vector<std::unique_ptr<NavigationItem>> items;
+  for (int i = 0; i < kHistorySize; i++) {
+    auto item = std::make_unique<NavigationItemImpl>();
+    item->SetURL(GetHistoryUrl(i));
+    item->SetTitle(GetHistoryTitle(i));
+    items.push_back(std::move(item));
+  }
+
+  for (bool compact : {false, true}) {
+    SetCompactEncoding(compact);
+    GURL url;
+    int first_index = 0;
+    base::ElapsedTimer timer;
+    for (int i = 0; i < kRepeatCount; i++) {
+      wk_navigation_util::CreateRestoreSessionUrl(kHistorySize - 1, items,
+                                                  &url, &first_index);
+    }
+    perf_test::PerfResultReporter reporter = GetReporter(compact);
+    reporter.AddResult("url_creation_time",
+                       timer.Elapsed().InMicrosecondsF() / kRepeatCount);
+    reporter.AddResult("url_length", static_cast<size_t>(url.spec().size()));
+  }
+}
+
+// Measures the time to restore a session history in a web view.
+TEST_F(SessionRestorePerfTest, Restore) {
+  for (bool compact : {false, true}) {
+    SetCompactEncoding(compact);
+    base::TimeDelta total_time;
+    for (int i = 0; i < kRepeatCount; i++)
+      total_time += MeasureRestore();
+    GetReporter(compact).AddResult(
+        "restore_time", total_time.InMillisecondsF() / kRepeatCount);
+  }
+}
+
+}  // namespace web
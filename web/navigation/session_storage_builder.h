@@ -20,6 +20,14 @@ class SessionStorageBuilder {
   // The provided |web_state| must already have a |NavigationManager|.
   void ExtractSessionState(WebStateImpl* web_state,
                            CRWSessionStorage* storage) const;
+  // Populates |web_state| with |storage|'s navigation history only. Used to
+  // realize a WebState whose metadata was extracted on creation.
+  void ExtractNavigationHistory(WebStateImpl* web_state,
+                                CRWSessionStorage* storage) const;
+  // Populates |web_state| with everything from |storage| but the navigation
+  // history: opener, certificate policy cache, user data and user agent.
+  void ExtractSessionMetadata(WebStateImpl* web_state,
+                              CRWSessionStorage* storage) const;
 };
 
 }  // namespace web
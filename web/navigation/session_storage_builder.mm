@@ -86,9 +86,17 @@ CRWSessionStorage* SessionStorageBuilder::BuildStorage(
 void SessionStorageBuilder::ExtractSessionState(
     WebStateImpl* web_state,
     CRWSessionStorage* storage) const {
+  // The opener must be known while the navigation history is restored.
+  web_state->created_with_opener_ = storage.hasOpener;
+  ExtractNavigationHistory(web_state, storage);
+  ExtractSessionMetadata(web_state, storage);
+}
+
+void SessionStorageBuilder::ExtractNavigationHistory(
+    WebStateImpl* web_state,
+    CRWSessionStorage* storage) const {
   DCHECK(web_state);
   DCHECK(storage);
-  web_state->created_with_opener_ = storage.hasOpener;
   NSArray* item_storages = storage.itemStorages;
   web::ScopedNavigationItemList items(item_storages.count);
   NavigationItemStorageBuilder item_storage_builder;
@@ -103,6 +111,14 @@ void SessionStorageBuilder::ExtractSessionState(
   }
   web_state->navigation_manager_->Restore(storage.lastCommittedItemIndex,
                                           std::move(items));
+}
+
+void SessionStorageBuilder::ExtractSessionMetadata(
+    WebStateImpl* web_state,
+    CRWSessionStorage* storage) const {
+  DCHECK(web_state);
+  DCHECK(storage);
+  web_state->created_with_opener_ = storage.hasOpener;
 
   SessionCertificatePolicyCacheStorageBuilder cert_builder;
   std::unique_ptr<SessionCertificatePolicyCacheImpl> cert_policy_cache =
@@ -35,6 +35,11 @@ class SessionStorageBuilder;
 // restoration.
 extern const char kRestoreNavigationTime[];
 
+// Names of UMA histograms to log the length of the restore_session.html URL
+// injecting the session history, and the time spent to create it.
+extern const char kRestoreSessionUrlLength[];
+extern const char kRestoreSessionUrlCreationTime[];
+
 // WKBackForwardList based implementation of NavigationManagerImpl.
 // This class relies on the following WKWebView APIs, defined by the
 // CRWWebViewNavigationProxy protocol:
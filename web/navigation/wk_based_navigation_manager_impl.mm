@@ -63,6 +63,9 @@ bool IsSameOrPlaceholderOf(const GURL& url1, const GURL& url2) {
 namespace web {
 
 const char kRestoreNavigationTime[] = "IOS.RestoreNavigationTime";
+const char kRestoreSessionUrlLength[] = "IOS.RestoreSessionUrlLength";
+const char kRestoreSessionUrlCreationTime[] =
+    "IOS.RestoreSessionUrlCreationTime";
 
 WKBasedNavigationManagerImpl::WKBasedNavigationManagerImpl()
     : pending_item_index_(-1),
@@ -719,8 +722,14 @@ void WKBasedNavigationManagerImpl::UnsafeRestore(
   // history restore so information such as scroll position is restored.
   int first_index = -1;
   GURL url;
+  base::ElapsedTimer url_creation_timer;
   wk_navigation_util::CreateRestoreSessionUrl(last_committed_item_index, items,
                                               &url, &first_index);
+  UMA_HISTOGRAM_CUSTOM_MICROSECONDS_TIMES(
+      kRestoreSessionUrlCreationTime, url_creation_timer.Elapsed(),
+      base::TimeDelta::FromMicroseconds(1), base::TimeDelta::FromSeconds(1),
+      50);
+  UMA_HISTOGRAM_COUNTS_1M(kRestoreSessionUrlLength, url.spec().size());
   DCHECK_GE(first_index, 0);
   DCHECK_LT(base::checked_cast<NSUInteger>(first_index), items.size());
   DCHECK(url.is_valid());
@@ -8,6 +8,7 @@
 
 #include "base/json/json_writer.h"
 #include "base/mac/bundle_locations.h"
+#include "base/strings/string_piece.h"
 #include "base/strings/string_util.h"
 #include "base/strings/sys_string_conversions.h"
 #include "base/values.h"
@@ -36,6 +37,24 @@ const char kRestoreSessionTargetUrlHashPrefix[] = "targetUrl=";
 const char kOriginalUrlKey[] = "for";
 NSString* const kReferrerHeaderName = @"Referer";
 
+namespace {
+
+// Keys of the session history JSON injected in restore_session.html.
+const char kRestoreSessionOffsetKey[] = "offset";
+const char kRestoreSessionUrlsKey[] = "urls";
+const char kRestoreSessionTitlesKey[] = "titles";
+const char kRestoreSessionPrefixesKey[] = "prefixes";
+
+// Returns the length of the longest common prefix of |a| and |b|.
+size_t GetCommonPrefixLength(base::StringPiece a, base::StringPiece b) {
+  size_t length = 0;
+  while (length < a.size() && length < b.size() && a[length] == b[length])
+    length++;
+  return length;
+}
+
+}  // namespace
+
 int GetSafeItemRange(int last_committed_item_index,
                      int item_count,
                      int* offset,
@@ -118,22 +137,45 @@ void CreateRestoreSessionUrl(
       GetSafeItemRange(last_committed_item_index, items.size(),
                        &first_restored_item_offset, &new_size);
 
-  // The URLs and titles of the restored entries are stored in two separate
-  // lists instead of a single list of objects to reduce the size of the JSON
-  // string to be included in the query parameter.
-  base::Value restored_urls(base::Value::Type::LIST);
-  base::Value restored_titles(base::Value::Type::LIST);
-  for (int i = first_restored_item_offset;
-       i < new_size + first_restored_item_offset; i++) {
-    NavigationItem* item = items[i].get();
-    restored_urls.Append(item->GetURL().spec());
-    restored_titles.Append(item->GetTitle());
-  }
   base::Value session(base::Value::Type::DICTIONARY);
   int committed_item_offset = new_last_committed_item_index + 1 - new_size;
-  session.SetKey("offset", base::Value(committed_item_offset));
-  session.SetKey("urls", std::move(restored_urls));
-  session.SetKey("titles", std::move(restored_titles));
+  session.SetKey(kRestoreSessionOffsetKey, base::Value(committed_item_offset));
+  if (base::FeatureList::IsEnabled(features::kCompactRestoreSessionEncoding)) {
+    // Consecutive entries are often on the same site, so each URL is stored
+    // as the length of the prefix it shares with the previous URL, followed by
+    // the rest of the URL.
+    base::Value restored_prefixes(base::Value::Type::LIST);
+    base::Value restored_urls(base::Value::Type::LIST);
+    base::Value restored_titles(base::Value::Type::LIST);
+    base::StringPiece previous_spec;
+    for (int i = first_restored_item_offset;
+         i < new_size + first_restored_item_offset; i++) {
+      NavigationItem* item = items[i].get();
+      base::StringPiece spec = item->GetURL().spec();
+      size_t prefix_length = GetCommonPrefixLength(spec, previous_spec);
+      restored_prefixes.Append(static_cast<int>(prefix_length));
+      restored_urls.Append(spec.substr(prefix_length));
+      restored_titles.Append(item->GetTitle());
+      previous_spec = spec;
+    }
+    session.SetKey(kRestoreSessionPrefixesKey, std::move(restored_prefixes));
+    session.SetKey(kRestoreSessionUrlsKey, std::move(restored_urls));
+    session.SetKey(kRestoreSessionTitlesKey, std::move(restored_titles));
+  } else {
+    // The URLs and titles of the restored entries are stored in two separate
+    // lists instead of a single list of objects to reduce the size of the JSON
+    // string to be included in the query parameter.
+    base::Value restored_urls(base::Value::Type::LIST);
+    base::Value restored_titles(base::Value::Type::LIST);
+    for (int i = first_restored_item_offset;
+         i < new_size + first_restored_item_offset; i++) {
+      NavigationItem* item = items[i].get();
+      restored_urls.Append(item->GetURL().spec());
+      restored_titles.Append(item->GetTitle());
+    }
+    session.SetKey(kRestoreSessionUrlsKey, std::move(restored_urls));
+    session.SetKey(kRestoreSessionTitlesKey, std::move(restored_titles));
+  }
 
   std::string session_json;
   base::JSONWriter::Write(session, &session_json);
@@ -11,6 +11,7 @@
 #include "base/strings/stringprintf.h"
 #include "base/strings/sys_string_conversions.h"
 #include "base/strings/utf_string_conversions.h"
+#include "base/test/scoped_feature_list.h"
 #include "base/values.h"
 #include "ios/web/common/features.h"
 #import "ios/web/navigation/navigation_item_impl.h"
@@ -151,6 +152,36 @@ TEST_F(WKNavigationUtilTest, CreateRestoreSessionUrl) {
             session_json);
 }
 
+// Tests that the compact encoding stores each URL relative to the previous one
+// and keeps the titles.
+TEST_F(WKNavigationUtilTest, CreateRestoreSessionUrlWithCompactEncoding) {
+  base::test::ScopedFeatureList feature_list;
+  feature_list.InitAndEnableFeature(features::kCompactRestoreSessionEncoding);
+
+  std::vector<std::unique_ptr<NavigationItem>> items;
+  for (const char* spec :
+       {"http://www.0.com/a", "http://www.0.com/b", "https://www.1.com/"}) {
+    auto item = std::make_unique<NavigationItemImpl>();
+    item->SetURL(GURL(spec));
+    item->SetTitle(base::ASCIIToUTF16("Title"));
+    items.push_back(std::move(item));
+  }
+
+  int first_index = 0;
+  GURL restore_session_url;
+  CreateRestoreSessionUrl(/*last_committed_item_index=*/1, items,
+                          &restore_session_url, &first_index);
+  ASSERT_EQ(0, first_index);
+  ASSERT_TRUE(IsRestoreSessionUrl(restore_session_url));
+
+  std::string session_json =
+      net::UnescapeBinaryURLComponent(restore_session_url.ref());
+  EXPECT_EQ("session={\"offset\":-1,\"prefixes\":[0,17,4],"
+            "\"titles\":[\"Title\",\"Title\",\"Title\"],"
+            "\"urls\":[\"http://www.0.com/a\",\"b\",\"s://www.1.com/\"]}",
+            session_json);
+}
+
 // In the past the math within CreateRestoreSessionUrl has had some edge case
 // crashes.  Ensure that nothing crashes.
 TEST_F(WKNavigationUtilTest, CreateRestoreSessionBruteForce) {
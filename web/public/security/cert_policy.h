@@ -44,6 +44,12 @@ class CertPolicy {
   // Causes the policy to allow this certificate for a given |error|.
   void Allow(net::X509Certificate* cert, net::CertStatus error);
 
+  // Returns whether a certificate allowed for |allowed_error| is allowed for
+  // |error|, i.e. whether |error| is an exact match to or a subset of
+  // |allowed_error|.
+  static bool IsErrorAllowed(net::CertStatus allowed_error,
+                             net::CertStatus error);
+
  private:
   // The set of fingerprints of allowed certificates.
   std::map<net::SHA256HashValue, net::CertStatus> allowed_;
@@ -5,27 +5,35 @@
 #ifndef IOS_WEB_PUBLIC_SECURITY_CERTIFICATE_POLICY_CACHE_H_
 #define IOS_WEB_PUBLIC_SECURITY_CERTIFICATE_POLICY_CACHE_H_
 
-#include <map>
+#include <stddef.h>
+
 #include <string>
 
+#include "base/containers/mru_cache.h"
 #include "base/macros.h"
+#include "base/synchronization/lock.h"
+#include "base/thread_annotations.h"
 #include "ios/web/public/security/cert_policy.h"
+#include "net/base/hash_value.h"
 #include "net/cert/x509_certificate.h"
 
 namespace web {
 
 // A manager for certificate policy decisions for hosts, used to remember
 // decisions about how to handle problematic certs.
-// This class is thread-safe only in that in can be created and passed around
-// on any thread; the policy-related methods can only be called from the IO
+// This class is thread-safe: its methods can be called from any thread, so that
+// the policies can be queried from the UI thread without a hop to the IO
 // thread.
+//
+// The decisions are kept by host and certificate fingerprint. Only the most
+// recently used decisions are kept, and querying a policy doesn't record
+// anything, so the cache doesn't grow with the hosts visited.
 class CertificatePolicyCache
     : public base::RefCountedThreadSafe<CertificatePolicyCache> {
  public:
-  // Can be called from any thread:
   CertificatePolicyCache();
-
-  // Everything from here on can only be called from the IO thread.
+  // Creates a cache keeping at most |max_entries| decisions.
+  explicit CertificatePolicyCache(size_t max_entries);
 
   // Records that |cert| is permitted to be used for |host| in the future.
   virtual void AllowCertForHost(net::X509Certificate* cert,
@@ -46,8 +54,23 @@ class CertificatePolicyCache
  private:
   friend class base::RefCountedThreadSafe<CertificatePolicyCache>;
 
-  // Certificate policies for each host.
-  std::map<std::string, CertPolicy> cert_policy_for_host_;
+  // Host and fingerprint of an allowed certificate.
+  struct Key {
+    bool operator==(const Key& other) const;
+
+    std::string host;
+    net::SHA256HashValue fingerprint;
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+
+  base::Lock lock_;
+
+  // Errors allowed for each host and certificate.
+  base::HashingMRUCache<Key, net::CertStatus, KeyHash> allowed_errors_
+      GUARDED_BY(lock_);
 
   DISALLOW_COPY_AND_ASSIGN(CertificatePolicyCache);
 };
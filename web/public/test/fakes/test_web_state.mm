@@ -294,6 +294,12 @@ bool TestWebState::IsBeingDestroyed() const {
   return false;
 }
 
+bool TestWebState::IsRealized() const {
+  return true;
+}
+
+void TestWebState::ForceRealized() {}
+
 void TestWebState::SetLoading(bool is_loading) {
   if (is_loading == is_loading_)
     return;
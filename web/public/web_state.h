@@ -157,6 +157,16 @@ class WebState : public base::SupportsUserData {
       const CreateParams& params,
       CRWSessionStorage* session_storage);
 
+  // Creates a new WebState from a serialized representation of the session
+  // without restoring its navigation history. The returned WebState is
+  // "unrealized": it can answer GetTitle(), GetVisibleURL(),
+  // GetLastCommittedURL() and BuildSessionStorage() from |session_storage|,
+  // and creates its web controller and restores its history the first time it
+  // is realized (see ForceRealized()). |session_storage| must not be nil.
+  static std::unique_ptr<WebState> CreateUnrealizedWithStorageSession(
+      const CreateParams& params,
+      CRWSessionStorage* session_storage);
+
   ~WebState() override {}
 
   // A callback that returns a pointer to a WebState. The callback can always be
@@ -293,6 +303,16 @@ class WebState : public base::SupportsUserData {
   // Whether this instance is in the process of being destroyed.
   virtual bool IsBeingDestroyed() const = 0;
 
+  // Returns true if the WebState has its web controller and navigation
+  // history. Only WebStates created with CreateUnrealizedWithStorageSession()
+  // can be unrealized.
+  virtual bool IsRealized() const = 0;
+
+  // Realizes the WebState if it is unrealized. This is done implicitly when
+  // the navigation manager or the view is requested, when the WebState is
+  // shown or when a URL is opened in it.
+  virtual void ForceRealized() = 0;
+
   // Gets the URL currently being displayed in the URL bar, if there is one.
   // This URL might be a pending navigation that hasn't committed yet, so it is
   // not guaranteed to match the current page in this WebState. A typical
@@ -31,6 +31,10 @@ class WebStateObserver {
   virtual void WasShown(WebState* web_state) {}
   virtual void WasHidden(WebState* web_state) {}
 
+  // Invoked when an unrealized WebState has created its web controller and
+  // restored its navigation history.
+  virtual void WebStateRealized(WebState* web_state) {}
+
   // Called when a navigation started in the WebState for the main frame.
   // |navigation_context| is unique to a specific navigation. The same
   // NavigationContext will be provided on subsequent call to
@@ -17,8 +17,8 @@ CertPolicy::~CertPolicy() {}
 CertPolicy::Judgment CertPolicy::Check(net::X509Certificate* cert,
                                        net::CertStatus error) const {
   auto allowed_iter = allowed_.find(cert->CalculateChainFingerprint256());
-  if ((allowed_iter != allowed_.end()) && (allowed_iter->second & error) &&
-      !(~(allowed_iter->second & error) ^ ~error)) {
+  if ((allowed_iter != allowed_.end()) &&
+      IsErrorAllowed(allowed_iter->second, error)) {
     return ALLOWED;
   }
   return UNKNOWN;  // We don't have a policy for this cert.
@@ -30,4 +30,10 @@ void CertPolicy::Allow(net::X509Certificate* cert, net::CertStatus error) {
   allowed_[cert->CalculateChainFingerprint256()] = error;
 }
 
+// static
+bool CertPolicy::IsErrorAllowed(net::CertStatus allowed_error,
+                                net::CertStatus error) {
+  return (allowed_error & error) && !(~(allowed_error & error) ^ ~error);
+}
+
 }  // namespace web
@@ -4,33 +4,69 @@
 
 #include "ios/web/public/security/certificate_policy_cache.h"
 
-#include "base/check_op.h"
-#include "ios/web/public/thread/web_thread.h"
+#include <string.h>
+
+#include <functional>
+#include <utility>
 
 namespace web {
 
-CertificatePolicyCache::CertificatePolicyCache() {}
+namespace {
+
+// Maximum number of decisions kept. Decisions are only recorded when the user
+// proceeds through an interstitial, so this is only reached by tests or
+// unusual browsing.
+const size_t kMaxEntries = 1000;
+
+}  // namespace
+
+bool CertificatePolicyCache::Key::operator==(const Key& other) const {
+  return fingerprint == other.fingerprint && host == other.host;
+}
+
+size_t CertificatePolicyCache::KeyHash::operator()(const Key& key) const {
+  // The fingerprint is a SHA-256 hash, so any of its bytes are well
+  // distributed.
+  size_t fingerprint_hash;
+  memcpy(&fingerprint_hash, key.fingerprint.data, sizeof(fingerprint_hash));
+  return std::hash<std::string>()(key.host) ^ fingerprint_hash;
+}
+
+CertificatePolicyCache::CertificatePolicyCache()
+    : CertificatePolicyCache(kMaxEntries) {}
+
+CertificatePolicyCache::CertificatePolicyCache(size_t max_entries)
+    : allowed_errors_(max_entries) {}
 
 CertificatePolicyCache::~CertificatePolicyCache() {}
 
 void CertificatePolicyCache::AllowCertForHost(net::X509Certificate* cert,
                                               const std::string& host,
                                               net::CertStatus error) {
-  DCHECK_CURRENTLY_ON(WebThread::IO);
-  cert_policy_for_host_[host].Allow(cert, error);
+  Key key{host, cert->CalculateChainFingerprint256()};
+  base::AutoLock auto_lock(lock_);
+  // If this same cert had already been saved with a different error status,
+  // this will replace it with the new error status.
+  allowed_errors_.Put(std::move(key), error);
 }
 
 CertPolicy::Judgment CertificatePolicyCache::QueryPolicy(
     net::X509Certificate* cert,
     const std::string& host,
     net::CertStatus error) {
-  DCHECK_CURRENTLY_ON(WebThread::IO);
-  return cert_policy_for_host_[host].Check(cert, error);
+  const Key key{host, cert->CalculateChainFingerprint256()};
+  base::AutoLock auto_lock(lock_);
+  auto it = allowed_errors_.Get(key);
+  if (it != allowed_errors_.end() &&
+      CertPolicy::IsErrorAllowed(it->second, error)) {
+    return CertPolicy::ALLOWED;
+  }
+  return CertPolicy::UNKNOWN;  // We don't have a policy for this cert.
 }
 
 void CertificatePolicyCache::ClearCertificatePolicies() {
-  DCHECK_CURRENTLY_ON(WebThread::IO);
-  cert_policy_for_host_.clear();
+  base::AutoLock auto_lock(lock_);
+  allowed_errors_.Clear();
 }
 
 }  // namespace web
@@ -0,0 +1,76 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ios/web/public/security/certificate_policy_cache.h"
+
+#include <string>
+#include <vector>
+
+#include "base/memory/ref_counted.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/timer/elapsed_timer.h"
+#include "net/cert/x509_certificate.h"
+#include "net/test/test_certificate_data.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+#include "testing/platform_test.h"
+
+namespace web {
+
+namespace {
+
+// Number of hosts with a policy.
+const int kHostCount = 10000;
+
+// Number of times each host is queried.
+const int kRepeatCount = 10;
+
+}  // namespace
+
+using CertificatePolicyCachePerfTest = PlatformTest;
+
+// Measures the time to query the policy of a certificate with 10k hosts with
+// an allowed certificate, for hosts with and without a policy.
+TEST_F(CertificatePolicyCachePerfTest, QueryPolicy) {
+  scoped_refptr<net::X509Certificate> cert =
+      net::X509Certificate::CreateFromBytes(
+          reinterpret_cast<const char*>(google_der), sizeof(google_der));
+  ASSERT_TRUE(cert);
+
+  std::vector<std::string> allowed_hosts;
+  std::vector<std::string> unknown_hosts;
+  for (int i = 0; i < kHostCount; i++) {
+    allowed_hosts.push_back("allowed" + base::NumberToString(i) + ".com");
+    unknown_hosts.push_back("unknown" + base::NumberToString(i) + ".com");
+  }
+
+  auto cache = base::MakeRefCounted<CertificatePolicyCache>(kHostCount);
+  for (const std::string& host : allowed_hosts) {
+    cache->AllowCertForHost(cert.get(), host, net::CERT_STATUS_DATE_INVALID);
+  }
+
+  perf_test::PerfResultReporter reporter("CertificatePolicyCache",
+                                         "10k_hosts");
+  reporter.RegisterImportantMetric("allowed_query_time", "ns");
+  reporter.RegisterImportantMetric("unknown_query_time", "ns");
+
+  for (bool allowed : {true, false}) {
+    const std::vector<std::string>& hosts =
+        allowed ? allowed_hosts : unknown_hosts;
+    base::ElapsedTimer timer;
+    for (int repeat = 0; repeat < kRepeatCount; repeat++) {
+      for (const std::string& host : hosts) {
+        EXPECT_EQ(allowed ? CertPolicy::ALLOWED : CertPolicy::UNKNOWN,
+                  cache->QueryPolicy(cert.get(), host,
+                                     net::CERT_STATUS_DATE_INVALID));
+      }
+    }
+    double query_time_ns = timer.Elapsed().InNanoseconds() /
+                           static_cast<double>(kHostCount * kRepeatCount);
+    reporter.AddResult(allowed ? "allowed_query_time" : "unknown_query_time",
+                       query_time_ns);
+  }
+}
+
+}  // namespace web
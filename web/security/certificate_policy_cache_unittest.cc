@@ -0,0 +1,103 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ios/web/public/security/certificate_policy_cache.h"
+
+#include "base/memory/ref_counted.h"
+#include "net/cert/x509_certificate.h"
+#include "net/test/test_certificate_data.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/platform_test.h"
+
+namespace web {
+
+class CertificatePolicyCacheTest : public PlatformTest {
+ protected:
+  void SetUp() override {
+    PlatformTest::SetUp();
+    google_cert_ = net::X509Certificate::CreateFromBytes(
+        reinterpret_cast<const char*>(google_der), sizeof(google_der));
+    ASSERT_TRUE(google_cert_);
+    webkit_cert_ = net::X509Certificate::CreateFromBytes(
+        reinterpret_cast<const char*>(webkit_der), sizeof(webkit_der));
+    ASSERT_TRUE(webkit_cert_);
+  }
+
+  scoped_refptr<net::X509Certificate> google_cert_;
+  scoped_refptr<net::X509Certificate> webkit_cert_;
+};
+
+// Tests that the policies are kept by host and certificate.
+TEST_F(CertificatePolicyCacheTest, Policy) {
+  auto cache = base::MakeRefCounted<CertificatePolicyCache>();
+  EXPECT_EQ(CertPolicy::UNKNOWN,
+            cache->QueryPolicy(google_cert_.get(), "google.com",
+                               net::CERT_STATUS_DATE_INVALID));
+
+  cache->AllowCertForHost(google_cert_.get(), "google.com",
+                          net::CERT_STATUS_DATE_INVALID);
+  EXPECT_EQ(CertPolicy::ALLOWED,
+            cache->QueryPolicy(google_cert_.get(), "google.com",
+                               net::CERT_STATUS_DATE_INVALID));
+  EXPECT_EQ(CertPolicy::UNKNOWN,
+            cache->QueryPolicy(google_cert_.get(), "google.com",
+                               net::CERT_STATUS_DATE_INVALID |
+                                   net::CERT_STATUS_COMMON_NAME_INVALID));
+  EXPECT_EQ(CertPolicy::UNKNOWN,
+            cache->QueryPolicy(google_cert_.get(), "example.com",
+                               net::CERT_STATUS_DATE_INVALID));
+  EXPECT_EQ(CertPolicy::UNKNOWN,
+            cache->QueryPolicy(webkit_cert_.get(), "google.com",
+                               net::CERT_STATUS_DATE_INVALID));
+
+  // Saving the same certificate with a new error replaces the previous one.
+  cache->AllowCertForHost(google_cert_.get(), "google.com",
+                          net::CERT_STATUS_AUTHORITY_INVALID);
+  EXPECT_EQ(CertPolicy::UNKNOWN,
+            cache->QueryPolicy(google_cert_.get(), "google.com",
+                               net::CERT_STATUS_DATE_INVALID));
+  EXPECT_EQ(CertPolicy::ALLOWED,
+            cache->QueryPolicy(google_cert_.get(), "google.com",
+                               net::CERT_STATUS_AUTHORITY_INVALID));
+
+  cache->ClearCertificatePolicies();
+  EXPECT_EQ(CertPolicy::UNKNOWN,
+            cache->QueryPolicy(google_cert_.get(), "google.com",
+                               net::CERT_STATUS_AUTHORITY_INVALID));
+}
+
+// Tests that the least recently used policies are evicted, and that queries
+// don't record anything.
+TEST_F(CertificatePolicyCacheTest, Eviction) {
+  auto cache = base::MakeRefCounted<CertificatePolicyCache>(2);
+  cache->AllowCertForHost(google_cert_.get(), "a.com",
+                          net::CERT_STATUS_DATE_INVALID);
+  cache->AllowCertForHost(google_cert_.get(), "b.com",
+                          net::CERT_STATUS_DATE_INVALID);
+
+  // Querying other hosts evicts nothing.
+  for (const char* host : {"c.com", "d.com", "e.com"}) {
+    EXPECT_EQ(CertPolicy::UNKNOWN,
+              cache->QueryPolicy(google_cert_.get(), host,
+                                 net::CERT_STATUS_DATE_INVALID));
+  }
+  EXPECT_EQ(CertPolicy::ALLOWED,
+            cache->QueryPolicy(google_cert_.get(), "a.com",
+                               net::CERT_STATUS_DATE_INVALID));
+
+  // b.com is now the least recently used.
+  cache->AllowCertForHost(webkit_cert_.get(), "c.com",
+                          net::CERT_STATUS_DATE_INVALID);
+  EXPECT_EQ(CertPolicy::ALLOWED,
+            cache->QueryPolicy(google_cert_.get(), "a.com",
+                               net::CERT_STATUS_DATE_INVALID));
+  EXPECT_EQ(CertPolicy::UNKNOWN,
+            cache->QueryPolicy(google_cert_.get(), "b.com",
+                               net::CERT_STATUS_DATE_INVALID));
+  EXPECT_EQ(CertPolicy::ALLOWED,
+            cache->QueryPolicy(webkit_cert_.get(), "c.com",
+                               net::CERT_STATUS_DATE_INVALID));
+}
+
+}  // namespace web
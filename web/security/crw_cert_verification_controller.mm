@@ -8,11 +8,13 @@
 
 #include "base/bind.h"
 #include "base/check_op.h"
+#include "base/feature_list.h"
 #import "base/ios/block_types.h"
 #include "base/memory/ref_counted.h"
 #include "base/strings/sys_string_conversions.h"
 #include "base/task/post_task.h"
 #include "base/task/thread_pool.h"
+#include "ios/web/common/features.h"
 #include "ios/web/public/browser_state.h"
 #include "ios/web/public/security/certificate_policy_cache.h"
 #include "ios/web/public/thread/web_task_traits.h"
@@ -61,7 +63,8 @@ using web::WebThread;
                   base::ScopedCFTypeRef<CFErrorRef>))completionHandler;
 
 // Returns cert accept policy for the given SecTrust result. |trustResult| must
-// not be for a valid cert. Must be called on IO thread.
+// not be for a valid cert. Must be called on IO thread, or on UI thread if
+// kQueryCertificatePoliciesOnUIThread is enabled.
 - (web::CertAcceptPolicy)
     loadPolicyForRejectedTrustResult:(SecTrustResultType)trustResult
                           certStatus:(net::CertStatus)certStatus
@@ -141,10 +144,10 @@ using web::WebThread;
     DCHECK(cert);
   }
   DCHECK(cert->intermediate_buffers().empty());
-  base::PostTask(FROM_HERE, {WebThread::IO}, base::BindOnce(^{
-                   _certPolicyCache->AllowCertForHost(
-                       cert.get(), base::SysNSStringToUTF8(host), status);
-                 }));
+  // The cache is thread-safe, so the decision is recorded before any policy
+  // query that follows.
+  _certPolicyCache->AllowCertForHost(cert.get(), base::SysNSStringToUTF8(host),
+                                     status);
 }
 
 #pragma mark - Private
@@ -180,6 +183,23 @@ using web::WebThread;
                          completionHandler:(web::PolicyDecisionHandler)handler {
   DCHECK_CURRENTLY_ON(WebThread::UI);
   DCHECK(handler);
+  if (base::FeatureList::IsEnabled(
+          web::features::kQueryCertificatePoliciesOnUIThread)) {
+    // The certificate policy cache is thread-safe, so there is no need to hop
+    // to the IO thread. |handler| is still called asynchronously.
+    net::CertStatus certStatus = [self certStatusFromTrustResult:trustResult
+                                                      trustError:trustError];
+    web::CertAcceptPolicy policy =
+        [self loadPolicyForRejectedTrustResult:trustResult
+                                    certStatus:certStatus
+                                   serverTrust:trust.get()
+                                          host:host];
+    dispatch_async(dispatch_get_main_queue(), ^{
+      handler(policy, certStatus);
+    });
+    return;
+  }
+
   TaskTraits traits{WebThread::IO, TaskShutdownBehavior::BLOCK_SHUTDOWN};
   base::PostTask(FROM_HERE, traits, base::BindOnce(^{
                    // |loadPolicyForRejectedTrustResult:certStatus:serverTrust
@@ -239,7 +259,10 @@ using web::WebThread;
                           certStatus:(net::CertStatus)certStatus
                          serverTrust:(SecTrustRef)trust
                                 host:(NSString*)host {
-  DCHECK_CURRENTLY_ON(WebThread::IO);
+  DCHECK_CURRENTLY_ON(base::FeatureList::IsEnabled(
+                          web::features::kQueryCertificatePoliciesOnUIThread)
+                          ? WebThread::UI
+                          : WebThread::IO);
   DCHECK_NE(web::SECURITY_STYLE_AUTHENTICATED,
             web::GetSecurityStyleFromTrustResult(trustResult));
 
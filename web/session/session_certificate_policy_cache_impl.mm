@@ -4,12 +4,9 @@
 
 #import "ios/web/session/session_certificate_policy_cache_impl.h"
 
-#include "base/bind.h"
-#include "base/task/post_task.h"
 #include "ios/web/public/browser_state.h"
 #include "ios/web/public/security/certificate_policy_cache.h"
 #import "ios/web/public/session/crw_session_certificate_policy_cache_storage.h"
-#include "ios/web/public/thread/web_task_traits.h"
 #include "ios/web/public/thread/web_thread.h"
 #include "net/cert/x509_util.h"
 #include "net/cert/x509_util_ios.h"
@@ -60,14 +57,11 @@ void SessionCertificatePolicyCacheImpl::UpdateCertificatePolicyCache(
     const scoped_refptr<web::CertificatePolicyCache>& cache) const {
   DCHECK_CURRENTLY_ON(WebThread::UI);
   DCHECK(cache.get());
-  NSSet* allowed_certs = [NSSet setWithSet:allowed_certs_];
-  const scoped_refptr<CertificatePolicyCache> cache_copy = cache;
-  base::PostTask(FROM_HERE, {WebThread::IO}, base::BindOnce(^{
-                   for (CRWSessionCertificateStorage* cert in allowed_certs) {
-                     cache_copy->AllowCertForHost(cert.certificate, cert.host,
-                                                  cert.status);
-                   }
-                 }));
+  // The cache is thread-safe, so the policies are recorded before any query
+  // that follows.
+  for (CRWSessionCertificateStorage* cert in allowed_certs_) {
+    cache->AllowCertForHost(cert.certificate, cert.host, cert.status);
+  }
 }
 
 void SessionCertificatePolicyCacheImpl::RegisterAllowedCertificate(
@@ -91,12 +85,8 @@ void SessionCertificatePolicyCacheImpl::RegisterAllowedCertificate(
                                 initWithCertificate:certificate
                                                host:host
                                              status:status]];
-  const scoped_refptr<CertificatePolicyCache> cache =
-      GetCertificatePolicyCache();
-  base::PostTask(
-      FROM_HERE, {WebThread::IO},
-      base::BindOnce(&CertificatePolicyCache::AllowCertForHost, cache,
-                     base::RetainedRef(certificate.get()), host, status));
+  GetCertificatePolicyCache()->AllowCertForHost(certificate.get(), host,
+                                                status);
 }
 
 void SessionCertificatePolicyCacheImpl::SetAllowedCerts(NSSet* allowed_certs) {
@@ -11,6 +11,7 @@
 
 @class CRWWebUISchemeHandler;
 @class CRWWKScriptMessageRouter;
+@class WKUserScript;
 @class WKWebViewConfiguration;
 
 namespace web {
@@ -91,6 +92,9 @@ class WKWebViewConfigurationProvider : public base::SupportsUserData::Data {
   CRWWebUISchemeHandler* scheme_handler_ = nil;
   WKWebViewConfiguration* configuration_ = nil;
   CRWWKScriptMessageRouter* router_;
+  // User scripts added by the last call to UpdateScripts(), which are reused
+  // by the next calls if their source did not change.
+  NSArray<WKUserScript*>* user_scripts_ = nil;
   BrowserState* browser_state_;
   std::unique_ptr<WKContentRuleListProvider> content_rule_list_provider_;
 
@@ -33,44 +33,21 @@ namespace {
 // A key used to associate a WKWebViewConfigurationProvider with a BrowserState.
 const char kWKWebViewConfigProviderKeyName[] = "wk_web_view_config_provider";
 
-// Returns a WKUserScript for JavsScript injected into the main frame at the
-// beginning of the document load.
-WKUserScript* InternalGetDocumentStartScriptForMainFrame(
-    BrowserState* browser_state) {
-  return [[WKUserScript alloc]
-        initWithSource:GetDocumentStartScriptForMainFrame(browser_state)
-         injectionTime:WKUserScriptInjectionTimeAtDocumentStart
-      forMainFrameOnly:YES];
-}
-
-// Returns a WKUserScript for JavsScript injected into the main frame at the
-// end of the document load.
-WKUserScript* InternalGetDocumentEndScriptForMainFrame(
-    BrowserState* browser_state) {
-  return [[WKUserScript alloc]
-        initWithSource:GetDocumentEndScriptForMainFrame(browser_state)
-         injectionTime:WKUserScriptInjectionTimeAtDocumentEnd
-      forMainFrameOnly:YES];
-}
-
-// Returns a WKUserScript for JavsScript injected into all frames at the
-// beginning of the document load.
-WKUserScript* InternalGetDocumentStartScriptForAllFrames(
-    BrowserState* browser_state) {
-  return [[WKUserScript alloc]
-        initWithSource:GetDocumentStartScriptForAllFrames(browser_state)
-         injectionTime:WKUserScriptInjectionTimeAtDocumentStart
-      forMainFrameOnly:NO];
-}
-
-// Returns a WKUserScript for JavsScript injected into all frames at the
-// end of the document load.
-WKUserScript* InternalGetDocumentEndScriptForAllFrames(
-    BrowserState* browser_state) {
-  return [[WKUserScript alloc]
-        initWithSource:GetDocumentEndScriptForAllFrames(browser_state)
-         injectionTime:WKUserScriptInjectionTimeAtDocumentEnd
-      forMainFrameOnly:NO];
+// Returns a WKUserScript for |source| injected at |injection_time|, in the main
+// frame only if |main_frame_only|. Returns |previous_script| instead if it has
+// the same source and injection parameters.
+WKUserScript* GetUserScript(WKUserScript* previous_script,
+                            NSString* source,
+                            WKUserScriptInjectionTime injection_time,
+                            BOOL main_frame_only) {
+  if (previous_script && previous_script.injectionTime == injection_time &&
+      previous_script.forMainFrameOnly == main_frame_only &&
+      [previous_script.source isEqualToString:source]) {
+    return previous_script;
+  }
+  return [[WKUserScript alloc] initWithSource:source
+                                injectionTime:injection_time
+                             forMainFrameOnly:main_frame_only];
 }
 
 }  // namespace
@@ -208,14 +185,25 @@ void WKWebViewConfigurationProvider::UpdateScripts() {
   [configuration_.userContentController removeAllUserScripts];
   // Main frame script depends upon scripts injected into all frames, so the
   // "AllFrames" scripts must be injected first.
-  [configuration_.userContentController
-      addUserScript:InternalGetDocumentStartScriptForAllFrames(browser_state_)];
-  [configuration_.userContentController
-      addUserScript:InternalGetDocumentStartScriptForMainFrame(browser_state_)];
-  [configuration_.userContentController
-      addUserScript:InternalGetDocumentEndScriptForAllFrames(browser_state_)];
-  [configuration_.userContentController
-      addUserScript:InternalGetDocumentEndScriptForMainFrame(browser_state_)];
+  // |user_scripts_| is nil or holds the four scripts in this order.
+  NSArray<WKUserScript*>* previous_scripts = user_scripts_;
+  user_scripts_ = @[
+    GetUserScript(previous_scripts[0],
+                  GetDocumentStartScriptForAllFrames(browser_state_),
+                  WKUserScriptInjectionTimeAtDocumentStart, NO),
+    GetUserScript(previous_scripts[1],
+                  GetDocumentStartScriptForMainFrame(browser_state_),
+                  WKUserScriptInjectionTimeAtDocumentStart, YES),
+    GetUserScript(previous_scripts[2],
+                  GetDocumentEndScriptForAllFrames(browser_state_),
+                  WKUserScriptInjectionTimeAtDocumentEnd, NO),
+    GetUserScript(previous_scripts[3],
+                  GetDocumentEndScriptForMainFrame(browser_state_),
+                  WKUserScriptInjectionTimeAtDocumentEnd, YES),
+  ];
+  for (WKUserScript* user_script in user_scripts_) {
+    [configuration_.userContentController addUserScript:user_script];
+  }
 }
 
 void WKWebViewConfigurationProvider::Purge() {
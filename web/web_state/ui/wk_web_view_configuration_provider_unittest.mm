@@ -206,6 +206,26 @@ TEST_F(WKWebViewConfigurationProviderTest, UpdateScripts) {
                     .length);
 }
 
+// Tests that the user scripts whose source did not change are reused when the
+// scripts are updated.
+TEST_F(WKWebViewConfigurationProviderTest, UpdateScriptsReusesUserScripts) {
+  GetWebClient()->SetEarlyPageScript(@"var test = 4;");
+  WKWebViewConfiguration* config = GetProvider().GetWebViewConfiguration();
+  NSArray* initial_scripts = config.userContentController.userScripts;
+  ASSERT_EQ(4U, initial_scripts.count);
+
+  GetWebClient()->SetEarlyPageScript(@"var test = 3;");
+  GetProvider().UpdateScripts();
+  config = GetProvider().GetWebViewConfiguration();
+  NSArray* updated_scripts = config.userContentController.userScripts;
+  ASSERT_EQ(4U, updated_scripts.count);
+
+  EXPECT_EQ(initial_scripts[0], updated_scripts[0]);
+  EXPECT_NE(initial_scripts[1], updated_scripts[1]);
+  EXPECT_EQ(initial_scripts[2], updated_scripts[2]);
+  EXPECT_EQ(initial_scripts[3], updated_scripts[3]);
+}
+
 // Tests that observers methods are correctly triggered when observing the
 // WKWebViewConfigurationProvider
 TEST_F(WKWebViewConfigurationProviderTest, Observers) {
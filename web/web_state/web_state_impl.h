@@ -69,6 +69,13 @@ class WebStateImpl : public WebState,
   explicit WebStateImpl(const CreateParams& params);
   // Constructor for WebStatesImpls created for deserialized sessions
   WebStateImpl(const CreateParams& params, CRWSessionStorage* session_storage);
+  // Constructor for WebStateImpls created for deserialized sessions. If
+  // |realized| is false, the creation of the web controller and the
+  // restoration of the navigation history are deferred until ForceRealized()
+  // is called.
+  WebStateImpl(const CreateParams& params,
+               CRWSessionStorage* session_storage,
+               bool realized);
   ~WebStateImpl() override;
 
   // Gets/Sets the CRWWebController that backs this object.
@@ -110,7 +117,9 @@ class WebStateImpl : public WebState,
   // Called when new FaviconURL candidates are received.
   void OnFaviconUrlUpdated(const std::vector<FaviconURL>& candidates);
 
-  // Returns the NavigationManager for this WebState.
+  // Returns the NavigationManager for this WebState. The non-const version
+  // realizes the WebState. The const version does not, and the history of an
+  // unrealized WebState is empty until it is realized.
   const NavigationManagerImpl& GetNavigationManagerImpl() const;
   NavigationManagerImpl& GetNavigationManagerImpl();
 
@@ -216,6 +225,8 @@ class WebStateImpl : public WebState,
   bool IsVisible() const override;
   bool IsEvicted() const override;
   bool IsBeingDestroyed() const override;
+  bool IsRealized() const override;
+  void ForceRealized() override;
   const GURL& GetVisibleURL() const override;
   const GURL& GetLastCommittedURL() const override;
   GURL GetCurrentURL(URLVerificationTrustLevel* trust_level) const override;
@@ -337,6 +348,10 @@ class WebStateImpl : public WebState,
   // Restores session history into the navigation manager.
   void RestoreSessionStorage(CRWSessionStorage* session_storage);
 
+  // Extracts the metadata of |session_storage| and keeps its last committed
+  // item to answer title and URL queries until the WebState is realized.
+  void RestoreUnrealizedSessionStorage(CRWSessionStorage* session_storage);
+
   // Delegate, not owned by this object.
   WebStateDelegate* delegate_;
 
@@ -400,6 +415,19 @@ class WebStateImpl : public WebState,
   // fetching JavaScript.
   std::vector<web::FaviconURL> cached_favicon_urls_;
 
+  // Whether the web controller has been created and the navigation history
+  // restored. See WebState::CreateUnrealizedWithStorageSession().
+  bool realized_ = true;
+
+  // The last committed item of the restored session, used to answer
+  // GetTitle(), GetVisibleURL() and GetLastCommittedURL() while the WebState
+  // is unrealized. Null once the WebState is realized.
+  std::unique_ptr<NavigationItemImpl> unrealized_item_;
+
+  // The value passed to SetWebUsageEnabled() while the WebState is unrealized.
+  // Forwarded to the web controller on realization.
+  bool unrealized_web_usage_enabled_ = true;
+
   // Whether a JavaScript dialog is currently being presented.
   bool running_javascript_dialog_ = false;
 
@@ -20,6 +20,7 @@
 #import "ios/web/navigation/error_page_helper.h"
 #import "ios/web/navigation/navigation_context_impl.h"
 #import "ios/web/navigation/navigation_item_impl.h"
+#import "ios/web/navigation/navigation_item_storage_builder.h"
 #import "ios/web/navigation/session_storage_builder.h"
 #import "ios/web/navigation/wk_based_navigation_manager_impl.h"
 #import "ios/web/navigation/wk_navigation_util.h"
@@ -80,11 +81,25 @@ std::unique_ptr<WebState> WebState::CreateWithStorageSession(
   return base::WrapUnique(new WebStateImpl(params, session_storage));
 }
 
+/* static */
+std::unique_ptr<WebState> WebState::CreateUnrealizedWithStorageSession(
+    const CreateParams& params,
+    CRWSessionStorage* session_storage) {
+  DCHECK(session_storage);
+  return base::WrapUnique(
+      new WebStateImpl(params, session_storage, /*realized=*/false));
+}
+
 WebStateImpl::WebStateImpl(const CreateParams& params)
     : WebStateImpl(params, nullptr) {}
 
 WebStateImpl::WebStateImpl(const CreateParams& params,
                            CRWSessionStorage* session_storage)
+    : WebStateImpl(params, session_storage, /*realized=*/true) {}
+
+WebStateImpl::WebStateImpl(const CreateParams& params,
+                           CRWSessionStorage* session_storage,
+                           bool realized)
     : delegate_(nullptr),
       is_loading_(false),
       is_being_destroyed_(false),
@@ -96,12 +111,22 @@ WebStateImpl::WebStateImpl(const CreateParams& params,
                            ? UserAgentType::AUTOMATIC
                            : UserAgentType::MOBILE),
       weak_factory_(this) {
+  DCHECK(realized || session_storage);
   navigation_manager_ = std::make_unique<WKBasedNavigationManagerImpl>();
 
   navigation_manager_->SetDelegate(this);
   navigation_manager_->SetBrowserState(params.browser_state);
-  // Send creation event and create the web controller.
+  // Send creation event.
   GlobalWebStateEventTracker::GetInstance()->OnWebStateCreated(this);
+
+  // An unrealized WebState only extracts the session metadata; the web
+  // controller is created and the history restored in ForceRealized().
+  if (!realized) {
+    realized_ = false;
+    RestoreUnrealizedSessionStorage(session_storage);
+    return;
+  }
+
   web_controller_ = [[CRWWebController alloc] initWithWebState:this];
 
   // Restore session history last because WKBasedNavigationManagerImpl relies on
@@ -260,6 +285,9 @@ bool WebStateImpl::IsVisible() const {
 }
 
 bool WebStateImpl::IsEvicted() const {
+  // An unrealized WebState has no web controller, but was not evicted.
+  if (!realized_)
+    return false;
   return ![web_controller_ isViewAlive];
 }
 
@@ -267,6 +295,32 @@ bool WebStateImpl::IsBeingDestroyed() const {
   return is_being_destroyed_;
 }
 
+bool WebStateImpl::IsRealized() const {
+  return realized_;
+}
+
+void WebStateImpl::ForceRealized() {
+  if (realized_)
+    return;
+
+  // Mark the WebState as realized first as the web controller and the
+  // navigation manager call back into the WebState while being set up.
+  realized_ = true;
+  unrealized_item_.reset();
+  web_controller_ = [[CRWWebController alloc] initWithWebState:this];
+  [web_controller_ setWebUsageEnabled:unrealized_web_usage_enabled_];
+
+  // |restored_session_storage_| can only be reset by a committed navigation,
+  // which cannot happen before the WebState is realized.
+  DCHECK(restored_session_storage_);
+  SessionStorageBuilder session_storage_builder;
+  session_storage_builder.ExtractNavigationHistory(this,
+                                                   restored_session_storage_);
+
+  for (auto& observer : observers_)
+    observer.WebStateRealized(this);
+}
+
 void WebStateImpl::OnPageLoaded(const GURL& url, bool load_success) {
   // Navigation manager loads internal URLs to restore session history and
   // create back-forward entries for WebUI. Do not trigger external callbacks.
@@ -292,6 +346,7 @@ const NavigationManagerImpl& WebStateImpl::GetNavigationManagerImpl() const {
 }
 
 NavigationManagerImpl& WebStateImpl::GetNavigationManagerImpl() {
+  ForceRealized();
   return *navigation_manager_;
 }
 
@@ -333,6 +388,9 @@ bool WebStateImpl::HasWebUI() {
 }
 
 const base::string16& WebStateImpl::GetTitle() const {
+  if (!realized_)
+    return unrealized_item_->GetTitleForDisplay();
+
   // TODO(stuartmorgan): Implement the NavigationManager logic necessary to
   // match the WebContents implementation of this method.
   DCHECK(Configured());
@@ -573,14 +631,21 @@ void WebStateImpl::OnWebFrameUnavailable(web::WebFrame* frame) {
 #pragma mark - WebState implementation
 
 bool WebStateImpl::IsWebUsageEnabled() const {
+  if (!realized_)
+    return unrealized_web_usage_enabled_;
   return [web_controller_ webUsageEnabled];
 }
 
 void WebStateImpl::SetWebUsageEnabled(bool enabled) {
+  if (!realized_) {
+    unrealized_web_usage_enabled_ = enabled;
+    return;
+  }
   [web_controller_ setWebUsageEnabled:enabled];
 }
 
 UIView* WebStateImpl::GetView() {
+  ForceRealized();
   return [web_controller_ view];
 }
 
@@ -595,6 +660,7 @@ void WebStateImpl::DidRevealWebContent() {
 }
 
 void WebStateImpl::WasShown() {
+  ForceRealized();
   if (IsVisible())
     return;
 
@@ -621,6 +687,7 @@ BrowserState* WebStateImpl::GetBrowserState() const {
 }
 
 void WebStateImpl::OpenURL(const WebState::OpenURLParams& params) {
+  ForceRealized();
   DCHECK(Configured());
   ClearTransientContent();
   if (delegate_)
@@ -723,16 +790,27 @@ bool WebStateImpl::ContentIsHTML() const {
 }
 
 const GURL& WebStateImpl::GetVisibleURL() const {
+  if (!realized_)
+    return unrealized_item_->GetVirtualURL();
   web::NavigationItem* item = navigation_manager_->GetVisibleItem();
   return item ? item->GetVirtualURL() : GURL::EmptyGURL();
 }
 
 const GURL& WebStateImpl::GetLastCommittedURL() const {
+  if (!realized_)
+    return unrealized_item_->GetVirtualURL();
   web::NavigationItem* item = navigation_manager_->GetLastCommittedItem();
   return item ? item->GetVirtualURL() : GURL::EmptyGURL();
 }
 
 GURL WebStateImpl::GetCurrentURL(URLVerificationTrustLevel* trust_level) const {
+  if (!realized_) {
+    // The URL comes from the restored session, as it does for a realized
+    // WebState whose restoration is still in progress.
+    if (trust_level)
+      *trust_level = URLVerificationTrustLevel::kAbsolute;
+    return unrealized_item_->GetVirtualURL();
+  }
   if (!trust_level) {
     auto ignore_trust = URLVerificationTrustLevel::kNone;
     return [web_controller_ currentURLWithTrustLevel:&ignore_trust];
@@ -797,6 +875,9 @@ void WebStateImpl::SetHasOpener(bool has_opener) {
 }
 
 bool WebStateImpl::CanTakeSnapshot() const {
+  // An unrealized WebState has no web view to take a snapshot of.
+  if (!realized_)
+    return false;
   // The WKWebView snapshot API depends on IPC execution that does not function
   // properly when JavaScript dialogs are running.
   return !running_javascript_dialog_;
@@ -818,6 +899,10 @@ void WebStateImpl::CreateFullPagePdf(
     base::OnceCallback<void(NSData*)> callback) {
   // Move the callback to a __block pointer, which will be in scope as long
   // as the callback is retained.
+  if (!realized_) {
+    std::move(callback).Run(nil);
+    return;
+  }
   __block base::OnceCallback<void(NSData*)> callback_for_block =
       std::move(callback);
   [web_controller_
@@ -982,4 +1067,26 @@ void WebStateImpl::RestoreSessionStorage(CRWSessionStorage* session_storage) {
   session_storage_builder.ExtractSessionState(this, session_storage);
 }
 
+void WebStateImpl::RestoreUnrealizedSessionStorage(
+    CRWSessionStorage* session_storage) {
+  // The storage is kept until the WebState is realized, and is returned as is
+  // by BuildSessionStorage() in the meantime.
+  restored_session_storage_ = session_storage;
+  SessionStorageBuilder session_storage_builder;
+  session_storage_builder.ExtractSessionMetadata(this, session_storage);
+
+  NSArray<CRWNavigationItemStorage*>* item_storages =
+      session_storage.itemStorages;
+  NSInteger index = session_storage.lastCommittedItemIndex;
+  if (index < 0 || index >= static_cast<NSInteger>(item_storages.count))
+    index = static_cast<NSInteger>(item_storages.count) - 1;
+  if (index < 0) {
+    unrealized_item_ = std::make_unique<NavigationItemImpl>();
+    return;
+  }
+  NavigationItemStorageBuilder item_storage_builder;
+  unrealized_item_ =
+      item_storage_builder.BuildNavigationItemImpl(item_storages[index]);
+}
+
 }  // namespace web
@@ -152,6 +152,20 @@ void HandleScriptCommand(bool* is_called,
   EXPECT_EQ(expected_sender_frame, sender_frame);
 }
 
+// WebStateObserver recording calls to WebStateRealized().
+class TestWebStateRealizedObserver : public WebStateObserver {
+ public:
+  bool web_state_realized_called() const { return web_state_realized_called_; }
+
+  // WebStateObserver:
+  void WebStateRealized(WebState* web_state) override {
+    web_state_realized_called_ = true;
+  }
+
+ private:
+  bool web_state_realized_called_ = false;
+};
+
 }  // namespace
 
 // Test fixture for web::WebStateImpl class.
@@ -1010,6 +1024,79 @@ TEST_F(WebStateImplTest, UncommittedRestoreSession) {
   EXPECT_EQ(@(1), user_data_value);
 }
 
+// Tests that an unrealized WebState answers title and URL queries from the
+// restored session, and is realized when its navigation manager is requested.
+TEST_F(WebStateImplTest, UnrealizedRestoreSession) {
+  GURL url("http://test.com");
+  CRWSessionStorage* session_storage = [[CRWSessionStorage alloc] init];
+  session_storage.lastCommittedItemIndex = 0;
+  CRWNavigationItemStorage* item_storage =
+      [[CRWNavigationItemStorage alloc] init];
+  item_storage.title = base::SysNSStringToUTF16(@"Title");
+  item_storage.virtualURL = url;
+  session_storage.itemStorages = @[ item_storage ];
+
+  web::WebState::CreateParams params(GetBrowserState());
+  WebStateImpl web_state(params, session_storage, /*realized=*/false);
+  TestWebStateRealizedObserver observer;
+  web_state.AddObserver(&observer);
+
+  EXPECT_FALSE(web_state.IsRealized());
+  EXPECT_FALSE(web_state.GetWebController());
+  EXPECT_FALSE(web_state.CanTakeSnapshot());
+  EXPECT_FALSE(web_state.IsEvicted());
+  EXPECT_NSEQ(@"Title", base::SysUTF16ToNSString(web_state.GetTitle()));
+  EXPECT_EQ(url, web_state.GetVisibleURL());
+  EXPECT_EQ(url, web_state.GetLastCommittedURL());
+
+  // The restored session is saved as is.
+  EXPECT_EQ(session_storage, web_state.BuildSessionStorage());
+
+  // Web usage is applied on realization.
+  web_state.SetWebUsageEnabled(false);
+  EXPECT_FALSE(web_state.IsWebUsageEnabled());
+  EXPECT_FALSE(web_state.IsRealized());
+  EXPECT_FALSE(observer.web_state_realized_called());
+
+  // The const navigation manager does not realize the WebState.
+  const WebStateImpl& const_web_state = web_state;
+  EXPECT_TRUE(const_web_state.GetNavigationManager());
+  EXPECT_FALSE(web_state.IsRealized());
+
+  EXPECT_TRUE(web_state.GetNavigationManager());
+  EXPECT_TRUE(web_state.IsRealized());
+  EXPECT_TRUE(observer.web_state_realized_called());
+  ASSERT_TRUE(web_state.GetWebController());
+  EXPECT_FALSE(web_state.GetWebController().webUsageEnabled);
+  EXPECT_NSEQ(@"Title", base::SysUTF16ToNSString(web_state.GetTitle()));
+  EXPECT_EQ(url, web_state.GetVisibleURL());
+
+  web_state.RemoveObserver(&observer);
+}
+
+// Tests that the metadata of the session is restored without realizing the
+// WebState.
+TEST_F(WebStateImplTest, UnrealizedRestoreSessionMetadata) {
+  CRWSessionStorage* session_storage = [[CRWSessionStorage alloc] init];
+  session_storage.hasOpener = YES;
+  session_storage.lastCommittedItemIndex = -1;
+  session_storage.itemStorages = @[];
+
+  web::WebState::CreateParams params(GetBrowserState());
+  std::unique_ptr<WebState> web_state =
+      WebState::CreateUnrealizedWithStorageSession(params, session_storage);
+
+  EXPECT_FALSE(web_state->IsRealized());
+  EXPECT_TRUE(web_state->HasOpener());
+  EXPECT_TRUE(web_state->GetSessionCertificatePolicyCache());
+  EXPECT_EQ(GURL::EmptyGURL(), web_state->GetVisibleURL());
+  EXPECT_TRUE(web_state->GetTitle().empty());
+  EXPECT_FALSE(web_state->IsRealized());
+
+  web_state->ForceRealized();
+  EXPECT_TRUE(web_state->IsRealized());
+}
+
 // Test that lastCommittedItemIndex is end-of-list when there's no defined
 // index, such as during a restore.
 TEST_F(WebStateImplTest, NoUncommittedRestoreSession) {
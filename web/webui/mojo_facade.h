@@ -77,7 +77,9 @@ class MojoFacade {
   // Writes a message to the message pipe endpoint given by handle. |args| is a
   // dictionary which must contain the following keys:
   //   - "handle" (a number representing MojoHandle, the endpoint to write to);
-  //   - "buffer" (a dictionary representing the message data; may be empty);
+  //   - "buffer" (the message data; may be empty). Either a dictionary
+  //     mapping each byte index to the byte value, or a base64 string, which
+  //     is much more compact for large messages;
   //   - "handles" (an array representing any handles to attach; handles are
   //     transferred and will no longer be valid; may be empty);
   // Returns MojoResult as a number.
@@ -85,11 +87,12 @@ class MojoFacade {
 
   // Reads a message from the message pipe endpoint given by handle. |args| is
   // a dictionary which must contain the keys "handle" (a number representing
-  // MojoHandle, the endpoint to read from).
+  // MojoHandle, the endpoint to read from). It may also contain the key
+  // "encoding" set to "base64" if the page supports the compact encoding.
   // Returns a dictionary with the following keys:
   //   - "result" (a number representing MojoResult);
-  //   - "buffer" (an array representing message data; non-empty only on
-  //     success);
+  //   - "buffer" (message data, as an array of numbers, or as a base64 string
+  //     if requested by "encoding"; non-empty only on success);
   //   - "handles" (an array representing MojoHandles received, if any);
   base::Value HandleMojoHandleReadMessage(base::Value args);
 
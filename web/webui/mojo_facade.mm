@@ -12,6 +12,7 @@
 
 #import <Foundation/Foundation.h>
 
+#include "base/base64.h"
 #include "base/bind.h"
 #import "base/ios/block_types.h"
 #include "base/json/json_reader.h"
@@ -30,6 +31,14 @@
 
 namespace web {
 
+namespace {
+
+// Value of the "encoding" argument of "MojoHandle.readMessage" requesting the
+// message data as a base64 string rather than an array of numbers.
+const char kBase64Encoding[] = "base64";
+
+}  // namespace
+
 MojoFacade::MojoFacade(WebState* web_state) : web_state_(web_state) {
   DCHECK_CURRENTLY_ON(WebThread::UI);
   DCHECK(web_state_);
@@ -134,8 +143,7 @@ base::Value MojoFacade::HandleMojoHandleWriteMessage(base::Value args) {
       args.FindKeyOfType("handles", base::Value::Type::LIST);
   CHECK(handles_list);
 
-  const base::Value* buffer =
-      args.FindKeyOfType("buffer", base::Value::Type::DICTIONARY);
+  const base::Value* buffer = args.FindKey("buffer");
   CHECK(buffer);
 
   int flags = MOJO_WRITE_MESSAGE_FLAG_NONE;
@@ -147,13 +155,22 @@ base::Value MojoFacade::HandleMojoHandleWriteMessage(base::Value args) {
     handles[i] = one_handle;
   }
 
-  std::vector<uint8_t> bytes(buffer->DictSize());
-  for (const auto& item : buffer->DictItems()) {
-    size_t index = std::numeric_limits<size_t>::max();
-    CHECK(base::StringToSizeT(item.first, &index));
-    CHECK(index < bytes.size());
-    int one_byte = item.second.GetInt();
-    bytes[index] = one_byte;
+  std::vector<uint8_t> bytes;
+  if (buffer->is_string()) {
+    // Compact encoding: the whole message as a single base64 string.
+    std::string decoded;
+    CHECK(base::Base64Decode(buffer->GetString(), &decoded));
+    bytes.assign(decoded.begin(), decoded.end());
+  } else {
+    CHECK(buffer->is_dict());
+    bytes.resize(buffer->DictSize());
+    for (const auto& item : buffer->DictItems()) {
+      size_t index = std::numeric_limits<size_t>::max();
+      CHECK(base::StringToSizeT(item.first, &index));
+      CHECK(index < bytes.size());
+      int one_byte = item.second.GetInt();
+      bytes[index] = one_byte;
+    }
   }
 
   mojo::MessagePipeHandle message_pipe(static_cast<MojoHandle>(*handle));
@@ -172,6 +189,9 @@ base::Value MojoFacade::HandleMojoHandleReadMessage(base::Value args) {
     handle_as_int = handle_as_value->GetInt();
   }
 
+  const std::string* encoding = args.FindStringKey("encoding");
+  const bool use_base64 = encoding && *encoding == kBase64Encoding;
+
   int flags = MOJO_READ_MESSAGE_FLAG_NONE;
 
   std::vector<uint8_t> bytes;
@@ -188,11 +208,15 @@ base::Value MojoFacade::HandleMojoHandleReadMessage(base::Value args) {
     }
     result.SetKey("handles", std::move(handles_list));
 
-    base::Value buffer(base::Value::Type::LIST);
-    for (uint32_t i = 0; i < bytes.size(); i++) {
-      buffer.Append(bytes[i]);
+    if (use_base64) {
+      result.SetKey("buffer", base::Value(base::Base64Encode(bytes)));
+    } else {
+      base::Value buffer(base::Value::Type::LIST);
+      for (uint32_t i = 0; i < bytes.size(); i++) {
+        buffer.Append(bytes[i]);
+      }
+      result.SetKey("buffer", std::move(buffer));
     }
-    result.SetKey("buffer", std::move(buffer));
   }
   result.SetKey("result", base::Value(static_cast<int>(mojo_result)));
 
@@ -0,0 +1,158 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#import "ios/web/webui/mojo_facade.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/base64.h"
+#include "base/json/json_reader.h"
+#include "base/json/json_writer.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/timer/elapsed_timer.h"
+#include "base/values.h"
+#import "ios/web/public/test/fakes/test_web_state.h"
+#include "ios/web/public/test/web_test.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+namespace web {
+
+namespace {
+
+// Number of round trips measured for each message size.
+const int kRoundTripCount = 10;
+
+// Returns the JSON of a "MojoHandle.writeMessage" message sending |bytes| to
+// |handle|, using the base64 encoding if |compact| is true.
+std::string GetWriteMessageJson(int handle,
+                                const std::vector<uint8_t>& bytes,
+                                bool compact) {
+  base::Value buffer;
+  if (compact) {
+    buffer = base::Value(base::Base64Encode(bytes));
+  } else {
+    buffer = base::Value(base::Value::Type::DICTIONARY);
+    for (size_t i = 0; i < bytes.size(); i++)
+      buffer.SetIntKey(base::NumberToString(i), bytes[i]);
+  }
+
+  base::Value args(base::Value::Type::DICTIONARY);
+  args.SetIntKey("handle", handle);
+  args.SetKey("handles", base::Value(base::Value::Type::LIST));
+  args.SetKey("buffer", std::move(buffer));
+
+  base::Value message(base::Value::Type::DICTIONARY);
+  message.SetStringKey("name", "MojoHandle.writeMessage");
+  message.SetKey("args", std::move(args));
+  std::string json;
+  base::JSONWriter::Write(message, &json);
+  return json;
+}
+
+// Returns the JSON of a "MojoHandle.readMessage" message reading from
+// |handle|, requesting the base64 encoding if |compact| is true.
+std::string GetReadMessageJson(int handle, bool compact) {
+  base::Value args(base::Value::Type::DICTIONARY);
+  args.SetIntKey("handle", handle);
+  if (compact)
+    args.SetStringKey("encoding", "base64");
+
+  base::Value message(base::Value::Type::DICTIONARY);
+  message.SetStringKey("name", "MojoHandle.readMessage");
+  message.SetKey("args", std::move(args));
+  std::string json;
+  base::JSONWriter::Write(message, &json);
+  return json;
+}
+
+// Measures writing a message to a pipe through MojoFacade and reading it back
+// from the other end, with the legacy per-byte encoding and with the base64
+// encoding.
+class MojoFacadePerfTest : public WebTest {
+ protected:
+  MojoFacadePerfTest() : facade_(std::make_unique<MojoFacade>(&web_state_)) {
+    base::Optional<base::Value> pipe =
+        base::JSONReader::Read(facade_->HandleMojoMessage(
+            R"({"name":"Mojo.createMessagePipe","args":{}})"));
+    handle0_ = *pipe->FindIntKey("handle0");
+    handle1_ = *pipe->FindIntKey("handle1");
+  }
+
+  ~MojoFacadePerfTest() override {
+    facade_->HandleMojoMessage(GetCloseMessageJson(handle0_));
+    facade_->HandleMojoMessage(GetCloseMessageJson(handle1_));
+  }
+
+  // Sends and reads back a message of |size| bytes |kRoundTripCount| times,
+  // and reports the average round trip time and the size of the JSON
+  // exchanged with the page.
+  void MeasureRoundTrip(size_t size, bool compact) {
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < size; i++)
+      bytes[i] = static_cast<uint8_t>(i * 31);
+
+    const std::string read_json = GetReadMessageJson(handle0_, compact);
+    size_t payload_size = 0;
+    base::ElapsedTimer timer;
+    for (int i = 0; i < kRoundTripCount; i++) {
+      // The page serializes the message, and parses the response.
+      const std::string write_json =
+          GetWriteMessageJson(handle1_, bytes, compact);
+      EXPECT_EQ("0", facade_->HandleMojoMessage(write_json));
+      const std::string response = facade_->HandleMojoMessage(read_json);
+      base::Optional<base::Value> message = base::JSONReader::Read(response);
+      ASSERT_TRUE(message);
+      payload_size = write_json.size() + response.size();
+    }
+    const base::TimeDelta elapsed = timer.Elapsed() / kRoundTripCount;
+
+    perf_test::PerfResultReporter reporter(
+        "MojoFacade.",
+        std::string(compact ? "base64_" : "legacy_") +
+            base::NumberToString(size / 1024) + "KB");
+    reporter.RegisterImportantMetric("round_trip_time", "ms");
+    reporter.RegisterImportantMetric("payload_size", "bytes");
+    reporter.AddResult("round_trip_time", elapsed);
+    reporter.AddResult("payload_size", payload_size);
+  }
+
+  // Measures round trips of all the message sizes.
+  void MeasureRoundTrips(bool compact) {
+    for (size_t size : {1024, 16 * 1024, 128 * 1024, 1024 * 1024})
+      MeasureRoundTrip(size, compact);
+  }
+
+ private:
+  static std::string GetCloseMessageJson(int handle) {
+    return R"({"name":"MojoHandle.close","args":{"handle":)" +
+           base::NumberToString(handle) + "}}";
+  }
+
+  TestWebState web_state_;
+  std::unique_ptr<MojoFacade> facade_;
+  int handle0_ = 0;
+  int handle1_ = 0;
+};
+
+TEST_F(MojoFacadePerfTest, LegacyEncoding) {
+  MeasureRoundTrips(/*compact=*/false);
+}
+
+TEST_F(MojoFacadePerfTest, Base64Encoding) {
+  MeasureRoundTrips(/*compact=*/true);
+}
+
+}  // namespace
+
+}  // namespace web
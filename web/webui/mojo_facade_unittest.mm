@@ -243,4 +243,52 @@ TEST_F(MojoFacadeTest, ReadWrite) {
   CloseHandle(handle1);
 }
 
+// Tests writing and reading a message using the base64 encoding.
+TEST_F(MojoFacadeTest, ReadWriteBase64) {
+  uint32_t handle0, handle1;
+  CreateMessagePipe(&handle0, &handle1);
+
+  // Write the bytes {9, 2, 216, 0} to the other end of the pipe.
+  NSDictionary* write = @{
+    @"name" : @"MojoHandle.writeMessage",
+    @"args" :
+        @{@"handle" : @(handle1), @"handles" : @[], @"buffer" : @"CQLYAA=="},
+  };
+  std::string result_as_string = facade()->HandleMojoMessage(GetJson(write));
+  int result = 0;
+  EXPECT_TRUE(base::StringToInt(result_as_string, &result));
+  EXPECT_EQ(MOJO_RESULT_OK, static_cast<MojoResult>(result));
+
+  // Read the message from the pipe as a base64 string.
+  NSDictionary* read = @{
+    @"name" : @"MojoHandle.readMessage",
+    @"args" : @{
+      @"handle" : @(handle0),
+      @"encoding" : @"base64",
+    },
+  };
+  NSDictionary* message = GetObject(facade()->HandleMojoMessage(GetJson(read)));
+  ASSERT_TRUE([message isKindOfClass:[NSDictionary class]]);
+  EXPECT_NSEQ(@"CQLYAA==", message[@"buffer"]);
+  EXPECT_FALSE([message[@"handles"] count]);
+  EXPECT_EQ(MOJO_RESULT_OK, [message[@"result"] unsignedIntValue]);
+
+  // A base64 message can be read by a page using the legacy encoding.
+  result_as_string = facade()->HandleMojoMessage(GetJson(write));
+  EXPECT_TRUE(base::StringToInt(result_as_string, &result));
+  EXPECT_EQ(MOJO_RESULT_OK, static_cast<MojoResult>(result));
+  read = @{
+    @"name" : @"MojoHandle.readMessage",
+    @"args" : @{
+      @"handle" : @(handle0),
+    },
+  };
+  message = GetObject(facade()->HandleMojoMessage(GetJson(read)));
+  NSArray* expected_message = @[ @9, @2, @216, @0 ];
+  EXPECT_NSEQ(expected_message, message[@"buffer"]);
+
+  CloseHandle(handle0);
+  CloseHandle(handle1);
+}
+
 }  // namespace web